@@ -21,7 +21,11 @@ HEADERS += \
     $$PWD/include/DS_Protocol.h \
     $$PWD/include/DS_DefaultProtocols.h \
     $$PWD/include/DS_Timer.h \
-    $$PWD/include/DS_Queue.h
+    $$PWD/include/DS_Queue.h \
+    $$PWD/include/DS_Discovery.h \
+    $$PWD/include/DS_Context.h \
+    $$PWD/include/DS_Capture.h \
+    $$PWD/include/DS_NetConsole.h
 
 SOURCES += \
     $$PWD/src/protocols/frc_2014.c \
@@ -38,7 +42,11 @@ SOURCES += \
     $$PWD/src/crc32.c \
     $$PWD/src/array.c \
     $$PWD/src/timer.c \
-    $$PWD/src/queue.c
+    $$PWD/src/queue.c \
+    $$PWD/src/discovery.c \
+    $$PWD/src/context.c \
+    $$PWD/src/capture.c \
+    $$PWD/src/netconsole.c
     
 include ($$PWD/lib/Socky/Socky.pri)
 include ($$PWD/lib/bstrlib/bstrlib.pri)
@@ -0,0 +1,29 @@
+TEMPLATE = app
+TARGET = LibDS_Bench
+
+CONFIG -= qt
+CONFIG += console
+
+include ($$PWD/../LibDS.pri)
+
+INCLUDEPATH += $$PWD/../emulator
+
+HEADERS += \
+    $$PWD/bench.h \
+    $$PWD/../emulator/emulator.h
+
+SOURCES += \
+    $$PWD/main.c \
+    $$PWD/bench_timers.c \
+    $$PWD/bench_sockets.c \
+    $$PWD/bench_resolver.c \
+    $$PWD/bench_scheduler.c \
+    $$PWD/bench_contexts.c \
+    $$PWD/bench_joysticks.c \
+    $$PWD/bench_crc32.c \
+    $$PWD/bench_frc2014.c \
+    $$PWD/bench_protocols.c \
+    $$PWD/bench_events.c \
+    $$PWD/bench_replay.c \
+    $$PWD/bench_loopback.c \
+    $$PWD/../emulator/emulator.c
@@ -0,0 +1,86 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LIB_DS_BENCH_H
+#define _LIB_DS_BENCH_H
+
+#include <stdint.h>
+
+/**
+ * Holds the resource usage of the process at a given point in time
+ */
+typedef struct _bench_usage {
+    uint64_t wall;     /**< Monotonic time (in nanoseconds) */
+    uint64_t cpu;      /**< Process CPU time (in nanoseconds) */
+    long switches;     /**< Voluntary + involuntary context switches */
+} Bench_Usage;
+
+/**
+ * Output formats of the benchmark results
+ */
+typedef enum {
+    BENCH_TEXT, /**< One line per benchmark (for humans) */
+    BENCH_CSV,  /**< One "bench,metric,value,unit" row per value */
+    BENCH_JSON, /**< One JSON object per value (JSON Lines) */
+} Bench_Format;
+
+/**
+ * Function measured by \c Bench_Run(), which must run the measured operation
+ * the given number of \a iterations
+ */
+typedef void (*Bench_Function) (void* data, const long iterations);
+
+extern int bench_seconds;
+extern int bench_warmup;
+extern int bench_repetitions;
+extern Bench_Format bench_format;
+
+extern void Bench_Value (const char* name,
+                         const char* metric,
+                         const double value,
+                         const char* unit);
+extern void Bench_Run (const char* name,
+                       Bench_Function function,
+                       void* data,
+                       const long iterations);
+
+extern uint64_t Bench_Cycles();
+extern void Bench_Sample (Bench_Usage* usage);
+extern void Bench_Report (const char* name,
+                          const Bench_Usage* start,
+                          const Bench_Usage* end);
+
+extern void Bench_Timers();
+extern void Bench_Sockets();
+extern void Bench_Resolver();
+extern void Bench_Scheduler();
+extern void Bench_Contexts();
+extern void Bench_Joysticks();
+extern void Bench_CRC32();
+extern void Bench_FRC2014();
+extern void Bench_Replay();
+extern void Bench_Loopback();
+extern void Bench_Protocols();
+extern void Bench_Events();
+
+#endif
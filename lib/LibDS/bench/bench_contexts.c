@@ -0,0 +1,128 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runs the FRC 2015 protocol in 1 and 64 contexts and reports the CPU usage
+ * and the memory used by each context (the memory used by the shared
+ * threads is included). The input sockets of every context
+ * are bound to ephemeral ports, so that the contexts do not collide.
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define CONTEXT_COUNT 64
+
+/**
+ * Returns the resident memory of the process (in KiB)
+ */
+static long resident_memory()
+{
+    long pages = 0;
+    FILE* file = fopen ("/proc/self/statm", "r");
+
+    if (file) {
+        if (fscanf (file, "%*s %ld", &pages) != 1)
+            pages = 0;
+
+        fclose (file);
+    }
+
+    return pages * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * Loads the FRC 2015 protocol in the current context, the robot packets are
+ * sent to the loopback interface
+ */
+static void configure_context()
+{
+    DS_Protocol* protocol = DS_GetProtocolFRC_2015();
+    protocol->fms_socket->in_port = 0;
+    protocol->radio_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    protocol->netconsole_socket->in_port = 0;
+
+    DS_SetCustomRobotAddress ("127.0.0.1");
+    DS_ConfigureProtocol (protocol);
+}
+
+/**
+ * Runs the given number of contexts for the configured number of seconds
+ * and prints the resource usage of the process
+ */
+static void run_contexts (const char* name, const int count)
+{
+    int i;
+    Bench_Usage start, end;
+    DS_Context* contexts [CONTEXT_COUNT];
+
+    long memory = resident_memory();
+
+    DS_Init();
+    configure_context();
+
+    /* Create the extra contexts */
+    for (i = 1; i < count; ++i) {
+        contexts [i] = DS_ContextCreate();
+        DS_SetCurrentContext (contexts [i]);
+        configure_context();
+    }
+
+    DS_SetCurrentContext (NULL);
+    memory = (resident_memory() - memory) / count;
+
+    /* Let the contexts run */
+    DS_Sleep (100);
+    DS_ResetSendStats (DS_CHANNEL_ROBOT);
+    Bench_Sample (&start);
+    DS_Sleep (bench_seconds * 1000);
+    Bench_Sample (&end);
+
+    DS_SendStats stats = DS_GetSendStats (DS_CHANNEL_ROBOT);
+
+    /* Destroy the contexts */
+    for (i = 1; i < count; ++i)
+        DS_ContextDestroy (contexts [i]);
+
+    DS_Close();
+
+    double wall = (end.wall - start.wall) / 1e9;
+    double cpu = 100 * ((end.cpu - start.cpu) / 1e9) / wall;
+    Bench_Value (name, "cpu", cpu, "%");
+    Bench_Value (name, "cpu-per-context", cpu / count, "%");
+    Bench_Value (name, "memory", memory, "KiB/context");
+    Bench_Value (name, "robot-rate", stats.sent / (double) bench_seconds, "Hz");
+}
+
+/**
+ * Measures the cost of running many driver station instances
+ */
+void Bench_Contexts()
+{
+    run_contexts ("contexts/1", 1);
+    run_contexts ("contexts/64", CONTEXT_COUNT);
+}
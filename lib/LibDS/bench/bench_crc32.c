@@ -0,0 +1,83 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the throughput of each CRC32 kernel with the size of a FRC 2014
+ * robot packet and with a larger buffer. Cycles are read from the time stamp
+ * counter, which runs at the nominal frequency of the CPU.
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+
+#include <stdio.h>
+
+#define TOTAL_BYTES (256 * 1024 * 1024) /* Bytes hashed per measurement */
+
+/**
+ * Hashes a buffer of the given \a length with the given \a kernel and prints
+ * the throughput in bytes per cycle and in GB/s
+ */
+static void run_kernel (const char* name,
+                        uint32_t (*kernel) (const void*, size_t),
+                        const int length)
+{
+    int i;
+    char label [64];
+    static uint8_t buffer [64 * 1024];
+    volatile uint32_t checksum = 0;
+    int rounds = TOTAL_BYTES / length;
+
+    for (i = 0; i < length; ++i)
+        buffer [i] = (uint8_t) (i * 31);
+
+    uint64_t start = DS_GetTime();
+    uint64_t start_cycles = Bench_Cycles();
+    for (i = 0; i < rounds; ++i)
+        checksum ^= kernel (buffer, length);
+    uint64_t cycles = Bench_Cycles() - start_cycles;
+    uint64_t time = DS_GetTime() - start;
+
+    double bytes = (double) rounds * length;
+    snprintf (label, sizeof (label), "crc32/%s/%d", name, length);
+    if (cycles > 0)
+        Bench_Value (label, "throughput", bytes / cycles, "bytes/cycle");
+    Bench_Value (label, "throughput", bytes / time, "GB/s");
+}
+
+/**
+ * Measures the throughput of the CRC32 kernels
+ */
+void Bench_CRC32()
+{
+    int i;
+    const int lengths [2] = {1024, 64 * 1024};
+
+    for (i = 0; i < 2; ++i) {
+        run_kernel ("bytewise", &DS_CRC32Bytewise, lengths [i]);
+        run_kernel ("slice8", &DS_CRC32Slice8, lengths [i]);
+
+        if (DS_CRC32FoldingSupported())
+            run_kernel ("folding", &DS_CRC32Folding, lengths [i]);
+    }
+}
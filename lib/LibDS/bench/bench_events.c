@@ -0,0 +1,211 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the throughput of the generic queue, and of DS_AddEvent() and
+ * DS_PollEvent() with a full and with an empty event queue. Items are pushed
+ * and popped in batches, like the event loop generates them and the client
+ * application reads them (one by one and with DS_PollEvents()). The event
+ * queue is also measured with several threads adding events while the main
+ * thread polls them.
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+#include "DS_Queue.h"
+
+#include <pthread.h>
+
+#define BATCH      32      /* Items pushed before popping them */
+#define PRODUCERS  4       /* Threads adding events in the contended bench */
+#define ITERATIONS 1000000 /* Items pushed/polled in each repetition */
+
+static pthread_mutex_t producers_lock = PTHREAD_MUTEX_INITIALIZER;
+static int producers_running = 0;
+
+/**
+ * Pushes and pops the given number of events through a queue
+ */
+static void push_pop (void* data, const long iterations)
+{
+    int j;
+    long i;
+    DS_Event event;
+    DS_Queue* queue = (DS_Queue*) data;
+
+    event.type = DS_ROBOT_ENABLED_CHANGED;
+    for (i = 0; i < iterations; i += BATCH) {
+        for (j = 0; j < BATCH; ++j)
+            DS_QueuePush (queue, &event);
+
+        for (j = 0; j < BATCH; ++j) {
+            DS_QueueGetFirst (queue);
+            DS_QueuePop (queue);
+        }
+    }
+}
+
+/**
+ * Adds and polls the given number of events
+ */
+static void add_poll (void* data, const long iterations)
+{
+    int j;
+    long i;
+    DS_Event event;
+
+    (void) data;
+
+    for (i = 0; i < iterations; i += BATCH) {
+        for (j = 0; j < BATCH; ++j) {
+            event.type = DS_ROBOT_ENABLED_CHANGED;
+            DS_AddEvent (&event);
+        }
+
+        while (DS_PollEvent (&event));
+    }
+}
+
+/**
+ * Adds the given number of events and drains them with DS_PollEvents()
+ */
+static void add_poll_batch (void* data, const long iterations)
+{
+    int j;
+    long i;
+    DS_Event event;
+    DS_Event buffer [BATCH];
+
+    (void) data;
+
+    for (i = 0; i < iterations; i += BATCH) {
+        for (j = 0; j < BATCH; ++j) {
+            event.type = DS_ROBOT_ENABLED_CHANGED;
+            DS_AddEvent (&event);
+        }
+
+        while (DS_PollEvents (buffer, BATCH) == BATCH);
+    }
+}
+
+/**
+ * Adds the number of events given by \a data from a producer thread
+ */
+static void* producer (void* data)
+{
+    long i;
+    DS_Event event;
+    long count = *((long*) data);
+
+    for (i = 0; i < count; ++i) {
+        event.type = DS_ROBOT_ENABLED_CHANGED;
+        DS_AddEvent (&event);
+    }
+
+    pthread_mutex_lock (&producers_lock);
+    --producers_running;
+    pthread_mutex_unlock (&producers_lock);
+
+    return NULL;
+}
+
+/**
+ * Adds the given number of events from several threads while this thread
+ * polls them
+ */
+static void add_poll_contended (void* data, const long iterations)
+{
+    int i;
+    int running;
+    DS_Event event;
+    pthread_t threads [PRODUCERS];
+    long count = iterations / PRODUCERS;
+
+    (void) data;
+
+    producers_running = PRODUCERS;
+    for (i = 0; i < PRODUCERS; ++i)
+        pthread_create (&threads [i], NULL, &producer, &count);
+
+    do {
+        pthread_mutex_lock (&producers_lock);
+        running = producers_running;
+        pthread_mutex_unlock (&producers_lock);
+
+        while (DS_PollEvent (&event));
+    } while (running > 0);
+
+    for (i = 0; i < PRODUCERS; ++i)
+        pthread_join (threads [i], NULL);
+}
+
+/**
+ * Polls the empty event queue the given number of times
+ */
+static void poll_empty (void* data, const long iterations)
+{
+    long i;
+    DS_Event event;
+
+    (void) data;
+
+    for (i = 0; i < iterations; ++i)
+        DS_PollEvent (&event);
+}
+
+/**
+ * Measures the event queue and event polling throughput
+ */
+void Bench_Events()
+{
+    DS_Queue queue;
+    DS_Event event;
+    DS_EventStats before;
+    DS_EventStats after;
+
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    DS_QueueInit (&queue, 50, sizeof (DS_Event));
+    Bench_Run ("events/queue/push-pop", &push_pop, &queue, ITERATIONS);
+    DS_QueueFree (&queue);
+
+    while (DS_PollEvent (&event));
+    Bench_Run ("events/add-poll", &add_poll, NULL, ITERATIONS);
+    Bench_Run ("events/add-poll-batch", &add_poll_batch, NULL, ITERATIONS);
+    Bench_Run ("events/poll-empty", &poll_empty, NULL, ITERATIONS);
+
+    DS_GetEventStats (&before);
+    Bench_Run ("events/add-poll/contended", &add_poll_contended, NULL,
+               ITERATIONS);
+    DS_GetEventStats (&after);
+    Bench_Value ("events/add-poll/contended", "dropped",
+                 100.0 * (after.dropped - before.dropped) /
+                 (after.added + after.dropped - before.added - before.dropped),
+                 "%");
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
@@ -0,0 +1,128 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the time needed to generate a FRC 2014 robot packet. The packet
+ * keeps its last contents and only updates the checksum with the bytes that
+ * changed, the cost of that update is reported next to the cost of a full
+ * checksum of the packet (with the fastest and with the bytewise kernels).
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PACKETS 200000 /* Packets generated for each measurement */
+
+/**
+ * Prints the mean number of cycles and nanoseconds of each packet
+ */
+static void report (const char* name, uint64_t cycles, uint64_t time)
+{
+    if (cycles > 0)
+        Bench_Value (name, "mean", cycles / (double) PACKETS, "cycles/packet");
+    Bench_Value (name, "mean", time / (double) PACKETS, "ns/packet");
+}
+
+/**
+ * Generates robot packets with changing joystick values
+ */
+static void run_packets()
+{
+    int i;
+    static DS_Packet packet;
+    DS_Protocol* protocol = DS_CurrentProtocol();
+
+    uint64_t start = DS_GetTime();
+    uint64_t start_cycles = Bench_Cycles();
+    for (i = 0; i < PACKETS; ++i) {
+        DS_SetJoystickAxis (0, 0, (i & 1) ? 0.5 : -0.5);
+
+        packet.length = 0;
+        protocol->create_robot_packet (&packet);
+    }
+
+    report ("frc2014/robot/packet",
+            Bench_Cycles() - start_cycles, DS_GetTime() - start);
+}
+
+/**
+ * Updates the checksum of a robot packet after its first 40 bytes (header
+ * and joysticks) change, either by patching the checksum or by calculating
+ * the checksum of the whole packet with the given \a checksum function
+ */
+static void run_checksum (const char* name,
+                          uint32_t (*checksum) (const void*, size_t))
+{
+    int i;
+    uint8_t before [40];
+    static uint8_t packet [1024];
+    volatile uint32_t crc = DS_CRC32 (packet, sizeof (packet));
+
+    uint64_t start = DS_GetTime();
+    uint64_t start_cycles = Bench_Cycles();
+    for (i = 0; i < PACKETS; ++i) {
+        memcpy (before, packet, sizeof (before));
+        packet [0] = (uint8_t) (i >> 8);
+        packet [1] = (uint8_t) i;
+        packet [8] = (uint8_t) (i & 1 ? 0x40 : 0xc0);
+
+        if (checksum)
+            crc = checksum (packet, sizeof (packet));
+        else
+            crc = DS_CRC32Patch (crc, before, packet, sizeof (before),
+                                 sizeof (packet) - sizeof (before));
+    }
+
+    report (name, Bench_Cycles() - start_cycles, DS_GetTime() - start);
+}
+
+/**
+ * Measures the FRC 2014 robot packet generation time
+ */
+void Bench_FRC2014()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    DS_Protocol* protocol = DS_GetProtocolFRC_2014();
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    DS_ConfigureProtocol (protocol);
+
+    DS_JoysticksAdd (6, 0, 10);
+    DS_SetRobotEnabled (1);
+
+    run_packets();
+    run_checksum ("frc2014/checksum/patched", NULL);
+    run_checksum ("frc2014/checksum/full", &DS_CRC32);
+    run_checksum ("frc2014/checksum/full-slice8", &DS_CRC32Slice8);
+    run_checksum ("frc2014/checksum/full-bytewise", &DS_CRC32Bytewise);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
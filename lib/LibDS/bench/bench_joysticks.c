@@ -0,0 +1,211 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the time needed to generate a FRC 2015 robot packet with one to
+ * six joysticks, both when the joystick values do not change between packets
+ * and when every joystick changes before each packet. The cost of changing a
+ * joystick value is also measured, as well as the cost of publishing a whole
+ * joystick frame with one call or with one call per value.
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+
+#include <stdio.h>
+
+#define PACKETS 200000  /* Packets generated in each repetition */
+#define CHANGES 1000000 /* Joystick values changed in each repetition */
+#define FRAMES  200000  /* Joystick frames published in each repetition */
+
+#define AXES    6  /* Axes of the benchmarked joysticks */
+#define HATS    1  /* Hats of the benchmarked joysticks */
+#define BUTTONS 10 /* Buttons of the benchmarked joysticks */
+
+/**
+ * Holds the parameters of an encoder run
+ */
+typedef struct _encoder {
+    int joysticks; /**< Number of joysticks */
+    int changing;  /**< Set to change every joystick before each packet */
+    int length;    /**< Length of the last packet */
+} Encoder;
+
+/**
+ * Generates the given number of robot packets
+ */
+static void encode_packets (void* data, const long iterations)
+{
+    int j;
+    long i;
+    static DS_Packet packet;
+    Encoder* encoder = (Encoder*) data;
+    DS_Protocol* protocol = DS_CurrentProtocol();
+
+    for (i = 0; i < iterations; ++i) {
+        if (encoder->changing) {
+            for (j = 0; j < encoder->joysticks; ++j)
+                DS_SetJoystickAxis (j, 0, (i & 1) ? 0.5 : -0.5);
+        }
+
+        packet.length = 0;
+        protocol->create_robot_packet (&packet);
+    }
+
+    encoder->length = packet.length;
+}
+
+/**
+ * Changes the first axis of the first joystick
+ */
+static void set_axis (void* data, const long iterations)
+{
+    long i;
+    (void) data;
+
+    for (i = 0; i < iterations; ++i)
+        DS_SetJoystickAxis (0, 0, (i & 1) ? 0.5 : -0.5);
+}
+
+/**
+ * Changes the first button of the first joystick
+ */
+static void set_button (void* data, const long iterations)
+{
+    long i;
+    (void) data;
+
+    for (i = 0; i < iterations; ++i)
+        DS_SetJoystickButton (0, 0, i & 1);
+}
+
+/**
+ * Changes the first hat of the first joystick
+ */
+static void set_hat (void* data, const long iterations)
+{
+    long i;
+    (void) data;
+
+    for (i = 0; i < iterations; ++i)
+        DS_SetJoystickHat (0, 0, (i & 1) ? 90 : 0);
+}
+
+/**
+ * Publishes whole joystick frames with DS_SetJoystickState()
+ */
+static void set_frame (void* data, const long iterations)
+{
+    int j;
+    long i;
+    int hats [HATS];
+    float axes [AXES];
+    (void) data;
+
+    for (i = 0; i < iterations; ++i) {
+        for (j = 0; j < AXES; ++j)
+            axes [j] = (i & 1) ? 0.5 : -0.5;
+        for (j = 0; j < HATS; ++j)
+            hats [j] = (i & 1) ? 90 : 0;
+
+        DS_SetJoystickState (0, axes, (i & 1) ? 0x155 : 0x2aa, hats);
+    }
+}
+
+/**
+ * Publishes the same joystick frames as \c set_frame(), but calling one
+ * setter for each axis, hat and button
+ */
+static void set_frame_elements (void* data, const long iterations)
+{
+    int j;
+    long i;
+    (void) data;
+
+    for (i = 0; i < iterations; ++i) {
+        for (j = 0; j < AXES; ++j)
+            DS_SetJoystickAxis (0, j, (i & 1) ? 0.5 : -0.5);
+        for (j = 0; j < HATS; ++j)
+            DS_SetJoystickHat (0, j, (i & 1) ? 90 : 0);
+        for (j = 0; j < BUTTONS; ++j)
+            DS_SetJoystickButton (0, j, ((i + j) & 1));
+    }
+}
+
+/**
+ * Generates robot packets with the given number of \a joysticks and prints
+ * the time needed to generate each packet
+ */
+static void run_encoder (const int joysticks, const int changing)
+{
+    int i;
+    char name [64];
+    Encoder encoder = { joysticks, changing, 0 };
+
+    DS_JoysticksReset();
+    for (i = 0; i < joysticks; ++i)
+        DS_JoysticksAdd (AXES, HATS, BUTTONS);
+
+    snprintf (name, sizeof (name), "joysticks/%d/%s",
+              joysticks, changing ? "changing" : "idle");
+    Bench_Run (name, &encode_packets, &encoder, PACKETS);
+    Bench_Value (name, "size", encoder.length, "bytes");
+}
+
+/**
+ * Measures the robot packet encoding time for 1 to 6 joysticks, and the cost
+ * of changing the joystick values
+ */
+void Bench_Joysticks()
+{
+    int i;
+
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    DS_Protocol* protocol = DS_GetProtocolFRC_2015();
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    protocol->netconsole_socket->in_port = 0;
+    DS_ConfigureProtocol (protocol);
+    DS_SetRobotEnabled (1);
+
+    for (i = 1; i <= 6; ++i) {
+        run_encoder (i, 0);
+        run_encoder (i, 1);
+    }
+
+    DS_JoysticksReset();
+    DS_JoysticksAdd (AXES, HATS, BUTTONS);
+    Bench_Run ("joysticks/set/axis", &set_axis, NULL, CHANGES);
+    Bench_Run ("joysticks/set/button", &set_button, NULL, CHANGES);
+    Bench_Run ("joysticks/set/hat", &set_hat, NULL, CHANGES);
+    Bench_Run ("joysticks/set/frame", &set_frame, NULL, FRAMES);
+    Bench_Run ("joysticks/set/frame-elements", &set_frame_elements, NULL,
+               FRAMES);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
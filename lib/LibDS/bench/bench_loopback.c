@@ -0,0 +1,131 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runs the DS against the robot and FMS emulator over the loopback interface
+ * and reports the packet rates, the round-trip time of the robot packets and
+ * the packet loss seen by the DS. The last run injects loss and delay in the
+ * emulator, the loss seen by the DS should match the injected loss.
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+#include "emulator.h"
+
+#include <stdio.h>
+
+/**
+ * Counts the NetConsole messages received by the DS and discards the other
+ * events
+ */
+static unsigned long poll_events()
+{
+    DS_Event event;
+    unsigned long messages = 0;
+
+    while (DS_PollEvent (&event)) {
+        if (event.type == DS_NETCONSOLE_NEW_MESSAGE)
+            ++messages;
+    }
+
+    return messages;
+}
+
+/**
+ * Runs the given \a protocol against the emulator with the given \a config
+ * for the configured number of seconds and prints the results
+ */
+static void run_loopback (const char* name,
+                          DS_Protocol* (*protocol)(),
+                          const Emulator_Config* config)
+{
+    int i;
+    unsigned long messages = 0;
+
+    DS_Init();
+    DS_SetCustomFMSAddress ("127.0.0.1");
+    DS_SetCustomRobotAddress ("127.0.0.1");
+    DS_ConfigureProtocol (protocol());
+
+    if (!Emulator_Start (config)) {
+        fprintf (stderr, "%s: emulator failed\n", name);
+        DS_Close();
+        return;
+    }
+
+    /* Let the DS connect to the robot */
+    DS_Sleep (500);
+    poll_events();
+    Emulator_ResetStats();
+    DS_ResetLossStats (DS_CHANNEL_ROBOT);
+    DS_ResetLatencyStats (DS_CHANNEL_ROBOT);
+
+    for (i = 0; i < bench_seconds * 10; ++i) {
+        DS_Sleep (100);
+        messages += poll_events();
+    }
+
+    DS_LatencyStats rtt = DS_GetLatencyStats (DS_CHANNEL_ROBOT);
+    DS_LossStats loss = DS_GetUplinkLoss (DS_CHANNEL_ROBOT);
+    Emulator_Stats stats = Emulator_GetStats();
+    int connected = DS_GetRobotCommunications();
+
+    Emulator_Stop();
+    DS_Close();
+
+    double seconds = (double) bench_seconds;
+    Bench_Value (name, "up", stats.robot_received / seconds, "pkt/s");
+    Bench_Value (name, "down", stats.robot_sent / seconds, "pkt/s");
+    Bench_Value (name, "rtt-p50", rtt.p50, "ms");
+    Bench_Value (name, "rtt-p99", rtt.p99, "ms");
+    Bench_Value (name, "loss", loss.loss, "%");
+    Bench_Value (name, "netconsole", messages / seconds, "msg/s");
+    Bench_Value (name, "connected", connected, "bool");
+}
+
+/**
+ * Runs every protocol against the emulator, then the FRC 2015 protocol with
+ * 5 % loss in each direction and 10-15 ms of delay
+ */
+void Bench_Loopback()
+{
+    Emulator_Config config;
+    Emulator_DefaultConfig (&config);
+
+    config.protocol = EMULATOR_FRC_2014;
+    run_loopback ("loopback/frc2014", &DS_GetProtocolFRC_2014, &config);
+
+    config.protocol = EMULATOR_FRC_2015;
+    run_loopback ("loopback/frc2015", &DS_GetProtocolFRC_2015, &config);
+
+    config.protocol = EMULATOR_FRC_2016;
+    run_loopback ("loopback/frc2016", &DS_GetProtocolFRC_2016, &config);
+
+    config.protocol = EMULATOR_FRC_2015;
+    config.fms = 1;
+    config.delay = 10;
+    config.jitter = 5;
+    config.uplink_loss = 5;
+    config.downlink_loss = 5;
+    run_loopback ("loopback/frc2015/lossy", &DS_GetProtocolFRC_2015, &config);
+}
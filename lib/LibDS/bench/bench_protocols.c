@@ -0,0 +1,177 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the time needed to encode and decode the FMS and robot packets of
+ * each default protocol. The decoded packets do not change between
+ * iterations, so decoding them does not generate events.
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ITERATIONS 200000 /* Packets encoded/decoded in each repetition */
+
+/**
+ * Holds the packet generator of a protocol
+ */
+typedef struct _encoder {
+    void (*create) (DS_Packet*); /**< Generator of the protocol */
+    int length;                  /**< Length of the last packet */
+} Encoder;
+
+/**
+ * Holds a packet given to the decoder of a protocol
+ */
+typedef struct _decoder {
+    int (*read) (const bstring);  /**< Decoder of the protocol */
+    const uint8_t* data;          /**< Packet bytes */
+    int length;                   /**< Packet length */
+} Decoder;
+
+/**
+ * Generates the given number of packets with the given generator
+ */
+static void encode_packets (void* data, const long iterations)
+{
+    long i;
+    static DS_Packet packet;
+    Encoder* encoder = (Encoder*) data;
+
+    for (i = 0; i < iterations; ++i) {
+        packet.length = 0;
+        encoder->create (&packet);
+    }
+
+    encoder->length = packet.length;
+}
+
+/**
+ * Decodes the same packet the given number of times
+ */
+static void decode_packets (void* data, const long iterations)
+{
+    long i;
+    struct tagbstring packet;
+    Decoder* decoder = (Decoder*) data;
+
+    btfromblk (packet, decoder->data, decoder->length);
+    for (i = 0; i < iterations; ++i)
+        decoder->read (&packet);
+}
+
+/**
+ * Measures the encoder of the given \a kind of packet, if the protocol sends
+ * such packets
+ */
+static void run_encoder (const char* protocol, const char* kind,
+                         void (*create) (DS_Packet*))
+{
+    char name [64];
+    static DS_Packet packet;
+    Encoder encoder = { create, 0 };
+
+    /* The protocol does not send this kind of packet */
+    packet.length = 0;
+    create (&packet);
+    if (packet.length == 0)
+        return;
+
+    snprintf (name, sizeof (name), "protocols/%s/encode-%s", protocol, kind);
+    Bench_Run (name, &encode_packets, &encoder, ITERATIONS);
+    Bench_Value (name, "size", encoder.length, "bytes");
+}
+
+/**
+ * Measures the decoder of the given \a kind of packet
+ */
+static void run_decoder (const char* protocol, const char* kind,
+                         int (*read) (const bstring),
+                         const uint8_t* data, const int length)
+{
+    char name [64];
+    Decoder decoder = { read, data, length };
+
+    snprintf (name, sizeof (name), "protocols/%s/decode-%s", protocol, kind);
+    Bench_Run (name, &decode_packets, &decoder, ITERATIONS);
+}
+
+/**
+ * Loads the given protocol (with three joysticks and the robot enabled) and
+ * measures its encoders and decoders
+ */
+static void run_protocol (const char* name, DS_Protocol* protocol,
+                          const uint8_t* fms, const int fms_length,
+                          const uint8_t* robot, const int robot_length)
+{
+    int i;
+
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    protocol->netconsole_socket->in_port = 0;
+    DS_ConfigureProtocol (protocol);
+
+    DS_JoysticksReset();
+    for (i = 0; i < 3; ++i)
+        DS_JoysticksAdd (6, 1, 10);
+
+    DS_SetRobotEnabled (1);
+
+    run_encoder (name, "fms", protocol->create_fms_packet);
+    run_encoder (name, "robot", protocol->create_robot_packet);
+    run_decoder (name, "fms", protocol->read_fms_packet, fms, fms_length);
+    run_decoder (name, "robot", protocol->read_robot_packet,
+                 robot, robot_length);
+}
+
+/**
+ * Measures the encoders and decoders of the FRC 2014, 2015 and 2016 protocols
+ */
+void Bench_Protocols()
+{
+    static uint8_t fms_2014 [5] = { 0x00, 0x00, 0x20, 'R', '1' };
+    static uint8_t robot_2014 [1024] = { 0x40, 0x12, 0x00 };
+    static uint8_t fms_2015 [22] = { 0x00, 0x01, 0x00, 0x04, 0x00, 0x00 };
+    static uint8_t robot_2015 [8] = { 0x00, 0x01, 0x01, 0x04, 0x20, 12, 0 };
+
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    run_protocol ("frc2014", DS_GetProtocolFRC_2014(),
+                  fms_2014, sizeof (fms_2014),
+                  robot_2014, sizeof (robot_2014));
+    run_protocol ("frc2015", DS_GetProtocolFRC_2015(),
+                  fms_2015, sizeof (fms_2015),
+                  robot_2015, sizeof (robot_2015));
+    run_protocol ("frc2016", DS_GetProtocolFRC_2016(),
+                  fms_2015, sizeof (fms_2015),
+                  robot_2015, sizeof (robot_2015));
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
@@ -0,0 +1,126 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the parser throughput of the protocols by replaying a synthetic
+ * capture of robot packets as fast as possible. The robot values do not
+ * change between packets, so the replay does not flood the event queue.
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PACKETS      200000            /* Packets written to each capture */
+#define CAPTURE_FILE "LibDS_Bench.cap" /* Capture file (removed afterwards) */
+
+/**
+ * Writes a capture of robot packets with the given \a length, generated by
+ * the given \a fill function
+ */
+static void write_capture (const int length,
+                           void (*fill) (uint8_t* packet, const int index))
+{
+    int i;
+    static uint8_t packet [DS_PACKET_CAPACITY];
+
+    remove (CAPTURE_FILE);
+    DS_Capture* capture = DS_CaptureOpen (CAPTURE_FILE);
+
+    for (i = 0; i < PACKETS; ++i) {
+        memset (packet, 0, length);
+        fill (packet, i);
+        DS_CaptureWrite (capture, DS_CAPTURE_ROBOT, DS_CAPTURE_INBOUND,
+                         packet, length);
+    }
+
+    DS_CaptureClose (capture);
+}
+
+/**
+ * Fills a FRC 2014 robot packet (12 V, robot not e-stopped)
+ */
+static void fill_2014 (uint8_t* packet, const int index)
+{
+    (void) index;
+    packet [1] = 0x12;
+}
+
+/**
+ * Fills a FRC 2015 robot packet (echoed index, robot code, 12 V)
+ */
+static void fill_2015 (uint8_t* packet, const int index)
+{
+    packet [0] = (uint8_t) (index >> 8);
+    packet [1] = (uint8_t) index;
+    packet [4] = 0x20;
+    packet [5] = 12;
+}
+
+/**
+ * Replays the capture with the given \a protocol and prints the throughput
+ */
+static void run_replay (const char* name, DS_Protocol* protocol)
+{
+    DS_ReplayStats stats;
+
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    protocol->netconsole_socket->in_port = 0;
+    DS_ConfigureProtocol (protocol);
+
+    if (!DS_ReplayCapture (CAPTURE_FILE, 0, &stats) || stats.time == 0) {
+        fprintf (stderr, "%s: replay failed\n", name);
+        return;
+    }
+
+    double seconds = stats.time / 1e9;
+    Bench_Value (name, "rate", stats.packets / seconds, "packets/s");
+    Bench_Value (name, "throughput", stats.bytes / seconds / 1e6, "MB/s");
+    Bench_Value (name, "mean", stats.time / (double) stats.packets, "ns/packet");
+    Bench_Value (name, "rejected", stats.packets - stats.accepted, "packets");
+}
+
+/**
+ * Measures the replay throughput of the FRC 2014 and 2015 protocols
+ */
+void Bench_Replay()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    write_capture (1024, &fill_2014);
+    run_replay ("replay/frc2014/robot", DS_GetProtocolFRC_2014());
+
+    write_capture (8, &fill_2015);
+    run_replay ("replay/frc2015/robot", DS_GetProtocolFRC_2015());
+
+    remove (CAPTURE_FILE);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
@@ -0,0 +1,125 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Compares the cost of sending a datagram to a host name when the address
+ * is resolved for every packet (like the old udp_sendto() did) against the
+ * cost of sending it with the resolver cache.
+ *
+ * A stub resolver that takes 1 ms to answer is used to emulate a slow mDNS
+ * lookup (e.g. roboRIO-TEAM-FRC.local) without depending on the network.
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <socky.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#define SENDS 500
+#define HOST  "roboRIO-3794-FRC.local"
+#define PORT  "11700"
+
+/**
+ * Emulates a slow lookup that always resolves to the loopback address
+ */
+static int stub_resolver (const char* host, const char* service,
+                          struct sockaddr_storage* addr, socklen_t* len)
+{
+    (void) host;
+
+    struct sockaddr_in* in = (struct sockaddr_in*) addr;
+    memset (addr, 0, sizeof (struct sockaddr_storage));
+    in->sin_family = AF_INET;
+    in->sin_port = htons (atoi (service));
+    in->sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    *len = sizeof (struct sockaddr_in);
+
+    DS_Sleep (1);
+    return 0;
+}
+
+/**
+ * Prints the mean and maximum cost of a send
+ */
+static void report (const char* name, const double sum, const double max)
+{
+    Bench_Value (name, "mean", sum / SENDS / 1000.0, "us");
+    Bench_Value (name, "max", max / 1000.0, "us");
+}
+
+/**
+ * Measures the send cost with and without the resolver cache
+ */
+void Bench_Resolver()
+{
+    int i;
+    double sum, max;
+    char data [] = "LibDS";
+
+    sockets_init (0);
+    socky_set_resolver (&stub_resolver);
+    int sfd = create_client_udp (SOCKY_IPv4, 0);
+
+    /* Resolve the address for every packet */
+    sum = max = 0;
+    for (i = 0; i < SENDS; ++i) {
+        uint64_t start = DS_GetTime();
+
+        socklen_t len;
+        struct sockaddr_storage addr;
+        if (stub_resolver (HOST, PORT, &addr, &len) == 0)
+            sendto (sfd, data, sizeof (data), 0, (struct sockaddr*) &addr, len);
+
+        double time = (double) (DS_GetTime() - start);
+        max = time > max ? time : max;
+        sum += time;
+    }
+
+    report ("resolver/uncached", sum, max);
+
+    /* Let the resolver thread resolve the address */
+    while (udp_sendto (sfd, data, sizeof (data), HOST, PORT, 0) < 0)
+        DS_Sleep (1);
+
+    /* Send with the cached address */
+    sum = max = 0;
+    for (i = 0; i < SENDS; ++i) {
+        uint64_t start = DS_GetTime();
+        udp_sendto (sfd, data, sizeof (data), HOST, PORT, 0);
+
+        double time = (double) (DS_GetTime() - start);
+        max = time > max ? time : max;
+        sum += time;
+    }
+
+    report ("resolver/cached", sum, max);
+
+    socket_close (sfd);
+    socky_set_resolver (NULL);
+    sockets_exit();
+}
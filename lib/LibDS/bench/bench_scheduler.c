@@ -0,0 +1,95 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runs the FRC 2015 protocol against the loopback interface and reports the
+ * send jitter of the robot channel (which must hold a 50 Hz cadence), both
+ * with an idle system and with one busy thread per CPU core.
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+static volatile int load_running = 0;
+
+/**
+ * Keeps a CPU core busy until the benchmark ends
+ */
+static void* generate_load (void* ptr)
+{
+    (void) ptr;
+
+    volatile unsigned long counter = 0;
+    while (load_running)
+        ++counter;
+
+    return NULL;
+}
+
+/**
+ * Sends robot packets for the configured number of seconds and prints the
+ * send statistics of the robot channel
+ */
+static void run_scheduler (const char* name, const int threads)
+{
+    int i;
+    pthread_t load [64];
+    int count = DS_Min (threads, 64);
+
+    load_running = 1;
+    for (i = 0; i < count; ++i)
+        pthread_create (&load [i], NULL, &generate_load, NULL);
+
+    DS_Init();
+    DS_SetCustomRobotAddress ("127.0.0.1");
+    DS_ConfigureProtocol (DS_GetProtocolFRC_2015());
+    DS_Sleep (100);
+    DS_ResetSendStats (DS_CHANNEL_ROBOT);
+    DS_Sleep (bench_seconds * 1000);
+
+    DS_SendStats stats = DS_GetSendStats (DS_CHANNEL_ROBOT);
+    DS_Close();
+
+    load_running = 0;
+    for (i = 0; i < count; ++i)
+        pthread_join (load [i], NULL);
+
+    Bench_Value (name, "rate", stats.sent / (double) bench_seconds, "Hz");
+    Bench_Value (name, "jitter-mean", stats.mean_jitter, "us");
+    Bench_Value (name, "jitter-stddev", stats.stddev_jitter, "us");
+    Bench_Value (name, "jitter-max", stats.max_jitter, "us");
+    Bench_Value (name, "skipped", stats.skipped, "deadlines");
+}
+
+/**
+ * Measures the send cadence of the robot channel with and without load
+ */
+void Bench_Scheduler()
+{
+    run_scheduler ("scheduler/robot/idle", 0);
+    run_scheduler ("scheduler/robot/load", (int) sysconf (_SC_NPROCESSORS_ONLN));
+}
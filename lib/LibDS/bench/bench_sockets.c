@@ -0,0 +1,160 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Measures the time between sending a datagram to a LibDS socket over the
+ * loopback interface and the moment in which a thread waiting with
+ * DS_SocketWaitForData() is able to read it, and the cost of sending a
+ * datagram with DS_SocketSend() and DS_SocketSendBuffer().
+ */
+
+#include "bench.h"
+#include "LibDS.h"
+
+#include <stdio.h>
+#include <socky.h>
+
+#define SAMPLES 1000  /* Datagrams used to measure the receive latency */
+#define SENDS   20000 /* Datagrams sent in each repetition */
+#define PORT    11500 /* Receiver port (PORT + 2 is never read) */
+
+/**
+ * Sends datagrams to a LibDS socket and prints the receive latency
+ */
+static void run_receive_latency()
+{
+    int i;
+    int received = 0;
+    double sum = 0;
+    double max = 0;
+
+    /* Open the receiver socket */
+    DS_Socket* socket = DS_SocketEmpty();
+    socket->in_port = PORT;
+    socket->out_port = PORT + 1;
+    DS_SocketOpen (socket);
+
+    /* Open the sender socket */
+    bstring data = bfromcstr ("LibDS");
+    int sender = create_client_udp (SOCKY_IPv4, 0);
+
+    for (i = 0; i < SAMPLES; ++i) {
+        uint64_t start = DS_GetTime();
+        udp_sendto (sender, (char*) data->data, blength (data),
+                    "127.0.0.1", "11500", 0);
+
+        /* Wait for the datagram (up to 100 ms) */
+        bstring packet = NULL;
+        while (!packet && DS_GetTime() - start < 100000000ULL) {
+            DS_SocketWaitForData (start + 100000000ULL);
+            packet = DS_SocketRead (socket);
+        }
+
+        /* Update statistics */
+        if (packet) {
+            double latency = (DS_GetTime() - start) / 1000.0;
+            max = latency > max ? latency : max;
+            sum += latency;
+            ++received;
+        }
+
+        bdestroy (packet);
+        DS_Sleep (1);
+    }
+
+    Bench_Value ("sockets/recv-latency", "mean",
+                 received ? sum / received : 0, "us");
+    Bench_Value ("sockets/recv-latency", "max", max, "us");
+    Bench_Value ("sockets/recv-latency", "received",
+                 received * 100.0 / SAMPLES, "%");
+
+    /* Close the sockets */
+    socket_close (sender);
+    DS_SocketClose (socket);
+    DS_FREE (socket);
+    bdestroy (data);
+}
+
+/**
+ * Sends the given number of datagrams with \c DS_SocketSend()
+ */
+static void send_strings (void* data, const long iterations)
+{
+    long i;
+    static struct tagbstring packet = bsStatic ("LibDS robot packet");
+
+    for (i = 0; i < iterations; ++i)
+        DS_SocketSend ((DS_Socket*) data, &packet);
+}
+
+/**
+ * Sends the given number of datagrams with \c DS_SocketSendBuffer()
+ */
+static void send_buffers (void* data, const long iterations)
+{
+    long i;
+    static const char packet [] = "LibDS robot packet";
+
+    for (i = 0; i < iterations; ++i)
+        DS_SocketSendBuffer ((DS_Socket*) data, packet, sizeof (packet) - 1);
+}
+
+/**
+ * Measures the cost of sending a datagram to a port that is never read (the
+ * datagrams are dropped by the operating system once its buffer is full)
+ */
+static void run_send_cost()
+{
+    char port [16];
+    snprintf (port, sizeof (port), "%d", PORT + 2);
+    int sink = create_server_udp (port, SOCKY_IPv4, 0);
+
+    DS_Socket* socket = DS_SocketEmpty();
+    socket->in_port = 0;
+    socket->out_port = PORT + 2;
+    socket->address = bfromcstr ("127.0.0.1");
+    DS_SocketOpen (socket);
+
+    Bench_Run ("sockets/send", &send_strings, socket, SENDS);
+    Bench_Run ("sockets/send-buffer", &send_buffers, socket, SENDS);
+
+    DS_SocketClose (socket);
+    DS_FREESTR (socket->address);
+    DS_FREE (socket);
+    socket_close (sink);
+}
+
+/**
+ * Measures the receive latency and the send cost of the LibDS sockets
+ */
+void Bench_Sockets()
+{
+    Timers_Init();
+    Sockets_Init();
+
+    run_receive_latency();
+    run_send_cost();
+
+    Sockets_Close();
+    Timers_Close();
+}
@@ -0,0 +1,221 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Compares the timer service against the old timer implementation, which
+ * used one thread per timer (each thread woke up every 'precision' msecs).
+ *
+ * Both implementations run the six timers used by the protocol module. The
+ * "idle" case only keeps the timers running, while the "loop" case also
+ * resets expired timers every 5 ms (like the protocol event loop does).
+ *
+ * The wake-up jitter of DS_SleepUntil() (which is used by the timer service
+ * and the event loop) is also measured with a 1 ms period.
+ */
+
+#include "bench.h"
+#include "DS_Timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define TIMER_COUNT    6
+#define WAKEUP_SAMPLES 1000
+
+/*
+ * Times and precisions of the timers used by the protocol module (based on
+ * the 2015 protocol)
+ */
+static const int times [TIMER_COUNT] = { 500, 1000, 20, 1000, 1000, 1000 };
+static const int precisions [TIMER_COUNT] = { 1, 1, 1, 50, 50, 50 };
+
+/*
+ * Legacy timer implementation
+ */
+static int legacy_running = 0;
+static DS_Timer legacy_timers [TIMER_COUNT];
+static pthread_t legacy_threads [TIMER_COUNT];
+
+/**
+ * Copy of the old timer thread function
+ */
+static void* legacy_update_timer (void* ptr)
+{
+    DS_Timer* timer = (DS_Timer*) ptr;
+
+    while (legacy_running == 1) {
+        if (timer->enabled && timer->time > 0 && !timer->expired) {
+            timer->elapsed += timer->precision;
+
+            if (timer->elapsed >= timer->time)
+                timer->expired = 1;
+        }
+
+        DS_Sleep (timer->precision);
+    }
+
+    return NULL;
+}
+
+/**
+ * Emulates the protocol event loop, which resets expired timers
+ */
+static void run_loop (DS_Timer* timers, const int legacy)
+{
+    uint64_t end = DS_GetTime() + (uint64_t) bench_seconds * 1000000000ULL;
+
+    while (DS_GetTime() < end) {
+        int i;
+        for (i = 0; i < TIMER_COUNT; ++i) {
+            if (timers [i].expired) {
+                if (legacy) {
+                    timers [i].expired = 0;
+                    timers [i].elapsed = 0;
+                }
+
+                else
+                    DS_TimerReset (&timers [i]);
+            }
+        }
+
+        DS_Sleep (5);
+    }
+}
+
+/**
+ * Runs the legacy timers (with or without the event loop)
+ */
+static void bench_legacy (const int loop)
+{
+    int i;
+    Bench_Usage start, end;
+
+    legacy_running = 1;
+    memset (legacy_timers, 0, sizeof (legacy_timers));
+    for (i = 0; i < TIMER_COUNT; ++i) {
+        legacy_timers [i].enabled = 1;
+        legacy_timers [i].time = times [i];
+        legacy_timers [i].precision = precisions [i];
+        pthread_create (&legacy_threads [i], NULL,
+                        &legacy_update_timer, &legacy_timers [i]);
+    }
+
+    Bench_Sample (&start);
+    if (loop)
+        run_loop (legacy_timers, 1);
+    else
+        DS_Sleep (bench_seconds * 1000);
+    Bench_Sample (&end);
+
+    legacy_running = 0;
+    for (i = 0; i < TIMER_COUNT; ++i)
+        pthread_join (legacy_threads [i], NULL);
+
+    Bench_Report (loop ? "timers/legacy/loop" : "timers/legacy/idle",
+                  &start, &end);
+}
+
+/**
+ * Runs the timer service (with or without the event loop)
+ */
+static void bench_service (const int loop)
+{
+    int i;
+    Bench_Usage start, end;
+    DS_Timer timers [TIMER_COUNT];
+
+    Timers_Init();
+    memset (timers, 0, sizeof (timers));
+    for (i = 0; i < TIMER_COUNT; ++i) {
+        DS_TimerInit (&timers [i], times [i], precisions [i]);
+        DS_TimerStart (&timers [i]);
+    }
+
+    Bench_Sample (&start);
+    if (loop)
+        run_loop (timers, 0);
+    else
+        DS_Sleep (bench_seconds * 1000);
+    Bench_Sample (&end);
+
+    for (i = 0; i < TIMER_COUNT; ++i)
+        DS_TimerStop (&timers [i]);
+    Timers_Close();
+
+    Bench_Report (loop ? "timers/service/loop" : "timers/service/idle",
+                  &start, &end);
+}
+
+/**
+ * Compares two doubles (used to sort the wake-up delays)
+ */
+static int compare_doubles (const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Sleeps until deadlines placed every millisecond and prints how late the
+ * thread wakes up after each deadline
+ */
+static void bench_wakeup()
+{
+    int i;
+    double sum = 0;
+    static double delays [WAKEUP_SAMPLES];
+
+    uint64_t deadline = DS_GetTime();
+    for (i = 0; i < WAKEUP_SAMPLES; ++i) {
+        deadline += 1000000ULL;
+        DS_SleepUntil (deadline);
+
+        delays [i] = (DS_GetTime() - deadline) / 1000.0;
+        sum += delays [i];
+    }
+
+    qsort (delays, WAKEUP_SAMPLES, sizeof (double), &compare_doubles);
+
+    Bench_Value ("timers/wakeup-jitter", "mean", sum / WAKEUP_SAMPLES, "us");
+    Bench_Value ("timers/wakeup-jitter", "p50",
+                 delays [WAKEUP_SAMPLES / 2], "us");
+    Bench_Value ("timers/wakeup-jitter", "p99",
+                 delays [WAKEUP_SAMPLES * 99 / 100], "us");
+    Bench_Value ("timers/wakeup-jitter", "max",
+                 delays [WAKEUP_SAMPLES - 1], "us");
+}
+
+/**
+ * Measures the CPU usage and wakeups per second of both timer implementations,
+ * and the wake-up jitter of the timer service
+ */
+void Bench_Timers()
+{
+    bench_legacy (0);
+    bench_service (0);
+    bench_legacy (1);
+    bench_service (1);
+    bench_wakeup();
+}
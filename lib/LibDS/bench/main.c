@@ -0,0 +1,320 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include "DS_Timer.h"
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+    #include <x86intrin.h>
+#endif
+
+#define MAX_REPETITIONS 100 /* Maximum number of repetitions of Bench_Run */
+
+/**
+ * Holds a benchmark that can be selected from the command line
+ */
+typedef struct _bench_entry {
+    const char* name;  /**< Prefix of the benchmark results */
+    void (*run)();     /**< Benchmark function */
+} Bench_Entry;
+
+/*
+ * Every benchmark, in the order in which they run
+ */
+static const Bench_Entry benches [] = {
+    { "timers", &Bench_Timers },
+    { "sockets", &Bench_Sockets },
+    { "resolver", &Bench_Resolver },
+    { "scheduler", &Bench_Scheduler },
+    { "contexts", &Bench_Contexts },
+    { "joysticks", &Bench_Joysticks },
+    { "crc32", &Bench_CRC32 },
+    { "frc2014", &Bench_FRC2014 },
+    { "protocols", &Bench_Protocols },
+    { "events", &Bench_Events },
+    { "replay", &Bench_Replay },
+    { "loopback", &Bench_Loopback },
+};
+
+/**
+ * Number of seconds that each time-based benchmark runs for
+ */
+int bench_seconds = 3;
+
+/**
+ * Number of untimed runs before the timed repetitions of \c Bench_Run()
+ */
+int bench_warmup = 1;
+
+/**
+ * Number of timed repetitions of \c Bench_Run()
+ */
+int bench_repetitions = 5;
+
+/**
+ * Output format of the results
+ */
+Bench_Format bench_format = BENCH_TEXT;
+
+/*
+ * Name of the benchmark printed in the current text line
+ */
+static char text_line [64] = "";
+
+/**
+ * Returns the value of the time stamp counter of the CPU (which runs at the
+ * nominal frequency of the CPU), or \c 0 if it is not available
+ */
+uint64_t Bench_Cycles()
+{
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Obtains the current wall time, CPU time and context switch count of the
+ * process (all threads are included)
+ */
+void Bench_Sample (Bench_Usage* usage)
+{
+    struct rusage ru;
+    getrusage (RUSAGE_SELF, &ru);
+
+    usage->wall = DS_GetTime();
+    usage->switches = ru.ru_nvcsw + ru.ru_nivcsw;
+    usage->cpu = ((uint64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL)
+                 + ((uint64_t) (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL);
+}
+
+/**
+ * Prints the CPU usage and the context switches per second between the
+ * \a start and \a end samples
+ */
+void Bench_Report (const char* name,
+                   const Bench_Usage* start,
+                   const Bench_Usage* end)
+{
+    double wall = (end->wall - start->wall) / 1e9;
+    double cpu = (end->cpu - start->cpu) / 1e9;
+    double switches = (double) (end->switches - start->switches);
+
+    Bench_Value (name, "cpu", 100 * cpu / wall, "%");
+    Bench_Value (name, "wakeups", switches / wall, "/s");
+}
+
+/**
+ * Ends the current line of the text output
+ */
+static void end_text_line()
+{
+    if (text_line [0] != '\0') {
+        printf ("\n");
+        text_line [0] = '\0';
+    }
+}
+
+/**
+ * Prints a result in the selected output format. In the text format, the
+ * values of the same benchmark are printed in the same line.
+ *
+ * \param name the name of the benchmark (e.g. "crc32/slice8/1024")
+ * \param metric the name of the value (e.g. "median")
+ * \param value the measured value
+ * \param unit the unit of the value (e.g. "ns/op")
+ */
+void Bench_Value (const char* name,
+                  const char* metric,
+                  const double value,
+                  const char* unit)
+{
+    switch (bench_format) {
+    case BENCH_CSV:
+        printf ("%s,%s,%.6g,%s\n", name, metric, value, unit);
+        break;
+    case BENCH_JSON:
+        printf ("{\"bench\":\"%s\",\"metric\":\"%s\",\"value\":%.6g,"
+                "\"unit\":\"%s\"}\n", name, metric, value, unit);
+        break;
+    default:
+        if (strcmp (text_line, name) != 0) {
+            end_text_line();
+            snprintf (text_line, sizeof (text_line), "%s", name);
+            printf ("%-32s", name);
+        }
+
+        printf ("   %s %.2f %s", metric, value, unit);
+        break;
+    }
+
+    fflush (stdout);
+}
+
+/**
+ * Compares two doubles (used to sort the repetitions)
+ */
+static int compare_doubles (const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Runs the given \a function \c bench_warmup times without measuring it, and
+ * then \c bench_repetitions times with the given number of \a iterations.
+ * The median, minimum and standard deviation of the time of each iteration
+ * are printed, together with the median cycles per iteration (if the time
+ * stamp counter is available).
+ *
+ * \param name the name of the benchmark
+ * \param function the function that runs the measured operation
+ * \param data the argument given to the \a function
+ * \param iterations the iterations of each repetition
+ */
+void Bench_Run (const char* name,
+                Bench_Function function,
+                void* data,
+                const long iterations)
+{
+    int i;
+    double sum = 0;
+    double deviation = 0;
+    double times [MAX_REPETITIONS];
+    double cycles [MAX_REPETITIONS];
+    int count = bench_repetitions;
+
+    if (count < 1)
+        count = 1;
+    if (count > MAX_REPETITIONS)
+        count = MAX_REPETITIONS;
+
+    for (i = 0; i < bench_warmup; ++i)
+        function (data, iterations);
+
+    for (i = 0; i < count; ++i) {
+        uint64_t start = DS_GetTime();
+        uint64_t start_cycles = Bench_Cycles();
+        function (data, iterations);
+        cycles [i] = (Bench_Cycles() - start_cycles) / (double) iterations;
+        times [i] = (DS_GetTime() - start) / (double) iterations;
+        sum += times [i];
+    }
+
+    for (i = 0; i < count; ++i)
+        deviation += (times [i] - sum / count) * (times [i] - sum / count);
+
+    qsort (times, count, sizeof (double), &compare_doubles);
+    qsort (cycles, count, sizeof (double), &compare_doubles);
+
+    Bench_Value (name, "median", times [count / 2], "ns/op");
+    Bench_Value (name, "min", times [0], "ns/op");
+    Bench_Value (name, "stddev", sqrt (deviation / count), "ns/op");
+    if (cycles [count / 2] > 0)
+        Bench_Value (name, "cycles", cycles [count / 2], "cycles/op");
+}
+
+/**
+ * Prints the command line options of the benchmarks
+ */
+static void usage (const char* name)
+{
+    printf ("Usage: %s [seconds] [options]\n\n"
+            "  --seconds <n>                duration of time-based benchmarks\n"
+            "  --warmup <n>                 untimed runs before measuring\n"
+            "  --repetitions <n>            timed repetitions (median is used)\n"
+            "  --format <text|csv|json>     output format\n"
+            "  --filter <name>              only run the given benchmark\n",
+            name);
+}
+
+/**
+ * Runs every benchmark (or the benchmark selected with --filter), the first
+ * argument may also be the number of seconds that each benchmark runs for
+ */
+int main (int argc, char** argv)
+{
+    int i;
+    const char* filter = NULL;
+
+    for (i = 1; i < argc; ++i) {
+        const char* option = argv [i];
+        const char* value = (i + 1 < argc) ? argv [i + 1] : NULL;
+
+        /* Number of seconds (kept for compatibility) */
+        if (atoi (option) > 0) {
+            bench_seconds = atoi (option);
+            continue;
+        }
+
+        /* Every option needs a value */
+        if (!value) {
+            usage (argv [0]);
+            return EXIT_FAILURE;
+        }
+
+        if (strcmp (option, "--seconds") == 0)
+            bench_seconds = atoi (value) > 0 ? atoi (value) : bench_seconds;
+        else if (strcmp (option, "--warmup") == 0)
+            bench_warmup = atoi (value) >= 0 ? atoi (value) : bench_warmup;
+        else if (strcmp (option, "--repetitions") == 0)
+            bench_repetitions = atoi (value) > 0 ? atoi (value) : bench_repetitions;
+        else if (strcmp (option, "--filter") == 0)
+            filter = value;
+        else if (strcmp (option, "--format") == 0) {
+            if (strcmp (value, "csv") == 0)
+                bench_format = BENCH_CSV;
+            else if (strcmp (value, "json") == 0)
+                bench_format = BENCH_JSON;
+            else
+                bench_format = BENCH_TEXT;
+        }
+
+        else {
+            usage (argv [0]);
+            return EXIT_FAILURE;
+        }
+
+        ++i;
+    }
+
+    if (bench_format == BENCH_CSV)
+        printf ("bench,metric,value,unit\n");
+
+    for (i = 0; i < (int) (sizeof (benches) / sizeof (benches [0])); ++i) {
+        if (!filter || strcmp (filter, benches [i].name) == 0)
+            benches [i].run();
+    }
+
+    end_text_line();
+    return EXIT_SUCCESS;
+}
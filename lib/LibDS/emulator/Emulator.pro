@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = LibDS_Emulator
+
+CONFIG -= qt
+CONFIG += console
+
+include ($$PWD/../LibDS.pri)
+
+HEADERS += \
+    $$PWD/emulator.h
+
+SOURCES += \
+    $$PWD/main.c \
+    $$PWD/emulator.c
@@ -0,0 +1,543 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Emulates a robot (and optionally the FMS) on the local machine, so that the
+ * DS can be tested and measured without hardware. The emulator answers the
+ * DS-to-robot packets with status packets (echoing the sequence numbers used
+ * to measure the round-trip time), asks for the date/time, sends NetConsole
+ * bursts and FMS packets, and can drop or delay packets on purpose.
+ */
+
+#include "emulator.h"
+#include "DS_Timer.h"
+
+#include <socky.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if !defined _WIN32
+    #include <sys/select.h>
+    #include <netinet/in.h>
+#endif
+
+/*
+ * Ports used by the FRC control system
+ */
+#define ROBOT_PORT         "1110" /* Robot input port */
+#define FMS_PORT           "1160" /* FMS input port */
+#define DS_ROBOT_PORT      1150   /* DS input port for robot packets */
+#define DS_FMS_PORT        1120   /* DS input port for FMS packets */
+#define DS_NETCONSOLE_PORT 6666   /* DS input port for NetConsole messages */
+
+/*
+ * Protocol bytes
+ */
+#define FRC2014_PACKET_SIZE    1024 /* Size of a 2014 robot packet */
+#define FRC2014_ENABLED        0x20 /* 2014 FMS robot enabled flag */
+#define FRC2015_ENABLED        0x04 /* 2015 FMS robot enabled flag */
+#define FRC2015_TAG_DATE       0x0f /* 2015 date/time tag */
+#define FRC2015_HAS_CODE       0x20 /* 2015 robot has code flag */
+#define FRC2015_REQUEST_TIME   0x01 /* 2015 date/time request */
+#define FRC2015_FMS_SIZE       22   /* Size of a 2015 FMS packet */
+
+/*
+ * Delay queue properties
+ */
+#define QUEUE_SIZE    128  /* Answers that can be delayed at the same time */
+#define MAX_DATAGRAM  2048 /* Maximum size of a datagram */
+#define POLL_INTERVAL 10   /* Maximum time between loop iterations (in ms) */
+
+/**
+ * Holds an answer that waits in the delay queue
+ */
+typedef struct _emulator_datagram {
+    int used;                          /**< Set if the slot holds an answer */
+    int port;                          /**< DS port of the answer */
+    uint64_t due;                      /**< Time at which it must be sent */
+    int length;                        /**< Length of the answer */
+    uint8_t data [FRC2014_PACKET_SIZE]; /**< Answer bytes */
+} Emulator_Datagram;
+
+/*
+ * Configuration and counters (the counters are read by other threads)
+ */
+static Emulator_Config config;
+static Emulator_Stats stats;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Emulator thread and sockets
+ */
+static pthread_t thread;
+static atomic_int running = 0;
+static int robot_sfd = -1;
+static int fms_sfd = -1;
+
+/*
+ * Address of the DS (learned from the first packet that it sends)
+ */
+static int ds_known = 0;
+static socklen_t ds_length = 0;
+static struct sockaddr_storage ds_address;
+
+/*
+ * Protocol state
+ */
+static uint32_t random_state = 1;
+static int time_pending = 0;
+static unsigned int fms_index = 0;
+static unsigned int netconsole_index = 0;
+static Emulator_Datagram queue [QUEUE_SIZE];
+
+/**
+ * Increments the given counter of the emulator statistics
+ */
+static void count (unsigned long* counter)
+{
+    pthread_mutex_lock (&stats_lock);
+    ++(*counter);
+    pthread_mutex_unlock (&stats_lock);
+}
+
+/**
+ * Returns a pseudo-random number (xorshift32), the sequence only depends on
+ * the configured seed so that runs can be repeated
+ */
+static uint32_t next_random()
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/**
+ * Returns \c 1 if a packet must be dropped with the given \a loss percentage
+ */
+static int drop (const int loss)
+{
+    return loss > 0 && (int) (next_random() % 100) < loss;
+}
+
+/**
+ * Sends the given datagram to the given \a port of the DS
+ */
+static void send_to_ds (const int port, const void* data, const int length)
+{
+    struct sockaddr_storage address = ds_address;
+
+    if (address.ss_family == AF_INET)
+        ((struct sockaddr_in*) &address)->sin_port = htons (port);
+    else if (address.ss_family == AF_INET6)
+        ((struct sockaddr_in6*) &address)->sin6_port = htons (port);
+
+    sendto (robot_sfd, (const char*) data, length, 0,
+            (struct sockaddr*) &address, ds_length);
+}
+
+/**
+ * Sends the given answer to the DS after the configured delay, or drops it
+ * if the downlink loss says so
+ *
+ * \returns \c 1 if the answer was sent (or queued)
+ */
+static int answer (const int port, const uint8_t* data, const int length)
+{
+    int i;
+
+    if (drop (config.downlink_loss)) {
+        count (&stats.downlink_lost);
+        return 0;
+    }
+
+    /* No delay, send the answer right away */
+    if (config.delay <= 0 && config.jitter <= 0) {
+        send_to_ds (port, data, length);
+        return 1;
+    }
+
+    /* Find a free slot in the delay queue */
+    for (i = 0; i < QUEUE_SIZE; ++i) {
+        if (!queue [i].used)
+            break;
+    }
+
+    if (i == QUEUE_SIZE || length > FRC2014_PACKET_SIZE) {
+        count (&stats.overflows);
+        return 0;
+    }
+
+    uint64_t delay = config.delay;
+    if (config.jitter > 0)
+        delay += next_random() % (config.jitter + 1);
+
+    queue [i].used = 1;
+    queue [i].port = port;
+    queue [i].length = length;
+    queue [i].due = DS_GetTime() + delay * 1000000ULL;
+    memcpy (queue [i].data, data, length);
+
+    return 1;
+}
+
+/**
+ * Sends the delayed answers that are due at the given \a time
+ *
+ * \returns the time at which the next delayed answer is due (or 0)
+ */
+static uint64_t flush_queue (const uint64_t time)
+{
+    int i;
+    uint64_t next = 0;
+
+    for (i = 0; i < QUEUE_SIZE; ++i) {
+        if (!queue [i].used)
+            continue;
+
+        if (queue [i].due <= time) {
+            send_to_ds (queue [i].port, queue [i].data, queue [i].length);
+            queue [i].used = 0;
+        }
+
+        else if (next == 0 || queue [i].due < next)
+            next = queue [i].due;
+    }
+
+    return next;
+}
+
+/**
+ * Writes the given \a voltage in the 2015 format (integer and 1/255 parts)
+ */
+static void encode_voltage (const float voltage, uint8_t* upper, uint8_t* lower)
+{
+    *upper = (uint8_t) voltage;
+    *lower = (uint8_t) ((voltage - *upper) * 0xff);
+}
+
+/**
+ * Answers a FRC 2014 robot packet. The answer echoes the control code (which
+ * holds the e-stop state) and carries the battery voltage, scaled the way the
+ * 2014 protocol expects it.
+ */
+static void read_2014_robot_packet (const uint8_t* data, const int length)
+{
+    uint8_t upper, lower;
+    static uint8_t packet [FRC2014_PACKET_SIZE];
+
+    if (length < 8)
+        return;
+
+    encode_voltage (config.voltage, &upper, &lower);
+
+    memset (packet, 0, sizeof (packet));
+    packet [0] = data [2];
+    packet [1] = (uint8_t) (upper * 0x12 / 12);
+    packet [2] = (uint8_t) (lower * 0x12 / 12 > 0xff ? 0xff : lower * 0x12 / 12);
+
+    if (answer (DS_ROBOT_PORT, packet, sizeof (packet)))
+        count (&stats.robot_sent);
+}
+
+/**
+ * Answers a FRC 2015 robot packet. The answer echoes the packet index and the
+ * control code, reports the robot code and the voltage, and asks for the
+ * date/time until the DS sends it.
+ */
+static void read_2015_robot_packet (const uint8_t* data, const int length)
+{
+    uint8_t packet [8];
+
+    if (length < 6)
+        return;
+
+    /* The DS sent the date/time instead of the joystick data */
+    if (length > 7 && data [7] == FRC2015_TAG_DATE && time_pending) {
+        time_pending = 0;
+        count (&stats.time_received);
+    }
+
+    packet [0] = data [0];
+    packet [1] = data [1];
+    packet [2] = 0x01;
+    packet [3] = data [3];
+    packet [4] = config.robot_code ? FRC2015_HAS_CODE : 0x00;
+    packet [7] = time_pending ? FRC2015_REQUEST_TIME : 0x00;
+    encode_voltage (config.voltage, &packet [5], &packet [6]);
+
+    if (answer (DS_ROBOT_PORT, packet, sizeof (packet))) {
+        count (&stats.robot_sent);
+        if (time_pending)
+            count (&stats.time_requests);
+    }
+}
+
+/**
+ * Sends a FMS packet to the DS, which sets the robot enabled state and the
+ * team station (red 1). The control mode is not changed.
+ */
+static void send_fms_packet()
+{
+    uint8_t packet [FRC2015_FMS_SIZE];
+    memset (packet, 0, sizeof (packet));
+
+    packet [0] = (uint8_t) (fms_index >> 8);
+    packet [1] = (uint8_t) fms_index;
+
+    if (config.protocol == EMULATOR_FRC_2014) {
+        packet [2] = config.fms_enabled ? FRC2014_ENABLED : 0x00;
+        packet [3] = 'R';
+        packet [4] = '1';
+    }
+
+    else
+        packet [3] = config.fms_enabled ? FRC2015_ENABLED : 0x00;
+
+    ++fms_index;
+    if (answer (DS_FMS_PORT, packet, sizeof (packet)))
+        count (&stats.fms_sent);
+}
+
+/**
+ * Sends a burst of NetConsole messages to the DS (the 2014 DS does not
+ * listen to NetConsole messages)
+ */
+static void send_netconsole_burst()
+{
+    int i;
+    char message [64];
+
+    if (config.protocol == EMULATOR_FRC_2014)
+        return;
+
+    for (i = 0; i < config.netconsole_burst; ++i) {
+        int length = snprintf (message, sizeof (message),
+                               "Emulator message %u", netconsole_index++);
+
+        send_to_ds (DS_NETCONSOLE_PORT, message, length);
+        count (&stats.netconsole_sent);
+    }
+}
+
+/**
+ * Reads every datagram received by the given socket, and learns the address
+ * of the DS from them
+ */
+static void read_socket (const int sfd)
+{
+    int length;
+    uint8_t data [MAX_DATAGRAM];
+    struct sockaddr_storage address;
+    socklen_t address_length = sizeof (address);
+
+    while ((length = recvfrom (sfd, (char*) data, sizeof (data), 0,
+                               (struct sockaddr*) &address,
+                               &address_length)) > 0) {
+        ds_known = 1;
+        ds_address = address;
+        ds_length = address_length;
+        address_length = sizeof (address);
+
+        /* FMS packets are only counted */
+        if (sfd == fms_sfd) {
+            count (&stats.fms_received);
+            continue;
+        }
+
+        count (&stats.robot_received);
+        if (drop (config.uplink_loss)) {
+            count (&stats.uplink_lost);
+            continue;
+        }
+
+        if (config.protocol == EMULATOR_FRC_2014)
+            read_2014_robot_packet (data, length);
+        else
+            read_2015_robot_packet (data, length);
+    }
+}
+
+/**
+ * Waits for DS packets (or for the next scheduled task) and answers them
+ */
+static void* run_emulator()
+{
+    uint64_t next_fms = DS_GetTime();
+    uint64_t next_netconsole = DS_GetTime();
+
+    while (running) {
+        uint64_t now = DS_GetTime();
+        uint64_t deadline = now + POLL_INTERVAL * 1000000ULL;
+
+        /* Send the delayed answers */
+        uint64_t next_answer = flush_queue (now);
+        if (next_answer > 0 && next_answer < deadline)
+            deadline = next_answer;
+
+        /* Send the FMS packets and NetConsole bursts */
+        if (ds_known) {
+            if (config.fms && config.fms_interval > 0 && now >= next_fms) {
+                send_fms_packet();
+                next_fms = now + config.fms_interval * 1000000ULL;
+            }
+
+            if (config.netconsole_interval > 0 && now >= next_netconsole) {
+                send_netconsole_burst();
+                next_netconsole = now + config.netconsole_interval * 1000000ULL;
+            }
+        }
+
+        /* Wait for DS packets */
+        fd_set set;
+        struct timeval tv;
+        uint64_t timeout = deadline > now ? (deadline - now) / 1000 : 0;
+        tv.tv_sec = (long) (timeout / 1000000);
+        tv.tv_usec = (long) (timeout % 1000000);
+
+        FD_ZERO (&set);
+        FD_SET (robot_sfd, &set);
+        FD_SET (fms_sfd, &set);
+
+        int max = robot_sfd > fms_sfd ? robot_sfd : fms_sfd;
+        if (select (max + 1, &set, NULL, NULL, &tv) <= 0)
+            continue;
+
+        if (FD_ISSET (robot_sfd, &set))
+            read_socket (robot_sfd);
+        if (FD_ISSET (fms_sfd, &set))
+            read_socket (fms_sfd);
+    }
+
+    return NULL;
+}
+
+/**
+ * Fills the given \a config with the default emulator configuration: a 2016
+ * robot with code, 12.5 V, NetConsole bursts every second and no FMS, loss
+ * or delay
+ */
+void Emulator_DefaultConfig (Emulator_Config* config)
+{
+    if (!config)
+        return;
+
+    memset (config, 0, sizeof (Emulator_Config));
+    config->protocol = EMULATOR_FRC_2016;
+    config->voltage = 12.5;
+    config->robot_code = 1;
+    config->request_time = 1;
+    config->fms_interval = 500;
+    config->netconsole_interval = 1000;
+    config->netconsole_burst = 5;
+    config->seed = 1;
+}
+
+/**
+ * Opens the robot and FMS ports and starts the emulator thread. The sockets
+ * API must be initialized (\c DS_Init() or \c sockets_init() do so).
+ *
+ * \returns \c 1 on success, \c 0 if the emulator is already running or if
+ *          the ports cannot be opened
+ */
+int Emulator_Start (const Emulator_Config* configuration)
+{
+    if (running || !configuration)
+        return 0;
+
+    /* Open the robot and FMS ports */
+    robot_sfd = create_server_udp (ROBOT_PORT, SOCKY_IPv4, 0);
+    fms_sfd = create_server_udp (FMS_PORT, SOCKY_IPv4, 0);
+    if (robot_sfd < 0 || fms_sfd < 0) {
+        fprintf (stderr, "Cannot open the emulator ports\n");
+        Emulator_Stop();
+        return 0;
+    }
+
+    set_socket_block (robot_sfd, 0);
+    set_socket_block (fms_sfd, 0);
+
+    /* Reset the emulator state */
+    config = *configuration;
+    ds_known = 0;
+    fms_index = 0;
+    netconsole_index = 0;
+    time_pending = config.request_time && config.protocol != EMULATOR_FRC_2014;
+    random_state = config.seed ? config.seed : 1;
+    memset (queue, 0, sizeof (queue));
+    Emulator_ResetStats();
+
+    /* Start the emulator thread */
+    running = 1;
+    if (pthread_create (&thread, NULL, &run_emulator, NULL) != 0) {
+        fprintf (stderr, "Cannot start the emulator thread\n");
+        running = 0;
+        Emulator_Stop();
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Stops the emulator thread and closes its ports
+ */
+void Emulator_Stop()
+{
+    if (running) {
+        running = 0;
+        pthread_join (thread, NULL);
+    }
+
+    if (robot_sfd >= 0)
+        socket_close (robot_sfd);
+    if (fms_sfd >= 0)
+        socket_close (fms_sfd);
+
+    robot_sfd = -1;
+    fms_sfd = -1;
+}
+
+/**
+ * Returns the traffic counters of the emulator
+ */
+Emulator_Stats Emulator_GetStats()
+{
+    pthread_mutex_lock (&stats_lock);
+    Emulator_Stats copy = stats;
+    pthread_mutex_unlock (&stats_lock);
+
+    return copy;
+}
+
+/**
+ * Resets the traffic counters of the emulator
+ */
+void Emulator_ResetStats()
+{
+    pthread_mutex_lock (&stats_lock);
+    memset (&stats, 0, sizeof (stats));
+    pthread_mutex_unlock (&stats_lock);
+}
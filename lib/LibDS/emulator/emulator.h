@@ -0,0 +1,91 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LIB_DS_EMULATOR_H
+#define _LIB_DS_EMULATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * Wire formats spoken by the emulator (the 2016 control system uses the
+ * 2015 wire format)
+ */
+typedef enum {
+    EMULATOR_FRC_2014,
+    EMULATOR_FRC_2015,
+    EMULATOR_FRC_2016,
+} Emulator_Protocol;
+
+/**
+ * Holds the configuration of the robot and FMS emulator
+ */
+typedef struct _emulator_config {
+    Emulator_Protocol protocol; /**< Wire format of the packets */
+    float voltage;              /**< Battery voltage reported by the robot */
+    int robot_code;             /**< Set if the robot reports user code */
+    int request_time;           /**< Set to request the date/time (2015) */
+    int fms;                    /**< Set to send FMS packets to the DS */
+    int fms_enabled;            /**< Robot enabled flag sent by the FMS */
+    int fms_interval;           /**< Time between FMS packets (in ms) */
+    int netconsole_interval;    /**< Time between NetConsole bursts (in ms) */
+    int netconsole_burst;       /**< Messages in each NetConsole burst */
+    int uplink_loss;            /**< DS packets dropped (in percent) */
+    int downlink_loss;          /**< Answers dropped (in percent) */
+    int delay;                  /**< Delay added to each answer (in ms) */
+    int jitter;                 /**< Random delay added to the delay (in ms) */
+    unsigned int seed;          /**< Seed of the loss and jitter generator */
+} Emulator_Config;
+
+/**
+ * Holds the traffic counters of the emulator
+ */
+typedef struct _emulator_stats {
+    unsigned long robot_received;  /**< DS-to-robot packets received */
+    unsigned long robot_sent;      /**< Robot-to-DS packets sent */
+    unsigned long fms_received;    /**< DS-to-FMS packets received */
+    unsigned long fms_sent;        /**< FMS-to-DS packets sent */
+    unsigned long uplink_lost;     /**< DS packets dropped on purpose */
+    unsigned long downlink_lost;   /**< Answers dropped on purpose */
+    unsigned long overflows;       /**< Answers dropped (delay queue full) */
+    unsigned long time_requests;   /**< Answers that requested the time */
+    unsigned long time_received;   /**< DS packets that carried the time */
+    unsigned long netconsole_sent; /**< NetConsole messages sent */
+} Emulator_Stats;
+
+extern void Emulator_DefaultConfig (Emulator_Config* config);
+
+extern int Emulator_Start (const Emulator_Config* config);
+extern void Emulator_Stop();
+
+extern Emulator_Stats Emulator_GetStats();
+extern void Emulator_ResetStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
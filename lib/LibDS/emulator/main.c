@@ -0,0 +1,169 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "emulator.h"
+#include "DS_Timer.h"
+
+#include <socky.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+static volatile sig_atomic_t running = 1;
+
+/**
+ * Stops the emulator when the user presses Ctrl+C
+ */
+static void stop (int signal)
+{
+    (void) signal;
+    running = 0;
+}
+
+/**
+ * Prints the command line options of the emulator
+ */
+static void usage (const char* name)
+{
+    printf ("Usage: %s [options]\n\n"
+            "  --protocol <2014|2015|2016>  wire format (default: 2016)\n"
+            "  --voltage <volts>            battery voltage (default: 12.5)\n"
+            "  --no-code                    report that there is no robot code\n"
+            "  --no-time                    do not request the date/time\n"
+            "  --fms                        send FMS packets to the DS\n"
+            "  --fms-enabled                enable the robot from the FMS\n"
+            "  --netconsole <ms>            time between NetConsole bursts\n"
+            "  --burst <messages>           messages in each NetConsole burst\n"
+            "  --loss <percent>             packet loss (both directions)\n"
+            "  --uplink-loss <percent>      loss of the DS packets\n"
+            "  --downlink-loss <percent>    loss of the answers\n"
+            "  --delay <ms>                 delay added to each answer\n"
+            "  --jitter <ms>                random delay added to the delay\n"
+            "  --seed <number>              seed of the loss/jitter generator\n",
+            name);
+}
+
+/**
+ * Reads the command line options into the given \a config
+ *
+ * \returns \c 0 if the options are invalid (or if the help was requested)
+ */
+static int parse_options (int argc, char** argv, Emulator_Config* config)
+{
+    int i;
+    for (i = 1; i < argc; ++i) {
+        const char* option = argv [i];
+        const char* value = (i + 1 < argc) ? argv [i + 1] : NULL;
+
+        if (strcmp (option, "--no-code") == 0)
+            config->robot_code = 0;
+        else if (strcmp (option, "--no-time") == 0)
+            config->request_time = 0;
+        else if (strcmp (option, "--fms") == 0)
+            config->fms = 1;
+        else if (strcmp (option, "--fms-enabled") == 0)
+            config->fms = config->fms_enabled = 1;
+
+        /* The remaining options need a value */
+        else if (!value)
+            return 0;
+
+        else if (strcmp (option, "--protocol") == 0) {
+            int year = atoi (value);
+            if (year == 2014)
+                config->protocol = EMULATOR_FRC_2014;
+            else if (year == 2015)
+                config->protocol = EMULATOR_FRC_2015;
+            else if (year == 2016)
+                config->protocol = EMULATOR_FRC_2016;
+            else
+                return 0;
+        }
+
+        else if (strcmp (option, "--voltage") == 0)
+            config->voltage = (float) atof (value);
+        else if (strcmp (option, "--netconsole") == 0)
+            config->netconsole_interval = atoi (value);
+        else if (strcmp (option, "--burst") == 0)
+            config->netconsole_burst = atoi (value);
+        else if (strcmp (option, "--loss") == 0)
+            config->uplink_loss = config->downlink_loss = atoi (value);
+        else if (strcmp (option, "--uplink-loss") == 0)
+            config->uplink_loss = atoi (value);
+        else if (strcmp (option, "--downlink-loss") == 0)
+            config->downlink_loss = atoi (value);
+        else if (strcmp (option, "--delay") == 0)
+            config->delay = atoi (value);
+        else if (strcmp (option, "--jitter") == 0)
+            config->jitter = atoi (value);
+        else if (strcmp (option, "--seed") == 0)
+            config->seed = (unsigned int) strtoul (value, NULL, 10);
+        else
+            return 0;
+
+        ++i;
+    }
+
+    return 1;
+}
+
+/**
+ * Runs the emulator until the user presses Ctrl+C, the traffic counters are
+ * printed every second
+ */
+int main (int argc, char** argv)
+{
+    Emulator_Config config;
+    Emulator_DefaultConfig (&config);
+
+    if (!parse_options (argc, argv, &config)) {
+        usage (argv [0]);
+        return EXIT_FAILURE;
+    }
+
+    sockets_init (1);
+    signal (SIGINT, &stop);
+
+    if (!Emulator_Start (&config))
+        return EXIT_FAILURE;
+
+    while (running) {
+        DS_Sleep (1000);
+
+        Emulator_Stats stats = Emulator_GetStats();
+        printf ("robot %lu/%lu   fms %lu/%lu   lost %lu/%lu   "
+                "time %lu/%lu   netconsole %lu\n",
+                stats.robot_received, stats.robot_sent,
+                stats.fms_received, stats.fms_sent,
+                stats.uplink_lost, stats.downlink_lost,
+                stats.time_requests, stats.time_received,
+                stats.netconsole_sent);
+        fflush (stdout);
+    }
+
+    Emulator_Stop();
+    sockets_exit();
+
+    return EXIT_SUCCESS;
+}
@@ -54,7 +54,6 @@ static bstring can_str = NULL;
 static bstring cpu_str = NULL;
 static bstring ram_str = NULL;
 static bstring disk_str = NULL;
-static bstring rstatus_str = NULL;
 static bstring robot_ip = NULL;
 static bstring voltage_str = NULL;
 static bstring console_str = NULL;
@@ -62,6 +61,11 @@ static bstring stick_check_str = NULL;
 static bstring rcode_check_str = NULL;
 static bstring robot_check_str = NULL;
 
+/*
+ * The status string is owned by the LibDS (no need to copy or free it)
+ */
+static const char* rstatus_str = INVALID;
+
 /**
  * Changes the \a label to "[*]" if checked is greater than \c 0,
  * otherwise, the function will change the \a label to "[ ]"
@@ -100,7 +104,6 @@ static void init_strings()
     disk_str = bfromcstr (INVALID);
     robot_ip = bfromcstr (INVALID);
     voltage_str = bfromcstr (INVALID);
-    rstatus_str = bfromcstr (INVALID);
     console_str = bfromcstr ("[INFO] Welcome to the ConsoleDS!");
 }
 
@@ -114,7 +117,6 @@ static void close_strings()
     DS_FREESTR (ram_str);
     DS_FREESTR (disk_str);
     DS_FREESTR (robot_ip);
-    DS_FREESTR (rstatus_str);
     DS_FREESTR (voltage_str);
     DS_FREESTR (console_str);
     DS_FREESTR (stick_check_str);
@@ -164,7 +166,7 @@ static void draw_windows()
     /* Add top window elements */
     mvwaddstr (console_win,  1, 2, bstr2cstr (console_str, 0));
     mvwaddstr (robotip_win,  1, 2, bstr2cstr (robot_ip, 0));
-    mvwaddstr (robot_status, 1, 2, bstr2cstr (rstatus_str, 0));
+    mvwaddstr (robot_status, 1, 2, rstatus_str);
 
     /* Add voltage elements */
     mvwaddstr (voltage_win,  1,  2, "Voltage:");
@@ -270,8 +272,7 @@ void update_interface()
  */
 void update_status_label()
 {
-    DS_FREESTR (rstatus_str);
-    rstatus_str = DS_GetStatusString();
+    rstatus_str = DS_GetStatusText (NULL);
 }
 
 /**
@@ -43,6 +43,11 @@ static int initialized = 0;
  */
 static int joystick_tracker = -1;
 
+/**
+ * SDL joysticks registered with the Driver Station
+ */
+static SDL_Joystick* sdl_joysticks [DS_MAX_JOYSTICKS] = {NULL};
+
 /**
  * Calculates the dynamic ID of the given joystick
  */
@@ -65,9 +70,15 @@ static void register_joysticks()
     DS_JoysticksReset();
 
     int i;
+    for (i = 0; i < DS_MAX_JOYSTICKS; ++i)
+        sdl_joysticks [i] = NULL;
+
     for (i = 0; i < SDL_NumJoysticks(); ++i) {
         SDL_Joystick* joystick = SDL_JoystickOpen (i);
 
+        if (i < DS_MAX_JOYSTICKS)
+            sdl_joysticks [i] = joystick;
+
         if (joystick) {
             DS_JoysticksAdd (SDL_JoystickNumAxes (joystick),
                              SDL_JoystickNumHats (joystick),
@@ -77,84 +88,96 @@ static void register_joysticks()
 }
 
 /**
- * Extracts the hat/POV information from the given \a event
- * and updates the state of the Driver Station joysticks
+ * Returns the angle (in degrees) of the given SDL \a hat value,
+ * or \c -1 if the hat is centered
  */
-static void process_hat_event (SDL_Event* event)
+static int get_angle (const Uint8 hat)
 {
-    if (!event)
-        return;
-
-    int angle = 0;
-    int hat = event->jhat.hat;
-    int joystick = get_id (event->jhat.which);
-
-    switch (event->jhat.value) {
+    switch (hat) {
     case SDL_HAT_RIGHTUP:
-        angle = 45;
-        break;
+        return 45;
     case SDL_HAT_RIGHTDOWN:
-        angle = 135;
-        break;
+        return 135;
     case SDL_HAT_LEFTDOWN:
-        angle = 225;
-        break;
+        return 225;
     case SDL_HAT_LEFTUP:
-        angle = 315;
-        break;
+        return 315;
     case SDL_HAT_UP:
-        angle = 0;
-        break;
+        return 0;
     case SDL_HAT_RIGHT:
-        angle = 90;
-        break;
+        return 90;
     case SDL_HAT_DOWN:
-        angle = 180;
-        break;
+        return 180;
     case SDL_HAT_LEFT:
-        angle = 270;
-        break;
+        return 270;
     default:
-        angle = -1;
-        break;
+        return -1;
+    }
+}
+
+/**
+ * Returns the opened SDL joystick with the given \a instance ID
+ */
+static SDL_Joystick* get_joystick (const SDL_JoystickID instance)
+{
+    int i;
+    for (i = 0; i < DS_MAX_JOYSTICKS; ++i) {
+        if (sdl_joysticks [i] &&
+                SDL_JoystickInstanceID (sdl_joysticks [i]) == instance)
+            return sdl_joysticks [i];
     }
 
-    if (joystick > INVALID_ID)
-        DS_SetJoystickHat (joystick, hat, angle);
+    return NULL;
 }
 
 /**
- * Extracts the axis information from the given \a event and updates
- * the state of the Driver Station joysticks
+ * Reads every axis, hat and button of the given SDL joystick \a instance
+ * and sends them to the Driver Station with a single call
  */
-static void process_axis_event (SDL_Event* event)
+static void publish_joystick (const SDL_JoystickID instance)
 {
-    if (!event)
+    int i;
+    uint32_t buttons = 0;
+    int hats [DS_MAX_JOYSTICK_HATS] = {0};
+    float axes [DS_MAX_JOYSTICK_AXES] = {0};
+
+    int joystick = get_id (instance);
+    SDL_Joystick* stick = get_joystick (instance);
+
+    if (!stick || joystick <= INVALID_ID)
         return;
 
-    int axis = event->jaxis.axis;
-    int joystick = get_id (event->jaxis.which);
-    double value = ((double) (event->jaxis.value)) / SDL_AXIS_RANGE;
+    int num_axes = DS_GetJoystickNumAxes (joystick);
+    int num_hats = DS_GetJoystickNumHats (joystick);
+    int num_buttons = DS_GetJoystickNumButtons (joystick);
+
+    for (i = 0; i < num_axes && i < SDL_JoystickNumAxes (stick); ++i)
+        axes [i] = ((double) SDL_JoystickGetAxis (stick, i)) / SDL_AXIS_RANGE;
 
-    if (joystick > INVALID_ID)
-        DS_SetJoystickAxis (joystick, axis, value);
+    for (i = 0; i < num_hats && i < SDL_JoystickNumHats (stick); ++i)
+        hats [i] = get_angle (SDL_JoystickGetHat (stick, i));
+
+    for (i = 0; i < num_buttons && i < SDL_JoystickNumButtons (stick); ++i)
+        buttons |= SDL_JoystickGetButton (stick, i) ? (1u << i) : 0;
+
+    DS_SetJoystickState (joystick, axes, buttons, hats);
 }
 
 /**
- * Extracts the button information from the given \a event
- * and updates the state of the Driver Station joysticks
+ * Adds the given SDL joystick \a instance to the list of joysticks that
+ * changed since the last update (if it is not already there)
  */
-static void process_button_event (SDL_Event* event)
+static void mark_changed (const SDL_JoystickID instance,
+                          SDL_JoystickID* changed, int* count)
 {
-    if (!event)
-        return;
-
-    int button = event->jbutton.button;
-    int joystick = get_id (event->jbutton.which);
-    int pressed = (event->jbutton.state == SDL_PRESSED);
+    int i;
+    for (i = 0; i < *count; ++i) {
+        if (changed [i] == instance)
+            return;
+    }
 
-    if (joystick > INVALID_ID)
-        DS_SetJoystickButton (joystick, button, pressed);
+    if (*count < DS_MAX_JOYSTICKS)
+        changed [(*count)++] = instance;
 }
 
 /**
@@ -194,7 +217,12 @@ void update_joysticks()
     if (!initialized)
         return;
 
+    int i;
+    int count = 0;
     SDL_Event event;
+    SDL_JoystickID changed [DS_MAX_JOYSTICKS];
+
+    /* Process the SDL events, but only read the joysticks once */
     while (SDL_PollEvent (&event)) {
         switch (event.type) {
         case SDL_JOYDEVICEADDED:
@@ -205,19 +233,21 @@ void update_joysticks()
             register_joysticks();
             break;
         case SDL_JOYAXISMOTION:
-            process_axis_event (&event);
+            mark_changed (event.jaxis.which, changed, &count);
             break;
         case SDL_JOYHATMOTION:
-            process_hat_event (&event);
+            mark_changed (event.jhat.which, changed, &count);
             break;
         case SDL_JOYBUTTONDOWN:
-            process_button_event (&event);
-            break;
         case SDL_JOYBUTTONUP:
-            process_button_event (&event);
+            mark_changed (event.jbutton.which, changed, &count);
             break;
         default:
             break;
         }
     }
+
+    /* Send one frame for each joystick that changed */
+    for (i = 0; i < count; ++i)
+        publish_joystick (changed [i]);
 }
@@ -33,6 +33,7 @@
 
 static int running = 1;
 static void process_events();
+static void process_event (DS_Event* event);
 static void* get_user_input();
 
 /**
@@ -43,6 +44,17 @@ int main()
     /* Initialize the DS (and its event loop) */
     DS_Init();
 
+    /* Only generate the events that are shown in the console */
+    DS_SetEventMask (DS_EVENT_MASK (DS_JOYSTICK_COUNT_CHANGED) |
+                     DS_EVENT_MASK (DS_ROBOT_VOLTAGE_CHANGED) |
+                     DS_EVENT_MASK (DS_ROBOT_CAN_UTIL_CHANGED) |
+                     DS_EVENT_MASK (DS_ROBOT_CPU_INFO_CHANGED) |
+                     DS_EVENT_MASK (DS_ROBOT_RAM_INFO_CHANGED) |
+                     DS_EVENT_MASK (DS_ROBOT_DISK_INFO_CHANGED) |
+                     DS_EVENT_MASK (DS_STATUS_STRING_CHANGED) |
+                     DS_EVENT_MASK (DS_ROBOT_COMMS_CHANGED) |
+                     DS_EVENT_MASK (DS_ROBOT_CODE_CHANGED));
+
     /* Connect to the FRC simulator (or OpenRIO Sim) */
     DS_SetCustomRobotAddress ("127.0.0.1");
 
@@ -57,12 +69,17 @@ int main()
     /* Load the FRC 2016 communication protocol */
     DS_ConfigureProtocol (DS_GetProtocolFRC_2016());
 
-    /* Run the application's event loop (unrelated to DS) */
+    /* Run the application's event loop, which wakes up as soon as there is
+     * a new DS event (or every 20 ms, to read the joysticks) */
     while (running) {
-        process_events();
+        DS_Event event;
+        if (DS_WaitEvent (&event, 20)) {
+            process_event (&event);
+            process_events();
+        }
+
         update_interface();
         update_joysticks();
-        DS_Sleep (20);
     }
 
     /* Close the DS and the application modules */
@@ -81,40 +98,45 @@ int main()
 static void process_events()
 {
     DS_Event event;
-    while (DS_PollEvent (&event)) {
-        switch (event.type) {
-        case DS_JOYSTICK_COUNT_CHANGED:
-            set_has_joysticks (DS_GetJoystickCount());
-            break;
-        case DS_NETCONSOLE_NEW_MESSAGE:
-            break;
-        case DS_ROBOT_VOLTAGE_CHANGED:
-            set_voltage (event.robot.voltage);
-            break;
-        case DS_ROBOT_CAN_UTIL_CHANGED:
-            set_can (event.robot.can_util);
-            break;
-        case DS_ROBOT_CPU_INFO_CHANGED:
-            set_cpu (event.robot.cpu_usage);
-            break;
-        case DS_ROBOT_RAM_INFO_CHANGED:
-            set_ram (event.robot.ram_usage);
-            break;
-        case DS_ROBOT_DISK_INFO_CHANGED:
-            set_disk (event.robot.disk_usage);
-            break;
-        case DS_STATUS_STRING_CHANGED:
-            update_status_label();
-            break;
-        case DS_ROBOT_COMMS_CHANGED:
-            set_robot_comms (event.robot.connected);
-            break;
-        case DS_ROBOT_CODE_CHANGED:
-            set_robot_code (event.robot.code);
-            break;
-        default:
-            break;
-        }
+    while (DS_PollEvent (&event))
+        process_event (&event);
+}
+
+/**
+ * Updates the console screen with the given DS \a event
+ */
+static void process_event (DS_Event* event)
+{
+    switch (event->type) {
+    case DS_JOYSTICK_COUNT_CHANGED:
+        set_has_joysticks (DS_GetJoystickCount());
+        break;
+    case DS_ROBOT_VOLTAGE_CHANGED:
+        set_voltage (event->robot.voltage);
+        break;
+    case DS_ROBOT_CAN_UTIL_CHANGED:
+        set_can (event->robot.can_util);
+        break;
+    case DS_ROBOT_CPU_INFO_CHANGED:
+        set_cpu (event->robot.cpu_usage);
+        break;
+    case DS_ROBOT_RAM_INFO_CHANGED:
+        set_ram (event->robot.ram_usage);
+        break;
+    case DS_ROBOT_DISK_INFO_CHANGED:
+        set_disk (event->robot.disk_usage);
+        break;
+    case DS_STATUS_STRING_CHANGED:
+        update_status_label();
+        break;
+    case DS_ROBOT_COMMS_CHANGED:
+        set_robot_comms (event->robot.connected);
+        break;
+    case DS_ROBOT_CODE_CHANGED:
+        set_robot_code (event->robot.code);
+        break;
+    default:
+        break;
     }
 }
 
@@ -0,0 +1,117 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LIB_DS_CAPTURE_H
+#define _LIB_DS_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "DS_Types.h"
+
+/*
+ * A capture file starts with a 16-byte header (the magic string, the format
+ * version and the size of the record header), followed by the records. Each
+ * record has a 16-byte header (the monotonic time in nanoseconds, the data
+ * length, the channel and the direction, all little-endian) followed by the
+ * datagram, padded to a multiple of 8 bytes. Records are only appended, so a
+ * capture can be read while it is being written, or mapped into memory.
+ */
+#define DS_CAPTURE_MAGIC   "LibDSCap"
+#define DS_CAPTURE_VERSION 1
+
+/**
+ * Channels recorded in a capture, the first values match \c DS_Channel
+ */
+typedef enum {
+    DS_CAPTURE_FMS = DS_CHANNEL_FMS,
+    DS_CAPTURE_RADIO = DS_CHANNEL_RADIO,
+    DS_CAPTURE_ROBOT = DS_CHANNEL_ROBOT,
+    DS_CAPTURE_NETCONSOLE,
+} DS_CaptureChannel;
+
+/**
+ * Direction of a captured datagram
+ */
+typedef enum {
+    DS_CAPTURE_INBOUND,
+    DS_CAPTURE_OUTBOUND,
+} DS_CaptureDirection;
+
+/**
+ * Holds a record read from a capture, the data points to the capture itself
+ */
+typedef struct _capture_record {
+    uint64_t time;                 /**< Monotonic time (in nanoseconds) */
+    DS_CaptureChannel channel;     /**< Channel of the datagram */
+    DS_CaptureDirection direction; /**< Direction of the datagram */
+    const uint8_t* data;           /**< Datagram bytes */
+    int length;                    /**< Datagram length */
+} DS_CaptureRecord;
+
+/**
+ * Holds the results of a capture replay
+ */
+typedef struct _replay_stats {
+    unsigned long packets;  /**< Inbound datagrams given to the protocol */
+    unsigned long accepted; /**< Datagrams that the protocol could read */
+    unsigned long skipped;  /**< Outbound datagrams (not replayed) */
+    unsigned long bytes;    /**< Inbound bytes given to the protocol */
+    uint64_t time;          /**< Time spent replaying (in nanoseconds) */
+} DS_ReplayStats;
+
+typedef struct _capture DS_Capture;
+typedef struct _capture_reader DS_CaptureReader;
+
+/* Capture writer */
+extern DS_Capture* DS_CaptureOpen (const char* path);
+extern void DS_CaptureClose (DS_Capture* capture);
+extern void DS_CaptureWrite (DS_Capture* capture,
+                             const DS_CaptureChannel channel,
+                             const DS_CaptureDirection direction,
+                             const void* data, const int length);
+
+/* Capture reader */
+extern DS_CaptureReader* DS_CaptureReaderOpen (const char* path);
+extern void DS_CaptureReaderClose (DS_CaptureReader* reader);
+extern int DS_CaptureReaderNext (DS_CaptureReader* reader,
+                                 DS_CaptureRecord* record);
+
+/* Capture of the current context */
+extern int DS_StartCapture (const char* path);
+extern void DS_StopCapture();
+
+/* Replay */
+extern int DS_ReplayCapture (const char* path,
+                             const int realtime,
+                             DS_ReplayStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -52,6 +52,12 @@ extern bstring DS_GetAppliedRobotAddress();
 
 /* Status string */
 extern bstring DS_GetStatusString();
+extern uint32_t DS_GetStatusVersion();
+extern const char* DS_GetStatusText (uint32_t* version);
+
+/* State snapshots */
+extern uint32_t DS_GetStateVersion();
+extern uint32_t DS_GetStateSnapshot (DS_StateSnapshot* snapshot);
 
 /* Getters */
 extern int DS_GetTeamNumber();
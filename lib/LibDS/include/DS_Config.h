@@ -46,12 +46,27 @@ extern "C" {
 #define RECONFIGURE_ROBOT 0x04
 #define RECONFIGURE_ALL   0x01 | 0x02 | 0x04
 
+/* Module functions */
+extern void Config_Init();
+extern void Config_Close();
+
 /* Misc */
 extern void CFG_ReconfigureAddresses (const int flags);
 
+/* State snapshots */
+extern void CFG_LockState();
+extern void CFG_UnlockState();
+extern void CFG_PublishState();
+extern uint32_t CFG_GetStateVersion();
+extern uint32_t CFG_GetStateSnapshot (DS_StateSnapshot* snapshot);
+
+/* Status string */
+extern uint32_t CFG_GetStatusVersion();
+extern const char* CFG_GetStatusString (uint32_t* version);
+
 /* NetConsole ouput */
-extern void CFG_AddNotification (bstring msg);
-extern void CFG_AddNetConsoleMessage (bstring msg);
+extern void CFG_AddNotification (const char* format, ...);
+extern void CFG_AddNetConsoleMessage (const char* data, const int length);
 
 /* Getters */
 extern int CFG_GetTeamNumber();
@@ -0,0 +1,78 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LIB_DS_CONTEXT_H
+#define _LIB_DS_CONTEXT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A context owns the state of one driver station instance (configuration,
+ * protocol, joysticks, events, etc). The timer service, the sockets reactor
+ * and the protocol event loop are shared by every context.
+ *
+ * The regular LibDS functions operate on the current context of the calling
+ * thread, which is the default context unless DS_SetCurrentContext() is
+ * used to select another one.
+ */
+typedef struct _context DS_Context;
+
+/**
+ * Identifies the state of each module inside a context
+ */
+typedef enum {
+    DS_MODULE_CLIENT,
+    DS_MODULE_CONFIG,
+    DS_MODULE_EVENTS,
+    DS_MODULE_NETCONSOLE,
+    DS_MODULE_DISCOVERY,
+    DS_MODULE_JOYSTICKS,
+    DS_MODULE_PROTOCOLS,
+    DS_MODULE_COUNT,
+} DS_Module;
+
+/* Module functions */
+extern void Contexts_Init();
+extern void Contexts_Close();
+
+/* Used by the other modules */
+extern void* Context_GetState (const DS_Module module);
+extern void Context_SetState (const DS_Module module, void* state);
+extern void Context_Lock();
+extern void Context_Unlock();
+extern void Context_ForEach (void (*function)());
+
+/* Context management */
+extern DS_Context* DS_ContextCreate();
+extern DS_Context* DS_DefaultContext();
+extern DS_Context* DS_CurrentContext();
+extern void DS_ContextDestroy (DS_Context* context);
+extern void DS_SetCurrentContext (DS_Context* context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
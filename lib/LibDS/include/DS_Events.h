@@ -33,6 +33,12 @@ extern "C" {
 
 #include "DS_Types.h"
 
+/**
+ * Number of events that each context can hold until they are polled (must be
+ * a power of two), new events are dropped while the queue is full
+ */
+#define DS_EVENT_QUEUE_SIZE 1024
+
 /**
  * \brief The types of events that can be delivered.
  */
@@ -58,6 +64,17 @@ typedef enum {
     DS_STATUS_STRING_CHANGED    = 0x18,
 } DS_EventType;
 
+/**
+ * Returns the subscription mask bit of the given event \a type, masks are
+ * combined with the \c | operator and passed to DS_SetEventMask()
+ */
+#define DS_EVENT_MASK(type) (1u << (type))
+
+/**
+ * Subscription mask that includes every event type
+ */
+#define DS_ALL_EVENTS 0xffffffffu
+
 /**
  * \brief FMS event fields
  */
@@ -100,11 +117,12 @@ typedef struct {
 } DS_JoystickEvent;
 
 /**
- * \brief NetConsole event fields
+ * \brief NetConsole event fields, the message is obtained from its
+ *        \a handle with DS_GetNetConsoleMessage()
  */
 typedef struct {
     DS_EventType type;
-    bstring message;
+    uint64_t handle;
 } DS_NetConsoleEvent;
 
 /**
@@ -119,10 +137,29 @@ typedef union {
     DS_NetConsoleEvent netconsole;
 } DS_Event;
 
+/**
+ * \brief Event queue counters
+ */
+typedef struct {
+    unsigned long added;   /**< Events queued since the context was created */
+    unsigned long dropped; /**< Events discarded because the queue was full */
+    unsigned long merged;  /**< Events merged into a queued event */
+    unsigned int pending;  /**< Events waiting to be polled */
+} DS_EventStats;
+
 extern void Events_Init();
 extern void Events_Close();
+extern int Events_Subscribed (const DS_EventType type);
 extern void DS_AddEvent (DS_Event* event);
+extern int DS_GetEventFd();
 extern int DS_PollEvent (DS_Event* event);
+extern int DS_PollEvents (DS_Event* buffer, const int max);
+extern int DS_WaitEvent (DS_Event* event, const int timeout);
+extern void DS_GetEventStats (DS_EventStats* stats);
+extern void DS_SetEventConflation (const int enabled);
+extern int DS_GetEventConflation();
+extern uint32_t DS_GetEventMask();
+extern void DS_SetEventMask (const uint32_t mask);
 
 #ifdef __cplusplus
 }
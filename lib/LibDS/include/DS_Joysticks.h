@@ -28,6 +28,17 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
+/*
+ * Capacity of the joystick store, any extra joysticks, axes, hats or
+ * buttons are ignored
+ */
+#define DS_MAX_JOYSTICKS        6
+#define DS_MAX_JOYSTICK_AXES    12
+#define DS_MAX_JOYSTICK_HATS    4
+#define DS_MAX_JOYSTICK_BUTTONS 32
+
 extern void Joysticks_Init();
 extern void Joysticks_Close();
 
@@ -39,12 +50,16 @@ extern int DS_GetJoystickNumButtons (int joystick);
 extern int DS_GetJoystickHat (int joystick, int hat);
 extern float DS_GetJoystickAxis (int joystick, int axis);
 extern int DS_GetJoystickButton (int joystick, int button);
+extern uint32_t DS_GetJoystickButtons (int joystick);
+extern unsigned int DS_GetJoystickVersion (int joystick);
 
 extern void DS_JoysticksReset();
 extern void DS_JoysticksAdd (const int axes, const int hats, const int buttons);
 extern void DS_SetJoystickHat (int joystick, int hat, int angle);
 extern void DS_SetJoystickAxis (int joystick, int axis, float value);
 extern void DS_SetJoystickButton (int joystick, int button, int pressed);
+extern void DS_SetJoystickState (int joystick, const float* axes,
+                                 uint32_t buttons, const int* hats);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,75 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LIB_DS_NETCONSOLE_H
+#define _LIB_DS_NETCONSOLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * Number of bytes of NetConsole messages that each context keeps, the oldest
+ * messages are overwritten when the buffer is full
+ */
+#define DS_NETCONSOLE_BUFFER_SIZE 65536
+
+/**
+ * Maximum number of NetConsole messages that each context keeps (must be a
+ * power of two)
+ */
+#define DS_NETCONSOLE_MAX_MESSAGES 1024
+
+/**
+ * \brief View of a NetConsole message stored by the LibDS
+ *
+ * The message bytes are not copied (nor NUL-terminated), \a data points to
+ * the NetConsole buffer and is only valid until the next call to
+ * DS_GetNetConsoleMessage() or DS_ReleaseNetConsoleMessage().
+ */
+typedef struct {
+    uint64_t handle;  /**< Handle of the message */
+    const char* data; /**< Message bytes */
+    int length;       /**< Number of bytes in \a data */
+} DS_NetConsoleMessage;
+
+/* Module functions */
+extern void NetConsole_Init();
+extern void NetConsole_Close();
+
+/* Used by the config module */
+extern uint64_t NetConsole_Add (const char* data, const int length);
+
+/* Message views */
+extern void DS_ReleaseNetConsoleMessage();
+extern unsigned long DS_GetNetConsoleDroppedMessages();
+extern int DS_GetNetConsoleMessage (const uint64_t handle,
+                                    DS_NetConsoleMessage* message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -30,15 +30,68 @@ extern "C" {
 
 #include "DS_Socket.h"
 
+/**
+ * Holds the send timing statistics of a channel, jitter is the delay between
+ * the scheduled send time of a packet and the time it was actually sent
+ */
+typedef struct _send_stats {
+    unsigned long sent;    /**< Number of packets sent on schedule */
+    unsigned long skipped; /**< Number of deadlines skipped (not sent) */
+    double mean_jitter;    /**< Mean send jitter (in microseconds) */
+    double max_jitter;     /**< Maximum send jitter (in microseconds) */
+    double stddev_jitter;  /**< Standard deviation of the jitter (in us) */
+} DS_SendStats;
+
+/**
+ * Holds the round-trip latency statistics of a channel, calculated from the
+ * most recent packets that were echoed back by the remote peer
+ */
+typedef struct _latency_stats {
+    unsigned long samples; /**< Number of RTT samples in the window */
+    double min;            /**< Minimum RTT (in milliseconds) */
+    double mean;           /**< Mean RTT (in milliseconds) */
+    double p50;            /**< Median RTT (in milliseconds) */
+    double p99;            /**< 99th percentile RTT (in milliseconds) */
+} DS_LatencyStats;
+
+/**
+ * Holds the packet loss statistics of one direction of a channel over the
+ * last few seconds, calculated from the gaps in the sequence numbers
+ */
+typedef struct _loss_stats {
+    unsigned long expected;  /**< Number of packets that should have arrived */
+    unsigned long lost;      /**< Number of packets that never arrived */
+    unsigned long reordered; /**< Number of packets that arrived out of order */
+    unsigned long bursts;    /**< Number of loss bursts (consecutive losses) */
+    unsigned long max_burst; /**< Length of the longest loss burst */
+    double mean_burst;       /**< Mean length of the loss bursts */
+    double loss;             /**< Packet loss (in percent) */
+} DS_LossStats;
+
+/**
+ * Maximum size of a packet generated by a protocol (one Ethernet MTU)
+ */
+#define DS_PACKET_CAPACITY 1500
+
+/**
+ * Holds a packet generated by a protocol. Each channel owns one packet, which
+ * is emptied before being passed to the packet generator of the protocol, so
+ * that no memory is allocated while sending data. Empty packets are not sent.
+ */
+typedef struct _packet {
+    uint8_t data [DS_PACKET_CAPACITY]; /**< Packet bytes */
+    int length;                        /**< Number of bytes used */
+} DS_Packet;
+
 typedef struct _protocol {
     bstring name;
     bstring (*fms_address)();
     bstring (*radio_address)();
     bstring (*robot_address)();
 
-    bstring (*create_fms_packet)();
-    bstring (*create_radio_packet)();
-    bstring (*create_robot_packet)();
+    void (*create_fms_packet) (DS_Packet*);
+    void (*create_radio_packet) (DS_Packet*);
+    void (*create_robot_packet) (DS_Packet*);
 
     int (*read_fms_packet) (const bstring);
     int (*read_radio_packet) (const bstring);
@@ -65,10 +118,14 @@ typedef struct _protocol {
     DS_Socket* radio_socket;
     DS_Socket* robot_socket;
     DS_Socket* netconsole_socket;
+
+    void* data;
 } DS_Protocol;
 
 extern void Protocols_Init();
 extern void Protocols_Close();
+extern void Protocols_Start();
+extern void Protocols_Stop();
 extern void DS_ConfigureProtocol (DS_Protocol* ptr);
 
 extern int DS_SentFMSPackets();
@@ -83,6 +140,25 @@ extern void DS_ResetFMSPackets();
 extern void DS_ResetRadioPackets();
 extern void DS_ResetRobotPackets();
 
+extern DS_SendStats DS_GetSendStats (const DS_Channel channel);
+extern void DS_ResetSendStats (const DS_Channel channel);
+
+extern int DS_PacketAppend (DS_Packet* packet, const uint8_t byte);
+extern int DS_PacketAppendBytes (DS_Packet* packet, const void* data, const int length);
+extern int DS_PacketResize (DS_Packet* packet, const int length);
+
+extern void DS_PacketSent (const DS_Channel channel, const unsigned int index);
+extern void DS_PacketEchoed (const DS_Channel channel, const unsigned int index);
+
+extern void DS_PacketReceived (const DS_Channel channel, const unsigned int index);
+
+extern DS_LatencyStats DS_GetLatencyStats (const DS_Channel channel);
+extern void DS_ResetLatencyStats (const DS_Channel channel);
+
+extern DS_LossStats DS_GetUplinkLoss (const DS_Channel channel);
+extern DS_LossStats DS_GetDownlinkLoss (const DS_Channel channel);
+extern void DS_ResetLossStats (const DS_Channel channel);
+
 extern DS_Protocol* DS_CurrentProtocol();
 
 #ifdef __cplusplus
@@ -28,11 +28,23 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
 #include <pthread.h>
 #include <bstrlib.h>
 
 #include "DS_Types.h"
 
+/**
+ * Number of received datagrams that each socket can hold until they are read,
+ * datagrams received while the ring is full are dropped
+ */
+#define DS_SOCKET_RING_SIZE 32
+
+/**
+ * Maximum size of a received datagram (larger datagrams are truncated)
+ */
+#define DS_SOCKET_SLOT_SIZE 2048
+
 /**
  * Holds all the private (erm, dirty) variables that the sockets module needs
  * to operate with the data provided by a \c DS_Socket structure
@@ -40,11 +52,12 @@ extern "C" {
 typedef struct {
     int sock_in;
     int sock_out;
-    bstring buffer;
+    void* ring;
     int client_init;
     int server_init;
     bstring in_service;
     bstring out_service;
+    pthread_mutex_t lock;
 } DS_SocketInfo;
 
 /**
@@ -74,8 +87,15 @@ extern void DS_SocketClose (DS_Socket* ptr);
 
 /* I/O functions */
 extern bstring DS_SocketRead (DS_Socket* ptr);
+extern bstring DS_SocketReadFrom (DS_Socket* ptr, bstring* source);
+extern int DS_SocketReadBuffer (DS_Socket* ptr, void* buffer, const int size);
+extern unsigned long DS_SocketDroppedPackets (DS_Socket* ptr);
 extern int DS_SocketSend (DS_Socket* ptr, const bstring data);
+extern int DS_SocketSendTo (DS_Socket* ptr, const bstring data, const bstring host);
+extern int DS_SocketSendBuffer (DS_Socket* ptr, const void* data, const int length);
+extern int DS_SocketSendBufferTo (DS_Socket* ptr, const void* data, const int length, const bstring host);
 extern void DS_SocketChangeAddress (DS_Socket* ptr, const bstring address);
+extern int DS_SocketWaitForData (const uint64_t deadline);
 
 #ifdef __cplusplus
 }
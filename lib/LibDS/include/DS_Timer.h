@@ -28,23 +28,32 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
 #include <pthread.h>
 
 /**
  * Represents a tiemr and its properties
  */
 typedef struct _timer {
-    int time;         /**< The time to wait until the timer expires */
-    int expired;      /**< Set to \c 1 if \a elapsed is greater than \a time */
-    int enabled;      /**< Enabled state of the timer */
-    int elapsed;      /**< Number of milliseconds elapsed since last reset */
-    int precision;    /**< The update interval (in milliseconds) */
-    int initialized;  /**< Set to \c 1 if the timer has been initialized */
+    int time;          /**< The time to wait until the timer expires */
+    int expired;       /**< Set to \c 1 if \a elapsed is greater than \a time */
+    int enabled;       /**< Enabled state of the timer */
+    int elapsed;       /**< Number of milliseconds elapsed at expiration */
+    int precision;     /**< The allowed expiration delay (in milliseconds) */
+    int initialized;   /**< Set to \c 1 if the timer has been initialized */
+    int queue_index;   /**< Position in the timer service queue (or \c -1) */
+    uint64_t deadline; /**< Monotonic expiration time (in nanoseconds) */
 } DS_Timer;
 
 extern void Timers_Init();
 extern void Timers_Close();
+extern uint64_t DS_GetTime();
 extern void DS_Sleep (const int millisecs);
+extern void DS_SleepUntil (const uint64_t deadline);
+extern void DS_CondInit (pthread_cond_t* cond);
+extern int DS_CondWaitUntil (pthread_cond_t* cond,
+                             pthread_mutex_t* mutex,
+                             const uint64_t deadline);
 extern void DS_TimerStop (DS_Timer* timer);
 extern void DS_TimerStart (DS_Timer* timer);
 extern void DS_TimerReset (DS_Timer* timer);
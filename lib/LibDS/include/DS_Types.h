@@ -28,6 +28,8 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 typedef enum {
     DS_CONTROL_TEST,
     DS_CONTROL_AUTONOMOUS,
@@ -45,11 +47,45 @@ typedef enum {
     DS_POSITION_3,
 } DS_Position;
 
+typedef enum {
+    DS_CHANNEL_FMS,
+    DS_CHANNEL_RADIO,
+    DS_CHANNEL_ROBOT,
+} DS_Channel;
+
 typedef enum {
     DS_SOCKET_UDP,
     DS_SOCKET_TCP,
 } DS_SocketType;
 
+/**
+ * \brief Consistent copy of the robot state, obtained with
+ *        DS_GetStateSnapshot()
+ *
+ * Every field has the same meaning (and value) as the respective DS_Get*
+ * function, but all of them are read at once. The \a version grows every
+ * time that the state changes. Every field must be 4 bytes long.
+ */
+typedef struct {
+    uint32_t version;            /**< Number of published state changes */
+    int team;                    /**< Team number */
+    int robot_code;              /**< Set if the robot code is running */
+    int robot_enabled;           /**< Set if the robot is enabled */
+    int can_be_enabled;          /**< Set if the robot can be enabled */
+    int emergency_stopped;       /**< Set if the robot is e-stopped */
+    int fms_communications;      /**< Set if the FMS is connected */
+    int radio_communications;    /**< Set if the radio is connected */
+    int robot_communications;    /**< Set if the robot is connected */
+    int cpu_usage;               /**< Robot CPU usage */
+    int ram_usage;               /**< Robot RAM usage */
+    int disk_usage;              /**< Robot disk usage */
+    int can_utilization;         /**< Robot CAN utilization */
+    float voltage;               /**< Robot battery voltage */
+    DS_Alliance alliance;        /**< Team alliance */
+    DS_Position position;        /**< Team position */
+    DS_ControlMode control_mode; /**< Robot control mode */
+} DS_StateSnapshot;
+
 #ifdef __cplusplus
 }
 #endif
@@ -52,6 +52,13 @@ extern uint8_t DS_GetFByte (float val, float max);
 extern int DS_StringIsEmpty (const bstring string);
 extern bstring DS_GetEmptyString (const int length);
 extern uint32_t DS_CRC32 (const void* buf, size_t size);
+extern uint32_t DS_CRC32Bytewise (const void* buf, size_t size);
+extern uint32_t DS_CRC32Slice8 (const void* buf, size_t size);
+extern uint32_t DS_CRC32Folding (const void* buf, size_t size);
+extern int DS_CRC32FoldingSupported();
+extern uint32_t DS_CRC32Patch (uint32_t crc,
+                               const void* before, const void* after,
+                               size_t span, size_t trailing);
 extern bstring DS_GetStaticIP (const int net, const int team, const int host);
 
 #ifdef __cplusplus
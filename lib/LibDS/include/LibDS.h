@@ -36,8 +36,12 @@ extern "C" {
 #include "DS_Events.h"
 #include "DS_Client.h"
 #include "DS_Socket.h"
+#include "DS_Context.h"
 #include "DS_Protocol.h"
 #include "DS_Joysticks.h"
+#include "DS_Discovery.h"
+#include "DS_Capture.h"
+#include "DS_NetConsole.h"
 #include "DS_DefaultProtocols.h"
 
 extern void DS_Init();
@@ -22,6 +22,7 @@
 
 #include "socky.h"
 
+#include <time.h>
 #include <stdlib.h>
 #include <pthread.h>
 
@@ -32,12 +33,45 @@
     #define GET_ERR errno
 #endif
 
+/* Resolver cache configuration */
+#define CACHE_SIZE       32
+#define CACHE_HOST_LEN   256
+#define CACHE_SERV_LEN   32
+#define CACHE_FAIL_TTL   1000
+
+/* Resolver cache entry states */
+#define ENTRY_EMPTY      0x00
+#define ENTRY_PENDING    0x01
+#define ENTRY_VALID      0x02
+#define ENTRY_FAILED     0x03
+
 typedef struct _close_socket {
     int sfd;
     int* error;
     int autoDelete;
 } _close_socket_info;
 
+typedef struct _cache_entry {
+    int state;
+    int refresh;
+    int permanent;
+    socklen_t len;
+    long long expires;
+    long long last_used;
+    struct sockaddr_storage addr;
+    char host [CACHE_HOST_LEN];
+    char service [CACHE_SERV_LEN];
+} _cache_entry;
+
+/* Resolver cache and its background thread */
+static int cache_ttl = 10000;
+static int resolver_running = 0;
+static pthread_t resolver_thread;
+static pthread_cond_t resolver_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static _cache_entry cache [CACHE_SIZE];
+static socky_resolver resolver = NULL;
+
 /**
  * Returns \c 0 if the given socket file descriptor is invalid
  *
@@ -272,6 +306,328 @@ static void* close_socket (void* data)
     return NULL;
 }
 
+/**
+ * Returns the current time of a monotonic clock (in milliseconds)
+ */
+static long long get_time_ms()
+{
+#if defined _WIN32
+    return (long long) GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ((long long) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#endif
+}
+
+/**
+ * Resolves the given \a host and \a service with \c getaddrinfo(), the first
+ * IPv4 address is preferred (if any), since LibDS uses IPv4 sockets.
+ *
+ * Returns \c 0 on success, \c -1 on failure
+ */
+static int default_resolver (const char* host, const char* service,
+                             struct sockaddr_storage* addr, socklen_t* len)
+{
+    struct addrinfo* info = get_address_info (host, service,
+                                              SOCKY_UDP, SOCKY_ANY);
+
+    /* Lookup failed */
+    if (!info)
+        return -1;
+
+    /* Get the first IPv4 address (or the first address) */
+    struct addrinfo* result = info;
+    struct addrinfo* ptr;
+    for (ptr = info; ptr != NULL; ptr = ptr->ai_next) {
+        if (ptr->ai_family == AF_INET) {
+            result = ptr;
+            break;
+        }
+    }
+
+    /* Copy the address */
+    *len = (socklen_t) result->ai_addrlen;
+    memcpy (addr, result->ai_addr, result->ai_addrlen);
+
+    freeaddrinfo (info);
+    return 0;
+}
+
+/**
+ * Resolves the given address if it is a numeric IP address, this does not
+ * involve any network access, so it is done directly by the caller.
+ *
+ * Returns \c 0 on success, \c -1 if the address is not numeric
+ */
+static int numeric_resolver (const char* host, const char* service,
+                             struct sockaddr_storage* addr, socklen_t* len)
+{
+    struct addrinfo hints, *info;
+
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+
+    if (getaddrinfo (host, service, &hints, &info) != 0)
+        return -1;
+
+    *len = (socklen_t) info->ai_addrlen;
+    memcpy (addr, info->ai_addr, info->ai_addrlen);
+
+    freeaddrinfo (info);
+    return 0;
+}
+
+/**
+ * Returns the cache entry for the given \a host and \a service, a new entry
+ * is created (replacing the least recently used entry) if needed.
+ *
+ * \note The cache lock must be held by the caller
+ */
+static _cache_entry* get_cache_entry (const char* host, const char* service)
+{
+    int i;
+    _cache_entry* oldest = NULL;
+
+    /* Search for an existing entry */
+    for (i = 0; i < CACHE_SIZE; ++i) {
+        _cache_entry* entry = &cache [i];
+        if (entry->state != ENTRY_EMPTY &&
+            strcmp (entry->host, host) == 0 &&
+            strcmp (entry->service, service) == 0)
+            return entry;
+
+        /* Pending entries are being used by the resolver thread */
+        if (entry->state == ENTRY_PENDING || entry->refresh)
+            continue;
+
+        if (!oldest || entry->state == ENTRY_EMPTY ||
+            (oldest->state != ENTRY_EMPTY && entry->last_used < oldest->last_used))
+            oldest = entry;
+    }
+
+    /* Every entry is waiting for the resolver */
+    if (!oldest)
+        return NULL;
+
+    /* Initialize the new entry */
+    memset (oldest, 0, sizeof (_cache_entry));
+    snprintf (oldest->host, sizeof (oldest->host), "%s", host);
+    snprintf (oldest->service, sizeof (oldest->service), "%s", service);
+
+    /* Numeric addresses never expire */
+    if (numeric_resolver (host, service, &oldest->addr, &oldest->len) == 0) {
+        oldest->permanent = 1;
+        oldest->state = ENTRY_VALID;
+    }
+
+    /* Let the resolver thread lookup the address */
+    else {
+        oldest->state = ENTRY_PENDING;
+        pthread_cond_signal (&resolver_cond);
+    }
+
+    return oldest;
+}
+
+/**
+ * Resolves the cache entries that are pending or that need to be refreshed,
+ * the lookups are done without holding the cache lock, so that threads that
+ * send data are never blocked by a slow lookup.
+ */
+static void* run_resolver (void* data)
+{
+    (void) data;
+
+    pthread_mutex_lock (&cache_lock);
+
+    while (resolver_running) {
+        int i;
+        _cache_entry* entry = NULL;
+
+        /* Find an entry that needs to be resolved */
+        for (i = 0; i < CACHE_SIZE && !entry; ++i) {
+            if (cache [i].state == ENTRY_PENDING || cache [i].refresh)
+                entry = &cache [i];
+        }
+
+        /* Nothing to do, wait for a new request */
+        if (!entry) {
+            pthread_cond_wait (&resolver_cond, &cache_lock);
+            continue;
+        }
+
+        /* Copy the request */
+        socklen_t len = 0;
+        struct sockaddr_storage addr;
+        char host [CACHE_HOST_LEN];
+        char service [CACHE_SERV_LEN];
+        socky_resolver function = resolver ? resolver : &default_resolver;
+        memcpy (host, entry->host, sizeof (host));
+        memcpy (service, entry->service, sizeof (service));
+
+        /* Resolve the address without holding the lock */
+        pthread_mutex_unlock (&cache_lock);
+        int error = function (host, service, &addr, &len);
+        pthread_mutex_lock (&cache_lock);
+
+        /* Entry was flushed while resolving the address */
+        if (strcmp (entry->host, host) != 0 ||
+            strcmp (entry->service, service) != 0)
+            continue;
+
+        /* Update the entry (failed refreshes keep the previous address) */
+        entry->refresh = 0;
+        if (error == 0) {
+            entry->len = len;
+            entry->addr = addr;
+            entry->state = ENTRY_VALID;
+            entry->expires = get_time_ms() + cache_ttl;
+        }
+
+        else {
+            if (entry->state != ENTRY_VALID)
+                entry->state = ENTRY_FAILED;
+
+            entry->expires = get_time_ms() + CACHE_FAIL_TTL;
+        }
+    }
+
+    pthread_mutex_unlock (&cache_lock);
+    return NULL;
+}
+
+/**
+ * Starts the resolver thread
+ */
+static void start_resolver()
+{
+    pthread_mutex_lock (&cache_lock);
+    int start = !resolver_running;
+    resolver_running = 1;
+    pthread_mutex_unlock (&cache_lock);
+
+    if (start && pthread_create (&resolver_thread, NULL, &run_resolver, NULL)) {
+        fprintf (stderr, "Cannot start resolver thread, error %d\n", GET_ERR);
+        resolver_running = 0;
+    }
+}
+
+/**
+ * Stops the resolver thread (waiting for the current lookup to finish)
+ */
+static void stop_resolver()
+{
+    pthread_mutex_lock (&cache_lock);
+    int stop = resolver_running;
+    resolver_running = 0;
+    pthread_cond_signal (&resolver_cond);
+    pthread_mutex_unlock (&cache_lock);
+
+    if (stop)
+        pthread_join (resolver_thread, NULL);
+}
+
+/**
+ * Obtains the address of the given \a host and \a service from the resolver
+ * cache. This function never blocks: if the address has not been resolved
+ * yet, a lookup is requested to the resolver thread and the function fails.
+ * Expired addresses are still returned while they are being refreshed.
+ *
+ * \param host the host name or IP address
+ * \param service the remote service/port string
+ * \param addr the structure in which to write the address
+ * \param len the length of the obtained address
+ *
+ * \returns \c 0 on success, \c -1 if the address is not available (yet)
+ */
+int socky_resolve (const char* host, const char* service,
+                   struct sockaddr_storage* addr, socklen_t* len)
+{
+    if (!host || !service || !addr || !len)
+        return -1;
+
+    int result = -1;
+    pthread_mutex_lock (&cache_lock);
+
+    _cache_entry* entry = get_cache_entry (host, service);
+    if (entry) {
+        long long now = get_time_ms();
+        entry->last_used = now;
+
+        /* Refresh expired addresses in the background */
+        if (!entry->permanent && entry->state != ENTRY_PENDING &&
+            !entry->refresh && now >= entry->expires) {
+            entry->refresh = 1;
+            pthread_cond_signal (&resolver_cond);
+        }
+
+        /* Copy the cached address */
+        if (entry->state == ENTRY_VALID) {
+            *len = entry->len;
+            *addr = entry->addr;
+            result = 0;
+        }
+    }
+
+    pthread_mutex_unlock (&cache_lock);
+    return result;
+}
+
+/**
+ * Marks the cached addresses of the given \a host as expired, so that they
+ * are looked up again in the background (the old addresses are still used
+ * until the lookup finishes)
+ */
+void socky_expire (const char* host)
+{
+    int i;
+    pthread_mutex_lock (&cache_lock);
+
+    for (i = 0; i < CACHE_SIZE; ++i) {
+        if (host && strcmp (cache [i].host, host) == 0)
+            cache [i].expires = 0;
+    }
+
+    pthread_mutex_unlock (&cache_lock);
+}
+
+/**
+ * Removes all the addresses from the resolver cache
+ */
+void socky_flush_cache()
+{
+    pthread_mutex_lock (&cache_lock);
+    memset (cache, 0, sizeof (cache));
+    pthread_mutex_unlock (&cache_lock);
+}
+
+/**
+ * Changes the time (in milliseconds) during which resolved addresses are
+ * used before they are refreshed
+ */
+void socky_set_cache_ttl (const int msecs)
+{
+    pthread_mutex_lock (&cache_lock);
+    cache_ttl = msecs > 0 ? msecs : 0;
+    pthread_mutex_unlock (&cache_lock);
+}
+
+/**
+ * Replaces the function used to resolve host names (e.g. to use a stub
+ * resolver for testing), set to \c NULL to use \c getaddrinfo() again.
+ * The resolver cache is flushed when the function changes.
+ */
+void socky_set_resolver (socky_resolver function)
+{
+    pthread_mutex_lock (&cache_lock);
+    resolver = function;
+    memset (cache, 0, sizeof (cache));
+    pthread_mutex_unlock (&cache_lock);
+}
+
 /**
  * If compiling on Windows, this function closes the WinSock API.
  * If you are using anything else, this function will do nothing.
@@ -280,6 +636,8 @@ static void* close_socket (void* data)
  */
 int sockets_exit()
 {
+    stop_resolver();
+
 #if defined _WIN32
     return WSACleanup();
 #endif
@@ -310,6 +668,7 @@ int sockets_init (const int exit_on_fail)
     (void) exit_on_fail;
 #endif
 
+    start_resolver();
     return 0;
 }
 
@@ -322,7 +681,7 @@ int sockets_init (const int exit_on_fail)
 int set_socket_block (const int sfd, const int block)
 {
 #if defined _WIN32
-    u_long flags = block ? 1 : 0;
+    u_long flags = block ? 0 : 1;
     return ioctlsocket (sfd, FIONBIO, &flags);
 #else
     int flags = block ? 0 : O_NONBLOCK;
@@ -511,6 +870,7 @@ int socket_close (const int sfd)
 
     /* Get error code and de-allocate structure */
     int error = *info->error;
+    free (info->error);
     free (info);
 
     /* Return error code */
@@ -595,7 +955,9 @@ int tcp_accept (const int sfd, char* host, const int host_len,
 }
 
 /**
- * Re-implements the \c sendto function
+ * Re-implements the \c sendto function, the address of the \a host is
+ * obtained from the resolver cache, so this function does not block while
+ * the address is being resolved (it returns \c -1 instead).
  *
  * \param sfd the socket descriptor
  * \param buf the data buffer to send
@@ -612,23 +974,14 @@ int udp_sendto (const int sfd,
     if (!valid_sfd (sfd) || buf == NULL || buf_len <= 0)
         return -1;
 
-    /* Get address info */
-    struct addrinfo* info = get_address_info (host, service,
-                                              SOCKY_UDP, SOCKY_ANY);
-
-    /* Invalid address info */
-    if (!info)
+    /* Get the cached address (the send fails until it is resolved) */
+    socklen_t len;
+    struct sockaddr_storage addr;
+    if (socky_resolve (host, service, &addr, &len) != 0)
         return -1;
 
     /* Send datagram */
-    int bytes = sendto (sfd, buf, buf_len, flags,
-                        info->ai_addr, info->ai_addrlen);
-
-    /* Free address information */
-    freeaddrinfo (info);
-
-    /* Return number of bytes written */
-    return bytes;
+    return sendto (sfd, buf, buf_len, flags, (struct sockaddr*) &addr, len);
 }
 
 /**
@@ -637,36 +990,22 @@ int udp_sendto (const int sfd,
  * \param sfd the socket file descriptor
  * \param buf the data buffer in which to write the data into
  * \param buf_len the length of the data buffer
- * \param host the remote host from which to receive data
- * \param service the local service/port from which to receive data
+ * \param host unused, kept for compatibility
+ * \param service unused, kept for compatibility
  * \param flags any additional flags that you may need to use
  */
 int udp_recvfrom (const int sfd, char* buf, const int buf_len,
                   const char* host, const char* service, const int flags)
 {
+    (void) host;
+    (void) service;
 
     /* Check if socket and buffer length are valid */
     if (!valid_sfd (sfd) || buf_len <= 0)
         return -1;
 
-    /* Get address info */
-    struct addrinfo* info = get_address_info (host, service,
-                                              SOCKY_UDP, SOCKY_ANY);
-
-    /* Invalid address info */
-    if (info == NULL)
-        return -1;
-
     /* Receive remote data */
-#if defined _WIN32
-    int bytes = recvfrom (sfd, buf, buf_len, flags,
-                          info->ai_addr, (int*) &info->ai_addrlen);
-#else
-    int bytes = recvfrom (sfd, buf, buf_len, flags,
-                          info->ai_addr, &info->ai_addrlen);
-#endif
-
-    /* Return the number of bytes received */
-    freeaddrinfo (info);
-    return bytes;
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof (addr);
+    return recvfrom (sfd, buf, buf_len, flags, (struct sockaddr*) &addr, &len);
 }
@@ -59,6 +59,18 @@ extern "C" {
 /* Set listen() backlog value */
 #define SOCKY_BACKLOG 128
 
+/* Host name resolver function */
+typedef int (*socky_resolver) (const char* host, const char* service,
+                               struct sockaddr_storage* addr, socklen_t* len);
+
+/* Resolver cache functions */
+extern void socky_flush_cache();
+extern void socky_expire (const char* host);
+extern void socky_set_cache_ttl (const int msecs);
+extern void socky_set_resolver (socky_resolver function);
+extern int socky_resolve (const char* host, const char* service,
+                          struct sockaddr_storage* addr, socklen_t* len);
+
 /* Misc functions */
 extern int sockets_exit();
 extern int sockets_init (const int exit_on_fail);
@@ -66,7 +66,7 @@ void DS_ArrayInsert (DS_Array* array, void* element)
     /* Resize array if required */
     if (array->used == array->size) {
         array->size *= 2;
-        array->data = realloc (array->data, array->size);
+        array->data = realloc (array->data, array->size * sizeof (void*));
     }
 
     /* Insert element */
@@ -88,7 +88,7 @@ void DS_ArrayInit (DS_Array* array, size_t initial_size)
         return;
 
     /* Allocate array data */
-    array->data = realloc (array->data, initial_size);
+    array->data = realloc (array->data, initial_size * sizeof (void*));
 
     /* Update array data */
     array->used = 0;
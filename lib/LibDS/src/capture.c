@@ -0,0 +1,365 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "DS_Timer.h"
+#include "DS_Utils.h"
+#include "DS_Config.h"
+#include "DS_Capture.h"
+#include "DS_Protocol.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined _WIN32
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#define HEADER_SIZE 16 /* Size of the file header and of the record headers */
+
+/**
+ * Writes the records of a capture file
+ */
+struct _capture {
+    FILE* file; /**< Capture file */
+};
+
+/**
+ * Reads the records of a capture file, which is mapped into memory
+ */
+struct _capture_reader {
+    uint8_t* data; /**< Contents of the capture file */
+    size_t size;   /**< Size of the capture file */
+    size_t offset; /**< Offset of the next record */
+};
+
+/**
+ * Writes the given \a value in little-endian order
+ */
+static void write_le (uint8_t* dest, uint64_t value, const int bytes)
+{
+    int i;
+    for (i = 0; i < bytes; ++i)
+        dest [i] = (uint8_t) (value >> (8 * i));
+}
+
+/**
+ * Reads a little-endian value of the given number of \a bytes
+ */
+static uint64_t read_le (const uint8_t* src, const int bytes)
+{
+    int i;
+    uint64_t value = 0;
+    for (i = bytes - 1; i >= 0; --i)
+        value = (value << 8) | src [i];
+
+    return value;
+}
+
+/**
+ * Returns the given \a length rounded up to a multiple of 8 bytes
+ */
+static size_t padded (const size_t length)
+{
+    return (length + 7) & ~((size_t) 7);
+}
+
+/**
+ * Creates the capture file at the given \a path, an existing file is
+ * replaced. Record times are only comparable within a capture (the
+ * monotonic clock starts again when the computer reboots), so two
+ * captures are never mixed in the same file.
+ *
+ * \returns the capture writer, or \c NULL on failure
+ */
+DS_Capture* DS_CaptureOpen (const char* path)
+{
+    if (!path)
+        return NULL;
+
+    FILE* file = fopen (path, "wb");
+    if (!file) {
+        fprintf (stderr, "Cannot open capture file %s\n", path);
+        return NULL;
+    }
+
+    /* Write the file header */
+    uint8_t header [HEADER_SIZE] = {0};
+    memcpy (header, DS_CAPTURE_MAGIC, 8);
+    write_le (header + 8, DS_CAPTURE_VERSION, 4);
+    write_le (header + 12, HEADER_SIZE, 4);
+    fwrite (header, 1, sizeof (header), file);
+
+    DS_Capture* capture = calloc (1, sizeof (DS_Capture));
+    capture->file = file;
+    return capture;
+}
+
+/**
+ * Writes the pending records and closes the given \a capture
+ */
+void DS_CaptureClose (DS_Capture* capture)
+{
+    if (!capture)
+        return;
+
+    fclose (capture->file);
+    free (capture);
+}
+
+/**
+ * Appends a record with the given datagram to the given \a capture, the
+ * record is stamped with the current monotonic time
+ */
+void DS_CaptureWrite (DS_Capture* capture,
+                      const DS_CaptureChannel channel,
+                      const DS_CaptureDirection direction,
+                      const void* data, const int length)
+{
+    static const uint8_t padding [8] = {0};
+
+    if (!capture || !data || length <= 0 || length > 0xffff)
+        return;
+
+    uint8_t header [HEADER_SIZE] = {0};
+    write_le (header, DS_GetTime(), 8);
+    write_le (header + 8, length, 2);
+    header [10] = (uint8_t) channel;
+    header [11] = (uint8_t) direction;
+
+    fwrite (header, 1, sizeof (header), capture->file);
+    fwrite (data, 1, length, capture->file);
+    fwrite (padding, 1, padded (length) - length, capture->file);
+}
+
+/**
+ * Maps the capture file at the given \a path into memory and checks its
+ * header
+ *
+ * \returns the capture reader, or \c NULL if the file is not a capture
+ */
+DS_CaptureReader* DS_CaptureReaderOpen (const char* path)
+{
+    if (!path)
+        return NULL;
+
+    DS_CaptureReader* reader = calloc (1, sizeof (DS_CaptureReader));
+
+#if defined _WIN32
+    /* Read the whole file into memory */
+    FILE* file = fopen (path, "rb");
+    if (file) {
+        fseek (file, 0, SEEK_END);
+        reader->size = (size_t) ftell (file);
+        fseek (file, 0, SEEK_SET);
+
+        reader->data = malloc (reader->size ? reader->size : 1);
+        if (fread (reader->data, 1, reader->size, file) != reader->size)
+            reader->size = 0;
+
+        fclose (file);
+    }
+#else
+    /* Map the file into memory */
+    struct stat info;
+    int fd = open (path, O_RDONLY);
+    if (fd >= 0 && fstat (fd, &info) == 0 && info.st_size >= HEADER_SIZE) {
+        void* map = mmap (NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            reader->data = map;
+            reader->size = info.st_size;
+        }
+    }
+
+    if (fd >= 0)
+        close (fd);
+#endif
+
+    /* Check the file header */
+    if (reader->size < HEADER_SIZE
+            || memcmp (reader->data, DS_CAPTURE_MAGIC, 8) != 0
+            || read_le (reader->data + 8, 4) != DS_CAPTURE_VERSION
+            || read_le (reader->data + 12, 4) != HEADER_SIZE) {
+        fprintf (stderr, "Invalid capture file %s\n", path);
+        DS_CaptureReaderClose (reader);
+        return NULL;
+    }
+
+    reader->offset = HEADER_SIZE;
+    return reader;
+}
+
+/**
+ * Un-maps the capture file of the given \a reader
+ */
+void DS_CaptureReaderClose (DS_CaptureReader* reader)
+{
+    if (!reader)
+        return;
+
+#if defined _WIN32
+    free (reader->data);
+#else
+    if (reader->data)
+        munmap (reader->data, reader->size);
+#endif
+
+    free (reader);
+}
+
+/**
+ * Reads the next record of the capture, the record data points to the
+ * capture and stays valid until the reader is closed. A truncated record
+ * at the end of the file (e.g. if the capture is still being written) is
+ * not returned.
+ *
+ * \returns \c 1 if a record was read, \c 0 at the end of the capture
+ */
+int DS_CaptureReaderNext (DS_CaptureReader* reader, DS_CaptureRecord* record)
+{
+    if (!reader || !record)
+        return 0;
+
+    if (reader->size - reader->offset < HEADER_SIZE)
+        return 0;
+
+    const uint8_t* header = reader->data + reader->offset;
+    size_t length = (size_t) read_le (header + 8, 2);
+    if (reader->size - reader->offset - HEADER_SIZE < length)
+        return 0;
+
+    record->time = read_le (header, 8);
+    record->length = (int) length;
+    record->channel = (DS_CaptureChannel) header [10];
+    record->direction = (DS_CaptureDirection) header [11];
+    record->data = header + HEADER_SIZE;
+
+    reader->offset += HEADER_SIZE + padded (length);
+    if (reader->offset > reader->size)
+        reader->offset = reader->size;
+
+    return 1;
+}
+
+/**
+ * Gives the given inbound \a record to the read functions of the given
+ * \a protocol
+ *
+ * \returns \c 1 if the protocol could read the datagram
+ */
+static int replay_record (DS_Protocol* protocol, const DS_CaptureRecord* record)
+{
+    struct tagbstring data;
+    btfromblk (data, record->data, record->length);
+
+    switch (record->channel) {
+    case DS_CAPTURE_FMS:
+        return protocol->read_fms_packet (&data);
+    case DS_CAPTURE_RADIO:
+        return protocol->read_radio_packet (&data);
+    case DS_CAPTURE_ROBOT:
+        return protocol->read_robot_packet (&data);
+    case DS_CAPTURE_NETCONSOLE:
+        CFG_AddNetConsoleMessage ((const char*) data.data, data.slen);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Gives the inbound datagrams of the capture at the given \a path to the
+ * protocol of the current context, either with their original timing (if
+ * \a realtime is set) or as fast as possible.
+ *
+ * The protocol must be configured before calling this function, and the
+ * context should not be connected to a robot while the capture is replayed
+ * (otherwise both sources will update the same state). The state snapshot
+ * is updated by the DS thread, as with the datagrams of a robot.
+ *
+ * \param path the path of the capture file
+ * \param realtime set to \c 1 to keep the original time between datagrams
+ * \param stats if not \c NULL, receives the results of the replay
+ *
+ * \returns \c 1 on success, \c 0 if there is no protocol or capture
+ */
+int DS_ReplayCapture (const char* path, const int realtime, DS_ReplayStats* stats)
+{
+    DS_CaptureRecord record;
+    DS_ReplayStats results;
+    DS_Protocol* protocol = DS_CurrentProtocol();
+
+    memset (&results, 0, sizeof (results));
+    if (!protocol)
+        return 0;
+
+    DS_CaptureReader* reader = DS_CaptureReaderOpen (path);
+    if (!reader)
+        return 0;
+
+    int timed = 0;
+    uint64_t first = 0;
+    uint64_t previous = 0;
+    uint64_t start = DS_GetTime();
+    uint64_t origin = start;
+    while (DS_CaptureReaderNext (reader, &record)) {
+        /* Only the received datagrams are replayed */
+        if (record.direction != DS_CAPTURE_INBOUND) {
+            ++results.skipped;
+            continue;
+        }
+
+        /* Wait until the datagram was originally received, a time that
+         * goes backwards (e.g. captures joined together) starts again */
+        if (realtime) {
+            if (!timed || record.time < previous) {
+                timed = 1;
+                first = record.time;
+                origin = DS_GetTime();
+            }
+
+            previous = record.time;
+            DS_SleepUntil (origin + (record.time - first));
+        }
+
+        ++results.packets;
+        results.bytes += record.length;
+
+        /* Do not let the DS thread publish a half-applied datagram */
+        CFG_LockState();
+        results.accepted += replay_record (protocol, &record);
+        CFG_UnlockState();
+    }
+
+    results.time = DS_GetTime() - start;
+    DS_CaptureReaderClose (reader);
+
+    if (stats)
+        *stats = results;
+
+    return 1;
+}
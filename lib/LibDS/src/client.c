@@ -24,26 +24,54 @@
 #include "DS_Utils.h"
 #include "DS_Client.h"
 #include "DS_Config.h"
+#include "DS_Context.h"
 #include "DS_Protocol.h"
+#include "DS_Discovery.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <bstrlib.h>
 
-static bstring status_string = NULL;
-static bstring custom_fms_address = NULL;
-static bstring custom_radio_address = NULL;
-static bstring custom_robot_address = NULL;
+#define REBOOT_MESSAGE  "Rebooting robot..."
+#define RESTART_MESSAGE "Restarting robot code..."
+
+/**
+ * Holds the state of the client module in a context
+ */
+typedef struct _client_state {
+    bstring custom_fms_address;   /**< User-set FMS address */
+    bstring custom_radio_address; /**< User-set radio address */
+    bstring custom_robot_address; /**< User-set robot address */
+} DS_ClientState;
+
+/**
+ * Returns the client state of the current context
+ */
+static DS_ClientState* state()
+{
+    return (DS_ClientState*) Context_GetState (DS_MODULE_CLIENT);
+}
+
+/**
+ * Returns \c 1 if there is a context to work with. Before DS_Init() and
+ * after DS_Close() there is none, and the client functions return the same
+ * default values that the DS uses while the robot is not connected.
+ */
+static int has_context()
+{
+    return DS_CurrentContext() != NULL;
+}
 
 /**
  * Allocates memory for the members of the client module
  */
 void Client_Init()
 {
-    status_string = bfromcstr ("");
-    custom_fms_address = bfromcstr ("");
-    custom_radio_address = bfromcstr ("");
-    custom_robot_address = bfromcstr ("");
+    Context_SetState (DS_MODULE_CLIENT, calloc (1, sizeof (DS_ClientState)));
+
+    state()->custom_fms_address = bfromcstr ("");
+    state()->custom_radio_address = bfromcstr ("");
+    state()->custom_robot_address = bfromcstr ("");
 }
 
 /**
@@ -51,10 +79,12 @@ void Client_Init()
  */
 void Client_Close()
 {
-    DS_FREESTR (status_string);
-    DS_FREESTR (custom_fms_address);
-    DS_FREESTR (custom_radio_address);
-    DS_FREESTR (custom_robot_address);
+    DS_FREESTR (state()->custom_fms_address);
+    DS_FREESTR (state()->custom_radio_address);
+    DS_FREESTR (state()->custom_robot_address);
+
+    free (state());
+    Context_SetState (DS_MODULE_CLIENT, NULL);
 }
 
 /**
@@ -64,7 +94,10 @@ void Client_Close()
  */
 bstring DS_GetCustomFMSAddress()
 {
-    return bstrcpy (custom_fms_address);
+    if (!has_context())
+        return bfromcstr ("");
+
+    return bstrcpy (state()->custom_fms_address);
 }
 
 /**
@@ -74,7 +107,10 @@ bstring DS_GetCustomFMSAddress()
  */
 bstring DS_GetCustomRadioAddress()
 {
-    return bstrcpy (custom_radio_address);
+    if (!has_context())
+        return bfromcstr ("");
+
+    return bstrcpy (state()->custom_radio_address);
 }
 
 /**
@@ -84,7 +120,10 @@ bstring DS_GetCustomRadioAddress()
  */
 bstring DS_GetCustomRobotAddress()
 {
-    return bstrcpy (custom_robot_address);
+    if (!has_context())
+        return bfromcstr ("");
+
+    return bstrcpy (state()->custom_robot_address);
 }
 
 /**
@@ -134,7 +173,7 @@ bstring DS_GetDefaultRobotAddress()
  */
 bstring DS_GetAppliedFMSAddress()
 {
-    if (DS_StringIsEmpty (custom_fms_address))
+    if (!has_context() || DS_StringIsEmpty (state()->custom_fms_address))
         return DS_GetDefaultFMSAddress();
 
     return DS_GetCustomFMSAddress();
@@ -148,7 +187,7 @@ bstring DS_GetAppliedFMSAddress()
  */
 bstring DS_GetAppliedRadioAddress()
 {
-    if (DS_StringIsEmpty (custom_radio_address))
+    if (!has_context() || DS_StringIsEmpty (state()->custom_radio_address))
         return DS_GetDefaultRadioAddress();
 
     return DS_GetCustomRadioAddress();
@@ -157,14 +196,23 @@ bstring DS_GetAppliedRadioAddress()
 /**
  * Returns the address used to communicate with the robot.
  * If the user-set address is not empty, then this function will return the
- * user-set address. Otherwise, this function will return the address
- * specified  by the currently loaded protocol.
+ * user-set address. Otherwise, this function will return the address in
+ * which the robot was discovered, or the address specified by the currently
+ * loaded protocol (if the robot has not been discovered yet).
  */
 bstring DS_GetAppliedRobotAddress()
 {
-    if (DS_StringIsEmpty (custom_robot_address))
+    if (!has_context())
         return DS_GetDefaultRobotAddress();
 
+    if (DS_StringIsEmpty (state()->custom_robot_address)) {
+        bstring address = Discovery_GetAddress();
+        if (address)
+            return address;
+
+        return DS_GetDefaultRobotAddress();
+    }
+
     return DS_GetCustomRobotAddress();
 }
 
@@ -180,38 +228,45 @@ bstring DS_GetAppliedRobotAddress()
  *    - Teleoperated Enabled/Disabled
  *    - Autonomous Enabled/Disabled
  *    - Test Enabled/Disabled
+ *
+ * The returned string is a copy that must be freed by the caller, use
+ * DS_GetStatusText() to read the status without allocating memory.
  */
 bstring DS_GetStatusString()
 {
-    DS_FREESTR (status_string);
+    return bfromcstr (DS_GetStatusText (NULL));
+}
 
-    if (!DS_GetRobotCommunications())
-        status_string = bfromcstr ("No Robot Communications");
+/**
+ * Returns the current status string without copying it. The string is
+ * static: it must not be freed and it remains valid after the status
+ * changes, so the client can keep it until the status \a version changes.
+ *
+ * The \a version is optional, and it is the same that is returned by
+ * DS_GetStatusVersion().
+ */
+const char* DS_GetStatusText (uint32_t* version)
+{
+    if (!has_context()) {
+        if (version)
+            *version = 0;
 
-    else if (!DS_GetRobotCode())
-        status_string = bfromcstr ("No Robot Code");
+        return "";
+    }
 
-    else if (DS_GetEmergencyStopped())
-        status_string = bfromcstr ("Emergency Stopped");
+    return CFG_GetStatusString (version);
+}
 
-    else {
-        switch (DS_GetControlMode()) {
-        case DS_CONTROL_TELEOPERATED:
-            status_string = bfromcstr ("Teleoperated");
-            break;
-        case DS_CONTROL_AUTONOMOUS:
-            status_string = bfromcstr ("Autonomous");
-            break;
-        case DS_CONTROL_TEST:
-            status_string = bfromcstr ("Test");
-            break;
-        }
-
-        bconcat (status_string, bfromcstr (DS_GetRobotEnabled() ?
-                                           " Enabled" : " Disabled"));
-    }
+/**
+ * Returns the version of the status string, which grows every time that
+ * the status string changes
+ */
+uint32_t DS_GetStatusVersion()
+{
+    if (!has_context())
+        return 0;
 
-    return bstrcpy (status_string);
+    return CFG_GetStatusVersion();
 }
 
 /**
@@ -219,6 +274,9 @@ bstring DS_GetStatusString()
  */
 int DS_GetTeamNumber()
 {
+    if (!has_context())
+        return 0;
+
     return CFG_GetTeamNumber();
 }
 
@@ -227,6 +285,9 @@ int DS_GetTeamNumber()
  */
 int DS_GetRobotCode()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetRobotCode();
 }
 
@@ -244,12 +305,46 @@ int DS_GetCanBeEnabled()
            && DS_GetRobotCommunications();
 }
 
+/**
+ * Copies a consistent view of the robot state into the given \a snapshot
+ * and returns its version. Unlike calling the individual getters, all the
+ * values in the snapshot belong to the same state update.
+ *
+ * If the returned version is the same as in the previous call, the state
+ * did not change and the client can skip updating its interface.
+ */
+uint32_t DS_GetStateSnapshot (DS_StateSnapshot* snapshot)
+{
+    if (!has_context()) {
+        memset (snapshot, 0, sizeof (DS_StateSnapshot));
+        return 0;
+    }
+
+    return CFG_GetStateSnapshot (snapshot);
+}
+
+/**
+ * Returns the version of the last published state snapshot, this is cheaper
+ * than DS_GetStateSnapshot() when the client only needs to know if the
+ * robot state changed.
+ */
+uint32_t DS_GetStateVersion()
+{
+    if (!has_context())
+        return 0;
+
+    return CFG_GetStateVersion();
+}
+
 /**
  * Returns \c 1 if the robot can be enabled, otherwise, this function will
  * return \c 0.
  */
 int DS_GetRobotEnabled()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetRobotEnabled();
 }
 
@@ -258,6 +353,9 @@ int DS_GetRobotEnabled()
  */
 int DS_GetRobotCPUUsage()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetRobotCPUUsage();
 }
 
@@ -266,6 +364,9 @@ int DS_GetRobotCPUUsage()
  */
 int DS_GetRobotRAMUsage()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetRobotRAMUsage();
 }
 
@@ -274,6 +375,9 @@ int DS_GetRobotRAMUsage()
  */
 int DS_GetRobotDiskUsage()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetRobotDiskUsage();
 }
 
@@ -282,6 +386,9 @@ int DS_GetRobotDiskUsage()
  */
 float DS_GetRobotVoltage()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetRobotVoltage();
 }
 
@@ -291,6 +398,9 @@ float DS_GetRobotVoltage()
  */
 DS_Alliance DS_GetAlliance()
 {
+    if (!has_context())
+        return DS_ALLIANCE_RED;
+
     return CFG_GetAlliance();
 }
 
@@ -300,6 +410,9 @@ DS_Alliance DS_GetAlliance()
  */
 DS_Position DS_GetPosition()
 {
+    if (!has_context())
+        return DS_POSITION_1;
+
     return CFG_GetPosition();
 }
 
@@ -308,6 +421,9 @@ DS_Position DS_GetPosition()
  */
 int DS_GetEmergencyStopped()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetEmergencyStopped();
 }
 
@@ -316,6 +432,9 @@ int DS_GetEmergencyStopped()
  */
 int DS_GetFMSCommunications()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetFMSCommunications();
 }
 
@@ -324,6 +443,9 @@ int DS_GetFMSCommunications()
  */
 int DS_GetRadioCommunications()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetRadioCommunications();
 }
 
@@ -332,6 +454,9 @@ int DS_GetRadioCommunications()
  */
 int DS_GetRobotCommunications()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetRobotCommunications();
 }
 
@@ -340,6 +465,9 @@ int DS_GetRobotCommunications()
  */
 int DS_GetRobotCANUtilization()
 {
+    if (!has_context())
+        return -1;
+
     return CFG_GetCANUtilization();
 }
 
@@ -348,6 +476,9 @@ int DS_GetRobotCANUtilization()
  */
 DS_ControlMode DS_GetControlMode()
 {
+    if (!has_context())
+        return DS_CONTROL_TELEOPERATED;
+
     return CFG_GetControlMode();
 }
 
@@ -369,7 +500,7 @@ void DS_RebootRobot()
 {
     if (DS_CurrentProtocol()) {
         DS_CurrentProtocol()->reboot_robot();
-        CFG_AddNetConsoleMessage (bfromcstr ("Rebooting robot..."));
+        CFG_AddNetConsoleMessage (REBOOT_MESSAGE, strlen (REBOOT_MESSAGE));
     }
 }
 
@@ -380,7 +511,7 @@ void DS_RestartRobotCode()
 {
     if (DS_CurrentProtocol()) {
         DS_CurrentProtocol()->restart_robot_code();
-        CFG_AddNetConsoleMessage (bfromcstr ("Restarting robot code..."));
+        CFG_AddNetConsoleMessage (RESTART_MESSAGE, strlen (RESTART_MESSAGE));
     }
 }
 
@@ -390,7 +521,8 @@ void DS_RestartRobotCode()
  */
 void DS_SetTeamNumber (const int team)
 {
-    CFG_SetTeamNumber (team);
+    if (has_context())
+        CFG_SetTeamNumber (team);
 }
 
 /**
@@ -398,7 +530,8 @@ void DS_SetTeamNumber (const int team)
  */
 void DS_SetRobotEnabled (const int enabled)
 {
-    CFG_SetRobotEnabled (enabled);
+    if (has_context())
+        CFG_SetRobotEnabled (enabled);
 }
 
 /**
@@ -406,7 +539,8 @@ void DS_SetRobotEnabled (const int enabled)
  */
 void DS_SetEmergencyStopped (const int stop)
 {
-    CFG_SetEmergencyStopped (stop);
+    if (has_context())
+        CFG_SetEmergencyStopped (stop);
 }
 
 /**
@@ -414,7 +548,8 @@ void DS_SetEmergencyStopped (const int stop)
  */
 void DS_SetAlliance (const DS_Alliance alliance)
 {
-    CFG_SetAlliance (alliance);
+    if (has_context())
+        CFG_SetAlliance (alliance);
 }
 
 /**
@@ -422,7 +557,8 @@ void DS_SetAlliance (const DS_Alliance alliance)
  */
 void DS_SetPosition (const DS_Position position)
 {
-    CFG_SetPosition (position);
+    if (has_context())
+        CFG_SetPosition (position);
 }
 
 /**
@@ -430,7 +566,8 @@ void DS_SetPosition (const DS_Position position)
  */
 void DS_SetControlMode (const DS_ControlMode mode)
 {
-    CFG_SetControlMode (mode);
+    if (has_context())
+        CFG_SetControlMode (mode);
 }
 
 /**
@@ -438,15 +575,18 @@ void DS_SetControlMode (const DS_ControlMode mode)
  */
 void DS_SetCustomFMSAddress (const char* address)
 {
+    if (!has_context())
+        return;
+
     if (strlen (address) > 0) {
-        DS_FREESTR (custom_fms_address);
-        custom_fms_address = bfromcstr (address);
+        DS_FREESTR (state()->custom_fms_address);
+        state()->custom_fms_address = bfromcstr (address);
         CFG_ReconfigureAddresses (RECONFIGURE_FMS);
     }
 
     else {
-        DS_FREESTR (custom_fms_address);
-        custom_fms_address = bfromcstr ("");
+        DS_FREESTR (state()->custom_fms_address);
+        state()->custom_fms_address = bfromcstr ("");
         CFG_ReconfigureAddresses (RECONFIGURE_FMS);
     }
 }
@@ -456,15 +596,18 @@ void DS_SetCustomFMSAddress (const char* address)
  */
 void DS_SetCustomRadioAddress (const char* address)
 {
+    if (!has_context())
+        return;
+
     if (strlen (address) > 0) {
-        DS_FREESTR (custom_radio_address);
-        custom_radio_address = bfromcstr (address);
+        DS_FREESTR (state()->custom_radio_address);
+        state()->custom_radio_address = bfromcstr (address);
         CFG_ReconfigureAddresses (RECONFIGURE_RADIO);
     }
 
     else {
-        DS_FREESTR (custom_radio_address);
-        custom_radio_address = bfromcstr ("");
+        DS_FREESTR (state()->custom_radio_address);
+        state()->custom_radio_address = bfromcstr ("");
         CFG_ReconfigureAddresses (RECONFIGURE_RADIO);
     }
 }
@@ -474,15 +617,20 @@ void DS_SetCustomRadioAddress (const char* address)
  */
 void DS_SetCustomRobotAddress (const char* address)
 {
+    if (!has_context())
+        return;
+
     if (strlen (address) > 0) {
-        DS_FREESTR (custom_robot_address);
-        custom_robot_address = bfromcstr (address);
+        DS_FREESTR (state()->custom_robot_address);
+        state()->custom_robot_address = bfromcstr (address);
+        Discovery_SetCustomAddress (1);
         CFG_ReconfigureAddresses (RECONFIGURE_ROBOT);
     }
 
     else {
-        DS_FREESTR (custom_robot_address);
-        custom_robot_address = bfromcstr ("");
+        DS_FREESTR (state()->custom_robot_address);
+        state()->custom_robot_address = bfromcstr ("");
+        Discovery_SetCustomAddress (0);
         CFG_ReconfigureAddresses (RECONFIGURE_ROBOT);
     }
 }
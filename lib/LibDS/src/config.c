@@ -25,28 +25,127 @@
 #include "DS_Client.h"
 #include "DS_Events.h"
 #include "DS_Config.h"
+#include "DS_Context.h"
 #include "DS_Protocol.h"
+#include "DS_Discovery.h"
+#include "DS_NetConsole.h"
 
 #include <math.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-/*
- * These variables hold the state(s) of the LibDS and its modules
- */
-static int team = 0;
-static int cpu_usage = -1;
-static int ram_usage = -1;
-static int disk_usage = -1;
-static int robot_code = -1;
-static int robot_enabled = -1;
-static int can_utilization = -1;
-static float robot_voltage = -1;
-static int emergency_stopped = -1;
-static int fms_communications = -1;
-static int radio_communications = -1;
-static int robot_communications = -1;
-static DS_Position robot_position = DS_POSITION_1;
-static DS_Alliance robot_alliance = DS_ALLIANCE_RED;
-static DS_ControlMode control_mode = DS_CONTROL_TELEOPERATED;
+#define NOTIFICATION_SIZE   512 /* Maximum length of a LibDS notification */
+#define NOTIFICATION_PREFIX "<font color=#aaa>** LibDS: "
+#define NOTIFICATION_SUFFIX "</font>"
+
+/* The status index uses the lower bits, its version uses the rest */
+#define STATUS_BITS 4
+#define STATUS_MASK ((1u << STATUS_BITS) - 1)
+
+/* Number of 32-bit words in a state snapshot */
+#define SNAPSHOT_WORDS (sizeof (DS_StateSnapshot) / sizeof (uint32_t))
+
+/* Snapshots are copied word by word, so they must not have partial words */
+typedef char snapshot_size_check [
+    (sizeof (DS_StateSnapshot) % sizeof (uint32_t)) == 0 ? 1 : -1];
+
+/**
+ * Every possible status string, they are never allocated or freed, so the
+ * clients can keep the pointers returned by CFG_GetStatusString()
+ */
+static const char* STATUS_STRINGS[] = {
+    "No Robot Communications",
+    "No Robot Code",
+    "Emergency Stopped",
+    "Test Disabled",
+    "Test Enabled",
+    "Autonomous Disabled",
+    "Autonomous Enabled",
+    "Teleoperated Disabled",
+    "Teleoperated Enabled",
+};
+
+/**
+ * Holds the state of the config module (the state of the robot, the FMS and
+ * the radio) in a context
+ */
+typedef struct _config_state {
+    int team;                    /**< Team number */
+    int cpu_usage;               /**< Robot CPU usage */
+    int ram_usage;               /**< Robot RAM usage */
+    int disk_usage;              /**< Robot disk usage */
+    int robot_code;              /**< Set if the robot code is running */
+    int robot_enabled;           /**< Set if the robot is enabled */
+    int can_utilization;         /**< Robot CAN utilization */
+    float robot_voltage;         /**< Robot battery voltage */
+    int emergency_stopped;       /**< Set if the robot is e-stopped */
+    int fms_communications;      /**< Set if the FMS is connected */
+    int radio_communications;    /**< Set if the radio is connected */
+    int robot_communications;    /**< Set if the robot is connected */
+    DS_Position robot_position;  /**< Team position */
+    DS_Alliance robot_alliance;  /**< Team alliance */
+    DS_ControlMode control_mode; /**< Robot control mode */
+
+    atomic_int changed;                    /**< Set if not published yet */
+    atomic_uint sequence;                  /**< Odd while publishing */
+    atomic_uint snapshot [SNAPSHOT_WORDS]; /**< Published state snapshot */
+    pthread_mutex_t publish_lock;          /**< Held while publishing */
+
+    atomic_uint status; /**< Status string index and version */
+} DS_ConfigState;
+
+/**
+ * Returns the config state of the current context
+ */
+static DS_ConfigState* state()
+{
+    return (DS_ConfigState*) Context_GetState (DS_MODULE_CONFIG);
+}
+
+/**
+ * Allocates the config state of the current context and sets its initial
+ * values (unknown robot state, red alliance, position 1, teleoperated)
+ */
+void Config_Init()
+{
+    DS_ConfigState* config = calloc (1, sizeof (DS_ConfigState));
+
+    config->team = 0;
+    config->cpu_usage = -1;
+    config->ram_usage = -1;
+    config->disk_usage = -1;
+    config->robot_code = -1;
+    config->robot_enabled = -1;
+    config->can_utilization = -1;
+    config->robot_voltage = -1;
+    config->emergency_stopped = -1;
+    config->fms_communications = -1;
+    config->radio_communications = -1;
+    config->robot_communications = -1;
+    config->robot_position = DS_POSITION_1;
+    config->robot_alliance = DS_ALLIANCE_RED;
+    config->control_mode = DS_CONTROL_TELEOPERATED;
+    pthread_mutex_init (&config->publish_lock, NULL);
+
+    Context_SetState (DS_MODULE_CONFIG, config);
+
+    /* Publish the initial state */
+    atomic_store (&config->changed, 1);
+    CFG_PublishState();
+}
+
+/**
+ * De-allocates the config state of the current context
+ */
+void Config_Close()
+{
+    pthread_mutex_destroy (&state()->publish_lock);
+    free (state());
+    Context_SetState (DS_MODULE_CONFIG, NULL);
+}
 
 /**
  * Ensures that the given \a input number is either \c 0 or \c 1
@@ -75,6 +174,41 @@ static int respect_range (const int input, const int min, const int max)
     return input;
 }
 
+/**
+ * Marks the state as changed, so that the next call to CFG_PublishState()
+ * publishes a new snapshot. Must be called after the state is written.
+ */
+static void mark_changed()
+{
+    atomic_store_explicit (&state()->changed, 1, memory_order_release);
+}
+
+/**
+ * Returns the index of the status string that describes the current state
+ */
+static unsigned int status_index()
+{
+    if (!CFG_GetRobotCommunications())
+        return 0;
+
+    else if (!CFG_GetRobotCode())
+        return 1;
+
+    else if (CFG_GetEmergencyStopped())
+        return 2;
+
+    switch (CFG_GetControlMode()) {
+    case DS_CONTROL_TEST:
+        return 3 + CFG_GetRobotEnabled();
+    case DS_CONTROL_AUTONOMOUS:
+        return 5 + CFG_GetRobotEnabled();
+    case DS_CONTROL_TELEOPERATED:
+        return 7 + CFG_GetRobotEnabled();
+    }
+
+    return 0;
+}
+
 /**
  * Creates and fills a robot event with the given \a type header
  */
@@ -82,6 +216,10 @@ static void create_robot_event (const DS_EventType type)
 {
     DS_Event event;
 
+    /* Do not read the robot state if nobody wants the event */
+    if (!Events_Subscribed (type))
+        return;
+
     event.robot.type = type;
     event.robot.code = CFG_GetRobotCode();
     event.robot.mode = CFG_GetControlMode();
@@ -98,30 +236,65 @@ static void create_robot_event (const DS_EventType type)
 }
 
 /**
- * Notifies the user about something through the NetConsole
+ * Selects the status string for the current state (increasing its version
+ * only if the string is different) and notifies the client
  */
-void CFG_AddNotification (bstring msg)
+static void status_changed()
 {
-    if (msg) {
-        bstring notification = bfromcstr ("<font color=#aaa>** LibDS: ");
-        bconcat (notification, msg),
-                bconcat (notification, bfromcstr ("</font>"));
-        CFG_AddNetConsoleMessage (notification);
-    }
+    DS_ConfigState* config = state();
+    unsigned int index = status_index();
+    unsigned int status = atomic_load (&config->status);
+
+    do {
+        if ((status & STATUS_MASK) == index)
+            break;
+    } while (!atomic_compare_exchange_weak (&config->status, &status,
+                                            (status & ~STATUS_MASK)
+                                            + (1u << STATUS_BITS) + index));
+
+    create_robot_event (DS_STATUS_STRING_CHANGED);
 }
 
 /**
- * Notifies the application of a new NetConsole message through the
- * DS events system
+ * Notifies the user about something through the NetConsole, the message is
+ * formatted with \c vsnprintf() (without allocating memory)
+ */
+void CFG_AddNotification (const char* format, ...)
+{
+    if (!format || !Events_Subscribed (DS_NETCONSOLE_NEW_MESSAGE))
+        return;
+
+    va_list args;
+    char text [NOTIFICATION_SIZE];
+    int length = snprintf (text, sizeof (text), NOTIFICATION_PREFIX);
+
+    va_start (args, format);
+    vsnprintf (text + length, sizeof (text) - length, format, args);
+    va_end (args);
+
+    length = strlen (text);
+    snprintf (text + length, sizeof (text) - length, NOTIFICATION_SUFFIX);
+    CFG_AddNetConsoleMessage (text, strlen (text));
+}
+
+/**
+ * Copies the given NetConsole message to the NetConsole buffer and notifies
+ * the application through the DS events system. Nothing is stored if the
+ * application is not subscribed to NetConsole events.
  *
- * \a msg the message to display
+ * \param data the message bytes (not NUL-terminated)
+ * \param length the number of bytes in the message
  */
-void CFG_AddNetConsoleMessage (bstring msg)
+void CFG_AddNetConsoleMessage (const char* data, const int length)
 {
-    if (msg) {
+    if (!data || !Events_Subscribed (DS_NETCONSOLE_NEW_MESSAGE))
+        return;
+
+    uint64_t handle = NetConsole_Add (data, length);
+    if (handle) {
         DS_Event event;
         event.netconsole.type = DS_NETCONSOLE_NEW_MESSAGE;
-        event.netconsole.message = msg;
+        event.netconsole.handle = handle;
         DS_AddEvent (&event);
     }
 }
@@ -163,7 +336,7 @@ void CFG_ReconfigureAddresses (const int flags)
  */
 int CFG_GetTeamNumber()
 {
-    return DS_Max (team, 0);
+    return DS_Max (state()->team, 0);
 }
 
 /**
@@ -171,7 +344,7 @@ int CFG_GetTeamNumber()
  */
 int CFG_GetRobotCode()
 {
-    return robot_code == 1;
+    return state()->robot_code == 1;
 }
 
 /**
@@ -179,7 +352,7 @@ int CFG_GetRobotCode()
  */
 int CFG_GetRobotEnabled()
 {
-    return robot_enabled == 1;
+    return state()->robot_enabled == 1;
 }
 
 /**
@@ -187,7 +360,7 @@ int CFG_GetRobotEnabled()
  */
 int CFG_GetRobotCPUUsage()
 {
-    return DS_Max (cpu_usage, 0);
+    return DS_Max (state()->cpu_usage, 0);
 }
 
 /**
@@ -195,7 +368,7 @@ int CFG_GetRobotCPUUsage()
  */
 int CFG_GetRobotRAMUsage()
 {
-    return DS_Max (ram_usage, 0);
+    return DS_Max (state()->ram_usage, 0);
 }
 
 /**
@@ -203,7 +376,7 @@ int CFG_GetRobotRAMUsage()
  */
 int CFG_GetCANUtilization()
 {
-    return DS_Max (can_utilization, 0);
+    return DS_Max (state()->can_utilization, 0);
 }
 
 /**
@@ -211,7 +384,7 @@ int CFG_GetCANUtilization()
  */
 int CFG_GetRobotDiskUsage()
 {
-    return DS_Max (disk_usage, 0);
+    return DS_Max (state()->disk_usage, 0);
 }
 
 /**
@@ -219,7 +392,7 @@ int CFG_GetRobotDiskUsage()
  */
 float CFG_GetRobotVoltage()
 {
-    return DS_Max (robot_voltage, 0);
+    return DS_Max (state()->robot_voltage, 0);
 }
 
 /**
@@ -229,7 +402,7 @@ float CFG_GetRobotVoltage()
  */
 DS_Alliance CFG_GetAlliance()
 {
-    return robot_alliance;
+    return state()->robot_alliance;
 }
 
 /**
@@ -240,7 +413,7 @@ DS_Alliance CFG_GetAlliance()
  */
 DS_Position CFG_GetPosition()
 {
-    return robot_position;
+    return state()->robot_position;
 }
 
 /**
@@ -248,7 +421,7 @@ DS_Position CFG_GetPosition()
  */
 int CFG_GetEmergencyStopped()
 {
-    return emergency_stopped == 1;
+    return state()->emergency_stopped == 1;
 }
 
 /**
@@ -257,7 +430,7 @@ int CFG_GetEmergencyStopped()
  */
 int CFG_GetFMSCommunications()
 {
-    return fms_communications == 1;
+    return state()->fms_communications == 1;
 }
 
 /**
@@ -266,7 +439,7 @@ int CFG_GetFMSCommunications()
  */
 int CFG_GetRadioCommunications()
 {
-    return radio_communications == 1;
+    return state()->radio_communications == 1;
 }
 
 /**
@@ -275,7 +448,7 @@ int CFG_GetRadioCommunications()
  */
 int CFG_GetRobotCommunications()
 {
-    return robot_communications == 1;
+    return state()->robot_communications == 1;
 }
 
 /**
@@ -286,7 +459,7 @@ int CFG_GetRobotCommunications()
  */
 DS_ControlMode CFG_GetControlMode()
 {
-    return control_mode;
+    return state()->control_mode;
 }
 
 /**
@@ -294,10 +467,11 @@ DS_ControlMode CFG_GetControlMode()
  */
 void CFG_SetRobotCode (const int code)
 {
-    if (robot_code != to_boolean (code)) {
-        robot_code = to_boolean (code);
+    if (state()->robot_code != to_boolean (code)) {
+        state()->robot_code = to_boolean (code);
+        mark_changed();
         create_robot_event (DS_ROBOT_CODE_CHANGED);
-        create_robot_event (DS_STATUS_STRING_CHANGED);
+        status_changed();
     }
 }
 
@@ -306,8 +480,10 @@ void CFG_SetRobotCode (const int code)
  */
 void CFG_SetTeamNumber (const int number)
 {
-    if (team != number) {
-        team = number;
+    if (state()->team != number) {
+        state()->team = number;
+        mark_changed();
+        Discovery_Reset();
         CFG_ReconfigureAddresses (RECONFIGURE_ALL);
     }
 }
@@ -317,10 +493,12 @@ void CFG_SetTeamNumber (const int number)
  */
 void CFG_SetRobotEnabled (const int enabled)
 {
-    if (robot_enabled != to_boolean (enabled)) {
-        robot_enabled = to_boolean (enabled) && !CFG_GetEmergencyStopped();
+    if (state()->robot_enabled != to_boolean (enabled)) {
+        state()->robot_enabled = to_boolean (enabled) &&
+                                 !CFG_GetEmergencyStopped();
+        mark_changed();
         create_robot_event (DS_ROBOT_ENABLED_CHANGED);
-        create_robot_event (DS_STATUS_STRING_CHANGED);
+        status_changed();
     }
 }
 
@@ -330,8 +508,9 @@ void CFG_SetRobotEnabled (const int enabled)
  */
 void CFG_SetRobotCPUUsage (const int percent)
 {
-    if (cpu_usage != percent) {
-        cpu_usage = respect_range (percent, 0, 100);
+    if (state()->cpu_usage != percent) {
+        state()->cpu_usage = respect_range (percent, 0, 100);
+        mark_changed();
         create_robot_event (DS_ROBOT_CPU_INFO_CHANGED);
     }
 }
@@ -342,8 +521,9 @@ void CFG_SetRobotCPUUsage (const int percent)
  */
 void CFG_SetRobotRAMUsage (const int percent)
 {
-    if (ram_usage != percent) {
-        ram_usage = respect_range (percent, 0, 100);
+    if (state()->ram_usage != percent) {
+        state()->ram_usage = respect_range (percent, 0, 100);
+        mark_changed();
         create_robot_event (DS_ROBOT_RAM_INFO_CHANGED);
     }
 }
@@ -354,8 +534,9 @@ void CFG_SetRobotRAMUsage (const int percent)
  */
 void CFG_SetRobotDiskUsage (const int percent)
 {
-    if (disk_usage != percent) {
-        disk_usage = respect_range (percent, 0, 100);
+    if (state()->disk_usage != percent) {
+        state()->disk_usage = respect_range (percent, 0, 100);
+        mark_changed();
         create_robot_event (DS_ROBOT_DISK_INFO_CHANGED);
     }
 }
@@ -365,8 +546,9 @@ void CFG_SetRobotDiskUsage (const int percent)
  */
 void CFG_SetRobotVoltage (const float voltage)
 {
-    if (robot_voltage != voltage) {
-        robot_voltage = roundf (voltage * 100) / 100;
+    if (state()->robot_voltage != voltage) {
+        state()->robot_voltage = roundf (voltage * 100) / 100;
+        mark_changed();
         create_robot_event (DS_ROBOT_VOLTAGE_CHANGED);
     }
 }
@@ -376,10 +558,11 @@ void CFG_SetRobotVoltage (const float voltage)
  */
 void CFG_SetEmergencyStopped (const int stopped)
 {
-    if (emergency_stopped != to_boolean (stopped)) {
-        emergency_stopped = to_boolean (stopped);
+    if (state()->emergency_stopped != to_boolean (stopped)) {
+        state()->emergency_stopped = to_boolean (stopped);
+        mark_changed();
         create_robot_event (DS_ROBOT_ESTOP_CHANGED);
-        create_robot_event (DS_STATUS_STRING_CHANGED);
+        status_changed();
     }
 }
 
@@ -388,8 +571,9 @@ void CFG_SetEmergencyStopped (const int stopped)
  */
 void CFG_SetAlliance (const DS_Alliance alliance)
 {
-    if (robot_alliance != alliance) {
-        robot_alliance = alliance;
+    if (state()->robot_alliance != alliance) {
+        state()->robot_alliance = alliance;
+        mark_changed();
         create_robot_event (DS_ROBOT_STATION_CHANGED);
     }
 }
@@ -399,8 +583,9 @@ void CFG_SetAlliance (const DS_Alliance alliance)
  */
 void CFG_SetPosition (const DS_Position position)
 {
-    if (robot_position != position) {
-        robot_position = position;
+    if (state()->robot_position != position) {
+        state()->robot_position = position;
+        mark_changed();
         create_robot_event (DS_ROBOT_STATION_CHANGED);
     }
 }
@@ -410,8 +595,9 @@ void CFG_SetPosition (const DS_Position position)
  */
 void CFG_SetCANUtilization (const int utilization)
 {
-    if (can_utilization != utilization) {
-        can_utilization = utilization;
+    if (state()->can_utilization != utilization) {
+        state()->can_utilization = utilization;
+        mark_changed();
         create_robot_event (DS_ROBOT_CAN_UTIL_CHANGED);
     }
 }
@@ -421,10 +607,11 @@ void CFG_SetCANUtilization (const int utilization)
  */
 void CFG_SetControlMode (const DS_ControlMode mode)
 {
-    if (control_mode != mode) {
-        control_mode = mode;
+    if (state()->control_mode != mode) {
+        state()->control_mode = mode;
+        mark_changed();
         create_robot_event (DS_ROBOT_MODE_CHANGED);
-        create_robot_event (DS_STATUS_STRING_CHANGED);
+        status_changed();
     }
 }
 
@@ -433,12 +620,13 @@ void CFG_SetControlMode (const DS_ControlMode mode)
  */
 void CFG_SetFMSCommunications (const int communications)
 {
-    if (fms_communications != to_boolean (communications)) {
-        fms_communications = to_boolean (communications);
+    if (state()->fms_communications != to_boolean (communications)) {
+        state()->fms_communications = to_boolean (communications);
+        mark_changed();
 
         DS_Event event;
         event.fms.type = DS_FMS_COMMS_CHANGED;
-        event.fms.connected = fms_communications;
+        event.fms.connected = state()->fms_communications;
         DS_AddEvent (&event);
 
         DS_ResetFMSPackets();
@@ -450,12 +638,13 @@ void CFG_SetFMSCommunications (const int communications)
  */
 void CFG_SetRadioCommunications (const int communications)
 {
-    if (radio_communications != to_boolean (communications)) {
-        radio_communications = to_boolean (communications);
+    if (state()->radio_communications != to_boolean (communications)) {
+        state()->radio_communications = to_boolean (communications);
+        mark_changed();
 
         DS_Event event;
         event.radio.type = DS_RADIO_COMMS_CHANGED;
-        event.radio.connected = fms_communications;
+        event.radio.connected = state()->fms_communications;
         DS_AddEvent (&event);
 
         DS_ResetRadioPackets();
@@ -467,10 +656,11 @@ void CFG_SetRadioCommunications (const int communications)
  */
 void CFG_SetRobotCommunications (const int communications)
 {
-    if (robot_communications != to_boolean (communications)) {
-        robot_communications = to_boolean (communications);
+    if (state()->robot_communications != to_boolean (communications)) {
+        state()->robot_communications = to_boolean (communications);
+        mark_changed();
         create_robot_event (DS_ROBOT_COMMS_CHANGED);
-        create_robot_event (DS_STATUS_STRING_CHANGED);
+        status_changed();
 
         DS_ResetRobotPackets();
     }
@@ -509,9 +699,152 @@ void CFG_RobotWatchdogExpired()
     CFG_SetEmergencyStopped (0);
     CFG_SetRobotCommunications (0);
 
-    /* Force the sockets to perform another lookup */
+    /* Look for the robot again */
+    Discovery_Reset();
     CFG_ReconfigureAddresses (RECONFIGURE_ROBOT);
 
     /* Update the status label */
-    create_robot_event (DS_STATUS_STRING_CHANGED);
+    status_changed();
+}
+
+/**
+ * Prevents CFG_PublishState() from publishing a snapshot while the caller
+ * applies a group of changes from outside the DS thread (e.g. a replayed
+ * packet), the changes are published by the next DS loop iteration
+ */
+void CFG_LockState()
+{
+    pthread_mutex_lock (&state()->publish_lock);
+}
+
+/**
+ * Allows CFG_PublishState() to publish the changes again
+ */
+void CFG_UnlockState()
+{
+    pthread_mutex_unlock (&state()->publish_lock);
+}
+
+/**
+ * Publishes a new state snapshot if the state changed since the last call.
+ * This is only called by the DS thread after each processed packet (the
+ * client functions only mark the state as changed), so readers never
+ * observe a snapshot that mixes values from two different packets.
+ */
+void CFG_PublishState()
+{
+    DS_ConfigState* config = state();
+    if (!atomic_exchange (&config->changed, 0))
+        return;
+
+    pthread_mutex_lock (&config->publish_lock);
+
+    unsigned int sequence = atomic_load_explicit (&config->sequence,
+                                                  memory_order_relaxed);
+
+    DS_StateSnapshot snapshot;
+    snapshot.version = (sequence + 2) / 2;
+    snapshot.team = CFG_GetTeamNumber();
+    snapshot.robot_code = CFG_GetRobotCode();
+    snapshot.robot_enabled = CFG_GetRobotEnabled();
+    snapshot.emergency_stopped = CFG_GetEmergencyStopped();
+    snapshot.fms_communications = CFG_GetFMSCommunications();
+    snapshot.radio_communications = CFG_GetRadioCommunications();
+    snapshot.robot_communications = CFG_GetRobotCommunications();
+    snapshot.cpu_usage = CFG_GetRobotCPUUsage();
+    snapshot.ram_usage = CFG_GetRobotRAMUsage();
+    snapshot.disk_usage = CFG_GetRobotDiskUsage();
+    snapshot.can_utilization = CFG_GetCANUtilization();
+    snapshot.voltage = CFG_GetRobotVoltage();
+    snapshot.alliance = CFG_GetAlliance();
+    snapshot.position = CFG_GetPosition();
+    snapshot.control_mode = CFG_GetControlMode();
+    snapshot.can_be_enabled = snapshot.robot_code
+                              && !snapshot.emergency_stopped
+                              && snapshot.robot_communications;
+
+    uint32_t words [SNAPSHOT_WORDS];
+    memcpy (words, &snapshot, sizeof (words));
+
+    /* Odd sequence: readers retry until we are done */
+    atomic_store_explicit (&config->sequence, sequence + 1,
+                           memory_order_relaxed);
+    atomic_thread_fence (memory_order_release);
+
+    size_t i;
+    for (i = 0; i < SNAPSHOT_WORDS; ++i)
+        atomic_store_explicit (&config->snapshot [i], words [i],
+                               memory_order_relaxed);
+
+    atomic_store_explicit (&config->sequence, sequence + 2,
+                           memory_order_release);
+
+    pthread_mutex_unlock (&config->publish_lock);
+}
+
+/**
+ * Returns the version of the last published state snapshot
+ */
+uint32_t CFG_GetStateVersion()
+{
+    return atomic_load_explicit (&state()->sequence,
+                                 memory_order_acquire) / 2;
+}
+
+/**
+ * Copies the last published state snapshot into the given \a snapshot and
+ * returns its version. This function never blocks the writer, it simply
+ * retries if a new snapshot is published while copying it.
+ */
+uint32_t CFG_GetStateSnapshot (DS_StateSnapshot* snapshot)
+{
+    DS_ConfigState* config = state();
+    uint32_t words [SNAPSHOT_WORDS];
+    unsigned int sequence;
+
+    for (;;) {
+        sequence = atomic_load_explicit (&config->sequence,
+                                         memory_order_acquire);
+        if (sequence & 1)
+            continue;
+
+        size_t i;
+        for (i = 0; i < SNAPSHOT_WORDS; ++i)
+            words [i] = atomic_load_explicit (&config->snapshot [i],
+                                              memory_order_relaxed);
+
+        atomic_thread_fence (memory_order_acquire);
+        if (atomic_load_explicit (&config->sequence,
+                                  memory_order_relaxed) == sequence)
+            break;
+    }
+
+    if (snapshot)
+        memcpy (snapshot, words, sizeof (words));
+
+    return sequence / 2;
+}
+
+/**
+ * Returns the version of the status string, which grows every time that the
+ * status string changes
+ */
+uint32_t CFG_GetStatusVersion()
+{
+    return atomic_load (&state()->status) >> STATUS_BITS;
+}
+
+/**
+ * Returns the current status string and (optionally) writes its version to
+ * \a version. The returned string is static, it must not be freed and it
+ * remains valid after the status changes.
+ */
+const char* CFG_GetStatusString (uint32_t* version)
+{
+    unsigned int status = atomic_load (&state()->status);
+
+    if (version)
+        *version = status >> STATUS_BITS;
+
+    return STATUS_STRINGS [status & STATUS_MASK];
 }
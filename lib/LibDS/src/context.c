@@ -0,0 +1,282 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "DS_Utils.h"
+#include "DS_Client.h"
+#include "DS_Config.h"
+#include "DS_Events.h"
+#include "DS_Context.h"
+#include "DS_NetConsole.h"
+#include "DS_Protocol.h"
+#include "DS_Joysticks.h"
+#include "DS_Discovery.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#if defined _MSC_VER
+    #define THREAD_LOCAL __declspec (thread)
+#else
+    #define THREAD_LOCAL __thread
+#endif
+
+/**
+ * Holds the state of every module for one driver station instance
+ */
+struct _context {
+    void* states [DS_MODULE_COUNT]; /**< Module states (indexed by DS_Module) */
+};
+
+/*
+ * Holds the default context (used by applications that are not aware of
+ * contexts) and the context selected by each thread
+ */
+static DS_Context* default_context = NULL;
+static THREAD_LOCAL DS_Context* current = NULL;
+
+/*
+ * Holds every context (including the default context), the lock is held
+ * while the protocol event loop is processing the contexts
+ */
+static DS_Context** contexts = NULL;
+static int context_count = 0;
+static int context_capacity = 0;
+static pthread_mutex_t contexts_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Adds the given \a context to the context list
+ */
+static void register_context (DS_Context* context)
+{
+    pthread_mutex_lock (&contexts_lock);
+
+    if (context_count >= context_capacity) {
+        context_capacity = DS_Max (context_capacity * 2, 8);
+        contexts = realloc (contexts, context_capacity * sizeof (DS_Context*));
+    }
+
+    contexts [context_count++] = context;
+
+    pthread_mutex_unlock (&contexts_lock);
+}
+
+/**
+ * Removes the given \a context from the context list, after this function
+ * returns the protocol event loop will not use the context anymore
+ */
+static void unregister_context (DS_Context* context)
+{
+    int i;
+    pthread_mutex_lock (&contexts_lock);
+
+    for (i = 0; i < context_count; ++i) {
+        if (contexts [i] == context) {
+            contexts [i] = contexts [--context_count];
+            break;
+        }
+    }
+
+    pthread_mutex_unlock (&contexts_lock);
+}
+
+/**
+ * Allocates a new context and initializes the state of every module
+ */
+static DS_Context* create_context()
+{
+    DS_Context* context = (DS_Context*) calloc (1, sizeof (DS_Context));
+    DS_Context* previous = current;
+
+    current = context;
+    Client_Init();
+    Config_Init();
+    Events_Init();
+    NetConsole_Init();
+    Discovery_Init();
+    Joysticks_Init();
+    Protocols_Init();
+    current = previous;
+
+    register_context (context);
+    return context;
+}
+
+/**
+ * Closes the protocol of the given \a context and de-allocates the state of
+ * every module
+ */
+static void destroy_context (DS_Context* context)
+{
+    DS_Context* previous = current;
+    unregister_context (context);
+
+    current = context;
+    Protocols_Close();
+    Discovery_Close();
+    Joysticks_Close();
+    NetConsole_Close();
+    Events_Close();
+    Config_Close();
+    Client_Close();
+    current = (previous == context) ? NULL : previous;
+
+    DS_FREE (context);
+}
+
+/**
+ * Creates the default context
+ */
+void Contexts_Init()
+{
+    if (!default_context)
+        default_context = create_context();
+}
+
+/**
+ * Destroys every context (including the default context)
+ */
+void Contexts_Close()
+{
+    while (context_count > 0)
+        destroy_context (contexts [0]);
+
+    DS_FREE (contexts);
+    context_capacity = 0;
+    default_context = NULL;
+}
+
+/**
+ * Returns the state of the given \a module in the current context, or
+ * \c NULL if there is no context (before DS_Init() or after DS_Close())
+ */
+void* Context_GetState (const DS_Module module)
+{
+    DS_Context* context = DS_CurrentContext();
+    return context ? context->states [module] : NULL;
+}
+
+/**
+ * Replaces the state of the given \a module in the current context, this
+ * function is called by the modules when they initialize/close their state
+ */
+void Context_SetState (const DS_Module module, void* state)
+{
+    DS_Context* context = DS_CurrentContext();
+    if (context)
+        context->states [module] = state;
+}
+
+/**
+ * Prevents the protocol event loop from processing the contexts until
+ * Context_Unlock() is called, this is used to replace the objects that the
+ * loop reads (e.g. the protocol of a context). The event loop itself must
+ * not call this function.
+ */
+void Context_Lock()
+{
+    pthread_mutex_lock (&contexts_lock);
+}
+
+/**
+ * Lets the protocol event loop process the contexts again
+ */
+void Context_Unlock()
+{
+    pthread_mutex_unlock (&contexts_lock);
+}
+
+/**
+ * Calls the given \a function once for every context, the context is made
+ * current while the function is running
+ */
+void Context_ForEach (void (*function)())
+{
+    int i;
+    DS_Context* previous = current;
+
+    pthread_mutex_lock (&contexts_lock);
+
+    for (i = 0; i < context_count; ++i) {
+        current = contexts [i];
+        function();
+    }
+
+    pthread_mutex_unlock (&contexts_lock);
+    current = previous;
+}
+
+/**
+ * Creates a new driver station instance, the context has its own protocol,
+ * configuration, joysticks and events. Use DS_SetCurrentContext() to
+ * operate on the new context.
+ *
+ * \note LibDS must be initialized with DS_Init() before calling this function
+ */
+DS_Context* DS_ContextCreate()
+{
+    if (!default_context) {
+        fprintf (stderr, "DS_ContextCreate: LibDS is not initialized\n");
+        return NULL;
+    }
+
+    return create_context();
+}
+
+/**
+ * Returns the default context, which is used by every thread that did not
+ * select another context
+ */
+DS_Context* DS_DefaultContext()
+{
+    return default_context;
+}
+
+/**
+ * Returns the context used by the calling thread
+ */
+DS_Context* DS_CurrentContext()
+{
+    return current ? current : default_context;
+}
+
+/**
+ * Closes the protocol of the given \a context and de-allocates it.
+ * The default context cannot be destroyed (it is destroyed by DS_Close()).
+ *
+ * \note The context must not be the current context of another thread
+ */
+void DS_ContextDestroy (DS_Context* context)
+{
+    if (context && context != default_context)
+        destroy_context (context);
+}
+
+/**
+ * Selects the \a context used by the LibDS functions called from the
+ * current thread, a \c NULL context selects the default context
+ */
+void DS_SetCurrentContext (DS_Context* context)
+{
+    current = context;
+}
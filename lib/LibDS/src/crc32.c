@@ -42,6 +42,18 @@
 
 #include "DS_Utils.h"
 
+#include <pthread.h>
+
+/*
+ * The folding kernel needs the PCLMULQDQ and SSE4.1 instructions, it is
+ * compiled for them (regardless of the compiler flags) and only used if the
+ * CPU supports them
+ */
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+    #define CRC32_FOLDING 1
+    #include <immintrin.h>
+#endif
+
 static uint32_t crc32_tab[] = {
     0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
     0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
@@ -88,15 +100,346 @@ static uint32_t crc32_tab[] = {
     0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
-uint32_t DS_CRC32 (const void* buf, size_t size)
-{
-    const uint8_t* p;
-    uint32_t crc = 0xFFFFFFFFUL;
+/*
+ * Tables used by the slice-by-8 kernel, the first table is \c crc32_tab and
+ * table \c n gives the CRC of a byte followed by \c n zero bytes
+ */
+static uint32_t crc32_slice [8][256];
 
-    p = buf;
+/*
+ * Holds x^(2^n) modulo the CRC32 polynomial for every n, and x^(8 * n) for
+ * the first lengths (used to move a CRC over a run of zero bytes without
+ * processing them)
+ */
+#define CRC32_ZEROS 2048
+static uint32_t crc32_x2n [32];
+static uint32_t crc32_zeros [CRC32_ZEROS];
 
+/*
+ * Kernel used by \c DS_CRC32, selected when it is called for the first time
+ */
+static uint32_t (*crc32_kernel) (uint32_t, const uint8_t*, size_t);
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Updates the given \a crc register with the given bytes, one byte at a time
+ */
+static uint32_t crc32_bytewise (uint32_t crc, const uint8_t* p, size_t size)
+{
     while (size--)
         crc = crc32_tab [ (crc ^ *p++) & 0xFF] ^ (crc >> 8);
 
-    return crc ^ 0xFFFFFFFFUL;
+    return crc;
+}
+
+/**
+ * Updates the given \a crc register with the given bytes, eight bytes at a
+ * time (the remaining bytes are processed one at a time)
+ */
+static uint32_t crc32_slice8 (uint32_t crc, const uint8_t* p, size_t size)
+{
+    while (size >= 8) {
+        uint32_t one = crc ^ ((uint32_t) p [0]
+                              | ((uint32_t) p [1] << 8)
+                              | ((uint32_t) p [2] << 16)
+                              | ((uint32_t) p [3] << 24));
+        uint32_t two = ((uint32_t) p [4]
+                        | ((uint32_t) p [5] << 8)
+                        | ((uint32_t) p [6] << 16)
+                        | ((uint32_t) p [7] << 24));
+
+        crc = crc32_slice [7][one & 0xFF]
+              ^ crc32_slice [6][(one >> 8) & 0xFF]
+              ^ crc32_slice [5][(one >> 16) & 0xFF]
+              ^ crc32_slice [4][one >> 24]
+              ^ crc32_slice [3][two & 0xFF]
+              ^ crc32_slice [2][(two >> 8) & 0xFF]
+              ^ crc32_slice [1][(two >> 16) & 0xFF]
+              ^ crc32_slice [0][two >> 24];
+
+        p += 8;
+        size -= 8;
+    }
+
+    return crc32_bytewise (crc, p, size);
+}
+
+#if CRC32_FOLDING
+/**
+ * Updates the given \a crc register with the given bytes by folding 64-byte
+ * blocks with carry-less multiplications, then reduces the result with a
+ * Barrett reduction. This is the algorithm described by Intel in "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction", with the
+ * constants of the bit-reflected CRC32 polynomial.
+ *
+ * Buffers smaller than 64 bytes and the last (size % 16) bytes are processed
+ * with the slice-by-8 kernel.
+ */
+__attribute__ ((target ("pclmul,sse4.1")))
+static uint32_t crc32_folding (uint32_t crc, const uint8_t* p, size_t size)
+{
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    if (size < 64)
+        return crc32_slice8 (crc, p, size);
+
+    /* Load the first block and add the CRC register to it */
+    x1 = _mm_loadu_si128 ((const __m128i*) (p + 0x00));
+    x2 = _mm_loadu_si128 ((const __m128i*) (p + 0x10));
+    x3 = _mm_loadu_si128 ((const __m128i*) (p + 0x20));
+    x4 = _mm_loadu_si128 ((const __m128i*) (p + 0x30));
+    x1 = _mm_xor_si128 (x1, _mm_cvtsi32_si128 ((int) crc));
+
+    p += 64;
+    size -= 64;
+
+    /* Fold 64-byte blocks (four lanes in parallel) */
+    x0 = _mm_set_epi64x (0x01c6e41596LL, 0x0154442bd4LL);
+    while (size >= 64) {
+        x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128 (x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128 (x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128 (x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128 (x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128 (x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128 (x4, x0, 0x11);
+
+        x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x5),
+                            _mm_loadu_si128 ((const __m128i*) (p + 0x00)));
+        x2 = _mm_xor_si128 (_mm_xor_si128 (x2, x6),
+                            _mm_loadu_si128 ((const __m128i*) (p + 0x10)));
+        x3 = _mm_xor_si128 (_mm_xor_si128 (x3, x7),
+                            _mm_loadu_si128 ((const __m128i*) (p + 0x20)));
+        x4 = _mm_xor_si128 (_mm_xor_si128 (x4, x8),
+                            _mm_loadu_si128 ((const __m128i*) (p + 0x30)));
+
+        p += 64;
+        size -= 64;
+    }
+
+    /* Fold the four lanes into one */
+    x0 = _mm_set_epi64x (0x00ccaa009eLL, 0x01751997d0LL);
+
+    x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+    x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+    x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+    x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x4), x5);
+
+    /* Fold the remaining 16-byte blocks */
+    while (size >= 16) {
+        x2 = _mm_loadu_si128 ((const __m128i*) p);
+
+        x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+        x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x2), x5);
+
+        p += 16;
+        size -= 16;
+    }
+
+    /* Fold 128 bits into 64 bits */
+    x2 = _mm_clmulepi64_si128 (x1, x0, 0x10);
+    x3 = _mm_setr_epi32 (~0, 0, ~0, 0);
+    x1 = _mm_srli_si128 (x1, 8);
+    x1 = _mm_xor_si128 (x1, x2);
+
+    x0 = _mm_set_epi64x (0, 0x0163cd6124LL);
+    x2 = _mm_srli_si128 (x1, 4);
+    x1 = _mm_and_si128 (x1, x3);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_xor_si128 (x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_set_epi64x (0x01f7011641LL, 0x01db710641LL);
+    x2 = _mm_and_si128 (x1, x3);
+    x2 = _mm_clmulepi64_si128 (x2, x0, 0x10);
+    x2 = _mm_and_si128 (x2, x3);
+    x2 = _mm_clmulepi64_si128 (x2, x0, 0x00);
+    x1 = _mm_xor_si128 (x1, x2);
+
+    crc = (uint32_t) _mm_extract_epi32 (x1, 1);
+    return crc32_slice8 (crc, p, size);
+}
+#endif
+
+/**
+ * Multiplies the polynomials \a a and \a b modulo the CRC32 polynomial
+ * (both use the bit-reflected representation of the CRC)
+ */
+static uint32_t crc32_multiply (uint32_t a, uint32_t b)
+{
+    int i;
+    uint32_t p = 0;
+
+    for (i = 31; i >= 0; --i) {
+        p ^= b & (0 - ((a >> i) & 1));
+        b = (b >> 1) ^ (0xEDB88320UL & (0 - (b & 1)));
+    }
+
+    return p;
+}
+
+/**
+ * Returns x^(8 * \a bytes) modulo the CRC32 polynomial, which is the factor
+ * that moves a CRC register over the given number of zero bytes
+ */
+static uint32_t crc32_zeros_factor (size_t bytes)
+{
+    int n = 3;
+    uint32_t p = 1UL << 31;
+
+    if (bytes < CRC32_ZEROS)
+        return crc32_zeros [bytes];
+
+    while (bytes) {
+        if (bytes & 1)
+            p = crc32_multiply (crc32_x2n [n & 31], p);
+
+        bytes >>= 1;
+        ++n;
+    }
+
+    return p;
+}
+
+/**
+ * Generates the slice-by-8 tables and the zero-byte factors and selects the
+ * fastest kernel supported by the CPU
+ */
+static void crc32_init()
+{
+    int i;
+    int j;
+
+    crc32_x2n [0] = 1UL << 30;
+    for (i = 1; i < 32; ++i)
+        crc32_x2n [i] = crc32_multiply (crc32_x2n [i - 1], crc32_x2n [i - 1]);
+
+    crc32_zeros [0] = 1UL << 31;
+    for (i = 1; i < CRC32_ZEROS; ++i)
+        crc32_zeros [i] = crc32_multiply (crc32_zeros [i - 1], crc32_x2n [3]);
+
+    for (i = 0; i < 256; ++i) {
+        crc32_slice [0][i] = crc32_tab [i];
+        for (j = 1; j < 8; ++j)
+            crc32_slice [j][i] = (crc32_slice [j - 1][i] >> 8)
+                                 ^ crc32_tab [crc32_slice [j - 1][i] & 0xFF];
+    }
+
+    crc32_kernel = &crc32_slice8;
+
+#if CRC32_FOLDING
+    if (DS_CRC32FoldingSupported())
+        crc32_kernel = &crc32_folding;
+#endif
+}
+
+/**
+ * Returns \c 1 if the CPU supports the instructions used by the folding
+ * kernel (\c DS_CRC32Folding is slower than \c DS_CRC32Slice8 otherwise)
+ */
+int DS_CRC32FoldingSupported()
+{
+#if CRC32_FOLDING
+    __builtin_cpu_init();
+    return __builtin_cpu_supports ("pclmul") && __builtin_cpu_supports ("sse4.1");
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Calculates the CRC32 checksum of the first \a size bytes of the given
+ * \a buf, using the fastest kernel supported by the CPU
+ */
+uint32_t DS_CRC32 (const void* buf, size_t size)
+{
+    pthread_once (&crc32_once, &crc32_init);
+    return crc32_kernel (0xFFFFFFFFUL, buf, size) ^ 0xFFFFFFFFUL;
+}
+
+/**
+ * Calculates the CRC32 checksum of the given \a buf one byte at a time with
+ * the lookup table (this is the reference implementation)
+ */
+uint32_t DS_CRC32Bytewise (const void* buf, size_t size)
+{
+    return crc32_bytewise (0xFFFFFFFFUL, buf, size) ^ 0xFFFFFFFFUL;
+}
+
+/**
+ * Calculates the CRC32 checksum of the given \a buf eight bytes at a time
+ */
+uint32_t DS_CRC32Slice8 (const void* buf, size_t size)
+{
+    pthread_once (&crc32_once, &crc32_init);
+    return crc32_slice8 (0xFFFFFFFFUL, buf, size) ^ 0xFFFFFFFFUL;
+}
+
+/**
+ * Calculates the CRC32 checksum of the given \a buf with carry-less
+ * multiplications. If the CPU does not support them, the slice-by-8 kernel
+ * is used instead.
+ */
+uint32_t DS_CRC32Folding (const void* buf, size_t size)
+{
+    pthread_once (&crc32_once, &crc32_init);
+
+#if CRC32_FOLDING
+    if (crc32_kernel == &crc32_folding)
+        return crc32_folding (0xFFFFFFFFUL, buf, size) ^ 0xFFFFFFFFUL;
+#endif
+
+    return crc32_slice8 (0xFFFFFFFFUL, buf, size) ^ 0xFFFFFFFFUL;
+}
+
+/**
+ * Updates the CRC32 checksum of a message after some of its bytes changed,
+ * without processing the bytes that did not change. The CRC is linear, so
+ * the checksum changes by the CRC of the difference between both messages
+ * (which is zero everywhere except in the changed bytes).
+ *
+ * \param crc the checksum of the message before the change
+ * \param before the \a span bytes of the message before the change
+ * \param after the \a span bytes of the message after the change
+ * \param span the number of bytes that changed
+ * \param trailing the number of bytes that follow the changed bytes
+ *
+ * \returns the checksum of the message after the change
+ */
+uint32_t DS_CRC32Patch (uint32_t crc,
+                        const void* before, const void* after,
+                        size_t span, size_t trailing)
+{
+    size_t i;
+    size_t done;
+    uint32_t delta = 0;
+    uint8_t difference [64];
+    const uint8_t* a = before;
+    const uint8_t* b = after;
+
+    pthread_once (&crc32_once, &crc32_init);
+
+    /* Leading zero bytes do not change a zero register */
+    for (done = 0; done < span; done += i) {
+        for (i = 0; i < sizeof (difference) && done + i < span; ++i)
+            difference [i] = a [done + i] ^ b [done + i];
+
+        delta = crc32_slice8 (delta, difference, i);
+    }
+
+    /* Move the difference over the bytes that did not change */
+    if (delta)
+        delta = crc32_multiply (crc32_zeros_factor (trailing), delta);
+
+    return crc ^ delta;
 }
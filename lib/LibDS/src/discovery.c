@@ -0,0 +1,325 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The robot discovery module is used while the robot address is unknown
+ * (e.g. after the robot reboots). Instead of sending robot packets to the
+ * protocol address only, the packets are sent to every candidate address in
+ * parallel and the module locks on to the first address that answers:
+ *
+ *    - The robot address specified by the protocol (e.g. an mDNS name)
+ *    - The static IP of the robot (10.TE.AM.2)
+ *    - The USB address of the roboRIO (172.22.11.2)
+ *    - Any address added with DS_AddRobotAddressCandidate()
+ *
+ * Slow candidates (e.g. mDNS names) are resolved in the background by the
+ * sockets module, so they do not delay the probes sent to other candidates.
+ * The discovered address is forgotten when the robot watchdog expires, and
+ * the module starts probing all candidates again.
+ */
+
+#include "DS_Utils.h"
+#include "DS_Client.h"
+#include "DS_Config.h"
+#include "DS_Context.h"
+#include "DS_Protocol.h"
+#include "DS_Discovery.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define USB_ADDRESS "172.22.11.2"
+#define MAX_CANDIDATES 16
+
+/**
+ * Holds the state of the discovery module in a context
+ */
+typedef struct _discovery_state {
+    bstring address;                          /**< Discovered address */
+    int custom_address;                       /**< Set if the user set one */
+    atomic_int discovering;                   /**< Set while probing */
+    int candidate_count;                      /**< Number of candidates */
+    int user_candidate_count;                 /**< Number of user candidates */
+    int candidates_valid;                     /**< Set if the list is updated */
+    bstring candidates [MAX_CANDIDATES];      /**< Addresses to probe */
+    bstring user_candidates [MAX_CANDIDATES]; /**< User-defined addresses */
+} DS_DiscoveryState;
+
+/*
+ * Protects the variables of the module (used by the protocol thread and
+ * the client application)
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the discovery state of the current context
+ */
+static DS_DiscoveryState* state()
+{
+    return (DS_DiscoveryState*) Context_GetState (DS_MODULE_DISCOVERY);
+}
+
+/**
+ * Adds the given \a candidate to the list (if it is not in the list already),
+ * the list takes ownership of the string.
+ *
+ * \note The module lock must be held by the caller
+ */
+static void add_candidate (bstring candidate)
+{
+    int i;
+
+    /* Invalid or empty candidate */
+    if (DS_StringIsEmpty (candidate) ||
+        state()->candidate_count >= MAX_CANDIDATES) {
+        DS_FREESTR (candidate);
+        return;
+    }
+
+    /* Candidate is already in the list */
+    for (i = 0; i < state()->candidate_count; ++i) {
+        if (bstrcmp (state()->candidates [i], candidate) == 0) {
+            DS_FREESTR (candidate);
+            return;
+        }
+    }
+
+    state()->candidates [state()->candidate_count++] = candidate;
+}
+
+/**
+ * Removes every address from the candidate list
+ *
+ * \note The module lock must be held by the caller
+ */
+static void clear_candidates()
+{
+    int i;
+    for (i = 0; i < state()->candidate_count; ++i)
+        DS_FREESTR (state()->candidates [i]);
+
+    state()->candidate_count = 0;
+    state()->candidates_valid = 0;
+}
+
+/**
+ * Generates the list of candidates based on the current protocol and
+ * team number (if it is not up to date)
+ *
+ * \note The module lock must be held by the caller
+ */
+static void update_candidates()
+{
+    int i;
+
+    if (state()->candidates_valid)
+        return;
+
+    clear_candidates();
+
+    /* Add the protocol address */
+    if (DS_CurrentProtocol())
+        add_candidate (DS_CurrentProtocol()->robot_address());
+
+    /* Add the static and USB addresses */
+    add_candidate (DS_GetStaticIP (10, CFG_GetTeamNumber(), 2));
+    add_candidate (bfromcstr (USB_ADDRESS));
+
+    /* Add the user-defined addresses */
+    for (i = 0; i < state()->user_candidate_count; ++i)
+        add_candidate (bstrcpy (state()->user_candidates [i]));
+
+    state()->candidates_valid = 1;
+}
+
+/**
+ * Initializes the discovery state of the current context
+ */
+void Discovery_Init()
+{
+    DS_DiscoveryState* discovery = calloc (1, sizeof (DS_DiscoveryState));
+    atomic_init (&discovery->discovering, 1);
+    Context_SetState (DS_MODULE_DISCOVERY, discovery);
+}
+
+/**
+ * Updates the discovering flag, which is set while the robot has not been
+ * found and the user did not specify a custom robot address
+ *
+ * \note The module lock must be held by the caller
+ */
+static void update_discovering()
+{
+    atomic_store (&state()->discovering,
+                  state()->address == NULL && !state()->custom_address);
+}
+
+/**
+ * De-allocates the candidate lists and the discovered address
+ */
+void Discovery_Close()
+{
+    pthread_mutex_lock (&lock);
+
+    clear_candidates();
+    DS_FREESTR (state()->address);
+
+    int i;
+    for (i = 0; i < state()->user_candidate_count; ++i)
+        DS_FREESTR (state()->user_candidates [i]);
+
+    state()->user_candidate_count = 0;
+    pthread_mutex_unlock (&lock);
+
+    free (state());
+    Context_SetState (DS_MODULE_DISCOVERY, NULL);
+}
+
+/**
+ * Forgets the discovered address and re-generates the candidate list, this
+ * function is called when the robot watchdog expires, when the team number
+ * changes or when a new protocol is loaded
+ */
+void Discovery_Reset()
+{
+    pthread_mutex_lock (&lock);
+    DS_FREESTR (state()->address);
+    state()->candidates_valid = 0;
+    update_discovering();
+    pthread_mutex_unlock (&lock);
+}
+
+/**
+ * Disables the discovery while the user specifies a \a custom robot
+ * address, this function is called by the client module
+ */
+void Discovery_SetCustomAddress (const int custom)
+{
+    pthread_mutex_lock (&lock);
+    state()->custom_address = (custom != 0);
+    update_discovering();
+    pthread_mutex_unlock (&lock);
+}
+
+/**
+ * Returns \c 1 if the robot address is being discovered, the discovery is
+ * not used if the user specified a custom robot address.
+ *
+ * This function does not lock nor allocate anything, so the protocols can
+ * call it for every robot packet.
+ */
+int Discovery_Active()
+{
+    return atomic_load (&state()->discovering);
+}
+
+/**
+ * Returns a copy of the discovered robot address, or \c NULL if the robot
+ * has not been found yet
+ */
+bstring Discovery_GetAddress()
+{
+    pthread_mutex_lock (&lock);
+    bstring copy = state()->address ? bstrcpy (state()->address) : NULL;
+    pthread_mutex_unlock (&lock);
+
+    return copy;
+}
+
+/**
+ * Sends the first \a length bytes of the given \a data to every candidate
+ * address using the given \a socket, the socket is expected to receive the
+ * response of the robot
+ */
+void Discovery_SendProbes (DS_Socket* socket,
+                           const void* data, const int length)
+{
+    int i;
+    pthread_mutex_lock (&lock);
+
+    update_candidates();
+    for (i = 0; i < state()->candidate_count; ++i)
+        DS_SocketSendBufferTo (socket, data, length, state()->candidates [i]);
+
+    pthread_mutex_unlock (&lock);
+}
+
+/**
+ * Locks on to the given \a source address, which is the first address that
+ * answered to the probes. The robot socket is then re-configured to only
+ * communicate with the discovered address.
+ */
+void Discovery_ProbeAnswered (const bstring source)
+{
+    if (DS_StringIsEmpty (source))
+        return;
+
+    pthread_mutex_lock (&lock);
+    int changed = atomic_load (&state()->discovering);
+    if (changed) {
+        state()->address = bstrcpy (source);
+        update_discovering();
+    }
+    pthread_mutex_unlock (&lock);
+
+    if (changed)
+        CFG_ReconfigureAddresses (RECONFIGURE_ROBOT);
+}
+
+/**
+ * Adds the given \a candidate to the list of addresses that are probed while
+ * looking for the robot
+ */
+void DS_AddRobotAddressCandidate (const char* candidate)
+{
+    if (!candidate || strlen (candidate) <= 0)
+        return;
+
+    pthread_mutex_lock (&lock);
+
+    if (state()->user_candidate_count < MAX_CANDIDATES) {
+        int index = state()->user_candidate_count++;
+        state()->user_candidates [index] = bfromcstr (candidate);
+        state()->candidates_valid = 0;
+    }
+
+    pthread_mutex_unlock (&lock);
+}
+
+/**
+ * Removes all the user-defined robot address candidates
+ */
+void DS_ClearRobotAddressCandidates()
+{
+    int i;
+    pthread_mutex_lock (&lock);
+
+    for (i = 0; i < state()->user_candidate_count; ++i)
+        DS_FREESTR (state()->user_candidates [i]);
+
+    state()->user_candidate_count = 0;
+    state()->candidates_valid = 0;
+
+    pthread_mutex_unlock (&lock);
+}
@@ -21,56 +21,641 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include "DS_Queue.h"
+#include "DS_Timer.h"
+#include "DS_Utils.h"
 #include "DS_Events.h"
+#include "DS_Context.h"
 
-#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-static DS_Queue events;
+#if defined __linux__
+    #include <unistd.h>
+    #include <sys/eventfd.h>
+#elif !defined _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#define QUEUE_MASK      (DS_EVENT_QUEUE_SIZE - 1)
+#define CONFLATED_TYPES 6 /* Number of event types that can be conflated */
+
+#if (DS_EVENT_QUEUE_SIZE & QUEUE_MASK) != 0
+#error "DS_EVENT_QUEUE_SIZE must be a power of two"
+#endif
+
+/*
+ * Holds a queued event. The \a sequence of a slot is equal to its position
+ * when producers may write it, and to its position + 1 once the event can be
+ * read by the consumer.
+ */
+typedef struct _slot {
+    atomic_uint sequence; /**< Position that this slot is ready for */
+    int conflated;        /**< Set to poll the latest value of the type */
+    DS_Event event;       /**< Event data */
+} DS_EventSlot;
+
+/*
+ * Bounded multi-producer/single-consumer ring of events. Producers reserve a
+ * slot by advancing \a tail, the thread that polls the events is the only
+ * writer of \a head. Producers and the consumer write to different cache
+ * lines.
+ */
+typedef struct _events {
+    atomic_uint tail;                          /**< Next position to write */
+    char tail_pad [64 - sizeof (atomic_uint)]; /**< Keeps \a tail alone */
+    atomic_uint head;                          /**< Next position to read */
+    char head_pad [64 - sizeof (atomic_uint)]; /**< Keeps \a head alone */
+    atomic_ulong added;                        /**< Events queued */
+    atomic_ulong dropped;                      /**< Events lost (queue full) */
+    atomic_ulong merged;                       /**< Events conflated */
+    atomic_int conflation;                     /**< Set if conflating events */
+    atomic_uint mask;                          /**< Subscribed event types */
+    pthread_mutex_t latest_lock;               /**< Guards the values below */
+    int pending [CONFLATED_TYPES];             /**< Set if a type is queued */
+    DS_Event latest [CONFLATED_TYPES];         /**< Latest value of a type */
+    atomic_int armed;                          /**< Set to wake the consumer */
+    atomic_int fd_used;                        /**< Set if the fd is watched */
+    int wake_fds [2];                          /**< Wake-up fd (read, write) */
+    int signaled;                              /**< Set by wake_up() */
+    pthread_cond_t wait_cond;                  /**< Signaled by wake_up() */
+    pthread_mutex_t wait_lock;                 /**< Guards \a signaled */
+    DS_EventSlot slots [DS_EVENT_QUEUE_SIZE];  /**< Event slots */
+} DS_EventQueue;
+
+/**
+ * Returns the event queue of the current context
+ */
+static DS_EventQueue* events()
+{
+    return (DS_EventQueue*) Context_GetState (DS_MODULE_EVENTS);
+}
+
+/**
+ * Creates the wake-up file descriptor of the given \a queue, which is an
+ * \c eventfd on Linux and a pipe on other POSIX systems. There is no wake-up
+ * descriptor on Windows.
+ */
+static void open_wake_fd (DS_EventQueue* queue)
+{
+    queue->wake_fds [0] = -1;
+    queue->wake_fds [1] = -1;
+
+#if defined __linux__
+    queue->wake_fds [0] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    queue->wake_fds [1] = queue->wake_fds [0];
+#elif !defined _WIN32
+    int i;
+    if (pipe (queue->wake_fds) == 0) {
+        for (i = 0; i < 2; ++i) {
+            fcntl (queue->wake_fds [i], F_SETFL, O_NONBLOCK);
+            fcntl (queue->wake_fds [i], F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    else {
+        queue->wake_fds [0] = -1;
+        queue->wake_fds [1] = -1;
+    }
+#endif
+
+    if (queue->wake_fds [0] < 0)
+        fprintf (stderr, "Event wake-up descriptor not available\n");
+}
+
+/**
+ * Closes the wake-up file descriptor of the given \a queue
+ */
+static void close_wake_fd (DS_EventQueue* queue)
+{
+#ifndef _WIN32
+    if (queue->wake_fds [0] >= 0)
+        close (queue->wake_fds [0]);
+
+    if (queue->wake_fds [1] >= 0 && queue->wake_fds [1] != queue->wake_fds [0])
+        close (queue->wake_fds [1]);
+#endif
+
+    queue->wake_fds [0] = -1;
+    queue->wake_fds [1] = -1;
+}
+
+/**
+ * Makes the wake-up file descriptor of the given \a queue readable
+ */
+static void signal_wake_fd (DS_EventQueue* queue)
+{
+#if defined __linux__
+    uint64_t value = 1;
+    if (write (queue->wake_fds [1], &value, sizeof (value)) < 0 && errno != EAGAIN)
+        fprintf (stderr, "Cannot signal event wake-up descriptor\n");
+#elif !defined _WIN32
+    char value = 1;
+    if (write (queue->wake_fds [1], &value, sizeof (value)) < 0 && errno != EAGAIN)
+        fprintf (stderr, "Cannot signal event wake-up descriptor\n");
+#else
+    (void) queue;
+#endif
+}
+
+/**
+ * Reads all the pending data from the wake-up file descriptor of the given
+ * \a queue, so that it is no longer readable
+ */
+static void clear_wake_fd (DS_EventQueue* queue)
+{
+#if defined __linux__
+    uint64_t value;
+    if (read (queue->wake_fds [0], &value, sizeof (value)) < 0 && errno != EAGAIN)
+        fprintf (stderr, "Cannot clear event wake-up descriptor\n");
+#elif !defined _WIN32
+    char buffer [64];
+    while (read (queue->wake_fds [0], buffer, sizeof (buffer)) > 0);
+#else
+    (void) queue;
+#endif
+}
+
+/**
+ * Wakes up the thread that waits for events (in DS_WaitEvent() or by
+ * watching the wake-up file descriptor)
+ */
+static void wake_up (DS_EventQueue* queue)
+{
+    if (queue->wake_fds [1] >= 0)
+        signal_wake_fd (queue);
+
+    pthread_mutex_lock (&queue->wait_lock);
+    queue->signaled = 1;
+    pthread_cond_signal (&queue->wait_cond);
+    pthread_mutex_unlock (&queue->wait_lock);
+}
+
+/**
+ * Returns the index of the latest value of the given event \a type, or
+ * \c -1 if the event type must never be conflated.
+ *
+ * Only events that report the current value of a measurement (or that ask
+ * the application to read the status string again) are conflated, events
+ * that report an edge (communications, enabled, e-stop, mode...) are always
+ * delivered one by one.
+ */
+static int conflation_index (const DS_EventType type)
+{
+    switch (type) {
+    case DS_ROBOT_VOLTAGE_CHANGED:
+        return 0;
+    case DS_ROBOT_CAN_UTIL_CHANGED:
+        return 1;
+    case DS_ROBOT_CPU_INFO_CHANGED:
+        return 2;
+    case DS_ROBOT_RAM_INFO_CHANGED:
+        return 3;
+    case DS_ROBOT_DISK_INFO_CHANGED:
+        return 4;
+    case DS_STATUS_STRING_CHANGED:
+        return 5;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * Writes the given \a event to the next free slot of the \a queue
+ *
+ * \returns 1 on success, 0 if the queue is full (and the event was dropped)
+ */
+static int push (DS_EventQueue* queue, DS_Event* event, const int conflated)
+{
+    DS_EventSlot* slot;
+    unsigned int position = atomic_load_explicit (&queue->tail,
+                                                  memory_order_relaxed);
+
+    for (;;) {
+        slot = &queue->slots [position & QUEUE_MASK];
+        unsigned int sequence = atomic_load_explicit (&slot->sequence,
+                                                      memory_order_acquire);
+        int difference = (int) (sequence - position);
+
+        /* The slot is free, try to reserve it */
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit (&queue->tail,
+                                                       &position,
+                                                       position + 1,
+                                                       memory_order_relaxed,
+                                                       memory_order_relaxed))
+                break;
+        }
+
+        /* The slot still holds an event that was not polled */
+        else if (difference < 0) {
+            atomic_fetch_add_explicit (&queue->dropped, 1, memory_order_relaxed);
+            return 0;
+        }
+
+        /* Another producer reserved the slot first */
+        else
+            position = atomic_load_explicit (&queue->tail, memory_order_relaxed);
+    }
+
+    slot->event = *event;
+    slot->conflated = conflated;
+    atomic_store_explicit (&slot->sequence, position + 1, memory_order_release);
+    atomic_fetch_add_explicit (&queue->added, 1, memory_order_relaxed);
+
+    /* Wake up the consumer if it found the queue empty (the fence orders the
+     * publication of the event with the read of the armed flag) */
+    atomic_thread_fence (memory_order_seq_cst);
+    if (atomic_load_explicit (&queue->armed, memory_order_relaxed) &&
+            atomic_exchange (&queue->armed, 0))
+        wake_up (queue);
+
+    return 1;
+}
+
+/**
+ * Stores the given \a event as the latest value of its type, and queues it
+ * only if no event of the same type is waiting to be polled
+ */
+static void push_conflated (DS_EventQueue* queue, DS_Event* event,
+                            const int index)
+{
+    pthread_mutex_lock (&queue->latest_lock);
+    int pending = queue->pending [index];
+    queue->latest [index] = *event;
+    queue->pending [index] = 1;
+    pthread_mutex_unlock (&queue->latest_lock);
+
+    /* The queued event will be polled with the new value */
+    if (pending) {
+        atomic_fetch_add_explicit (&queue->merged, 1, memory_order_relaxed);
+        return;
+    }
+
+    /* The queue is full, let the next event of this type try again */
+    if (!push (queue, event, 1)) {
+        pthread_mutex_lock (&queue->latest_lock);
+        queue->pending [index] = 0;
+        pthread_mutex_unlock (&queue->latest_lock);
+    }
+}
 
 /**
- * Initializes the event queue with an initial support for 50 events
+ * Initializes the event queue and marks every slot as writable
  */
 void Events_Init()
 {
-    DS_QueueInit (&events, 50, sizeof (DS_Event));
+    unsigned int i;
+    DS_EventQueue* queue = (DS_EventQueue*) calloc (1, sizeof (DS_EventQueue));
+
+    for (i = 0; i < DS_EVENT_QUEUE_SIZE; ++i)
+        atomic_init (&queue->slots [i].sequence, i);
+
+    atomic_init (&queue->mask, DS_ALL_EVENTS);
+    pthread_mutex_init (&queue->latest_lock, NULL);
+    pthread_mutex_init (&queue->wait_lock, NULL);
+    DS_CondInit (&queue->wait_cond);
+    open_wake_fd (queue);
+
+    Context_SetState (DS_MODULE_EVENTS, queue);
 }
 
 /**
- * De-allocates the event queue (that's all)
+ * De-allocates the event queue
  */
 void Events_Close()
 {
-    DS_QueueFree (&events);
+    close_wake_fd (events());
+    pthread_cond_destroy (&events()->wait_cond);
+    pthread_mutex_destroy (&events()->wait_lock);
+    pthread_mutex_destroy (&events()->latest_lock);
+    free (events());
+    Context_SetState (DS_MODULE_EVENTS, NULL);
+}
+
+/**
+ * Returns \c 1 if the application wants to receive events of the given
+ * \a type. Modules should check this before building an event that is costly
+ * to generate.
+ */
+int Events_Subscribed (const DS_EventType type)
+{
+    uint32_t mask = atomic_load_explicit (&events()->mask, memory_order_relaxed);
+    return (mask & DS_EVENT_MASK (type)) != 0;
 }
 
 /**
- * Adds the given \a event to the event queue
+ * Adds the given \a event to the event queue. This function can be called
+ * from any thread and never waits for the application to poll the events
+ * (a full queue drops the event instead). It only takes short internal
+ * locks: to update the latest value of a conflated event, and to wake up a
+ * thread that waits in DS_WaitEvent().
+ *
+ * Events of types that are not included in the event mask are discarded.
+ *
+ * If the queue is full, the event is discarded (the events that are already
+ * queued are kept) and counted as dropped.
+ *
+ * If event conflation is enabled and an event of the same type is still
+ * queued, the queued event is updated with the new value instead.
  *
  * \param event the event to register in the event queue
  */
 void DS_AddEvent (DS_Event* event)
 {
-    DS_QueuePush (&events, (void*) event);
+    DS_EventQueue* queue = events();
+    if (!queue)
+        return;
+
+    uint32_t mask = atomic_load_explicit (&queue->mask, memory_order_relaxed);
+
+    /* Nobody wants this event */
+    if (!(mask & DS_EVENT_MASK (event->type)))
+        return;
+
+    if (atomic_load_explicit (&queue->conflation, memory_order_relaxed)) {
+        int index = conflation_index (event->type);
+        if (index >= 0) {
+            push_conflated (queue, event, index);
+            return;
+        }
+    }
+
+    push (queue, event, 0);
+}
+
+/**
+ * Copies the event at the given \a position of the \a queue to the given
+ * \a event object and makes its slot writable again. The caller must update
+ * the head of the queue.
+ *
+ * \returns 1 on success, 0 if there is no event at that position yet
+ */
+static int take (DS_EventQueue* queue, const unsigned int position,
+                 DS_Event* event)
+{
+    DS_EventSlot* slot = &queue->slots [position & QUEUE_MASK];
+    unsigned int sequence = atomic_load_explicit (&slot->sequence,
+                                                  memory_order_acquire);
+
+    /* The slot was not written yet */
+    if (sequence != position + 1)
+        return 0;
+
+    /* Read the latest value of a conflated event */
+    if (slot->conflated) {
+        int index = conflation_index (slot->event.type);
+        pthread_mutex_lock (&queue->latest_lock);
+        *event = queue->latest [index];
+        queue->pending [index] = 0;
+        pthread_mutex_unlock (&queue->latest_lock);
+    }
+
+    else
+        *event = slot->event;
+
+    atomic_store_explicit (&slot->sequence,
+                           position + DS_EVENT_QUEUE_SIZE,
+                           memory_order_release);
+
+    return 1;
+}
+
+/**
+ * Copies the first event in the \a queue to the given \a event object
+ *
+ * \returns 1 on success, 0 if the queue is empty
+ */
+static int pop (DS_EventQueue* queue, DS_Event* event)
+{
+    unsigned int position = atomic_load_explicit (&queue->head,
+                                                  memory_order_relaxed);
+
+    if (!take (queue, position, event))
+        return 0;
+
+    atomic_store_explicit (&queue->head, position + 1, memory_order_relaxed);
+    return 1;
+}
+
+/**
+ * Called when the consumer finds the \a queue empty. Clears the wake-up
+ * descriptor, asks the next producer to wake up the consumer, and checks the
+ * queue again (in case that an event was added before the request was seen
+ * by the producers).
+ *
+ * \returns 1 if an event was copied to \a event, 0 if the queue is empty
+ */
+static int arm (DS_EventQueue* queue, DS_Event* event)
+{
+    if (queue->wake_fds [0] >= 0)
+        clear_wake_fd (queue);
+
+    if (!atomic_load_explicit (&queue->armed, memory_order_relaxed)) {
+        atomic_store (&queue->armed, 1);
+        atomic_thread_fence (memory_order_seq_cst);
+    }
+
+    return pop (queue, event);
 }
 
 /**
  * Polls for currently pending events and copies the first event in the queue
  * to the given \a event object.
  *
+ * Events must only be polled by one thread at a time (usually the UI thread
+ * of the application).
+ *
  * \returns 1 if there are any pending events, or 0 if there are none available.
  *
  * \param event we write the obtained event data here
  */
 int DS_PollEvent (DS_Event* event)
 {
-    DS_Event* front = (DS_Event*) DS_QueueGetFirst (&events);
+    DS_EventQueue* queue = events();
 
-    if (front) {
-        DS_QueuePop (&events);
-        memcpy (event, front, sizeof (DS_Event));
+    if (!queue)
+        return 0;
+
+    if (pop (queue, event))
         return 1;
-    }
+
+    /* The wake-up descriptor must become readable with the next event */
+    if (atomic_load_explicit (&queue->fd_used, memory_order_relaxed))
+        return arm (queue, event);
 
     return 0;
 }
+
+/**
+ * Copies up to \a max pending events (in the order that they were added) to
+ * the given \a buffer. The queue is drained in one operation, which is
+ * faster than calling DS_PollEvent() for each event.
+ *
+ * Like DS_PollEvent(), this function must only be called by one thread at a
+ * time.
+ *
+ * \returns the number of events written to the \a buffer
+ *
+ * \param buffer array of at least \a max events
+ * \param max the maximum number of events to copy
+ */
+int DS_PollEvents (DS_Event* buffer, const int max)
+{
+    int count = 0;
+    DS_EventQueue* queue = events();
+
+    if (!queue || !buffer || max <= 0)
+        return 0;
+
+    /* Read the ready events and publish the new head once */
+    unsigned int head = atomic_load_explicit (&queue->head,
+                                              memory_order_relaxed);
+    while (count < max && take (queue, head + count, &buffer [count]))
+        ++count;
+
+    atomic_store_explicit (&queue->head, head + count, memory_order_relaxed);
+
+    /* The queue was drained, the wake-up descriptor must be armed */
+    if (count < max && atomic_load_explicit (&queue->fd_used,
+                                             memory_order_relaxed))
+        count += arm (queue, &buffer [count]);
+
+    return count;
+}
+
+/**
+ * Waits until an event is available and copies it to the given \a event
+ * object. The calling thread sleeps (without polling) until an event is added
+ * or until \a timeout milliseconds have passed.
+ *
+ * Use a negative \a timeout to wait forever, and a \a timeout of \c 0 to
+ * return immediately (like DS_PollEvent()).
+ *
+ * \returns 1 if an event was obtained, 0 if the timeout expired
+ */
+int DS_WaitEvent (DS_Event* event, const int timeout)
+{
+    int expired = 0;
+    DS_EventQueue* queue = events();
+    uint64_t deadline = DS_GetTime() + (uint64_t) DS_Max (timeout, 0) * 1000000;
+
+    /* There is no context (and nothing will wake us up) */
+    if (!queue)
+        return 0;
+
+    for (;;) {
+        if (pop (queue, event) || arm (queue, event))
+            return 1;
+
+        if (expired || timeout == 0)
+            return 0;
+
+        /* Sleep until a producer wakes us up */
+        pthread_mutex_lock (&queue->wait_lock);
+        while (!queue->signaled && !expired) {
+            if (timeout < 0)
+                pthread_cond_wait (&queue->wait_cond, &queue->wait_lock);
+            else
+                expired = DS_CondWaitUntil (&queue->wait_cond,
+                                            &queue->wait_lock,
+                                            deadline) == ETIMEDOUT;
+        }
+
+        queue->signaled = 0;
+        pthread_mutex_unlock (&queue->wait_lock);
+    }
+}
+
+/**
+ * Returns a file descriptor that becomes readable when events are added to
+ * the queue of the current context after it was found empty, or \c -1 if the
+ * platform does not support it (Windows).
+ *
+ * The descriptor can be watched with \c select(), \c poll() or a
+ * \c QSocketNotifier. When it becomes readable, call DS_PollEvent() until it
+ * returns \c 0, which also clears the descriptor. Do not read from it.
+ */
+int DS_GetEventFd()
+{
+    DS_EventQueue* queue = events();
+    if (!queue)
+        return -1;
+
+    if (queue->wake_fds [0] >= 0)
+        atomic_store (&queue->fd_used, 1);
+
+    return queue->wake_fds [0];
+}
+
+/**
+ * Writes the counters of the event queue of the current context to the
+ * given \a stats structure
+ */
+void DS_GetEventStats (DS_EventStats* stats)
+{
+    if (stats) {
+        DS_EventQueue* queue = events();
+        unsigned int head = atomic_load (&queue->head);
+        unsigned int tail = atomic_load (&queue->tail);
+
+        stats->added = atomic_load (&queue->added);
+        stats->dropped = atomic_load (&queue->dropped);
+        stats->merged = atomic_load (&queue->merged);
+        stats->pending = tail - head;
+    }
+}
+
+/**
+ * Enables or disables the conflation of value events (voltage, CPU, RAM, disk
+ * and CAN usage and status string changes) in the current context.
+ *
+ * When enabled, at most one event of each of these types waits in the queue,
+ * and it is polled with the latest value that was reported. This keeps the
+ * queue short when the application polls events slower than the robot sends
+ * its status. The order of the other events is not affected.
+ *
+ * Conflation is disabled by default.
+ */
+void DS_SetEventConflation (const int enabled)
+{
+    atomic_store (&events()->conflation, enabled != 0);
+}
+
+/**
+ * Returns \c 1 if value events are conflated in the current context
+ */
+int DS_GetEventConflation()
+{
+    return atomic_load (&events()->conflation);
+}
+
+/**
+ * Selects the types of events that are queued in the current context, use
+ * \c DS_EVENT_MASK() to build the \a mask, for example:
+ *
+ * \code
+ * DS_SetEventMask (DS_EVENT_MASK (DS_ROBOT_COMMS_CHANGED) |
+ *                  DS_EVENT_MASK (DS_ROBOT_VOLTAGE_CHANGED));
+ * \endcode
+ *
+ * Events of other types are not generated at all, which avoids building them
+ * (and storing NetConsole messages that would never be read). Events
+ * that were already queued are still delivered. All the event types are
+ * subscribed by default (\c DS_ALL_EVENTS).
+ */
+void DS_SetEventMask (const uint32_t mask)
+{
+    atomic_store (&events()->mask, mask);
+}
+
+/**
+ * Returns the types of events that are queued in the current context
+ */
+uint32_t DS_GetEventMask()
+{
+    return atomic_load (&events()->mask);
+}
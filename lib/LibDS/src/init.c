@@ -29,7 +29,7 @@ static int init = 0;
 /**
  * Initializes all the modules of the LibDS library, you should call this
  * function before your application begins interacting with the different
- * modules of the LibDS.
+ * modules of the LibDS. The default context is created by this function.
  */
 void DS_Init()
 {
@@ -37,11 +37,9 @@ void DS_Init()
         init = 1;
 
         Timers_Init();
-        Client_Init();
-        Events_Init();
         Sockets_Init();
-        Joysticks_Init();
-        Protocols_Init();
+        Contexts_Init();
+        Protocols_Start();
     }
 }
 
@@ -49,20 +47,18 @@ void DS_Init()
  * Closes all the modules of the LibDS library, you should call this before
  * exiting your application. Failure to do this may result with socket
  * problems (regardless if you are using the offical DS or not), memory
- * problems and increased CPU usage (due to threads managed by the LibDS)
+ * problems and increased CPU usage (due to threads managed by the LibDS).
+ * Every context (including the default context) is destroyed.
  */
 void DS_Close()
 {
     if (DS_Initialized()) {
         init = 0;
 
-        Timers_Close();
+        Protocols_Stop();
+        Contexts_Close();
         Sockets_Close();
-        Protocols_Close();
-        Joysticks_Close();
-
-        Events_Close();
-        Client_Close();
+        Timers_Close();
     }
 }
 
@@ -21,29 +21,58 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include "DS_Array.h"
+#include "DS_Utils.h"
 #include "DS_Config.h"
 #include "DS_Events.h"
+#include "DS_Context.h"
 #include "DS_Joysticks.h"
 
+#include <math.h>
 #include <stdio.h>
+#include <stdatomic.h>
+
+/* Axis values are stored as integers in the [-AXIS_RANGE, AXIS_RANGE] range */
+#define AXIS_RANGE 32767
 
 /**
- * Represents a joystick and its information
+ * Represents a joystick and its information.
+ *
+ * The values are written by the application and read by the protocol
+ * thread. The version is stored after the values (and read before them),
+ * so a reader that sees a version also sees the values that it belongs to.
  */
 typedef struct _joystick {
-    int* hats;       /**< An array with the hat angles */
-    float* axes;    /**< An array with the axis values */
-    int* buttons;    /**< An array with the button states */
-    int num_axes;    /**< The number of axes of the joystick */
-    int num_hats;    /**< The number of hats of the joystick */
-    int num_buttons; /**< The number of buttons of the joystick */
+    _Atomic (int16_t) axes [DS_MAX_JOYSTICK_AXES]; /**< Scaled axis values */
+    _Atomic (int16_t) hats [DS_MAX_JOYSTICK_HATS]; /**< Hat angles */
+    _Atomic (uint32_t) buttons;    /**< One bit per pressed button */
+    uint8_t num_axes;              /**< The number of axes */
+    uint8_t num_hats;              /**< The number of hats */
+    uint8_t num_buttons;           /**< The number of buttons */
+    atomic_uint version;           /**< Changes when a value changes */
 } DS_Joystick;
 
 /**
- * Holds all the joysticks
+ * Holds every joystick of a context in a single block of memory, so that
+ * the protocols read the joystick values without chasing pointers
+ */
+typedef struct _joysticks {
+    atomic_int count;                         /**< Registered joysticks */
+    DS_Joystick joysticks [DS_MAX_JOYSTICKS]; /**< Joystick values */
+} DS_JoystickStore;
+
+/*
+ * Source of the joystick versions, shared by every context so that a version
+ * is never given to two different joysticks
  */
-static DS_Array array;
+static atomic_uint versions = 0;
+
+/**
+ * Returns the joystick store of the current context
+ */
+static DS_JoystickStore* store()
+{
+    return (DS_JoystickStore*) Context_GetState (DS_MODULE_JOYSTICKS);
+}
 
 /**
  * Registers a joystick event to the LibDS event system
@@ -62,38 +91,87 @@ static void register_event()
  */
 static DS_Joystick* get_joystick (int joystick)
 {
-    if ((int) array.used > joystick)
-        return (DS_Joystick*) array.data [joystick];
+    if (joystick >= 0 && DS_GetJoystickCount() > joystick)
+        return &store()->joysticks [joystick];
 
     return NULL;
 }
 
 /**
- * Returns \c true if the given \a joystick exists and is valid
+ * Returns the bits used by the given number of \a buttons
  */
-static int joystick_exists (int joystick)
+static uint32_t button_mask (const int buttons)
 {
-    if (DS_GetJoystickCount() > joystick)
-        return get_joystick (joystick) != NULL;
+    if (buttons >= 32)
+        return 0xffffffff;
 
-    return 0;
+    return (1u << buttons) - 1;
 }
 
 /**
- * Initializes the joystick array, with an initial support for 6 joysticks
+ * Converts the given axis \a value (from \c -1 to \c 1) to its stored value
+ */
+static int16_t to_axis (float value)
+{
+    if (isnan (value))
+        value = 0;
+    else if (value < -1)
+        value = -1;
+    else if (value > 1)
+        value = 1;
+
+    return (int16_t) roundf (value * AXIS_RANGE);
+}
+
+/**
+ * Returns the given \a input if it is between \c 0 and \a max, otherwise,
+ * this function will return the nearest limit (and warn about it)
+ */
+static int limit (const int input, const int max, const char* name)
+{
+    if (input > max) {
+        fprintf (stderr, "Joystick has %d %s, only %d will be used!\n",
+                 input, name, max);
+        return max;
+    }
+
+    return DS_Max (input, 0);
+}
+
+/**
+ * Initializes the joystick store, which supports up to \c DS_MAX_JOYSTICKS
  */
 void Joysticks_Init()
 {
-    DS_ArrayInit (&array, 6);
+    Context_SetState (DS_MODULE_JOYSTICKS,
+                      calloc (1, sizeof (DS_JoystickStore)));
 }
 
 /**
- * De-allocates the joystick array data
+ * De-allocates the joystick store
  */
 void Joysticks_Close()
 {
-    DS_ArrayFree (&array);
+    atomic_store (&store()->count, 0);
     register_event();
+
+    free (store());
+    Context_SetState (DS_MODULE_JOYSTICKS, NULL);
+}
+
+/**
+ * Gives a new version to the given \a stick, so that the protocols know that
+ * its values have changed (version \c 0 is never used)
+ */
+static void update_version (DS_Joystick* stick)
+{
+    unsigned int version;
+
+    do {
+        version = atomic_fetch_add (&versions, 1) + 1;
+    } while (version == 0);
+
+    atomic_store_explicit (&stick->version, version, memory_order_release);
 }
 
 /**
@@ -101,7 +179,10 @@ void Joysticks_Close()
  */
 int DS_GetJoystickCount()
 {
-    return array.used;
+    if (store())
+        return atomic_load_explicit (&store()->count, memory_order_acquire);
+
+    return 0;
 }
 
 /**
@@ -110,10 +191,8 @@ int DS_GetJoystickCount()
  */
 int DS_GetJoystickNumHats (int joystick)
 {
-    if (joystick_exists (joystick))
-        return get_joystick (joystick)->num_hats;
-
-    return 0;
+    DS_Joystick* stick = get_joystick (joystick);
+    return stick ? stick->num_hats : 0;
 }
 
 /**
@@ -122,10 +201,8 @@ int DS_GetJoystickNumHats (int joystick)
  */
 int DS_GetJoystickNumAxes (int joystick)
 {
-    if (joystick_exists (joystick))
-        return get_joystick (joystick)->num_axes;
-
-    return 0;
+    DS_Joystick* stick = get_joystick (joystick);
+    return stick ? stick->num_axes : 0;
 }
 
 /**
@@ -134,10 +211,8 @@ int DS_GetJoystickNumAxes (int joystick)
  */
 int DS_GetJoystickNumButtons (int joystick)
 {
-    if (joystick_exists (joystick))
-        return get_joystick (joystick)->num_buttons;
-
-    return 0;
+    DS_Joystick* stick = get_joystick (joystick);
+    return stick ? stick->num_buttons : 0;
 }
 
 /**
@@ -150,12 +225,10 @@ int DS_GetJoystickNumButtons (int joystick)
  */
 int DS_GetJoystickHat (int joystick, int hat)
 {
-    if (CFG_GetRobotEnabled() && joystick_exists (joystick)) {
-        DS_Joystick* stick = get_joystick (joystick);
+    DS_Joystick* stick = get_joystick (joystick);
 
-        if (stick->num_hats > hat)
-            return stick->hats [hat];
-    }
+    if (CFG_GetRobotEnabled() && stick && hat >= 0 && stick->num_hats > hat)
+        return atomic_load_explicit (&stick->hats [hat], memory_order_relaxed);
 
     return 0;
 }
@@ -170,12 +243,11 @@ int DS_GetJoystickHat (int joystick, int hat)
  */
 float DS_GetJoystickAxis (int joystick, int axis)
 {
-    if (CFG_GetRobotEnabled() && joystick_exists (joystick)) {
-        DS_Joystick* stick = get_joystick (joystick);
+    DS_Joystick* stick = get_joystick (joystick);
 
-        if (stick->num_axes > axis)
-            return stick->axes [axis];
-    }
+    if (CFG_GetRobotEnabled() && stick && axis >= 0 && stick->num_axes > axis)
+        return (float) atomic_load_explicit (&stick->axes [axis],
+                                             memory_order_relaxed) / AXIS_RANGE;
 
     return 0;
 }
@@ -190,12 +262,45 @@ float DS_GetJoystickAxis (int joystick, int axis)
  */
 int DS_GetJoystickButton (int joystick, int button)
 {
-    if (CFG_GetRobotEnabled() && joystick_exists (joystick)) {
-        DS_Joystick* stick = get_joystick (joystick);
+    if (button >= 0 && button < DS_MAX_JOYSTICK_BUTTONS)
+        return (DS_GetJoystickButtons (joystick) >> button) & 1;
 
-        if (stick->num_buttons > button)
-            return stick->buttons [button];
-    }
+    return 0;
+}
+
+/**
+ * Returns the states of all the buttons of the given \a joystick, where
+ * the bit \c n is set if the button \c n is pressed.
+ * If the joystick does not exist, this function will return \c 0
+ *
+ * \note Regardless of protocol implementation, this function will return
+ *       a neutral value if the robot is disabled. This is for additional
+ *       safety!
+ */
+uint32_t DS_GetJoystickButtons (int joystick)
+{
+    DS_Joystick* stick = get_joystick (joystick);
+
+    if (CFG_GetRobotEnabled() && stick)
+        return atomic_load_explicit (&stick->buttons, memory_order_relaxed);
+
+    return 0;
+}
+
+/**
+ * Returns the version of the given \a joystick, which changes every time
+ * that one of its values changes. Protocols use it to avoid encoding the
+ * same joystick values again. If the joystick does not exist, this function
+ * will return \c 0
+ *
+ * The version must be read before the joystick values, so that values that
+ * change while they are read get a version that has not been seen yet.
+ */
+unsigned int DS_GetJoystickVersion (int joystick)
+{
+    DS_Joystick* stick = get_joystick (joystick);
+    if (stick)
+        return atomic_load_explicit (&stick->version, memory_order_acquire);
 
     return 0;
 }
@@ -205,9 +310,10 @@ int DS_GetJoystickButton (int joystick, int button)
  */
 void DS_JoysticksReset()
 {
-    DS_ArrayFree (&array);
-    DS_ArrayInit (&array, 6);
+    if (!store())
+        return;
 
+    atomic_store (&store()->count, 0);
     register_event();
 }
 
@@ -215,30 +321,48 @@ void DS_JoysticksReset()
  * Registers a new joystick with the given number of \a axes, \a hats and
  * \a buttons. All joystick values are set to a neutral state to ensure
  * safe operation of the robot.
+ *
+ * \note Joysticks can have up to \c DS_MAX_JOYSTICK_AXES axes,
+ *       \c DS_MAX_JOYSTICK_HATS hats and \c DS_MAX_JOYSTICK_BUTTONS
+ *       buttons, the rest are ignored
  */
 void DS_JoysticksAdd (const int axes, const int hats, const int buttons)
 {
+    /* There is no context (the DS is not initialized) */
+    if (!store())
+        return;
+
     /* Joystick is empty */
     if (axes <= 0 && hats <= 0 && buttons <= 0) {
         fprintf (stderr, "Cannot register empty joystick!\n");
         return;
     }
 
-    /* Allocate memory for a new joystick */
-    DS_Joystick* joystick = (DS_Joystick*) malloc (sizeof (DS_Joystick));
+    /* There is no space for another joystick */
+    int count = DS_GetJoystickCount();
+    if (count >= DS_MAX_JOYSTICKS) {
+        fprintf (stderr, "Cannot register more than %d joysticks!\n",
+                 DS_MAX_JOYSTICKS);
+        return;
+    }
 
-    /* Set joystick properties */
-    joystick->num_axes = axes;
-    joystick->num_hats = hats;
-    joystick->num_buttons = buttons;
+    /* Reset the joystick values and set its properties */
+    int i;
+    DS_Joystick* joystick = &store()->joysticks [count];
+    for (i = 0; i < DS_MAX_JOYSTICK_AXES; ++i)
+        atomic_store_explicit (&joystick->axes [i], 0, memory_order_relaxed);
+    for (i = 0; i < DS_MAX_JOYSTICK_HATS; ++i)
+        atomic_store_explicit (&joystick->hats [i], 0, memory_order_relaxed);
 
-    /* Set joystick value arrays */
-    joystick->hats = calloc (hats, sizeof (int));
-    joystick->axes = calloc (axes, sizeof (float));
-    joystick->buttons = calloc (buttons, sizeof (int));
+    atomic_store_explicit (&joystick->buttons, 0, memory_order_relaxed);
+    joystick->num_axes = limit (axes, DS_MAX_JOYSTICK_AXES, "axes");
+    joystick->num_hats = limit (hats, DS_MAX_JOYSTICK_HATS, "hats");
+    joystick->num_buttons = limit (buttons, DS_MAX_JOYSTICK_BUTTONS,
+                                   "buttons");
+    update_version (joystick);
 
-    /* Register the new joystick in the joystick list */
-    DS_ArrayInsert (&array, (void*) joystick);
+    /* Register the new joystick (after its values are set) */
+    atomic_store_explicit (&store()->count, count + 1, memory_order_release);
 
     /* Emit the joystick count changed event */
     register_event();
@@ -249,11 +373,13 @@ void DS_JoysticksAdd (const int axes, const int hats, const int buttons)
  */
 void DS_SetJoystickHat (int joystick, int hat, int angle)
 {
-    if (joystick_exists (joystick)) {
-        DS_Joystick* stick = get_joystick (joystick);
+    DS_Joystick* stick = get_joystick (joystick);
 
-        if (stick->num_hats > hat)
-            stick->hats [hat] = angle;
+    if (stick && hat >= 0 && stick->num_hats > hat
+            && atomic_load (&stick->hats [hat]) != (int16_t) angle) {
+        atomic_store_explicit (&stick->hats [hat], (int16_t) angle,
+                               memory_order_relaxed);
+        update_version (stick);
     }
 }
 
@@ -262,11 +388,16 @@ void DS_SetJoystickHat (int joystick, int hat, int angle)
  */
 void DS_SetJoystickAxis (int joystick, int axis, float value)
 {
-    if (joystick_exists (joystick)) {
-        DS_Joystick* stick = get_joystick (joystick);
+    DS_Joystick* stick = get_joystick (joystick);
+
+    if (stick && axis >= 0 && stick->num_axes > axis) {
+        int16_t scaled = to_axis (value);
 
-        if (stick->num_axes > axis)
-            stick->axes [axis] = value;
+        if (atomic_load (&stick->axes [axis]) != scaled) {
+            atomic_store_explicit (&stick->axes [axis], scaled,
+                                   memory_order_relaxed);
+            update_version (stick);
+        }
     }
 }
 
@@ -275,10 +406,66 @@ void DS_SetJoystickAxis (int joystick, int axis, float value)
  */
 void DS_SetJoystickButton (int joystick, int button, int pressed)
 {
-    if (joystick_exists (joystick)) {
-        DS_Joystick* stick = get_joystick (joystick);
+    DS_Joystick* stick = get_joystick (joystick);
+
+    if (stick && button >= 0 && stick->num_buttons > button) {
+        uint32_t current = atomic_load (&stick->buttons);
+        uint32_t buttons = current & ~(1u << button);
+        if (pressed > 0)
+            buttons |= (1u << button);
+
+        if (current != buttons) {
+            atomic_store_explicit (&stick->buttons, buttons,
+                                   memory_order_relaxed);
+            update_version (stick);
+        }
+    }
+}
+
+/**
+ * Updates every value of the given \a joystick at once, which is cheaper
+ * than calling the individual setters for each axis, hat and button.
+ *
+ * \param joystick the joystick to update
+ * \param axes the axis values (from \c -1 to \c 1), there must be one value
+ *        for each axis of the joystick, or \c NULL to keep the current values
+ * \param buttons the button states, where the bit \c n is set if the button
+ *        \c n is pressed (bits of non-existing buttons are ignored)
+ * \param hats the hat angles, there must be one value for each hat of the
+ *        joystick, or \c NULL to keep the current values
+ */
+void DS_SetJoystickState (int joystick, const float* axes,
+                          uint32_t buttons, const int* hats)
+{
+    int i;
+    int changed = 0;
+    DS_Joystick* stick = get_joystick (joystick);
+
+    if (!stick)
+        return;
+
+    if (axes) {
+        for (i = 0; i < stick->num_axes; ++i) {
+            int16_t scaled = to_axis (axes [i]);
+            changed |= (atomic_load (&stick->axes [i]) != scaled);
+            atomic_store_explicit (&stick->axes [i], scaled,
+                                   memory_order_relaxed);
+        }
+    }
 
-        if (stick->num_buttons > button)
-            stick->buttons [button] = (pressed > 0) ? 1 : 0;
+    if (hats) {
+        for (i = 0; i < stick->num_hats; ++i) {
+            changed |= (atomic_load (&stick->hats [i]) != (int16_t) hats [i]);
+            atomic_store_explicit (&stick->hats [i], (int16_t) hats [i],
+                                   memory_order_relaxed);
+        }
     }
+
+    buttons &= button_mask (stick->num_buttons);
+    changed |= (atomic_load (&stick->buttons) != buttons);
+    atomic_store_explicit (&stick->buttons, buttons, memory_order_relaxed);
+
+    /* Give a single version to the whole update */
+    if (changed)
+        update_version (stick);
 }
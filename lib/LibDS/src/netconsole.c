@@ -0,0 +1,244 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "DS_Context.h"
+#include "DS_NetConsole.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define INDEX_MASK (DS_NETCONSOLE_MAX_MESSAGES - 1)
+
+#if (DS_NETCONSOLE_MAX_MESSAGES & INDEX_MASK) != 0
+#error "DS_NETCONSOLE_MAX_MESSAGES must be a power of two"
+#endif
+
+/*
+ * Location of a stored message. Byte positions grow forever, the offset of a
+ * message in the buffer is its position modulo the buffer size.
+ */
+typedef struct _entry {
+    uint64_t position; /**< Byte position of the message */
+    int length;        /**< Number of bytes in the message */
+} DS_NetConsoleEntry;
+
+/*
+ * Holds the NetConsole messages of a context. Messages are written one after
+ * another in a fixed buffer (a message that does not fit at the end of the
+ * buffer starts again at its beginning, so it is never split), and their
+ * handles are consecutive numbers.
+ */
+typedef struct _netconsole {
+    char buffer [DS_NETCONSOLE_BUFFER_SIZE];                 /**< Bytes */
+    DS_NetConsoleEntry entries [DS_NETCONSOLE_MAX_MESSAGES]; /**< Messages */
+    uint64_t oldest;        /**< Handle of the oldest stored message */
+    uint64_t next;          /**< Handle of the next message */
+    uint64_t position;      /**< Byte position of the next message */
+    uint64_t pinned;        /**< Handle being viewed (or \c 0) */
+    uint64_t last_read;     /**< Newest handle that was viewed */
+    unsigned long dropped;  /**< Messages lost before they were viewed */
+    pthread_mutex_t lock;   /**< Guards the whole structure */
+} DS_NetConsole;
+
+/**
+ * Returns the NetConsole buffer of the current context
+ */
+static DS_NetConsole* netconsole()
+{
+    return (DS_NetConsole*) Context_GetState (DS_MODULE_NETCONSOLE);
+}
+
+/**
+ * Returns the location of the message with the given \a handle
+ */
+static DS_NetConsoleEntry* entry (DS_NetConsole* ptr, const uint64_t handle)
+{
+    return &ptr->entries [handle & INDEX_MASK];
+}
+
+/**
+ * Initializes the NetConsole buffer of the current context. Handles start
+ * at \c 1, so that \c 0 is never a valid handle.
+ */
+void NetConsole_Init()
+{
+    DS_NetConsole* ptr = (DS_NetConsole*) calloc (1, sizeof (DS_NetConsole));
+
+    ptr->next = 1;
+    ptr->oldest = 1;
+    pthread_mutex_init (&ptr->lock, NULL);
+
+    Context_SetState (DS_MODULE_NETCONSOLE, ptr);
+}
+
+/**
+ * De-allocates the NetConsole buffer of the current context
+ */
+void NetConsole_Close()
+{
+    pthread_mutex_destroy (&netconsole()->lock);
+    free (netconsole());
+    Context_SetState (DS_MODULE_NETCONSOLE, NULL);
+}
+
+/**
+ * Copies the given message to the NetConsole buffer, overwriting the oldest
+ * messages if needed. Messages longer than the buffer are truncated.
+ *
+ * The message that is being viewed by the application is never overwritten,
+ * if the new message would overwrite it, the new message is dropped instead.
+ *
+ * \returns the handle of the new message, or \c 0 if it was dropped
+ */
+uint64_t NetConsole_Add (const char* data, const int length)
+{
+    uint64_t handle = 0;
+    DS_NetConsole* ptr = netconsole();
+    int size = length;
+
+    if (!data || length < 0)
+        return 0;
+
+    if (size > DS_NETCONSOLE_BUFFER_SIZE)
+        size = DS_NETCONSOLE_BUFFER_SIZE;
+
+    pthread_mutex_lock (&ptr->lock);
+
+    /* Do not split the message at the end of the buffer */
+    uint64_t position = ptr->position;
+    uint64_t offset = position % DS_NETCONSOLE_BUFFER_SIZE;
+    if (offset + size > DS_NETCONSOLE_BUFFER_SIZE)
+        position += DS_NETCONSOLE_BUFFER_SIZE - offset;
+
+    /* Overwrite the oldest messages until the new one fits */
+    while (ptr->oldest < ptr->next) {
+        int full = (ptr->next - ptr->oldest) >= DS_NETCONSOLE_MAX_MESSAGES;
+        int overlaps = position + size - entry (ptr, ptr->oldest)->position
+                       > DS_NETCONSOLE_BUFFER_SIZE;
+
+        if (!full && !overlaps)
+            break;
+
+        /* The application is reading this message */
+        if (ptr->oldest == ptr->pinned) {
+            ++ptr->dropped;
+            pthread_mutex_unlock (&ptr->lock);
+            return 0;
+        }
+
+        /* The message is lost before the application read it */
+        if (ptr->oldest > ptr->last_read)
+            ++ptr->dropped;
+
+        ++ptr->oldest;
+    }
+
+    /* Copy the message */
+    handle = ptr->next++;
+    entry (ptr, handle)->length = size;
+    entry (ptr, handle)->position = position;
+    memcpy (ptr->buffer + (position % DS_NETCONSOLE_BUFFER_SIZE), data, size);
+    ptr->position = position + size;
+
+    pthread_mutex_unlock (&ptr->lock);
+    return handle;
+}
+
+/**
+ * Obtains a view of the NetConsole message with the given \a handle (which
+ * is obtained from a \c DS_NETCONSOLE_NEW_MESSAGE event), without copying it.
+ *
+ * The message is kept in the buffer until this function is called again or
+ * until DS_ReleaseNetConsoleMessage() is called, so views must be released
+ * quickly. Views must only be obtained by one thread (usually the thread
+ * that polls the events).
+ *
+ * \returns 1 on success, 0 if the message was overwritten by newer messages
+ *
+ * \param handle the handle of the message
+ * \param message the view to fill
+ */
+int DS_GetNetConsoleMessage (const uint64_t handle,
+                             DS_NetConsoleMessage* message)
+{
+    int found = 0;
+    DS_NetConsole* ptr = netconsole();
+
+    if (!message)
+        return 0;
+
+    pthread_mutex_lock (&ptr->lock);
+    ptr->pinned = 0;
+
+    if (handle >= ptr->oldest && handle < ptr->next) {
+        DS_NetConsoleEntry* location = entry (ptr, handle);
+        message->handle = handle;
+        message->length = location->length;
+        message->data = ptr->buffer +
+                        (location->position % DS_NETCONSOLE_BUFFER_SIZE);
+
+        found = 1;
+        ptr->pinned = handle;
+        if (handle > ptr->last_read)
+            ptr->last_read = handle;
+    }
+
+    pthread_mutex_unlock (&ptr->lock);
+
+    if (!found) {
+        message->handle = 0;
+        message->data = NULL;
+        message->length = 0;
+    }
+
+    return found;
+}
+
+/**
+ * Releases the last message view obtained with DS_GetNetConsoleMessage(),
+ * which may then be overwritten by new messages
+ */
+void DS_ReleaseNetConsoleMessage()
+{
+    DS_NetConsole* ptr = netconsole();
+
+    pthread_mutex_lock (&ptr->lock);
+    ptr->pinned = 0;
+    pthread_mutex_unlock (&ptr->lock);
+}
+
+/**
+ * Returns the number of NetConsole messages that were overwritten (or
+ * discarded) before the application could view them
+ */
+unsigned long DS_GetNetConsoleDroppedMessages()
+{
+    DS_NetConsole* ptr = netconsole();
+
+    pthread_mutex_lock (&ptr->lock);
+    unsigned long dropped = ptr->dropped;
+    pthread_mutex_unlock (&ptr->lock);
+
+    return dropped;
+}
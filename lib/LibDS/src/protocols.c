@@ -26,105 +26,349 @@
 #include "DS_Client.h"
 #include "DS_Config.h"
 #include "DS_Events.h"
+#include "DS_Context.h"
 #include "DS_Socket.h"
+#include "DS_Capture.h"
 #include "DS_Protocol.h"
+#include "DS_Discovery.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
-#define SEND_PRECISION 1  /* Update the sender timers every millisecond */
-#define RECV_PRECISION 50 /* Update the watchdogs every 50 milliseconds */
+#define LOOP_TIMEOUT 50   /* Run the event loop at least every 50 ms */
+#define RECV_PRECISION 50 /* Watchdogs may expire up to 50 ms late */
+
+#define LATENCY_SLOTS   256 /* Number of in-flight packets tracked per channel */
+#define LATENCY_SAMPLES 256 /* Number of RTT samples kept per channel */
+
+#define LOSS_BUCKETS     10   /* Number of buckets in the loss window */
+#define LOSS_BUCKET_TIME 500  /* Time covered by each bucket (5 s window) */
+#define LOSS_MAX_GAP     1000 /* Larger sequence jumps mean the peer restarted */
+#define LOSS_HISTORY     64   /* Late packets are detected up to this age */
 
 /*
- * Holds a pointer to the current protocol in use
+ * Holds the send schedule of a channel, packets are sent on a fixed time
+ * grid (deadline, deadline + period, deadline + 2 * period...)
  */
-static DS_Protocol* protocol = NULL;
+typedef struct _send_channel {
+    uint64_t period;       /**< Send interval (in nanoseconds), 0 = disabled */
+    uint64_t deadline;     /**< Monotonic time of the next scheduled send */
+    double jitter_sum;     /**< Sum of the jitter samples (in microseconds) */
+    double jitter_sq_sum;  /**< Sum of the squared jitter samples */
+    DS_SendStats stats;    /**< Send statistics exposed to the client */
+    DS_Packet packet;      /**< Buffer in which the packets are generated */
+} DS_SendChannel;
 
 /*
- * Define the sender watchdogs (when one expires, we send a packet)
+ * Holds the send times of the packets that are waiting to be echoed by the
+ * remote peer and the most recent round-trip time samples of a channel
  */
-static DS_Timer fms_send_timer;
-static DS_Timer radio_send_timer;
-static DS_Timer robot_send_timer;
+typedef struct _latency_channel {
+    uint64_t sent_time [LATENCY_SLOTS];      /**< Send time of each slot, 0 = empty */
+    unsigned int sent_index [LATENCY_SLOTS]; /**< Sequence number of each slot */
+    double samples [LATENCY_SAMPLES];        /**< Ring of RTT samples (in ms) */
+    unsigned long count;                     /**< Number of RTT samples taken */
+} DS_LatencyChannel;
 
 /*
- * Define the receiver watchdogs (when one expires, comms are lost)
+ * Holds the loss counters of a slice of time, packets recovered by a late
+ * arrival are subtracted from the slice that counted them as lost
  */
-static DS_Timer fms_recv_timer;
-static DS_Timer radio_recv_timer;
-static DS_Timer robot_recv_timer;
+typedef struct _loss_bucket {
+    uint64_t epoch; /**< Time slice number (time / bucket time) */
+    long expected;  /**< Packets expected in the slice */
+    long lost;      /**< Packets lost in the slice */
+    long reordered; /**< Packets that arrived late in the slice */
+    long bursts;    /**< Loss bursts detected in the slice */
+    long max_burst; /**< Longest loss burst detected in the slice */
+} DS_LossBucket;
 
 /*
- * If set to anything else than 0, then the event loop will be allowed to run
+ * Holds the sliding loss window of one direction of a channel, the window
+ * is made of time slices so that old losses are forgotten at no extra cost
  */
-static int running = 0;
+typedef struct _loss_window {
+    int synced;                            /**< Set after the first packet */
+    unsigned int highest;                  /**< Highest sequence number seen */
+    uint64_t received;                     /**< Bit n: highest - n received */
+    uint64_t charged [LOSS_HISTORY];       /**< Slice that lost each number */
+    DS_LossBucket buckets [LOSS_BUCKETS];  /**< Ring of time slices */
+} DS_LossWindow;
 
 /*
- * Protocol read success booleans (used to feed the watchdogs)
+ * Holds the state of the protocols module in a context, the channel arrays
+ * are indexed by DS_Channel
  */
-static int fms_read = 0;
-static int radio_read = 0;
-static int robot_read = 0;
+typedef struct _protocols_state {
+    DS_Protocol* protocol;           /**< Protocol in use (may be NULL) */
+    DS_SendChannel channels [3];     /**< Send schedules */
+    DS_LatencyChannel latency [3];   /**< Latency trackers */
+    DS_LossWindow uplink [3];        /**< Uplink loss windows */
+    DS_LossWindow downlink [3];      /**< Downlink loss windows */
+    DS_Timer fms_recv_timer;         /**< FMS watchdog */
+    DS_Timer radio_recv_timer;       /**< Radio watchdog */
+    DS_Timer robot_recv_timer;       /**< Robot watchdog */
+    int fms_read;                    /**< Set if a FMS packet was read */
+    int radio_read;                  /**< Set if a radio packet was read */
+    int robot_read;                  /**< Set if a robot packet was read */
+    int sent_fms_packets;            /**< Number of sent FMS packets */
+    int sent_radio_packets;          /**< Number of sent radio packets */
+    int sent_robot_packets;          /**< Number of sent robot packets */
+    int received_fms_packets;        /**< Number of received FMS packets */
+    int received_radio_packets;      /**< Number of received radio packets */
+    int received_robot_packets;      /**< Number of received robot packets */
+    _Atomic (DS_Capture*) capture;   /**< Packet capture (may be NULL) */
+} DS_ProtocolsState;
 
 /*
- * Holds the received data
+ * Protect the send schedules, latency trackers and loss windows of every
+ * context (they are used by the event loop and by the client application)
  */
-static bstring fms_data = NULL;
-static bstring radio_data = NULL;
-static bstring robot_data = NULL;
-static bstring netcs_data = NULL;
+static pthread_mutex_t channels_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t latency_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t loss_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /*
- * Holds the sent/received packets
+ * Protects the packet capture of every context (it is written by the event
+ * loop and started/stopped by the client application), the lock is only
+ * taken while a capture is running
  */
-static int sent_fms_packets = 0;
-static int sent_radio_packets = 0;
-static int sent_robot_packets = 0;
-static int received_fms_packets = 0;
-static int received_radio_packets = 0;
-static int received_robot_packets = 0;
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /*
- * The thread ID for the protocol event loop
+ * If set to anything else than 0, then the event loop will be allowed to run
+ */
+static atomic_int running = 0;
+
+/*
+ * Holds the time at which the event loop must wake up again, calculated
+ * while the loop processes every context
+ */
+static uint64_t loop_deadline = 0;
+
+/*
+ * The thread ID for the protocol event loop (shared by all contexts)
  */
 static pthread_t event_thread;
 
 /**
- * Sends a new packet to the FMS, the generated data is immediatly deleted
- * once the packet has been sent
+ * Returns the protocols state of the current context
+ */
+static DS_ProtocolsState* state()
+{
+    return (DS_ProtocolsState*) Context_GetState (DS_MODULE_PROTOCOLS);
+}
+
+/**
+ * Writes the given datagram to the packet capture of the current context
+ * (if a capture was started)
+ */
+static void capture (const DS_CaptureChannel channel,
+                     const DS_CaptureDirection direction,
+                     const void* data, const int length)
+{
+    /* Avoid the lock if no capture is running */
+    if (!atomic_load_explicit (&state()->capture, memory_order_acquire))
+        return;
+
+    pthread_mutex_lock (&capture_lock);
+    DS_CaptureWrite (atomic_load (&state()->capture),
+                     channel, direction, data, length);
+    pthread_mutex_unlock (&capture_lock);
+}
+
+/**
+ * Empties the packet buffer of the given \a channel and returns it, so that
+ * the protocol can generate a new packet in it
+ */
+static DS_Packet* channel_packet (const DS_Channel channel)
+{
+    DS_Packet* packet = &state()->channels [channel].packet;
+    packet->length = 0;
+    return packet;
+}
+
+/**
+ * Appends the given \a byte to the given \a packet
+ *
+ * \returns \c 1 on success, \c 0 if the packet is full
+ */
+int DS_PacketAppend (DS_Packet* packet, const uint8_t byte)
+{
+    if (!packet || packet->length >= DS_PACKET_CAPACITY)
+        return 0;
+
+    packet->data [packet->length++] = byte;
+    return 1;
+}
+
+/**
+ * Appends the first \a length bytes of the given \a data to the given
+ * \a packet. Nothing is appended if the data does not fit in the packet.
+ *
+ * \returns \c 1 on success, \c 0 if the data does not fit in the packet
+ */
+int DS_PacketAppendBytes (DS_Packet* packet, const void* data, const int length)
+{
+    if (!packet || !data || length < 0)
+        return 0;
+
+    if (length > DS_PACKET_CAPACITY - packet->length)
+        return 0;
+
+    memcpy (packet->data + packet->length, data, length);
+    packet->length += length;
+    return 1;
+}
+
+/**
+ * Changes the length of the given \a packet, the bytes added to the packet
+ * are set to zero. This is used by protocols with fixed-size packets.
+ *
+ * \returns \c 1 on success, \c 0 if the \a length exceeds the capacity
+ */
+int DS_PacketResize (DS_Packet* packet, const int length)
+{
+    if (!packet || length < 0 || length > DS_PACKET_CAPACITY)
+        return 0;
+
+    if (length > packet->length)
+        memset (packet->data + packet->length, 0, length - packet->length);
+
+    packet->length = length;
+    return 1;
+}
+
+/**
+ * Generates a new packet in the FMS packet buffer and sends it to the FMS
  */
 static void send_fms_data()
 {
-    ++sent_fms_packets;
-    bstring data = protocol->create_fms_packet();
-    DS_SocketSend (protocol->fms_socket, data);
-    DS_FREESTR (data);
+    ++state()->sent_fms_packets;
+    DS_Packet* packet = channel_packet (DS_CHANNEL_FMS);
+    state()->protocol->create_fms_packet (packet);
+    DS_SocketSendBuffer (state()->protocol->fms_socket,
+                         packet->data, packet->length);
+    capture (DS_CAPTURE_FMS, DS_CAPTURE_OUTBOUND,
+             packet->data, packet->length);
 }
 
 /**
- * Sends a new packet to the radio, the generated data is immediatly deleted
- * once the packet has been sent
+ * Generates a new packet in the radio packet buffer and sends it to the radio
  */
 static void send_radio_data()
 {
-    ++sent_radio_packets;
-    bstring data = protocol->create_radio_packet();
-    DS_SocketSend (protocol->radio_socket, data);
-    DS_FREESTR (data);
+    ++state()->sent_radio_packets;
+    DS_Packet* packet = channel_packet (DS_CHANNEL_RADIO);
+    state()->protocol->create_radio_packet (packet);
+    DS_SocketSendBuffer (state()->protocol->radio_socket,
+                         packet->data, packet->length);
+    capture (DS_CAPTURE_RADIO, DS_CAPTURE_OUTBOUND,
+             packet->data, packet->length);
 }
 
 /**
- * Sends a new packet to the robot, the generated data is immediatly deleted
- * once the packet has been sent
+ * Generates a new packet in the robot packet buffer and sends it to the
+ * robot. While the robot address is being discovered, the packet is sent to
+ * every candidate address.
  */
 static void send_robot_data()
 {
-    ++sent_robot_packets;
-    bstring data = protocol->create_robot_packet();
-    DS_SocketSend (protocol->robot_socket, data);
-    DS_FREESTR (data);
+    ++state()->sent_robot_packets;
+    DS_Packet* packet = channel_packet (DS_CHANNEL_ROBOT);
+    state()->protocol->create_robot_packet (packet);
+
+    if (Discovery_Active())
+        Discovery_SendProbes (state()->protocol->robot_socket,
+                              packet->data, packet->length);
+    else
+        DS_SocketSendBuffer (state()->protocol->robot_socket,
+                             packet->data, packet->length);
+
+    capture (DS_CAPTURE_ROBOT, DS_CAPTURE_OUTBOUND,
+             packet->data, packet->length);
+}
+
+/**
+ * Checks if the given \a channel must send a packet at the given time and
+ * moves its deadline to the next slot of the time grid.
+ *
+ * The following rules are applied when a deadline is missed:
+ *    - If the send is late by less than one period, the packet is sent
+ *      immediately and the next deadline stays on the grid (catch-up)
+ *    - If one or more whole periods were missed, the missed slots are
+ *      skipped instead of sending a burst of packets
+ *
+ * Returns \c 1 if a packet must be sent now
+ */
+static int send_due (const DS_Channel channel, const uint64_t now)
+{
+    int due = 0;
+    DS_SendChannel* ch = &state()->channels [channel];
+
+    pthread_mutex_lock (&channels_lock);
+
+    if (ch->period > 0 && now >= ch->deadline) {
+        uint64_t late = now - ch->deadline;
+        uint64_t missed = late / ch->period;
+
+        /* Skip the missed slots and move to the next grid slot */
+        ch->deadline += (missed + 1) * ch->period;
+        ch->stats.skipped += missed;
+
+        /* Update jitter statistics */
+        double jitter = (late - (missed * ch->period)) / 1000.0;
+        ch->jitter_sum += jitter;
+        ch->jitter_sq_sum += jitter * jitter;
+        ch->stats.max_jitter = fmax (ch->stats.max_jitter, jitter);
+        ch->stats.sent += 1;
+
+        due = 1;
+    }
+
+    pthread_mutex_unlock (&channels_lock);
+    return due;
+}
+
+/**
+ * Returns the earliest send deadline of all channels or the given
+ * \a fallback time (whichever comes first)
+ */
+static uint64_t next_deadline (const uint64_t fallback)
+{
+    int i;
+    uint64_t deadline = fallback;
+
+    pthread_mutex_lock (&channels_lock);
+
+    for (i = 0; i < 3; ++i) {
+        DS_SendChannel* ch = &state()->channels [i];
+        if (ch->period > 0 && ch->deadline < deadline)
+            deadline = ch->deadline;
+    }
+
+    pthread_mutex_unlock (&channels_lock);
+    return deadline;
+}
+
+/**
+ * Configures the send schedule of the given \a channel, the first packet is
+ * sent immediately. An \a interval lower than \c 1 disables the channel.
+ */
+static void schedule_channel (const DS_Channel channel, const int interval)
+{
+    pthread_mutex_lock (&channels_lock);
+
+    DS_SendChannel* ch = &state()->channels [channel];
+    memset (ch, 0, sizeof (DS_SendChannel));
+    ch->deadline = DS_GetTime();
+    ch->period = interval > 0 ? interval * 1000000ULL : 0;
+
+    pthread_mutex_unlock (&channels_lock);
 }
 
 /**
@@ -134,85 +378,94 @@ static void send_robot_data()
 static void send_data()
 {
     /* Protocol is NULL, abort */
-    if (!protocol)
+    if (!state()->protocol)
         return;
 
+    /* Get current time */
+    uint64_t now = DS_GetTime();
+
     /* Send FMS packet */
-    if (fms_send_timer.expired) {
+    if (send_due (DS_CHANNEL_FMS, now))
         send_fms_data();
-        DS_TimerReset (&fms_send_timer);
-    }
 
     /* Send radio packet */
-    if (radio_send_timer.expired) {
+    if (send_due (DS_CHANNEL_RADIO, now))
         send_radio_data();
-        DS_TimerReset (&radio_send_timer);
-    }
 
     /* Send robot packet */
-    if (robot_send_timer.expired) {
+    if (send_due (DS_CHANNEL_ROBOT, now))
         send_robot_data();
-        DS_TimerReset (&robot_send_timer);
-    }
-}
-
-/**
- * Clears the strings that hold the incoming data packets
- */
-static void clear_recv_data()
-{
-    DS_FREESTR (fms_data);
-    DS_FREESTR (radio_data);
-    DS_FREESTR (robot_data);
-    DS_FREESTR (netcs_data);
 }
 
 /**
  * Reads the received data using the functions provided by the current protocol.
+ * Every datagram received since the last call is read (in order of arrival).
  * If there is no protocol running, then this function will do nothing.
  */
 static void recv_data()
 {
     /* Protocol is NULL, abort */
-    if (!protocol)
+    if (!state()->protocol)
         return;
 
-    /* Reset the data pointers */
-    clear_recv_data();
+    bstring data = NULL;
 
-    /* Read data from sockets */
-    fms_data = DS_SocketRead (protocol->fms_socket);
-    radio_data = DS_SocketRead (protocol->radio_socket);
-    robot_data = DS_SocketRead (protocol->robot_socket);
-    netcs_data = DS_SocketRead (protocol->netconsole_socket);
+    /* Read FMS packets */
+    while ((data = DS_SocketRead (state()->protocol->fms_socket))) {
+        capture (DS_CAPTURE_FMS, DS_CAPTURE_INBOUND,
+                 data->data, blength (data));
+        int success = state()->protocol->read_fms_packet (data);
 
-    /* Read FMS packet */
-    if (fms_data) {
-        ++received_fms_packets;
-        fms_read = protocol->read_fms_packet (fms_data);
-        CFG_SetFMSCommunications (fms_read);
+        ++state()->received_fms_packets;
+        state()->fms_read |= success;
+        CFG_SetFMSCommunications (success);
+        DS_FREESTR (data);
     }
 
-    /* Read radio packet */
-    if (radio_data) {
-        ++received_radio_packets;
-        radio_read = protocol->read_radio_packet (radio_data);
-        CFG_SetRadioCommunications (radio_read);
-    }
+    /* Read radio packets */
+    while ((data = DS_SocketRead (state()->protocol->radio_socket))) {
+        capture (DS_CAPTURE_RADIO, DS_CAPTURE_INBOUND,
+                 data->data, blength (data));
+        int success = state()->protocol->read_radio_packet (data);
 
-    /* Read robot packet */
-    if (robot_data) {
-        ++received_robot_packets;
-        robot_read = protocol->read_robot_packet (robot_data);
-        CFG_SetRobotCommunications (robot_read);
+        ++state()->received_radio_packets;
+        state()->radio_read |= success;
+        CFG_SetRadioCommunications (success);
+        DS_FREESTR (data);
     }
 
-    /* Add NetConsole message to event system */
-    if (netcs_data)
-        CFG_AddNetConsoleMessage (bstrcpy (netcs_data));
+    /* Read robot packets (and lock on to the first robot that answers),
+     * the source address is only needed while discovering the robot */
+    bstring source = NULL;
+    int discovering = Discovery_Active();
+    DS_Socket* robot_socket = state()->protocol->robot_socket;
+    while ((data = discovering ? DS_SocketReadFrom (robot_socket, &source)
+                               : DS_SocketRead (robot_socket))) {
+        capture (DS_CAPTURE_ROBOT, DS_CAPTURE_INBOUND,
+                 data->data, blength (data));
+        int success = state()->protocol->read_robot_packet (data);
+
+        if (success && discovering) {
+            Discovery_ProbeAnswered (source);
+            discovering = Discovery_Active();
+        }
+
+        ++state()->received_robot_packets;
+        state()->robot_read |= success;
+        CFG_SetRobotCommunications (success);
+        DS_FREESTR (source);
+        DS_FREESTR (data);
+    }
 
-    /* Reset the data pointers */
-    clear_recv_data();
+    /* Add NetConsole messages to event system */
+    int length;
+    char message [DS_SOCKET_SLOT_SIZE];
+    DS_Socket* netconsole_socket = state()->protocol->netconsole_socket;
+    while ((length = DS_SocketReadBuffer (netconsole_socket, message,
+                                          sizeof (message))) >= 0) {
+        capture (DS_CAPTURE_NETCONSOLE, DS_CAPTURE_INBOUND, message, length);
+        CFG_AddNetConsoleMessage (message, length);
+    }
 }
 
 /**
@@ -221,49 +474,66 @@ static void recv_data()
 static void update_watchdogs()
 {
     /* Feed the watchdogs if packets are read */
-    if (fms_read)   DS_TimerReset (&fms_recv_timer);
-    if (radio_read) DS_TimerReset (&radio_recv_timer);
-    if (robot_read) DS_TimerReset (&robot_recv_timer);
+    if (state()->fms_read)   DS_TimerReset (&state()->fms_recv_timer);
+    if (state()->radio_read) DS_TimerReset (&state()->radio_recv_timer);
+    if (state()->robot_read) DS_TimerReset (&state()->robot_recv_timer);
 
     /* Clear the read success values */
-    fms_read = 0;
-    radio_read = 0;
-    robot_read = 0;
+    state()->fms_read = 0;
+    state()->radio_read = 0;
+    state()->robot_read = 0;
 
     /* Reset the FMS if the watchdog expires */
-    if (fms_recv_timer.expired) {
+    if (state()->fms_recv_timer.expired) {
         CFG_FMSWatchdogExpired();
-        DS_TimerReset (&fms_recv_timer);
+        DS_TimerReset (&state()->fms_recv_timer);
     }
 
     /* Reset the radio if the watchdog expires */
-    if (radio_recv_timer.expired) {
+    if (state()->radio_recv_timer.expired) {
         CFG_RadioWatchdogExpired();
-        DS_TimerReset (&radio_recv_timer);
+        DS_TimerReset (&state()->radio_recv_timer);
     }
 
     /* Reset the robot if the watchdog expires */
-    if (robot_recv_timer.expired) {
+    if (state()->robot_recv_timer.expired) {
         CFG_RobotWatchdogExpired();
-        DS_TimerReset (&robot_recv_timer);
+        DS_TimerReset (&state()->robot_recv_timer);
     }
 }
 
 /**
- * This function is executed periodically, the function does the following:
- *    - Send data to the FMS, robot and radio
+ * Runs one iteration of the event loop for the current context:
+ *    - Send data to the FMS, robot and radio (if their deadlines are reached)
  *    - Read received data from the FMS, robot and radio
  *    - Feed/reset the watchdogs
  *    - Check if any of the watchdogs has expired
+ *    - Publish the new state snapshot (if the state changed)
+ */
+static void process_context()
+{
+    send_data();
+    recv_data();
+    update_watchdogs();
+    CFG_PublishState();
+
+    loop_deadline = next_deadline (loop_deadline);
+}
+
+/**
+ * This function is executed periodically and processes every context.
+ *
+ * The loop waits until the sockets module receives data or until the next
+ * send deadline of any context is reached (whichever comes first), deadlines
+ * are absolute times so the send cadence does not drift with the time spent
+ * in each iteration.
  */
 static void* run_event_loop()
 {
     while (running) {
-        send_data();
-        recv_data();
-        update_watchdogs();
-
-        DS_Sleep (5);
+        loop_deadline = DS_GetTime() + LOOP_TIMEOUT * 1000000ULL;
+        Context_ForEach (&process_context);
+        DS_SocketWaitForData (loop_deadline);
     }
 
     pthread_exit (0);
@@ -271,28 +541,19 @@ static void* run_event_loop()
 }
 
 /**
- * Returns a pointer to the current protocol
+ * Returns a pointer to the protocol of the current context
  */
 DS_Protocol* DS_CurrentProtocol()
 {
-    return protocol;
+    DS_ProtocolsState* protocols = state();
+    return protocols ? protocols->protocol : NULL;
 }
 
 /**
- * Initializes the protocol sender/receiver thread and the timers
+ * Starts the protocol event loop, which is shared by all contexts
  */
-void Protocols_Init()
+void Protocols_Start()
 {
-    /* Initialize sender timers */
-    DS_TimerInit (&fms_send_timer,   0, SEND_PRECISION);
-    DS_TimerInit (&radio_send_timer, 0, SEND_PRECISION);
-    DS_TimerInit (&robot_send_timer, 0, SEND_PRECISION);
-
-    /* Initialize watchdog timers */
-    DS_TimerInit (&fms_recv_timer,   0, RECV_PRECISION);
-    DS_TimerInit (&radio_recv_timer, 0, RECV_PRECISION);
-    DS_TimerInit (&robot_recv_timer, 0, RECV_PRECISION);
-
     /* Allow the event loop to run */
     running = 1;
 
@@ -306,53 +567,90 @@ void Protocols_Init()
     }
 }
 
+/**
+ * Stops the protocol event loop
+ */
+void Protocols_Stop()
+{
+    if (running) {
+        running = 0;
+        pthread_join (event_thread, NULL);
+    }
+}
+
+/**
+ * Allocates the protocols state of the current context and initializes its
+ * watchdogs (no protocol is loaded and the send schedules are disabled)
+ */
+void Protocols_Init()
+{
+    Context_SetState (DS_MODULE_PROTOCOLS,
+                      calloc (1, sizeof (DS_ProtocolsState)));
+
+    /* Disable the send schedules */
+    schedule_channel (DS_CHANNEL_FMS, 0);
+    schedule_channel (DS_CHANNEL_RADIO, 0);
+    schedule_channel (DS_CHANNEL_ROBOT, 0);
+
+    /* Initialize watchdog timers */
+    DS_TimerInit (&state()->fms_recv_timer,   0, RECV_PRECISION);
+    DS_TimerInit (&state()->radio_recv_timer, 0, RECV_PRECISION);
+    DS_TimerInit (&state()->robot_recv_timer, 0, RECV_PRECISION);
+}
+
 /**
  * De-allocates the current protocol and closes its sockets
  */
 static void close_protocol()
 {
     /* Protocol is NULL, abort */
-    if (!protocol)
+    if (!state()->protocol)
         return;
 
     /* Close the sockets */
-    DS_SocketClose (protocol->fms_socket);
-    DS_SocketClose (protocol->radio_socket);
-    DS_SocketClose (protocol->robot_socket);
-    DS_SocketClose (protocol->netconsole_socket);
+    DS_SocketClose (state()->protocol->fms_socket);
+    DS_SocketClose (state()->protocol->radio_socket);
+    DS_SocketClose (state()->protocol->robot_socket);
+    DS_SocketClose (state()->protocol->netconsole_socket);
 
-    /* Stop sender timers */
-    DS_TimerStop (&fms_send_timer);
-    DS_TimerStop (&radio_send_timer);
-    DS_TimerStop (&robot_send_timer);
+    /* Stop sending packets */
+    schedule_channel (DS_CHANNEL_FMS, 0);
+    schedule_channel (DS_CHANNEL_RADIO, 0);
+    schedule_channel (DS_CHANNEL_ROBOT, 0);
 
     /* Stop receiver timers */
-    DS_TimerStop (&fms_recv_timer);
-    DS_TimerStop (&radio_recv_timer);
-    DS_TimerStop (&robot_recv_timer);
+    DS_TimerStop (&state()->fms_recv_timer);
+    DS_TimerStop (&state()->radio_recv_timer);
+    DS_TimerStop (&state()->robot_recv_timer);
 
     /* Delete sockets */
-    DS_FREE (protocol->fms_socket);
-    DS_FREE (protocol->radio_socket);
-    DS_FREE (protocol->robot_socket);
-    DS_FREE (protocol->netconsole_socket);
+    DS_FREE (state()->protocol->fms_socket);
+    DS_FREE (state()->protocol->radio_socket);
+    DS_FREE (state()->protocol->robot_socket);
+    DS_FREE (state()->protocol->netconsole_socket);
 
     /* De-allocate the protocol */
-    DS_FREE (protocol);
+    DS_FREE (state()->protocol->data);
+    DS_FREE (state()->protocol);
 }
 
 /**
- * Stops the sender/receiver thread and deletes the allocated protocol
+ * Deletes the protocol of the current context and de-allocates the
+ * protocols state of the context
  */
 void Protocols_Close()
 {
-    running = 0;
     close_protocol();
-    DS_StopThread (event_thread);
+    DS_StopCapture();
+
+    free (state());
+    Context_SetState (DS_MODULE_PROTOCOLS, NULL);
 }
 
 /**
- * De-allocates the current protocol and loads the given protocol
+ * De-allocates the current protocol and loads the given protocol.
+ * The event loop is paused while the protocols are replaced, so that it
+ * never uses the sockets or data of the old protocol after they are freed.
  *
  * \param ptr pointer to the new protocol implementation to load
  */
@@ -362,11 +660,22 @@ void DS_ConfigureProtocol (DS_Protocol* ptr)
     if (!ptr)
         return;
 
+    Context_Lock();
+
     /* Close previous protocol */
     close_protocol();
 
     /* Re-assign the protocol */
-    protocol = ptr;
+    state()->protocol = ptr;
+    Discovery_Reset();
+
+    /* Sequence numbers of the old protocol are meaningless now */
+    DS_ResetLatencyStats (DS_CHANNEL_FMS);
+    DS_ResetLatencyStats (DS_CHANNEL_RADIO);
+    DS_ResetLatencyStats (DS_CHANNEL_ROBOT);
+    DS_ResetLossStats (DS_CHANNEL_FMS);
+    DS_ResetLossStats (DS_CHANNEL_RADIO);
+    DS_ResetLossStats (DS_CHANNEL_ROBOT);
 
     /* Update sockets */
     DS_SocketOpen (ptr->fms_socket);
@@ -374,28 +683,25 @@ void DS_ConfigureProtocol (DS_Protocol* ptr)
     DS_SocketOpen (ptr->robot_socket);
     DS_SocketOpen (ptr->netconsole_socket);
 
-    /* Update sender timers */
-    fms_send_timer.time = ptr->fms_interval;
-    radio_send_timer.time = ptr->radio_interval;
-    robot_send_timer.time = ptr->robot_interval;
-
     /* Update watchdogs */
-    fms_recv_timer.time = DS_Min (ptr->fms_interval * 50, 1000);
-    radio_recv_timer.time = DS_Min (ptr->radio_interval * 50, 1000);
-    robot_recv_timer.time = DS_Min (ptr->robot_interval * 50, 1000);
-
-    /* Start the timers */
-    DS_TimerStart (&fms_send_timer);
-    DS_TimerStart (&fms_recv_timer);
-    DS_TimerStart (&radio_send_timer);
-    DS_TimerStart (&radio_recv_timer);
-    DS_TimerStart (&robot_send_timer);
-    DS_TimerStart (&robot_recv_timer);
+    state()->fms_recv_timer.time = DS_Min (ptr->fms_interval * 50, 1000);
+    state()->radio_recv_timer.time = DS_Min (ptr->radio_interval * 50, 1000);
+    state()->robot_recv_timer.time = DS_Min (ptr->robot_interval * 50, 1000);
+
+    /* Start the watchdogs */
+    DS_TimerStart (&state()->fms_recv_timer);
+    DS_TimerStart (&state()->radio_recv_timer);
+    DS_TimerStart (&state()->robot_recv_timer);
+
+    /* Start the send schedules */
+    schedule_channel (DS_CHANNEL_FMS, ptr->fms_interval);
+    schedule_channel (DS_CHANNEL_RADIO, ptr->radio_interval);
+    schedule_channel (DS_CHANNEL_ROBOT, ptr->robot_interval);
+
+    Context_Unlock();
 
     /* Notify application of protocol change */
-    char* name = bstr2cstr (ptr->name, 0);
-    CFG_AddNotification (bformat ("%s loaded", name));
-    DS_FREE (name);
+    CFG_AddNotification ("%s loaded", bdata (ptr->name));
 }
 
 /**
@@ -403,7 +709,7 @@ void DS_ConfigureProtocol (DS_Protocol* ptr)
  */
 int DS_SentFMSPackets()
 {
-    return DS_Max (1, sent_fms_packets);
+    return DS_Max (1, state()->sent_fms_packets);
 }
 
 /**
@@ -411,7 +717,7 @@ int DS_SentFMSPackets()
  */
 int DS_SentRadioPackets()
 {
-    return DS_Max (1, sent_radio_packets);
+    return DS_Max (1, state()->sent_radio_packets);
 }
 
 /**
@@ -419,7 +725,7 @@ int DS_SentRadioPackets()
  */
 int DS_SentRobotPackets()
 {
-    return DS_Max (1, sent_robot_packets);
+    return DS_Max (1, state()->sent_robot_packets);
 }
 
 /**
@@ -427,7 +733,7 @@ int DS_SentRobotPackets()
  */
 int DS_ReceivedFMSPackets()
 {
-    return received_fms_packets;
+    return state()->received_fms_packets;
 }
 
 /**
@@ -435,7 +741,7 @@ int DS_ReceivedFMSPackets()
  */
 int DS_ReceivedRadioPackets()
 {
-    return received_radio_packets;
+    return state()->received_radio_packets;
 }
 
 /**
@@ -443,7 +749,7 @@ int DS_ReceivedRadioPackets()
  */
 int DS_ReceivedRobotPackets()
 {
-    return received_robot_packets;
+    return state()->received_robot_packets;
 }
 
 /**
@@ -452,8 +758,8 @@ int DS_ReceivedRobotPackets()
  */
 void DS_ResetFMSPackets()
 {
-    sent_fms_packets = 0;
-    received_fms_packets = 0;
+    state()->sent_fms_packets = 0;
+    state()->received_fms_packets = 0;
 }
 
 /**
@@ -462,8 +768,8 @@ void DS_ResetFMSPackets()
  */
 void DS_ResetRadioPackets()
 {
-    sent_radio_packets = 0;
-    received_radio_packets = 0;
+    state()->sent_radio_packets = 0;
+    state()->received_radio_packets = 0;
 }
 
 /**
@@ -472,6 +778,356 @@ void DS_ResetRadioPackets()
  */
 void DS_ResetRobotPackets()
 {
-    sent_robot_packets = 0;
-    received_robot_packets = 0;
+    state()->sent_robot_packets = 0;
+    state()->received_robot_packets = 0;
+}
+
+/**
+ * Returns the send timing statistics of the given \a channel, which can be
+ * used to verify that packets are being sent at the protocol interval
+ */
+DS_SendStats DS_GetSendStats (const DS_Channel channel)
+{
+    pthread_mutex_lock (&channels_lock);
+
+    DS_SendChannel* ch = &state()->channels [channel];
+    DS_SendStats stats = ch->stats;
+
+    if (stats.sent > 0) {
+        double mean = ch->jitter_sum / stats.sent;
+        double variance = (ch->jitter_sq_sum / stats.sent) - (mean * mean);
+
+        stats.mean_jitter = mean;
+        stats.stddev_jitter = sqrt (fmax (variance, 0));
+    }
+
+    pthread_mutex_unlock (&channels_lock);
+    return stats;
+}
+
+/**
+ * Resets the send timing statistics of the given \a channel
+ */
+void DS_ResetSendStats (const DS_Channel channel)
+{
+    pthread_mutex_lock (&channels_lock);
+
+    state()->channels [channel].jitter_sum = 0;
+    state()->channels [channel].jitter_sq_sum = 0;
+    memset (&state()->channels [channel].stats, 0, sizeof (DS_SendStats));
+
+    pthread_mutex_unlock (&channels_lock);
+}
+
+/**
+ * Compares two RTT samples, used to sort them with \c qsort()
+ */
+static int compare_samples (const void* a, const void* b)
+{
+    double x = *((const double*) a);
+    double y = *((const double*) b);
+    return (x > y) - (x < y);
+}
+
+/**
+ * Registers the send time of the packet with the given sequence \a index.
+ * Protocols call this function when generating a packet that the remote
+ * peer echoes back (the packet is sent right after being generated).
+ *
+ * \param channel the channel used to send the packet
+ * \param index the sequence number of the packet (only 16 bits are used)
+ */
+void DS_PacketSent (const DS_Channel channel, const unsigned int index)
+{
+    unsigned int seq = index & 0xffff;
+    DS_LatencyChannel* ch = &state()->latency [channel];
+
+    pthread_mutex_lock (&latency_lock);
+
+    ch->sent_index [seq % LATENCY_SLOTS] = seq;
+    ch->sent_time [seq % LATENCY_SLOTS] = DS_GetTime();
+
+    pthread_mutex_unlock (&latency_lock);
+}
+
+/**
+ * Returns the time slice of the given loss \a window that corresponds to
+ * the current time, the slice is cleared if it belongs to an old window
+ */
+static DS_LossBucket* current_bucket (DS_LossWindow* window)
+{
+    uint64_t epoch = DS_GetTime() / (LOSS_BUCKET_TIME * 1000000ULL);
+    DS_LossBucket* bucket = &window->buckets [epoch % LOSS_BUCKETS];
+
+    if (bucket->epoch != epoch) {
+        memset (bucket, 0, sizeof (DS_LossBucket));
+        bucket->epoch = epoch;
+    }
+
+    return bucket;
+}
+
+/**
+ * Updates the loss \a window with a received sequence \a index:
+ *    - A jump forward of more than one number is a burst of lost packets
+ *    - A jump backwards is a late (reordered) packet, which was counted as
+ *      lost when the gap was found, so it is subtracted from the losses of
+ *      the slice that counted it (if that slice is still in the window)
+ *    - Repeated numbers (duplicates) and packets older than the last
+ *      \c LOSS_HISTORY numbers are ignored
+ *    - Very large jumps (peer restarted or sequence reset) re-sync the window
+ */
+static void update_loss (DS_LossWindow* window, const unsigned int index)
+{
+    unsigned int seq = index & 0xffff;
+
+    pthread_mutex_lock (&loss_lock);
+
+    DS_LossBucket* bucket = current_bucket (window);
+    unsigned int gap = (seq - window->highest) & 0xffff;
+
+    /* First packet or peer restart, start counting from here */
+    if (!window->synced || (gap > LOSS_MAX_GAP && gap < 0x10000 - LOSS_MAX_GAP)) {
+        window->synced = 1;
+        window->highest = seq;
+        window->received = 1;
+        bucket->expected += 1;
+    }
+
+    /* Packet is newer than the last one, check for lost packets */
+    else if (gap > 0 && gap < 0x8000) {
+        long lost = gap - 1;
+
+        if (lost > 0) {
+            bucket->lost += lost;
+            bucket->bursts += 1;
+            bucket->max_burst = DS_Max (bucket->max_burst, lost);
+        }
+
+        /* Remember which slice counted each missing number */
+        unsigned int i;
+        for (i = 1; i < gap && i <= LOSS_HISTORY; ++i)
+            window->charged [(seq - i) % LOSS_HISTORY] = bucket->epoch;
+
+        if (gap >= LOSS_HISTORY)
+            window->received = 1;
+        else
+            window->received = (window->received << gap) | 1;
+
+        window->highest = seq;
+        bucket->expected += gap;
+    }
+
+    /* Packet is older than the last one, it was not lost after all */
+    else if (gap > 0) {
+        unsigned int age = (window->highest - seq) & 0xffff;
+
+        if (age < LOSS_HISTORY && !(window->received & (1ULL << age))) {
+            uint64_t epoch = window->charged [seq % LOSS_HISTORY];
+            DS_LossBucket* charged = &window->buckets [epoch % LOSS_BUCKETS];
+
+            if (charged->epoch == epoch)
+                charged->lost -= 1;
+
+            window->received |= (1ULL << age);
+            bucket->reordered += 1;
+        }
+    }
+
+    pthread_mutex_unlock (&loss_lock);
+}
+
+/**
+ * Adds the time slices of the given loss \a window that are still in the
+ * sliding window and calculates its loss statistics
+ */
+static DS_LossStats get_loss (DS_LossWindow* window)
+{
+    int i;
+    DS_LossStats stats;
+    long expected = 0, lost = 0, reordered = 0, bursts = 0, max_burst = 0;
+    uint64_t epoch = DS_GetTime() / (LOSS_BUCKET_TIME * 1000000ULL);
+
+    memset (&stats, 0, sizeof (DS_LossStats));
+
+    pthread_mutex_lock (&loss_lock);
+
+    for (i = 0; i < LOSS_BUCKETS; ++i) {
+        DS_LossBucket* bucket = &window->buckets [i];
+
+        if (bucket->epoch + LOSS_BUCKETS > epoch) {
+            lost += bucket->lost;
+            bursts += bucket->bursts;
+            expected += bucket->expected;
+            reordered += bucket->reordered;
+            max_burst = DS_Max (max_burst, bucket->max_burst);
+        }
+    }
+
+    pthread_mutex_unlock (&loss_lock);
+
+    stats.lost = lost;
+    stats.bursts = bursts;
+    stats.expected = expected;
+    stats.reordered = reordered;
+    stats.max_burst = max_burst;
+
+    if (bursts > 0)
+        stats.mean_burst = (double) lost / bursts;
+
+    if (expected > 0)
+        stats.loss = (double) lost * 100 / expected;
+
+    return stats;
+}
+
+/**
+ * Matches the echoed sequence \a index with the send time of the original
+ * packet and adds a new RTT sample. Unknown, duplicated or too old sequence
+ * numbers are ignored.
+ *
+ * \param channel the channel that received the echo
+ * \param index the sequence number echoed by the remote peer
+ */
+void DS_PacketEchoed (const DS_Channel channel, const unsigned int index)
+{
+    uint64_t now = DS_GetTime();
+    unsigned int seq = index & 0xffff;
+    unsigned int slot = seq % LATENCY_SLOTS;
+    DS_LatencyChannel* ch = &state()->latency [channel];
+
+    update_loss (&state()->uplink [channel], seq);
+    pthread_mutex_lock (&latency_lock);
+
+    if (ch->sent_time [slot] > 0 && ch->sent_index [slot] == seq) {
+        double rtt = (now - ch->sent_time [slot]) / 1000000.0;
+        ch->samples [ch->count % LATENCY_SAMPLES] = rtt;
+        ch->sent_time [slot] = 0;
+        ++ch->count;
+    }
+
+    pthread_mutex_unlock (&latency_lock);
+}
+
+/**
+ * Registers the reception of a packet with the given sequence \a index.
+ * Protocols call this function when the remote peer numbers its packets,
+ * gaps in the sequence numbers are used to calculate the downlink loss.
+ *
+ * \param channel the channel that received the packet
+ * \param index the sequence number of the packet (only 16 bits are used)
+ */
+void DS_PacketReceived (const DS_Channel channel, const unsigned int index)
+{
+    update_loss (&state()->downlink [channel], index);
+}
+
+/**
+ * Returns the round-trip latency statistics of the given \a channel,
+ * calculated from its most recent RTT samples. If the protocol does not
+ * echo packets on the channel, then every value will be \c 0.
+ */
+DS_LatencyStats DS_GetLatencyStats (const DS_Channel channel)
+{
+    unsigned long i;
+    DS_LatencyStats stats;
+    double samples [LATENCY_SAMPLES];
+
+    memset (&stats, 0, sizeof (DS_LatencyStats));
+
+    pthread_mutex_lock (&latency_lock);
+    stats.samples = DS_Min (state()->latency [channel].count, LATENCY_SAMPLES);
+    memcpy (samples, state()->latency [channel].samples, sizeof (samples));
+    pthread_mutex_unlock (&latency_lock);
+
+    if (stats.samples == 0)
+        return stats;
+
+    qsort (samples, stats.samples, sizeof (double), &compare_samples);
+
+    for (i = 0; i < stats.samples; ++i)
+        stats.mean += samples [i];
+
+    stats.min = samples [0];
+    stats.mean /= stats.samples;
+    stats.p50 = samples [(unsigned long) ceil (stats.samples * 0.50) - 1];
+    stats.p99 = samples [(unsigned long) ceil (stats.samples * 0.99) - 1];
+
+    return stats;
+}
+
+/**
+ * Resets the round-trip latency statistics of the given \a channel and
+ * forgets about the packets that are waiting to be echoed
+ */
+void DS_ResetLatencyStats (const DS_Channel channel)
+{
+    pthread_mutex_lock (&latency_lock);
+    memset (&state()->latency [channel], 0, sizeof (DS_LatencyChannel));
+    pthread_mutex_unlock (&latency_lock);
+}
+
+/**
+ * Returns the uplink (client to peer) packet loss of the given \a channel
+ * over the last five seconds. The uplink loss is calculated from the
+ * sequence numbers echoed by the peer, so lost echoes are also counted.
+ */
+DS_LossStats DS_GetUplinkLoss (const DS_Channel channel)
+{
+    return get_loss (&state()->uplink [channel]);
+}
+
+/**
+ * Returns the downlink (peer to client) packet loss of the given \a channel
+ * over the last five seconds, calculated from the sequence numbers of the
+ * packets sent by the peer
+ */
+DS_LossStats DS_GetDownlinkLoss (const DS_Channel channel)
+{
+    return get_loss (&state()->downlink [channel]);
+}
+
+/**
+ * Clears the uplink and downlink loss windows of the given \a channel
+ */
+void DS_ResetLossStats (const DS_Channel channel)
+{
+    pthread_mutex_lock (&loss_lock);
+    memset (&state()->uplink [channel], 0, sizeof (DS_LossWindow));
+    memset (&state()->downlink [channel], 0, sizeof (DS_LossWindow));
+    pthread_mutex_unlock (&loss_lock);
+}
+
+/**
+ * Writes every datagram sent or received by the current context to the
+ * capture file at the given \a path (an existing file is replaced).
+ * A capture that was already running is stopped first.
+ *
+ * \returns \c 1 if the capture was started, \c 0 on failure
+ */
+int DS_StartCapture (const char* path)
+{
+    DS_StopCapture();
+
+    DS_Capture* file = DS_CaptureOpen (path);
+    if (!file)
+        return 0;
+
+    pthread_mutex_lock (&capture_lock);
+    atomic_store (&state()->capture, file);
+    pthread_mutex_unlock (&capture_lock);
+
+    return 1;
+}
+
+/**
+ * Stops the packet capture of the current context and closes the capture file
+ */
+void DS_StopCapture()
+{
+    pthread_mutex_lock (&capture_lock);
+    DS_Capture* file = atomic_exchange (&state()->capture, NULL);
+    pthread_mutex_unlock (&capture_lock);
+
+    DS_CaptureClose (file);
 }
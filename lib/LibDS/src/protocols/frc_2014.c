@@ -21,14 +21,14 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include <math.h>
-
 #include "DS_Utils.h"
 #include "DS_Config.h"
 #include "DS_Protocol.h"
 #include "DS_Joysticks.h"
 #include "DS_DefaultProtocols.h"
 
+#include <string.h>
+
 /*
  * Protocol bytes
  */
@@ -49,11 +49,6 @@ static const uint8_t cAllianceBlue     = 0x42;
 static const uint8_t cFMSAutonomous    = 0x53;
 static const uint8_t cFMSTeleoperated  = 0x43;
 
-/*
- * Sent robot acket counters, they are used as packet IDs
- */
-static unsigned int sent_robot_packets = 0;
-
 /*
  * Joystick properties
  */
@@ -63,11 +58,31 @@ static int max_buttons = 10;
 static int max_joysticks = 4;
 
 /*
- * Control code flags
+ * Robot packet layout
+ */
+#define PACKET_SIZE     1024 /* Size of a robot packet */
+#define VERSION_OFFSET  72   /* Offset of the DS version */
+#define CHECKSUM_OFFSET 1020 /* Offset of the CRC32 checksum */
+
+/**
+ * Holds the state of a protocol instance (each context has its own)
  */
-static int resync = 0;
-static int reboot = 0;
-static int restart_code = 0;
+typedef struct _frc_2014_state {
+    unsigned int sent_robot_packets;    /**< Sent robot packets (packet ID) */
+    int resync;                         /**< Set to resync with the robot */
+    int reboot;                         /**< Set to reboot the robot */
+    int restart_code;                   /**< Set to restart the robot code */
+    uint8_t robot_packet [PACKET_SIZE]; /**< Last robot packet (no CRC) */
+    uint32_t robot_checksum;            /**< Checksum of the last packet */
+} DS_FRC2014State;
+
+/**
+ * Returns the state of the protocol instance used by the current context
+ */
+static DS_FRC2014State* state()
+{
+    return (DS_FRC2014State*) DS_CurrentProtocol()->data;
+}
 
 /**
  * Gets the alliance type from the received \a byte
@@ -132,7 +147,7 @@ static uint8_t get_control_code()
     }
 
     /* Resync robot communications */
-    if (resync)
+    if (state()->resync)
         code |= cResyncComms;
 
     /* Let robot know if we are connected to FMS */
@@ -144,7 +159,7 @@ static uint8_t get_control_code()
         code = cEmergencyStopOn;
 
     /* Send the reboot code if required */
-    if (reboot)
+    if (state()->reboot)
         code = cRebootRobot;
 
     return code;
@@ -194,8 +209,7 @@ static uint8_t get_digital_inputs()
 }
 
 /**
- * Adds joystick information to a DS-to-robot packet, beginning at the given
- * \a offset in the data packet.
+ * Adds joystick information to the given DS-to-robot \a packet.
  *
  * The 2014 communication protocol records the data for all four joysticks,
  * if a joystick or joystick member is not present, we will send a neutral
@@ -207,30 +221,26 @@ static uint8_t get_digital_inputs()
  * Button states are stored in a similar way as enumerated flags in a C/C++
  * program.
  */
-static bstring get_joystick_data()
+static void add_joystick_data (DS_Packet* packet)
 {
     /* Initialize variables */
     int i = 0;
     int j = 0;
-    bstring buf = bfromcstr ("");
 
     /* Add data for every joystick */
     for (i = 0; i < max_joysticks; ++i) {
         /* Add axis data */
         for (j = 0; j < max_axes; ++j)
-            bconchar (buf, DS_GetFByte (DS_GetJoystickAxis (i, j), 1));
+            DS_PacketAppend (packet, DS_GetFByte (DS_GetJoystickAxis (i, j), 1));
 
         /* Generate button data */
-        uint16_t button_flags = 0;
-        for (j = 0; j < max_buttons; ++j)
-            button_flags += DS_GetJoystickButton (i, j) ? pow (2, j) : 0;
+        uint16_t button_flags = DS_GetJoystickButtons (i)
+                                & ((1 << max_buttons) - 1);
 
         /* Add button data */
-        bconchar (buf, (button_flags & 0xff00) >> 8);
-        bconchar (buf, (button_flags & 0xff));
+        DS_PacketAppend (packet, (button_flags & 0xff00) >> 8);
+        DS_PacketAppend (packet, (button_flags & 0xff));
     }
-
-    return buf;
 }
 
 /**
@@ -261,17 +271,17 @@ static bstring robot_address()
 /**
  * Generates an empty (ignored) FMS packet.
  */
-static bstring create_fms_packet()
+static void create_fms_packet (DS_Packet* packet)
 {
-    return bfromcstr ("");
+    (void) packet;
 }
 
 /**
  * Generates an empty (ignored) radio packet.
  */
-static bstring create_radio_packet()
+static void create_radio_packet (DS_Packet* packet)
 {
-    return bfromcstr ("");
+    (void) packet;
 }
 
 /**
@@ -285,56 +295,71 @@ static bstring create_radio_packet()
  *     - (Number?) of digital inputs
  *     - The version of the FRC Driver Station
  *     - The CRC32 checksum of the packet
+ *
+ * Most of the packet never changes, so the last packet is kept and only the
+ * bytes that changed are used to update its checksum.
  */
-static bstring create_robot_packet()
+static void create_robot_packet (DS_Packet* packet)
 {
-    /* Create initial packet */
-    bstring data = DS_GetEmptyString (8);
+    int i = 0;
+    int first = -1;
+    int last = -1;
+    uint8_t* previous = state()->robot_packet;
 
     /* Add packet index */
-    bSetChar (data, 0, (sent_robot_packets & 0xff00) >> 8);
-    bSetChar (data, 1, (sent_robot_packets & 0xff));
+    DS_PacketAppend (packet, (state()->sent_robot_packets & 0xff00) >> 8);
+    DS_PacketAppend (packet, (state()->sent_robot_packets & 0xff));
 
     /* Add control code and digital inputs */
-    bSetChar (data, 2, get_control_code());
-    bSetChar (data, 3,  get_digital_inputs());
+    DS_PacketAppend (packet, get_control_code());
+    DS_PacketAppend (packet, get_digital_inputs());
 
     /* Add team number */
-    bSetChar (data, 4, (CFG_GetTeamNumber() & 0xff00) >> 8);
-    bSetChar (data, 5, (CFG_GetTeamNumber() & 0xff));
+    DS_PacketAppend (packet, (CFG_GetTeamNumber() & 0xff00) >> 8);
+    DS_PacketAppend (packet, (CFG_GetTeamNumber() & 0xff));
 
     /* Add alliance and position */
-    bSetChar (data, 6, get_alliance_code());
-    bSetChar (data, 7, get_position_code());
+    DS_PacketAppend (packet, get_alliance_code());
+    DS_PacketAppend (packet, get_position_code());
 
     /* Add joystick data */
-    bconcat (data, get_joystick_data());
+    add_joystick_data (packet);
 
-    /* Now resize the datagram to 1024 bytes */
-    balloc (data, 1024);
+    /* Find the bytes that changed since the last packet */
+    for (i = 0; i < packet->length; ++i) {
+        if (packet->data [i] != previous [i]) {
+            if (first < 0)
+                first = i;
 
-    /* Add FRC Driver Station version (same as the one sent by 16.0.1) */
-    bSetChar (data, 72, (uint8_t) 0x30);
-    bSetChar (data, 73, (uint8_t) 0x34);
-    bSetChar (data, 74, (uint8_t) 0x30);
-    bSetChar (data, 75, (uint8_t) 0x31);
-    bSetChar (data, 76, (uint8_t) 0x31);
-    bSetChar (data, 77, (uint8_t) 0x36);
-    bSetChar (data, 78, (uint8_t) 0x30);
-    bSetChar (data, 79, (uint8_t) 0x30);
+            last = i;
+        }
+    }
+
+    /* Update the checksum with the changed bytes only */
+    if (first >= 0) {
+        int span = last - first + 1;
+        state()->robot_checksum = DS_CRC32Patch (state()->robot_checksum,
+                                                 previous + first,
+                                                 packet->data + first,
+                                                 span, PACKET_SIZE - last - 1);
+        memcpy (previous + first, packet->data + first, span);
+    }
+
+    /* Copy the constant part of the packet (padding and DS version) */
+    memcpy (packet->data + packet->length,
+            previous + packet->length,
+            PACKET_SIZE - packet->length);
+    packet->length = PACKET_SIZE;
 
     /* Add CRC32 checksum */
-    uint32_t checksum = DS_CRC32 (data, sizeof (data));
-    bSetChar (data, 1020, (checksum & 0xff000000) >> 24);
-    bSetChar (data, 1021, (checksum & 0xff0000) >> 16);
-    bSetChar (data, 1022, (checksum & 0xff00) >> 8);
-    bSetChar (data, 1023, (checksum & 0xff));
+    uint32_t checksum = state()->robot_checksum;
+    packet->data [CHECKSUM_OFFSET + 0] = (checksum & 0xff000000) >> 24;
+    packet->data [CHECKSUM_OFFSET + 1] = (checksum & 0xff0000) >> 16;
+    packet->data [CHECKSUM_OFFSET + 2] = (checksum & 0xff00) >> 8;
+    packet->data [CHECKSUM_OFFSET + 3] = (checksum & 0xff);
 
     /* Increase sent robot packets */
-    ++sent_robot_packets;
-
-    /* Return address of data */
-    return data;
+    ++state()->sent_robot_packets;
 }
 
 /**
@@ -437,9 +462,9 @@ static void reset_radio()
  */
 static void reset_robot()
 {
-    resync = 1;
-    reboot = 0;
-    restart_code = 0;
+    state()->resync = 1;
+    state()->reboot = 0;
+    state()->restart_code = 0;
 }
 
 /**
@@ -448,7 +473,7 @@ static void reset_robot()
  */
 static void reboot_robot()
 {
-    reboot = 1;
+    state()->reboot = 1;
 }
 
 /**
@@ -457,7 +482,24 @@ static void reboot_robot()
  */
 void restart_robot_code()
 {
-    restart_code = 1;
+    state()->restart_code = 1;
+}
+
+/**
+ * Generates the constant part of the robot packets (zero padding, DS version
+ * and a zero checksum) and calculates its checksum, which is then updated as
+ * the packet data changes
+ */
+static void init_robot_packet (DS_FRC2014State* ptr)
+{
+    /* FRC Driver Station version (same as the one sent by 16.0.1) */
+    static const uint8_t version [8] = {
+        0x30, 0x34, 0x30, 0x31, 0x31, 0x36, 0x30, 0x30
+    };
+
+    memset (ptr->robot_packet, 0, PACKET_SIZE);
+    memcpy (ptr->robot_packet + VERSION_OFFSET, version, sizeof (version));
+    ptr->robot_checksum = DS_CRC32 (ptr->robot_packet, PACKET_SIZE);
 }
 
 /**
@@ -471,6 +513,10 @@ DS_Protocol* DS_GetProtocolFRC_2014()
     /* Set protocol name */
     protocol->name = bfromcstr ("FRC 2014 Communication Protocol");
 
+    /* Allocate protocol state */
+    protocol->data = calloc (1, sizeof (DS_FRC2014State));
+    init_robot_packet ((DS_FRC2014State*) protocol->data);
+
     /* Set address functions */
     protocol->fms_address = &fms_address;
     protocol->radio_address = &radio_address;
@@ -28,7 +28,6 @@
 #include "DS_DefaultProtocols.h"
 
 #include <time.h>
-#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -71,17 +70,41 @@ static const uint8_t cRequestTime        = 0x01;
 static const uint8_t cRobotHasCode       = 0x20;
 
 /*
- * Sent robot and FMS packet counters
+ * Joystick block cache properties
  */
-static unsigned int send_time_data = 0;
-static unsigned int sent_fms_packets = 0;
-static unsigned int sent_robot_packets = 0;
+#define CACHED_JOYSTICKS 6  /* Number of joysticks with a cached block */
+#define JOYSTICK_BLOCK   64 /* Capacity of a cached joystick block */
 
-/*
- * Control code flags
+/**
+ * Holds the encoded data of a joystick, which is only encoded again when the
+ * joystick version (or the enabled state of the robot) changes
+ */
+typedef struct _frc_2015_joystick {
+    unsigned int version;          /**< Encoded joystick version, 0 = none */
+    int enabled;                   /**< Robot enabled state when encoded */
+    int length;                    /**< Length of the encoded data */
+    uint8_t data [JOYSTICK_BLOCK]; /**< Encoded joystick data */
+} DS_FRC2015Joystick;
+
+/**
+ * Holds the state of a protocol instance (each context has its own)
  */
-static int reboot = 0;
-static int restart_code = 0;
+typedef struct _frc_2015_state {
+    unsigned int send_time_data;     /**< Set if the robot wants the time */
+    unsigned int sent_fms_packets;   /**< Sent FMS packets (packet ID) */
+    unsigned int sent_robot_packets; /**< Sent robot packets (packet ID) */
+    int reboot;                      /**< Set to reboot the robot */
+    int restart_code;                /**< Set to restart the robot code */
+    DS_FRC2015Joystick joysticks [CACHED_JOYSTICKS]; /**< Joystick blocks */
+} DS_FRC2015State;
+
+/**
+ * Returns the state of the protocol instance used by the current context
+ */
+static DS_FRC2015State* state()
+{
+    return (DS_FRC2015State*) DS_CurrentProtocol()->data;
+}
 
 /**
  * Obtains the voltage float from the given \a upper and \a lower bytes
@@ -205,9 +228,9 @@ static uint8_t get_request_code()
 
     /* Robot has comms, check if we need to send additional flags */
     if (CFG_GetRobotCommunications()) {
-        if (reboot)
+        if (state()->reboot)
             code = cRequestReboot;
-        else if (restart_code)
+        else if (state()->restart_code)
             code = cRequestRestartCode;
     }
 
@@ -257,7 +280,7 @@ static uint8_t get_station_code()
  * joystick data (which is sent to the robot) and to resize the client->robot
  * datagram automatically.
  */
-static uint8_t get_joystick_size (const int joystick)
+static int get_joystick_size (const int joystick)
 {
     int header_size = 2;
     int button_data = 3;
@@ -268,16 +291,56 @@ static uint8_t get_joystick_size (const int joystick)
 }
 
 /**
- * Returns information regarding the current date and time and the timezone
- * of the client computer.
+ * Writes the joystick information structure of the given \a joystick in the
+ * given \a data buffer, which must be able to hold the joystick size.
+ *
+ * \returns the number of bytes written
+ */
+static int encode_joystick (const int joystick, uint8_t* data)
+{
+    int j = 0;
+    int length = 0;
+    int num_axes = DS_GetJoystickNumAxes (joystick);
+    int num_hats = DS_GetJoystickNumHats (joystick);
+    int num_buttons = DS_GetJoystickNumButtons (joystick);
+
+    /* Add joystick header */
+    data [length++] = get_joystick_size (joystick);
+    data [length++] = cTagJoystick;
+
+    /* Add axis data */
+    data [length++] = num_axes;
+    for (j = 0; j < num_axes; ++j)
+        data [length++] = DS_GetFByte (DS_GetJoystickAxis (joystick, j), 1);
+
+    /* Generate button data (only the first 16 buttons are sent) */
+    uint16_t button_flags = DS_GetJoystickButtons (joystick) & 0xffff;
+
+    /* Add button data */
+    data [length++] = num_buttons;
+    data [length++] = (button_flags & 0xff00) >> 8;
+    data [length++] = (button_flags & 0xff);
+
+    /* Add hat data */
+    data [length++] = num_hats;
+    for (j = 0; j < num_hats; ++j) {
+        int hat = DS_GetJoystickHat (joystick, j);
+        data [length++] = (hat & 0xff00) >> 8;
+        data [length++] = (hat & 0xff);
+    }
+
+    return length;
+}
+
+/**
+ * Adds information regarding the current date and time and the timezone
+ * of the client computer to the given \a packet.
  *
  * The robot may ask for this information in some cases (e.g. when initializing
  * the robot code).
  */
-static bstring get_timezone_data()
+static void add_timezone_data (DS_Packet* packet)
 {
-    bstring data = DS_GetEmptyString (14);
-
     /* Get current time */
     time_t rt = 0;
     uint32_t ms = 0;
@@ -289,89 +352,79 @@ static bstring get_timezone_data()
     GetTimeZoneInformation (&info);
 
     /* Convert the wchar to a standard string */
-    char* str = malloc (wcslen (info.StandardName));
-    wcstombs (str, info.StandardName, wcslen (info.StandardName));
-
-    /* Convert the obtained cstring to a bstring */
-    bstring tz = bfromcstr (str);
-    free (str);
+    char tz [64] = {0};
+    wcstombs (tz, info.StandardName, sizeof (tz) - 1);
 
     /* Get milliseconds */
     GetSystemTime (&info.StandardDate);
     ms = (uint32_t) info.StandardDate.wMilliseconds;
 #else
     /* Timezone is stored directly in time_t structure */
-    bstring tz = bfromcstr (timeinfo->tm_zone);
+    const char* tz = timeinfo->tm_zone;
 #endif
 
     /* Encode date/time in datagram */
-    bSetChar (data, 0,  (uint8_t) 0x0b);
-    bSetChar (data, 1,  (uint8_t) cTagDate);
-    bSetChar (data, 2,  (uint8_t) (ms & 0xff000000) >> 24);
-    bSetChar (data, 3,  (uint8_t) (ms & 0xff0000) >> 16);
-    bSetChar (data, 4,  (uint8_t) (ms & 0xff00) >> 8);
-    bSetChar (data, 5,  (uint8_t) (ms & 0xff));
-    bSetChar (data, 6,  (uint8_t) timeinfo->tm_sec);
-    bSetChar (data, 7,  (uint8_t) timeinfo->tm_min);
-    bSetChar (data, 8,  (uint8_t) timeinfo->tm_hour);
-    bSetChar (data, 9,  (uint8_t) timeinfo->tm_yday);
-    bSetChar (data, 10, (uint8_t) timeinfo->tm_mon);
-    bSetChar (data, 11, (uint8_t) timeinfo->tm_year);
+    DS_PacketAppend (packet, (uint8_t) 0x0b);
+    DS_PacketAppend (packet, (uint8_t) cTagDate);
+    DS_PacketAppend (packet, (uint8_t) (ms & 0xff000000) >> 24);
+    DS_PacketAppend (packet, (uint8_t) (ms & 0xff0000) >> 16);
+    DS_PacketAppend (packet, (uint8_t) (ms & 0xff00) >> 8);
+    DS_PacketAppend (packet, (uint8_t) (ms & 0xff));
+    DS_PacketAppend (packet, (uint8_t) timeinfo->tm_sec);
+    DS_PacketAppend (packet, (uint8_t) timeinfo->tm_min);
+    DS_PacketAppend (packet, (uint8_t) timeinfo->tm_hour);
+    DS_PacketAppend (packet, (uint8_t) timeinfo->tm_yday);
+    DS_PacketAppend (packet, (uint8_t) timeinfo->tm_mon);
+    DS_PacketAppend (packet, (uint8_t) timeinfo->tm_year);
 
     /* Add timezone length and tag */
-    bSetChar (data, 12, blength (tz));
-    bSetChar (data, 13, cTagTimezone);
+    DS_PacketAppend (packet, strlen (tz));
+    DS_PacketAppend (packet, cTagTimezone);
 
     /* Add timezone string */
-    bconcat (data, tz);
-    DS_FREESTR (tz);
-
-    /* Return the obtained data */
-    return data;
+    DS_PacketAppendBytes (packet, tz, strlen (tz));
 }
 
 /**
- * Constructs a joystick information structure for every attached joystick.
- * Unlike the 2014 protocol, the 2015 protocol only generates joystick data
- * for the attached joysticks.
+ * Adds a joystick information structure for every attached joystick to the
+ * given \a packet. Unlike the 2014 protocol, the 2015 protocol only generates
+ * joystick data for the attached joysticks.
+ *
+ * The encoded data of each joystick is kept between packets, and a joystick
+ * is only encoded again when its values (or the robot enabled state) change.
  */
-static bstring get_joystick_data()
+static void add_joystick_data (DS_Packet* packet)
 {
-    /* Initialize the variables */
     int i = 0;
-    int j = 0;
-    bstring data = bfromcstr ("");
+    int enabled = CFG_GetRobotEnabled();
 
     /* Generate data for each joystick */
     for (i = 0; i < DS_GetJoystickCount(); ++i) {
-        bconchar (data, get_joystick_size (i));
-        bconchar (data, cTagJoystick);
-
-        /* Add axis data */
-        bconchar (data, DS_GetJoystickNumAxes (i));
-        for (j = 0; j < DS_GetJoystickNumAxes (i); ++j)
-            bconchar (data, DS_GetFByte (DS_GetJoystickAxis (i, j), 1));
-
-        /* Generate button data */
-        uint16_t button_flags = 0;
-        for (j = 0; j < DS_GetJoystickNumButtons (i); ++j)
-            button_flags += DS_GetJoystickButton (i, j) ? (int) pow (2, j) : 0;
-
-        /* Add button data */
-        bconchar (data, DS_GetJoystickNumButtons (i));
-        bconchar (data, (button_flags & 0xff00) >> 8);
-        bconchar (data, (button_flags & 0xff));
-
-        /* Add hat data */
-        bconchar (data, DS_GetJoystickNumHats (i));
-        for (j = 0; j < DS_GetJoystickNumHats (i); ++j) {
-            bconchar (data, (DS_GetJoystickHat (i, j) & 0xff00) >> 8);
-            bconchar (data, (DS_GetJoystickHat (i, j) & 0xff));
+        int size = get_joystick_size (i);
+
+        /* Joystick cannot be cached, encode it directly in the packet */
+        if (i >= CACHED_JOYSTICKS || size > JOYSTICK_BLOCK) {
+            uint8_t* data = packet->data + packet->length;
+            if (packet->length + size <= DS_PACKET_CAPACITY)
+                packet->length += encode_joystick (i, data);
+
+            continue;
+        }
+
+        /* Encode the joystick again if it changed, the version is read
+         * before the values, so values that change while we encode them
+         * are encoded again with the next packet */
+        DS_FRC2015Joystick* block = &state()->joysticks [i];
+        unsigned int version = DS_GetJoystickVersion (i);
+        if (block->version != version || block->enabled != enabled) {
+            block->length = encode_joystick (i, block->data);
+            block->version = version;
+            block->enabled = enabled;
         }
-    }
 
-    /* Return obtained data */
-    return data;
+        /* Copy the encoded joystick to the packet */
+        DS_PacketAppendBytes (packet, block->data, block->length);
+    }
 }
 
 /**
@@ -469,36 +522,31 @@ static bstring robot_address()
  *    - Radio and robot ping flags
  *    - The team number
  */
-static bstring create_fms_packet()
+static void create_fms_packet (DS_Packet* packet)
 {
-    /* Create an 8-byte long packet */
-    bstring data = DS_GetEmptyString (8);
-
     /* Get voltage bytes */
     uint8_t integer = 0;
     uint8_t decimal = 0;
     encode_voltage (CFG_GetRobotVoltage(), &integer, &decimal);
 
     /* Add FMS packet count */
-    bSetChar (data, 0, (sent_fms_packets & 0xff00) >> 8);
-    bSetChar (data, 1, (sent_fms_packets & 0xff));
+    DS_PacketAppend (packet, (state()->sent_fms_packets & 0xff00) >> 8);
+    DS_PacketAppend (packet, (state()->sent_fms_packets & 0xff));
 
     /* Add DS version and FMS control code */
-    bSetChar (data, 2, cFMS_DS_Version);
-    bSetChar (data, 3, fms_control_code());
+    DS_PacketAppend (packet, cFMS_DS_Version);
+    DS_PacketAppend (packet, fms_control_code());
 
     /* Add team number */
-    bSetChar (data, 4, (CFG_GetTeamNumber() & 0xff00) >> 8);
-    bSetChar (data, 5, (CFG_GetTeamNumber() & 0xff));
+    DS_PacketAppend (packet, (CFG_GetTeamNumber() & 0xff00) >> 8);
+    DS_PacketAppend (packet, (CFG_GetTeamNumber() & 0xff));
 
     /* Add robot voltage */
-    bSetChar (data, 6, integer);
-    bSetChar (data, 7, decimal);
+    DS_PacketAppend (packet, integer);
+    DS_PacketAppend (packet, decimal);
 
     /* Increase FMS packet counter */
-    ++sent_fms_packets;
-
-    return data;
+    ++state()->sent_fms_packets;
 }
 
 /**
@@ -506,9 +554,9 @@ static bstring create_fms_packet()
  * to the DS Radio / Bridge. For that reason, the 2015 communication protocol
  * generates empty radio packets.
  */
-static bstring create_radio_packet()
+static void create_radio_packet (DS_Packet* packet)
 {
-    return bfromcstr ("");
+    (void) packet;
 }
 
 /**
@@ -521,34 +569,33 @@ static bstring create_radio_packet()
  *    - Date and time data (if robot requests it)
  *    - Joystick information (if the robot does not want date/time)
  */
-static bstring create_robot_packet()
+static void create_robot_packet (DS_Packet* packet)
 {
-    bstring data = DS_GetEmptyString (6);
-
     /* Add packet index */
-    bSetChar (data, 0, (sent_robot_packets & 0xff00) >> 8);
-    bSetChar (data, 1, (sent_robot_packets & 0xff));
+    DS_PacketAppend (packet, (state()->sent_robot_packets & 0xff00) >> 8);
+    DS_PacketAppend (packet, (state()->sent_robot_packets & 0xff));
 
     /* Add packet header */
-    bSetChar (data, 2, cTagGeneral);
+    DS_PacketAppend (packet, cTagGeneral);
 
     /* Add control code, request flags and team station */
-    bSetChar (data, 3, get_control_code());
-    bSetChar (data, 4, get_request_code());
-    bSetChar (data, 5, get_station_code());
+    DS_PacketAppend (packet, get_control_code());
+    DS_PacketAppend (packet, get_request_code());
+    DS_PacketAppend (packet, get_station_code());
 
     /* Add timezone data (if robot wants it) */
-    if (send_time_data)
-        bconcat (data, get_timezone_data());
+    if (state()->send_time_data)
+        add_timezone_data (packet);
 
     /* Add joystick data */
-    else if (sent_robot_packets > 5)
-        bconcat (data, get_joystick_data());
+    else if (state()->sent_robot_packets > 5)
+        add_joystick_data (packet);
 
-    /* Increase robot packet counter */
-    ++sent_robot_packets;
+    /* Start measuring the round-trip time of this packet */
+    DS_PacketSent (DS_CHANNEL_ROBOT, state()->sent_robot_packets);
 
-    return data;
+    /* Increase robot packet counter */
+    ++state()->sent_robot_packets;
 }
 
 /**
@@ -570,9 +617,13 @@ static int read_fms_packet (const bstring data)
         return 0;
 
     /* Read FMS packet */
+    uint16_t index = (data->data [0] << 8) | data->data [1];
     uint8_t control = data->data [3];
     uint8_t station = data->data [5];
 
+    /* Use the FMS packet index to measure packet loss */
+    DS_PacketReceived (DS_CHANNEL_FMS, index);
+
     /* Change robot enabled state based on what FMS tells us to do*/
     CFG_SetRobotEnabled (control & cEnabled);
 
@@ -607,6 +658,7 @@ static int read_radio_packet (const bstring data)
 
 /**
  * Interprets the packet and obtains the following information:
+ *    - The echoed packet index (used to measure the round-trip time)
  *    - The user code state of the robot
  *    - If the robot needs to get the current date/time from the client
  *    - The emergency stop state of the robot
@@ -624,16 +676,20 @@ static int read_robot_packet (const bstring data)
         return 0;
 
     /* Read robot packet */
+    uint16_t echoed = (data->data [0] << 8) | data->data [1];
     uint8_t control = data->data [3];
     uint8_t rstatus = data->data [4];
     uint8_t request = data->data [7];
 
+    /* The robot echoes the index of the last packet it received */
+    DS_PacketEchoed (DS_CHANNEL_ROBOT, echoed);
+
     /* Update client information */
     CFG_SetRobotCode (rstatus & cRobotHasCode);
     CFG_SetEmergencyStopped (control & cEmergencyStop);
 
     /* Update date/time request flag */
-    send_time_data = (request == cRequestTime);
+    state()->send_time_data = (request == cRequestTime);
 
     /* Calculate the voltage */
     uint8_t upper = data->data [5];
@@ -669,9 +725,9 @@ static void reset_radio()
  */
 static void reset_robot()
 {
-    reboot = 0;
-    restart_code = 0;
-    send_time_data = 0;
+    state()->reboot = 0;
+    state()->restart_code = 0;
+    state()->send_time_data = 0;
 }
 
 /**
@@ -679,7 +735,7 @@ static void reset_robot()
  */
 static void reboot_robot()
 {
-    reboot = 1;
+    state()->reboot = 1;
 }
 
 /**
@@ -688,7 +744,7 @@ static void reboot_robot()
  */
 static void restart_robot_code()
 {
-    restart_code = 1;
+    state()->restart_code = 1;
 }
 
 /**
@@ -702,6 +758,9 @@ DS_Protocol* DS_GetProtocolFRC_2015()
     /* Set protocol name */
     protocol->name = bfromcstr ("FRC 2015 Communication Protocol");
 
+    /* Allocate protocol state */
+    protocol->data = calloc (1, sizeof (DS_FRC2015State));
+
     /* Set address functions */
     protocol->fms_address = &fms_address;
     protocol->radio_address = &radio_address;
@@ -22,10 +22,71 @@
  */
 
 #include "DS_Utils.h"
+#include "DS_Timer.h"
 #include "DS_Socket.h"
 
 #include <socky.h>
 #include <bstraux.h>
+#include <stdatomic.h>
+
+#if defined __linux__
+    #define USE_EPOLL 1
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+#endif
+
+#define MAX_EVENTS     16 /* Maximum number of events handled per wake-up */
+#define MAX_READS      64 /* Maximum number of datagrams read per wake-up */
+#define SELECT_TIMEOUT 10 /* Registry refresh interval of the select() loop */
+
+/*
+ * Holds a received datagram and the address of its sender
+ */
+typedef struct _datagram {
+    int length;                      /**< Number of bytes received */
+    socklen_t source_len;            /**< Length of the source address */
+    struct sockaddr_storage source;  /**< Address of the sender */
+    char data [DS_SOCKET_SLOT_SIZE]; /**< Received bytes */
+} DS_Datagram;
+
+/*
+ * Single-producer/single-consumer ring of received datagrams. The reactor
+ * is the only writer of \a tail and the reader is the only writer of
+ * \a head, so no locks are needed to pass datagrams between both threads.
+ */
+typedef struct _ring {
+    atomic_uint head;                        /**< Next slot to read */
+    atomic_uint tail;                        /**< Next slot to write */
+    atomic_ulong dropped;                    /**< Datagrams lost (ring full) */
+    DS_Datagram slots [DS_SOCKET_RING_SIZE]; /**< Datagram slots */
+} DS_Ring;
+
+/*
+ * Holds the sockets watched by the reactor
+ */
+static DS_Socket** registry = NULL;
+static int registry_size = 0;
+static int registry_capacity = 0;
+
+/*
+ * Reactor thread and its lock (which is held while the reactor accesses a
+ * registered socket)
+ */
+static atomic_int reactor_running = 0;
+static pthread_t reactor_thread;
+static pthread_mutex_t reactor_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#if USE_EPOLL
+static int epoll_fd = -1;
+static int wake_fd = -1;
+#endif
+
+/*
+ * Used to wake up the threads that wait for received data
+ */
+static int data_pending = 0;
+static pthread_cond_t data_cond;
+static pthread_mutex_t data_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /**
  * Returns the given \a number as a string
@@ -36,94 +97,228 @@ static bstring itc (int number)
 }
 
 /**
- * Copies the received data from the socket in its data buffer
+ * Reads one datagram from the given socket into the next free slot of its
+ * ring. If the ring is full, the datagram is read (to clear it from the
+ * operating system's queue) and discarded.
+ *
+ * Returns the number of bytes read, or a value lower than \c 1 if there was
+ * no data to read
  */
-static void read_socket (DS_Socket* ptr)
+static int read_socket (DS_Socket* ptr)
 {
-    if (!ptr)
-        return;
+    if (!ptr || !ptr->info.ring)
+        return -1;
 
-    /* Initialize temporary buffer */
-    int read = -1;
-    bstring data = DS_GetEmptyString (1024);
+    DS_Ring* ring = (DS_Ring*) ptr->info.ring;
+    unsigned int tail = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit (&ring->head, memory_order_acquire);
+
+    /* Ring is full, read into a scratch slot and drop the datagram */
+    int full = (tail - head) >= DS_SOCKET_RING_SIZE;
+    static DS_Datagram scratch;
+    DS_Datagram* slot = full ? &scratch : &ring->slots [tail % DS_SOCKET_RING_SIZE];
+
+    /* Read the datagram */
+    slot->source_len = sizeof (slot->source);
+    slot->length = recvfrom (ptr->info.sock_in,
+                             slot->data, sizeof (slot->data), 0,
+                             (struct sockaddr*) &slot->source,
+                             &slot->source_len);
+
+    /* Nothing was received */
+    if (slot->length <= 0)
+        return slot->length;
+
+    /* Update drop count or publish the datagram */
+    if (full)
+        atomic_fetch_add_explicit (&ring->dropped, 1, memory_order_relaxed);
+    else
+        atomic_store_explicit (&ring->tail, tail + 1, memory_order_release);
+
+    return slot->length;
+}
 
-    /* Read TCP socket */
-    if (ptr->type == DS_SOCKET_TCP)
-        read = recv (ptr->info.sock_in, (char*) data->data, blength (data), 0);
+/**
+ * Wakes up the threads that are waiting for received data
+ */
+static void notify_data()
+{
+    pthread_mutex_lock (&data_lock);
+    data_pending = 1;
+    pthread_cond_broadcast (&data_cond);
+    pthread_mutex_unlock (&data_lock);
+}
 
-    /* Read UDP socket */
-    if (ptr->type == DS_SOCKET_UDP)
-        read = udp_recvfrom (ptr->info.sock_in,
-                             (char*) data->data, blength (data),
-                             bstr2cstr (ptr->address, 0),
-                             bstr2cstr (ptr->info.in_service, 0), 0);
+/**
+ * Returns the registered socket that uses the given input \a fd
+ * \note The reactor lock must be held by the caller
+ */
+static DS_Socket* find_socket (const int fd)
+{
+    int i;
+    for (i = 0; i < registry_size; ++i) {
+        if (registry [i]->info.sock_in == fd)
+            return registry [i];
+    }
 
-    /* We received some data, copy it to socket's buffer */
-    if (read > 0) {
-        DS_FREESTR (ptr->info.buffer);
-        ptr->info.buffer = DS_GetEmptyString (read);
+    return NULL;
+}
 
-        int i;
-        for (i = 0; i < read; ++i)
-            ptr->info.buffer->data [i] = data->data [i];
+/**
+ * Reads all the datagrams received by the socket that uses the given \a fd,
+ * the socket is ignored if it has been closed in the meantime
+ */
+static void dispatch (const int fd)
+{
+    pthread_mutex_lock (&reactor_lock);
+
+    int reads = 0;
+    DS_Socket* ptr = find_socket (fd);
+    while (reads < MAX_READS && read_socket (ptr) > 0)
+        ++reads;
+
+    pthread_mutex_unlock (&reactor_lock);
+}
+
+/**
+ * Adds the given socket to the list of sockets watched by the reactor
+ */
+static void register_socket (DS_Socket* ptr)
+{
+    pthread_mutex_lock (&reactor_lock);
+
+    if (registry_size >= registry_capacity) {
+        registry_capacity = DS_Max (registry_capacity * 2, 8);
+        registry = (DS_Socket**) realloc (registry,
+                                          registry_capacity * sizeof (DS_Socket*));
     }
 
-    /* De-allocate temporary data */
-    DS_FREESTR (data);
+    registry [registry_size++] = ptr;
+
+#if USE_EPOLL
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = ptr->info.sock_in;
+    epoll_ctl (epoll_fd, EPOLL_CTL_ADD, ptr->info.sock_in, &event);
+#endif
+
+    pthread_mutex_unlock (&reactor_lock);
 }
 
 /**
- * Runs the server socket loop, which uses the \c select() function
- * to copy received data into the socket's buffer only when the
- * operating system detects that the socket received some data.
+ * Removes the given socket from the list of sockets watched by the reactor,
+ * once this function returns, the reactor will not access the socket.
+ */
+static void unregister_socket (DS_Socket* ptr)
+{
+    pthread_mutex_lock (&reactor_lock);
+
+    int i;
+    for (i = 0; i < registry_size; ++i) {
+        if (registry [i] == ptr) {
+            registry [i] = registry [--registry_size];
+            break;
+        }
+    }
+
+#if USE_EPOLL
+    struct epoll_event event;
+    memset (&event, 0, sizeof (event));
+    epoll_ctl (epoll_fd, EPOLL_CTL_DEL, ptr->info.sock_in, &event);
+#endif
+
+    pthread_mutex_unlock (&reactor_lock);
+}
+
+/**
+ * Runs the reactor, which waits until any of the registered sockets receives
+ * data, reads the data into the socket's buffer and wakes up the threads
+ * waiting for data (e.g. the protocol event loop).
  *
- * \param ptr a pointer to a \c DS_Socket structure
+ * On Linux, the reactor uses \c epoll() and only wakes up when data is
+ * received (or when the module is closed). Other platforms use \c select()
+ * with a short timeout to pick up newly registered sockets.
  */
-static void server_loop (DS_Socket* ptr)
+static void* run_reactor (void* ptr)
 {
-    if (!ptr)
-        return;
+    (void) ptr;
 
-    int rc, fd;
-    fd_set set;
-    struct timeval tv;
-    set_socket_block (ptr->info.sock_in, 0);
+#if USE_EPOLL
+    struct epoll_event events [MAX_EVENTS];
 
-    while (ptr->info.server_init == 1 && ptr->info.sock_in > 0) {
-        tv.tv_sec = 0;
-        tv.tv_usec = 5000 * 100;
+    while (reactor_running) {
+        int i;
+        int received = 0;
+        int count = epoll_wait (epoll_fd, events, MAX_EVENTS, -1);
+
+        for (i = 0; i < count; ++i) {
+            if (events [i].data.fd == wake_fd) {
+                uint64_t value;
+                if (read (wake_fd, &value, sizeof (value)) < 0)
+                    continue;
+            }
+
+            else {
+                dispatch (events [i].data.fd);
+                received = 1;
+            }
+        }
+
+        if (received)
+            notify_data();
+    }
+#else
+    while (reactor_running) {
+        int i;
+        int nfds = 0;
+        int received = 0;
+
+        fd_set set;
+        struct timeval tv;
 
         FD_ZERO (&set);
-        FD_SET (ptr->info.sock_in, &set);
+        tv.tv_sec = 0;
+        tv.tv_usec = SELECT_TIMEOUT * 1000;
 
-#if defined _WIN32
-        fd = 0;
-#else
-        fd = ptr->info.sock_in + 1;
-#endif
+        /* Get the registered sockets */
+        pthread_mutex_lock (&reactor_lock);
+        for (i = 0; i < registry_size; ++i) {
+            FD_SET (registry [i]->info.sock_in, &set);
+            nfds = DS_Max (nfds, registry [i]->info.sock_in + 1);
+        }
+        pthread_mutex_unlock (&reactor_lock);
 
-        rc = select (fd, &set, NULL, NULL, &tv);
-        if (rc > 0 && FD_ISSET (ptr->info.sock_in, &set))
-            read_socket (ptr);
+        /* No sockets to watch */
+        if (nfds == 0) {
+            DS_Sleep (SELECT_TIMEOUT);
+            continue;
+        }
+
+        /* Wait for data */
+        if (select (nfds, &set, NULL, NULL, &tv) > 0) {
+            for (i = 0; i < nfds; ++i) {
+                if (FD_ISSET (i, &set)) {
+                    dispatch (i);
+                    received = 1;
+                }
+            }
+        }
 
-        fsync (ptr->info.sock_in);
+        if (received)
+            notify_data();
     }
+#endif
+
+    return NULL;
 }
 
 /**
  * Initializes the given socket structure
  *
- * \param data raw pointer to a \c DS_Socket structure
+ * \param ptr pointer to a \c DS_Socket structure
  */
-static void* create_socket (void* data)
+static void create_socket (DS_Socket* ptr)
 {
-    /* Data pointer is NULL */
-    if (!data)
-        return NULL;
-
-    /* Cast raw pointer to socket */
-    DS_Socket* ptr = (DS_Socket*) data;
-
     /* Load fallback address if input address is invalid */
     if (DS_StringIsEmpty (ptr->address) || ptr->broadcast == 1) {
         DS_FREESTR (ptr->address);
@@ -153,17 +348,12 @@ static void* create_socket (void* data)
                                 SOCKY_IPv4, 0);
 
         ptr->info.sock_out = create_client_udp (SOCKY_IPv4, 0);
+        set_socket_block (ptr->info.sock_out, 0);
     }
 
     /* Update initialized states */
     ptr->info.server_init = (ptr->info.sock_in > 0);
     ptr->info.client_init = (ptr->info.sock_out > 0);
-
-    /* Start server loop */
-    server_loop (ptr);
-
-    /* Exit */
-    return NULL;
 }
 
 /**
@@ -184,36 +374,105 @@ DS_Socket* DS_SocketEmpty()
     /* Fill socket info structure */
     socket->info.sock_in = 0;
     socket->info.sock_out = 0;
-    socket->info.buffer = NULL;
+    socket->info.ring = NULL;
     socket->info.server_init = 0;
     socket->info.client_init = 0;
     socket->info.in_service = NULL;
     socket->info.out_service = NULL;
+    pthread_mutex_init (&socket->info.lock, NULL);
 
     return socket;
 }
 
 /**
- * Initializes the sockets module and its event system
+ * Initializes the sockets module and starts the reactor thread
  */
 void Sockets_Init()
 {
     sockets_init (1);
+    DS_CondInit (&data_cond);
+
+#if USE_EPOLL
+    epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    wake_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd;
+    epoll_ctl (epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+#endif
+
+    reactor_running = 1;
+    int err = pthread_create (&reactor_thread, NULL, &run_reactor, NULL);
+
+    /* Report thread creation errors */
+    if (err) {
+        reactor_running = 0;
+        fprintf (stderr, "Cannot create reactor thread, error %d\n", err);
+    }
 }
 
 /**
- * Stops the event loops and closes all socket structures
+ * Stops the reactor thread and closes the sockets module
  */
 void Sockets_Close()
 {
+    int joinable = reactor_running;
+
+    /* Stop the reactor */
+    reactor_running = 0;
+#if USE_EPOLL
+    uint64_t value = 1;
+    if (write (wake_fd, &value, sizeof (value)) < 0)
+        fprintf (stderr, "Cannot wake up reactor thread\n");
+#endif
+
+    /* Wait for the reactor thread to exit */
+    if (joinable)
+        pthread_join (reactor_thread, NULL);
+
+#if USE_EPOLL
+    close (wake_fd);
+    close (epoll_fd);
+    wake_fd = -1;
+    epoll_fd = -1;
+#endif
+
+    /* Clear the socket registry */
+    registry_size = 0;
+    registry_capacity = 0;
+    DS_FREE (registry);
+
+    /* Release any thread waiting for data */
+    notify_data();
     sockets_exit();
 }
 
 /**
- * Initializes and configures the given socket
+ * Blocks the calling thread until any socket receives data or until the
+ * monotonic clock reaches the given \a deadline (see DS_GetTime()).
  *
- * \note The socket will be initialzed in another thread to avoid blocking
- *       the main thread of the application
+ * Returns \c 1 if data was received, \c 0 if the deadline was reached
+ */
+int DS_SocketWaitForData (const uint64_t deadline)
+{
+    pthread_mutex_lock (&data_lock);
+
+    while (!data_pending) {
+        if (DS_CondWaitUntil (&data_cond, &data_lock, deadline) != 0)
+            break;
+    }
+
+    int received = data_pending;
+    data_pending = 0;
+
+    pthread_mutex_unlock (&data_lock);
+    return received;
+}
+
+/**
+ * Initializes and configures the given socket, the socket's input file
+ * descriptor is then watched by the reactor thread
  */
 void DS_SocketOpen (DS_Socket* ptr)
 {
@@ -225,9 +484,18 @@ void DS_SocketOpen (DS_Socket* ptr)
     if (ptr->disabled)
         return;
 
-    /* Initialize the socket in another thread */
-    pthread_t thread;
-    pthread_create (&thread, NULL, &create_socket, (void*) ptr);
+    /* Create the sockets */
+    create_socket (ptr);
+
+    /* Allocate the datagram ring */
+    if (!ptr->info.ring)
+        ptr->info.ring = calloc (1, sizeof (DS_Ring));
+
+    /* Let the reactor read the socket */
+    if (ptr->info.server_init) {
+        set_socket_block (ptr->info.sock_in, 0);
+        register_socket (ptr);
+    }
 }
 
 /**
@@ -242,18 +510,24 @@ void DS_SocketClose (DS_Socket* ptr)
     if (!ptr)
         return;
 
+    /* Stop watching the socket */
+    if (ptr->info.server_init)
+        unregister_socket (ptr);
+
     /* Reset socket properties */
     ptr->info.server_init = 0;
     ptr->info.client_init = 0;
 
     /* Close sockets */
-    socket_close_threaded (ptr->info.sock_in, NULL);
-    socket_close_threaded (ptr->info.sock_out, NULL);
+    socket_close (ptr->info.sock_in);
+    socket_close (ptr->info.sock_out);
 
     /* Clear data buffers */
-    DS_FREESTR (ptr->info.buffer);
+    pthread_mutex_lock (&ptr->info.lock);
+    DS_FREE (ptr->info.ring);
     DS_FREESTR (ptr->info.in_service);
     DS_FREESTR (ptr->info.out_service);
+    pthread_mutex_unlock (&ptr->info.lock);
 
     /* Reset socket information structure */
     ptr->info.sock_in = -1;
@@ -261,30 +535,119 @@ void DS_SocketClose (DS_Socket* ptr)
 }
 
 /**
- * Returns any data received by the given socket
+ * Returns the oldest datagram received by the given socket (or \c NULL if
+ * there is no pending data), the caller is responsible of de-allocating
+ * the returned string.
+ *
+ * Datagrams are returned in the order in which they were received, call
+ * this function until it returns \c NULL to read all of them.
+ *
+ * \note This function must always be called from the same thread
  *
  * \param ptr pointer to a \c DS_Socket structure
  */
 bstring DS_SocketRead (DS_Socket* ptr)
+{
+    return DS_SocketReadFrom (ptr, NULL);
+}
+
+/**
+ * Returns the oldest datagram received by the given socket (just like
+ * DS_SocketRead() does) and writes the numeric IP address of its sender in
+ * \a source (if \a source is not \c NULL and a datagram was read).
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ * \param source pointer to the string in which to write the sender address,
+ *        the caller is responsible of de-allocating it
+ */
+bstring DS_SocketReadFrom (DS_Socket* ptr, bstring* source)
 {
     /* Invalid pointer */
-    if (!ptr)
+    if (!ptr || !ptr->info.ring)
         return NULL;
 
     /* Socket is disabled or uninitialized */
     if ((ptr->info.server_init == 0) || (ptr->disabled == 1))
         return NULL;
 
-    /* Copy the current buffer and clear it */
-    if (blength (ptr->info.buffer) > 0) {
-        bstring buffer = bstrcpy (ptr->info.buffer);
-        DS_FREESTR (ptr->info.buffer);
-        return buffer;
+    DS_Ring* ring = (DS_Ring*) ptr->info.ring;
+    unsigned int head = atomic_load_explicit (&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit (&ring->tail, memory_order_acquire);
+
+    /* Ring is empty */
+    if (head == tail)
+        return NULL;
+
+    /* Copy the datagram */
+    DS_Datagram* slot = &ring->slots [head % DS_SOCKET_RING_SIZE];
+    bstring data = blk2bstr (slot->data, slot->length);
+
+    /* Get the sender address */
+    if (source) {
+        char host [NI_MAXHOST];
+        if (getnameinfo ((struct sockaddr*) &slot->source, slot->source_len,
+                         host, sizeof (host), NULL, 0, NI_NUMERICHOST) == 0)
+            *source = bfromcstr (host);
+        else
+            *source = NULL;
     }
 
-    return NULL;
+    /* Release the slot */
+    atomic_store_explicit (&ring->head, head + 1, memory_order_release);
+
+    return data;
+}
+
+/**
+ * Copies the oldest datagram received by the given socket to the given
+ * \a buffer (truncating it to \a size bytes), without allocating memory.
+ *
+ * \note This function must always be called from the same thread
+ *
+ * \returns the number of bytes copied, or \c -1 if there was no datagram
+ *
+ * \param ptr pointer to a \c DS_Socket structure
+ * \param buffer the buffer in which to write the datagram
+ * \param size the size of the buffer
+ */
+int DS_SocketReadBuffer (DS_Socket* ptr, void* buffer, const int size)
+{
+    /* Invalid pointer */
+    if (!ptr || !ptr->info.ring || !buffer || size < 0)
+        return -1;
+
+    /* Socket is disabled or uninitialized */
+    if ((ptr->info.server_init == 0) || (ptr->disabled == 1))
+        return -1;
+
+    DS_Ring* ring = (DS_Ring*) ptr->info.ring;
+    unsigned int head = atomic_load_explicit (&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit (&ring->tail, memory_order_acquire);
+
+    /* Ring is empty */
+    if (head == tail)
+        return -1;
+
+    /* Copy the datagram and release the slot */
+    DS_Datagram* slot = &ring->slots [head % DS_SOCKET_RING_SIZE];
+    int length = DS_Min (slot->length, size);
+    memcpy (buffer, slot->data, length);
+    atomic_store_explicit (&ring->head, head + 1, memory_order_release);
+
+    return length;
 }
 
+/**
+ * Returns the number of datagrams that were discarded by the given socket
+ * because they arrived while its ring was full
+ */
+unsigned long DS_SocketDroppedPackets (DS_Socket* ptr)
+{
+    if (ptr && ptr->info.ring)
+        return atomic_load (&((DS_Ring*) ptr->info.ring)->dropped);
+
+    return 0;
+}
 
 /**
  * Sends the given \a data using the given socket
@@ -295,9 +658,42 @@ bstring DS_SocketRead (DS_Socket* ptr)
  * \returns number of bytes written on success, -1 on failure
  */
 int DS_SocketSend (DS_Socket* ptr, const bstring data)
+{
+    if (DS_StringIsEmpty (data))
+        return -1;
+
+    return DS_SocketSendBuffer (ptr, data->data, blength (data));
+}
+
+/**
+ * Sends the given \a data to the given \a host (instead of the address of
+ * the socket) using the output port of the given socket.
+ *
+ * \returns number of bytes written on success, -1 on failure
+ */
+int DS_SocketSendTo (DS_Socket* ptr, const bstring data, const bstring host)
+{
+    if (DS_StringIsEmpty (data))
+        return -1;
+
+    return DS_SocketSendBufferTo (ptr, data->data, blength (data), host);
+}
+
+/**
+ * Sends the first \a length bytes of the given \a data buffer using the
+ * given socket. Unlike \c DS_SocketSend, this function does not need the
+ * data to be stored in a string, so it never allocates memory.
+ *
+ * \param ptr pointer to the socket to use to send the given \a data
+ * \param data the data buffer to send
+ * \param length the number of bytes to send
+ *
+ * \returns number of bytes written on success, -1 on failure
+ */
+int DS_SocketSendBuffer (DS_Socket* ptr, const void* data, const int length)
 {
     /* Invalid pointer and/or empty data buffer */
-    if (!ptr || DS_StringIsEmpty (data))
+    if (!ptr || !data || length <= 0)
         return -1;
 
     /* Socket is disabled or uninitialized */
@@ -306,15 +702,18 @@ int DS_SocketSend (DS_Socket* ptr, const bstring data)
 
     /* Send data using TCP */
     if (ptr->type == DS_SOCKET_TCP)
-        return send (ptr->info.sock_out,
-                     bstr2cstr (data, 0), blength (data), 0);
+        return send (ptr->info.sock_out, (const char*) data, length, 0);
 
     /* Send data using UDP */
     else if (ptr->type == DS_SOCKET_UDP) {
-        return udp_sendto (ptr->info.sock_out,
-                           bstr2cstr (data, 0), blength (data),
-                           bstr2cstr (ptr->address, 0),
-                           bstr2cstr (ptr->info.out_service, 0), 0);
+        pthread_mutex_lock (&ptr->info.lock);
+        int bytes = udp_sendto (ptr->info.sock_out,
+                                (const char*) data, length,
+                                (char*) ptr->address->data,
+                                (char*) ptr->info.out_service->data, 0);
+        pthread_mutex_unlock (&ptr->info.lock);
+
+        return bytes;
     }
 
     /* Should not happen */
@@ -322,7 +721,39 @@ int DS_SocketSend (DS_Socket* ptr, const bstring data)
 }
 
 /**
- * Changes the \a address of the given socket structre
+ * Sends the first \a length bytes of the given \a data buffer to the given
+ * \a host (instead of the address of the socket) using the output port of
+ * the given socket.
+ *
+ * \returns number of bytes written on success, -1 on failure
+ */
+int DS_SocketSendBufferTo (DS_Socket* ptr, const void* data, const int length,
+                           const bstring host)
+{
+    /* Invalid pointer, data or host */
+    if (!ptr || !data || length <= 0 || DS_StringIsEmpty (host))
+        return -1;
+
+    /* Only UDP sockets can send data to another host */
+    if (ptr->type != DS_SOCKET_UDP)
+        return -1;
+
+    /* Socket is disabled or uninitialized */
+    if ((ptr->info.client_init == 0) || (ptr->disabled == 1))
+        return -1;
+
+    return udp_sendto (ptr->info.sock_out,
+                       (const char*) data, length,
+                       (char*) host->data,
+                       (char*) ptr->info.out_service->data, 0);
+}
+
+/**
+ * Changes the \a address of the given socket structre.
+ *
+ * UDP sockets only need to change their destination address, so they are
+ * not re-opened (and keep receiving data while the address changes). If
+ * the address did not change, it is resolved again in the background.
  *
  * \param ptr pointer to a \c DS_Socket structure
  * \param address the new address to apply to the socket
@@ -340,22 +771,25 @@ void DS_SocketChangeAddress (DS_Socket* ptr, const bstring address)
         ip = DS_FallBackAddress;
     }
 
-    /* Re-assign the address only if its different from input IP */
-    if (ptr->address) {
-        if (bstrcmp (ptr->address, ip) != 0) {
-            DS_SocketClose (ptr);
-            DS_FREESTR (ptr->address);
-            ptr->address = ip;
-            DS_SocketOpen (ptr);
-        }
+    /* Address did not change, look it up again in the background */
+    if (ptr->address && bstrcmp (ptr->address, ip) == 0) {
+        socky_expire ((char*) ip->data);
+        DS_FREESTR (ip);
+        return;
+    }
 
-        else
-            DS_FREESTR (ip);
+    /* Replace the destination address of an open UDP socket */
+    if (ptr->type == DS_SOCKET_UDP && ptr->info.client_init) {
+        pthread_mutex_lock (&ptr->info.lock);
+        DS_FREESTR (ptr->address);
+        ptr->address = ip;
+        pthread_mutex_unlock (&ptr->info.lock);
     }
 
-    /* Socket address is empty, remplaze it directly */
+    /* Re-open the socket with the new address */
     else {
         DS_SocketClose (ptr);
+        DS_FREESTR (ptr->address);
         ptr->address = ip;
         DS_SocketOpen (ptr);
     }
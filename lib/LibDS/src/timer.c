@@ -22,10 +22,12 @@
  */
 
 #include "DS_Utils.h"
-#include "DS_Array.h"
 #include "DS_Timer.h"
 
+#include <time.h>
 #include <stdio.h>
+#include <errno.h>
+#include <string.h>
 
 #if defined _WIN32
     #include <windows.h>
@@ -33,62 +35,312 @@
     #include <unistd.h>
 #endif
 
-static DS_Array timers;
+/*
+ * Converts milliseconds to nanoseconds
+ */
+#define MSEC_TO_NSEC(x) ((uint64_t) (x) * 1000000ULL)
+
+/*
+ * The timer queue is a binary min-heap sorted by the deadline of each timer
+ */
+static DS_Timer** queue = NULL;
+static int queue_size = 0;
+static int queue_capacity = 0;
+
+/*
+ * Timer service thread and its synchronization primitives
+ */
 static int running = 0;
+static pthread_t service_thread;
+static pthread_cond_t service_cond;
+static pthread_mutex_t service_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Swaps the timers at the given heap positions and updates their indexes
+ */
+static void queue_swap (const int a, const int b)
+{
+    DS_Timer* timer = queue [a];
+
+    queue [a] = queue [b];
+    queue [b] = timer;
+
+    queue [a]->queue_index = a;
+    queue [b]->queue_index = b;
+}
+
+/**
+ * Moves the timer at the given \a index up in the heap until its parent
+ * expires before it does
+ */
+static void queue_sift_up (int index)
+{
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (queue [parent]->deadline <= queue [index]->deadline)
+            break;
+
+        queue_swap (index, parent);
+        index = parent;
+    }
+}
 
 /**
- * Updates the properties of the given \a timer
- * This function is called in a separate thread for each timer that we use.
- * This is **not** the best way to implement a timer, but its effective,
- * easy to understand and efficient. Also, this implementation does not need
- * to play with the kernel/OS to compare elapsed times periodically.
+ * Moves the timer at the given \a index down in the heap until both of its
+ * children expire after it does
  */
-static void* update_timer (void* ptr)
+static void queue_sift_down (int index)
 {
-    if (!ptr)
-        return NULL;
+    for (;;) {
+        int smallest = index;
+        int left = (2 * index) + 1;
+        int right = (2 * index) + 2;
+
+        if (left < queue_size &&
+            queue [left]->deadline < queue [smallest]->deadline)
+            smallest = left;
 
-    DS_Timer* timer = (DS_Timer*) ptr;
+        if (right < queue_size &&
+            queue [right]->deadline < queue [smallest]->deadline)
+            smallest = right;
 
-    while (running == 1) {
-        if (timer->enabled && timer->time > 0 && !timer->expired) {
-            timer->elapsed += timer->precision;
+        if (smallest == index)
+            break;
 
-            if (timer->elapsed >= timer->time)
-                timer->expired = 1;
+        queue_swap (index, smallest);
+        index = smallest;
+    }
+}
+
+/**
+ * Removes the given \a timer from the queue (if it is queued)
+ * \note The service lock must be held by the caller
+ */
+static void queue_remove (DS_Timer* timer)
+{
+    int index = timer->queue_index;
+    if (index < 0 || index >= queue_size || queue [index] != timer)
+        return;
+
+    --queue_size;
+    timer->queue_index = -1;
+
+    if (index != queue_size) {
+        queue [index] = queue [queue_size];
+        queue [index]->queue_index = index;
+        queue_sift_up (index);
+        queue_sift_down (queue [index]->queue_index);
+    }
+}
+
+/**
+ * Inserts the given \a timer in the queue, the timer's deadline must be set
+ * before calling this function.
+ *
+ * \note The service lock must be held by the caller
+ */
+static void queue_insert (DS_Timer* timer)
+{
+    if (queue_size >= queue_capacity) {
+        queue_capacity = DS_Max (queue_capacity * 2, 8);
+        queue = (DS_Timer**) realloc (queue,
+                                      queue_capacity * sizeof (DS_Timer*));
+    }
+
+    timer->queue_index = queue_size;
+    queue [queue_size++] = timer;
+    queue_sift_up (timer->queue_index);
+}
+
+/**
+ * (Re)schedules the given \a timer so that it expires \a time milliseconds
+ * from now, the service thread is woken up if the timer becomes the next one
+ * to expire.
+ */
+static void schedule_timer (DS_Timer* timer)
+{
+    pthread_mutex_lock (&service_lock);
+
+    queue_remove (timer);
+
+    if (timer->enabled && timer->time > 0) {
+        timer->deadline = DS_GetTime() + MSEC_TO_NSEC (timer->time);
+        queue_insert (timer);
+
+        if (timer->queue_index == 0)
+            pthread_cond_signal (&service_cond);
+    }
+
+    pthread_mutex_unlock (&service_lock);
+}
+
+/**
+ * Runs the timer service, which sleeps until the next timer deadline and
+ * marks every timer whose deadline (minus its precision) has been reached as
+ * expired. Timers with similar deadlines are expired in the same wake-up,
+ * and the thread does not wake up at all if there are no enabled timers.
+ */
+static void* run_timer_service (void* ptr)
+{
+    (void) ptr;
+
+    pthread_mutex_lock (&service_lock);
+
+    while (running) {
+        /* No timers are queued, wait until one is started */
+        if (queue_size <= 0) {
+            pthread_cond_wait (&service_cond, &service_lock);
+            continue;
         }
 
-        DS_Sleep (timer->precision);
+        /* Expire all timers that are (almost) due */
+        uint64_t now = DS_GetTime();
+        while (queue_size > 0) {
+            DS_Timer* timer = queue [0];
+            uint64_t slack = MSEC_TO_NSEC (timer->precision);
+
+            if (timer->deadline > now + slack)
+                break;
+
+            queue_remove (timer);
+            timer->expired = 1;
+            timer->elapsed = timer->time;
+        }
+
+        /* Sleep until the next timer expires */
+        if (queue_size > 0)
+            DS_CondWaitUntil (&service_cond, &service_lock, queue [0]->deadline);
     }
 
+    pthread_mutex_unlock (&service_lock);
     return NULL;
 }
 
 /**
- * Initializes the timer array, which is used to keep track of all the timers
- * used by the library. We need to do this so that we can terminate each timer
- * thread once the module is closed.
+ * Initializes the timer queue and starts the timer service thread, which is
+ * shared by every timer used by the library.
  */
 void Timers_Init()
 {
+    /* Initialize the service condition */
+    DS_CondInit (&service_cond);
+
+    /* Reset the timer queue */
+    queue_size = 0;
+    queue_capacity = 0;
+    DS_FREE (queue);
+
+    /* Start the service thread */
     running = 1;
-    DS_ArrayInit (&timers, 10);
+    int err = pthread_create (&service_thread, NULL, &run_timer_service, NULL);
+
+    /* Report thread creation errors */
+    if (err) {
+        running = 0;
+        fprintf (stderr, "Cannot create timer thread, error %d\n", err);
+    }
 }
 
 /**
- * Breaks all the timer loops and stops every thread used by this module
+ * Stops the timer service thread and waits for it to finish
  */
 void Timers_Close()
 {
+    int joinable = running;
+
+    /* Break the service loop */
+    pthread_mutex_lock (&service_lock);
     running = 0;
-    DS_ArrayFree (&timers);
+    pthread_cond_signal (&service_cond);
+    pthread_mutex_unlock (&service_lock);
+
+    /* Wait for the thread to exit */
+    if (joinable)
+        pthread_join (service_thread, NULL);
+
+    /* Un-queue the remaining timers */
+    int i;
+    for (i = 0; i < queue_size; ++i)
+        queue [i]->queue_index = -1;
+
+    /* De-allocate the queue */
+    queue_size = 0;
+    queue_capacity = 0;
+    DS_FREE (queue);
+    pthread_cond_destroy (&service_cond);
+}
+
+/**
+ * Returns the current time of the system's monotonic clock (in nanoseconds).
+ * The returned value is only useful to measure time intervals.
+ */
+uint64_t DS_GetTime()
+{
+#if defined _WIN32
+    LARGE_INTEGER count;
+    static LARGE_INTEGER frequency;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency (&frequency);
+
+    QueryPerformanceCounter (&count);
+    return (uint64_t) ((double) count.QuadPart * 1e9 / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+/**
+ * Initializes the given condition variable so that it can be used with
+ * DS_CondWaitUntil(). The condition uses the monotonic clock when the
+ * platform supports it.
+ */
+void DS_CondInit (pthread_cond_t* cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init (&attr);
+#if !defined _WIN32 && !defined __APPLE__
+    pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+#endif
+    pthread_cond_init (cond, &attr);
+    pthread_condattr_destroy (&attr);
+}
+
+/**
+ * Waits on the given condition variable until it is signaled or until the
+ * monotonic clock reaches the given \a deadline (in nanoseconds).
+ *
+ * The \a mutex must be locked by the caller and the condition must have
+ * been initialized with DS_CondInit(). Returns \c ETIMEDOUT if the deadline
+ * was reached, otherwise it returns \c 0.
+ */
+int DS_CondWaitUntil (pthread_cond_t* cond,
+                      pthread_mutex_t* mutex,
+                      const uint64_t deadline)
+{
+    struct timespec ts;
+    uint64_t target = deadline;
+
+    /* Condition does not use the monotonic clock, convert to real time */
+#if defined _WIN32 || defined __APPLE__
+    uint64_t now = DS_GetTime();
+    uint64_t remaining = (deadline > now) ? deadline - now : 0;
+
+    clock_gettime (CLOCK_REALTIME, &ts);
+    target = ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec + remaining;
+#endif
+
+    ts.tv_sec = (time_t) (target / 1000000000ULL);
+    ts.tv_nsec = (long) (target % 1000000000ULL);
+
+    return pthread_cond_timedwait (cond, mutex, &ts);
 }
 
 /**
  * Pauses the execution state of the program/thread for the given
  * number of \a millisecs.
- *
- * We use this function to update each timer based on its precision
  */
 void DS_Sleep (const int millisecs)
 {
@@ -99,6 +351,39 @@ void DS_Sleep (const int millisecs)
 #endif
 }
 
+/**
+ * Pauses the execution state of the program/thread until the monotonic
+ * clock reaches the given \a deadline (in nanoseconds, see DS_GetTime()).
+ *
+ * Sleeping until an absolute time (instead of sleeping for an interval) does
+ * not accumulate the time spent by the caller between two sleeps, which
+ * allows periodic tasks to run on a fixed time grid without drifting.
+ */
+void DS_SleepUntil (const uint64_t deadline)
+{
+#if defined __linux__
+    struct timespec ts;
+    ts.tv_sec = (time_t) (deadline / 1000000000ULL);
+    ts.tv_nsec = (long) (deadline % 1000000000ULL);
+
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        continue;
+#else
+    uint64_t now = DS_GetTime();
+    if (deadline <= now)
+        return;
+
+    #if defined _WIN32
+    Sleep ((DWORD) ((deadline - now + 999999ULL) / 1000000ULL));
+    #else
+    struct timespec ts;
+    ts.tv_sec = (time_t) ((deadline - now) / 1000000000ULL);
+    ts.tv_nsec = (long) ((deadline - now) % 1000000000ULL);
+    nanosleep (&ts, NULL);
+    #endif
+#endif
+}
+
 /**
  * Resets and disables the given \a timer
  */
@@ -108,6 +393,7 @@ void DS_TimerStop (DS_Timer* timer)
         timer->enabled = 0;
         timer->expired = 0;
         timer->elapsed = 0;
+        schedule_timer (timer);
     }
 }
 
@@ -120,6 +406,7 @@ void DS_TimerStart (DS_Timer* timer)
         timer->enabled = 1;
         timer->expired = 0;
         timer->elapsed = 0;
+        schedule_timer (timer);
     }
 }
 
@@ -131,21 +418,21 @@ void DS_TimerReset (DS_Timer* timer)
     if (timer) {
         timer->expired = 0;
         timer->elapsed = 0;
+        schedule_timer (timer);
     }
 }
 
 /**
  * Initializes the given \a timer with the given \a time and \a precision.
- * The timers are updated using a threaded while loop (that sleeps the number
- * of milliseconds specified with \a precision). As stated before, this is
- * probably not the best timer implementation out there, but its simple and
- * it works perfectly for this library.
  *
- * A word of advice, using a higher \a precision (lower value in msecs) will
- * result in increased CPU usage, this thing does not have morals and will eat
- * the whole cake if you allow it.
+ * Timers do not have threads of their own, the timer service keeps all
+ * enabled timers in a queue sorted by their deadlines and sleeps until the
+ * earliest one expires. The \a precision (in milliseconds) is the delay that
+ * the timer tolerates, which allows the service to expire several timers
+ * with close deadlines in a single wake-up.
  *
- * This function will return \c 0 if the timer thread fails to start.
+ * This function will return \c 0 if the timer is invalid or if it has
+ * already been initialized.
  */
 int DS_TimerInit (DS_Timer* timer, const int time, const int precision)
 {
@@ -159,19 +446,12 @@ int DS_TimerInit (DS_Timer* timer, const int time, const int precision)
         timer->expired = 0;
         timer->elapsed = 0;
         timer->time = time;
+        timer->deadline = 0;
         timer->initialized = 1;
+        timer->queue_index = -1;
         timer->precision = precision;
 
-        /* Configure the thread */
-        pthread_t thread;
-        int err = pthread_create (&thread, NULL, &update_timer, (void*) timer);
-
-        /* Report thread creation errors */
-        if (err)
-            fprintf (stderr, "Cannot create timer thread, error %d\n", err);
-
-        /* Return 1 if there are no errors */
-        return (err == 0);
+        return 1;
     }
 
     return 0;
@@ -0,0 +1,33 @@
+TEMPLATE = app
+TARGET = LibDS_Tests
+
+CONFIG -= qt
+CONFIG += console
+
+include ($$PWD/../LibDS.pri)
+
+HEADERS += \
+    $$PWD/tests.h
+
+SOURCES += \
+    $$PWD/main.c \
+    $$PWD/test_sockets.c \
+    $$PWD/test_discovery.c \
+    $$PWD/test_latency.c \
+    $$PWD/test_loss.c \
+    $$PWD/test_contexts.c \
+    $$PWD/test_allocations.c \
+    $$PWD/test_joysticks.c \
+    $$PWD/test_crc32.c \
+    $$PWD/test_capture.c \
+    $$PWD/test_events.c \
+    $$PWD/test_netconsole.c \
+    $$PWD/test_state.c
+
+#
+# Build with "qmake CONFIG+=tsan" to run the tests under ThreadSanitizer
+#
+tsan {
+    QMAKE_CFLAGS += -fsanitize=thread -g
+    QMAKE_LFLAGS += -fsanitize=thread
+}
@@ -0,0 +1,78 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+
+#include <stdlib.h>
+
+static int failed = 0;
+static int current_failed = 0;
+static int total_run = 0;
+static int total_failed = 0;
+
+/**
+ * Marks the current test as failed
+ */
+void Tests_Fail()
+{
+    current_failed = 1;
+}
+
+/**
+ * Runs the given \a test and prints its result
+ */
+void Tests_Run (const char* name, void (*test)())
+{
+    current_failed = 0;
+    test();
+
+    ++total_run;
+    if (current_failed) {
+        ++total_failed;
+        failed = 1;
+    }
+
+    printf ("%s: %s\n", current_failed ? "FAIL" : "PASS", name);
+}
+
+/**
+ * Runs every test and returns a non-zero exit code if any of them failed
+ */
+int main()
+{
+    Test_Sockets();
+    Test_Discovery();
+    Test_Latency();
+    Test_Loss();
+    Test_Contexts();
+    Test_Allocations();
+    Test_Joysticks();
+    Test_CRC32();
+    Test_Capture();
+    Test_Events();
+    Test_NetConsole();
+    Test_State();
+
+    printf ("\n%d tests, %d failed\n", total_run, total_failed);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
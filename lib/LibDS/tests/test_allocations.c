@@ -0,0 +1,179 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+
+#include <stdlib.h>
+
+#define WARMUP_PACKETS  50  /* Packets sent before counting allocations */
+#define COUNTED_PACKETS 100 /* Packets sent while counting allocations */
+
+/*
+ * The allocation counter wraps the allocator of the GNU C library, other
+ * platforms (and sanitizer builds, which replace the allocator) only check
+ * that the packets are generated and sent
+ */
+#if defined __GLIBC__ && \
+    !defined __SANITIZE_ADDRESS__ && !defined __SANITIZE_THREAD__
+extern void* __libc_malloc (size_t size);
+extern void* __libc_calloc (size_t count, size_t size);
+extern void* __libc_realloc (void* ptr, size_t size);
+
+static __thread int counting = 0;
+static __thread unsigned long allocations = 0;
+
+void* malloc (size_t size)
+{
+    allocations += counting;
+    return __libc_malloc (size);
+}
+
+void* calloc (size_t count, size_t size)
+{
+    allocations += counting;
+    return __libc_calloc (count, size);
+}
+
+void* realloc (void* ptr, size_t size)
+{
+    allocations += counting;
+    return __libc_realloc (ptr, size);
+}
+#else
+static int counting = 0;
+static unsigned long allocations = 0;
+#endif
+
+/**
+ * Generates and sends one packet on each channel of the current protocol,
+ * in the same way as the event loop, and returns the number of robot
+ * packets that were sent successfully
+ */
+static int send_packets (DS_Packet* packet)
+{
+    DS_Protocol* protocol = DS_CurrentProtocol();
+
+    packet->length = 0;
+    protocol->create_fms_packet (packet);
+    DS_SocketSendBuffer (protocol->fms_socket, packet->data, packet->length);
+
+    packet->length = 0;
+    protocol->create_radio_packet (packet);
+    DS_SocketSendBuffer (protocol->radio_socket, packet->data, packet->length);
+
+    packet->length = 0;
+    protocol->create_robot_packet (packet);
+    return DS_SocketSendBuffer (protocol->robot_socket,
+                                packet->data, packet->length) > 0;
+}
+
+/**
+ * Loads the given \a protocol with six joysticks, waits until the robot
+ * address is resolved and returns the number of heap allocations done while
+ * sending the next packets (or \c -1 if the packets could not be sent)
+ */
+static long steady_state_allocations (DS_Protocol* protocol)
+{
+    int i;
+    int sent = 0;
+    static DS_Packet packet;
+
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    protocol->netconsole_socket->in_port = 0;
+    DS_SetCustomRobotAddress ("127.0.0.1");
+    DS_ConfigureProtocol (protocol);
+
+    DS_JoysticksReset();
+    for (i = 0; i < 6; ++i) {
+        DS_JoysticksAdd (6, 1, 12);
+        DS_SetJoystickAxis (i, 0, 0.5);
+        DS_SetJoystickButton (i, 3, 1);
+        DS_SetJoystickHat (i, 0, 90);
+    }
+
+    /* Wait for the address to be resolved */
+    for (i = 0; i < 200 && sent < WARMUP_PACKETS; ++i) {
+        sent += send_packets (&packet);
+        DS_Sleep (1);
+    }
+
+    if (sent < WARMUP_PACKETS)
+        return -1;
+
+    /* Count the allocations done by the steady-state packets */
+    sent = 0;
+    allocations = 0;
+    counting = 1;
+    for (i = 0; i < COUNTED_PACKETS; ++i)
+        sent += send_packets (&packet);
+    counting = 0;
+
+    if (sent < COUNTED_PACKETS || packet.length <= 0)
+        return -1;
+
+    return (long) allocations;
+}
+
+/**
+ * The 2014 protocol must not allocate memory to send packets
+ */
+static void test_frc_2014()
+{
+    TEST_ASSERT (steady_state_allocations (DS_GetProtocolFRC_2014()) == 0);
+}
+
+/**
+ * The 2015 protocol must not allocate memory to send packets
+ */
+static void test_frc_2015()
+{
+    TEST_ASSERT (steady_state_allocations (DS_GetProtocolFRC_2015()) == 0);
+}
+
+/**
+ * The 2016 protocol must not allocate memory to send packets
+ */
+static void test_frc_2016()
+{
+    TEST_ASSERT (steady_state_allocations (DS_GetProtocolFRC_2016()) == 0);
+}
+
+/**
+ * Runs the packet allocation tests
+ */
+void Test_Allocations()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_frc_2014);
+    RUN_TEST (test_frc_2015);
+    RUN_TEST (test_frc_2016);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
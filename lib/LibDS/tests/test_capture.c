@@ -0,0 +1,293 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+#include "DS_Capture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Capture file used by the tests (removed after each test)
+ */
+#define CAPTURE_FILE "LibDS_Tests.cap"
+
+/*
+ * Size of the file header and of the record headers
+ */
+#define HEADER_SIZE 16
+
+/**
+ * Writes a FRC 2015 robot packet with the given \a voltage and robot code
+ * flag to the given \a capture
+ */
+static void write_robot_packet (DS_Capture* capture,
+                                const int voltage,
+                                const int code)
+{
+    uint8_t packet [8] = {0};
+    packet [4] = code ? 0x20 : 0x00;
+    packet [5] = (uint8_t) voltage;
+
+    DS_CaptureWrite (capture, DS_CAPTURE_ROBOT, DS_CAPTURE_INBOUND,
+                     packet, sizeof (packet));
+}
+
+/**
+ * The records read from a capture must match the records written to it, in
+ * the same order, a truncated record must not be returned, and opening the
+ * capture again must replace the old records
+ */
+static void test_round_trip()
+{
+    remove (CAPTURE_FILE);
+
+    const char* message = "NetConsole";
+    const uint8_t packet [] = {0x00, 0x01, 0x01, 0x00, 0x00, 0x00};
+
+    /* This record must be replaced */
+    DS_Capture* capture = DS_CaptureOpen (CAPTURE_FILE);
+    DS_CaptureWrite (capture, DS_CAPTURE_FMS, DS_CAPTURE_OUTBOUND,
+                     message, strlen (message));
+    DS_CaptureClose (capture);
+
+    /* Write three records (the third one is cut below) */
+    capture = DS_CaptureOpen (CAPTURE_FILE);
+    DS_CaptureWrite (capture, DS_CAPTURE_ROBOT, DS_CAPTURE_OUTBOUND,
+                     packet, sizeof (packet));
+    DS_CaptureWrite (capture, DS_CAPTURE_NETCONSOLE, DS_CAPTURE_INBOUND,
+                     message, strlen (message));
+    DS_CaptureWrite (capture, DS_CAPTURE_FMS, DS_CAPTURE_INBOUND,
+                     packet, sizeof (packet));
+    DS_CaptureClose (capture);
+
+    uint8_t contents [256];
+    FILE* file = fopen (CAPTURE_FILE, "rb");
+    size_t size = fread (contents, 1, sizeof (contents), file);
+    fclose (file);
+
+    file = fopen (CAPTURE_FILE, "wb");
+    fwrite (contents, 1, size - 4, file);
+    fclose (file);
+
+    DS_CaptureRecord first;
+    DS_CaptureRecord second;
+    DS_CaptureRecord third;
+    DS_CaptureReader* reader = DS_CaptureReaderOpen (CAPTURE_FILE);
+
+    TEST_ASSERT (reader != NULL);
+    TEST_ASSERT (DS_CaptureReaderNext (reader, &first));
+    TEST_ASSERT (DS_CaptureReaderNext (reader, &second));
+    TEST_ASSERT (!DS_CaptureReaderNext (reader, &third));
+
+    TEST_ASSERT (first.channel == DS_CAPTURE_ROBOT);
+    TEST_ASSERT (first.direction == DS_CAPTURE_OUTBOUND);
+    TEST_ASSERT (first.length == sizeof (packet));
+    TEST_ASSERT (memcmp (first.data, packet, sizeof (packet)) == 0);
+
+    TEST_ASSERT (second.channel == DS_CAPTURE_NETCONSOLE);
+    TEST_ASSERT (second.direction == DS_CAPTURE_INBOUND);
+    TEST_ASSERT (second.length == (int) strlen (message));
+    TEST_ASSERT (memcmp (second.data, message, strlen (message)) == 0);
+    TEST_ASSERT (second.time >= first.time);
+
+    /* Records start on 8-byte boundaries */
+    TEST_ASSERT ((second.data - first.data) % 8 == 0);
+
+    DS_CaptureReaderClose (reader);
+    remove (CAPTURE_FILE);
+}
+
+/**
+ * Files that are not captures must be rejected
+ */
+static void test_invalid_file()
+{
+    FILE* file = fopen (CAPTURE_FILE, "wb");
+    fputs ("This is not a capture file", file);
+    fclose (file);
+
+    TEST_ASSERT (DS_CaptureReaderOpen (CAPTURE_FILE) == NULL);
+    TEST_ASSERT (DS_CaptureReaderOpen ("LibDS_Missing.cap") == NULL);
+
+    remove (CAPTURE_FILE);
+}
+
+/**
+ * Replaying a capture must give the inbound datagrams to the protocol and
+ * skip the outbound datagrams
+ */
+static void test_replay()
+{
+    remove (CAPTURE_FILE);
+
+    DS_Protocol* protocol = DS_GetProtocolFRC_2015();
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    protocol->netconsole_socket->in_port = 0;
+    DS_ConfigureProtocol (protocol);
+
+    const uint8_t outbound [6] = {0};
+    const uint8_t invalid [3] = {0};
+
+    DS_Capture* capture = DS_CaptureOpen (CAPTURE_FILE);
+    write_robot_packet (capture, 10, 0);
+    DS_CaptureWrite (capture, DS_CAPTURE_ROBOT, DS_CAPTURE_OUTBOUND,
+                     outbound, sizeof (outbound));
+    DS_CaptureWrite (capture, DS_CAPTURE_ROBOT, DS_CAPTURE_INBOUND,
+                     invalid, sizeof (invalid));
+    write_robot_packet (capture, 12, 1);
+    DS_CaptureClose (capture);
+
+    DS_ReplayStats stats;
+    int replayed = DS_ReplayCapture (CAPTURE_FILE, 0, &stats);
+
+    TEST_ASSERT (replayed);
+    TEST_ASSERT (stats.packets == 3);
+    TEST_ASSERT (stats.accepted == 2);
+    TEST_ASSERT (stats.skipped == 1);
+    TEST_ASSERT (stats.bytes == 8 + 3 + 8);
+    TEST_ASSERT (DS_GetRobotCode() == 1);
+    TEST_ASSERT (DS_GetRobotVoltage() == 12);
+
+    remove (CAPTURE_FILE);
+}
+
+/**
+ * A realtime replay must not wait when the record times go backwards (e.g.
+ * two captures joined together), it must start timing again instead
+ */
+static void test_replay_backwards()
+{
+    remove (CAPTURE_FILE);
+
+    DS_Protocol* protocol = DS_GetProtocolFRC_2015();
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    protocol->netconsole_socket->in_port = 0;
+    DS_ConfigureProtocol (protocol);
+
+    DS_Capture* capture = DS_CaptureOpen (CAPTURE_FILE);
+    write_robot_packet (capture, 10, 0);
+    write_robot_packet (capture, 12, 1);
+    DS_CaptureClose (capture);
+
+    /* Move the first record one hour ahead of the second one */
+    uint8_t contents [256];
+    FILE* file = fopen (CAPTURE_FILE, "rb");
+    size_t size = fread (contents, 1, sizeof (contents), file);
+    fclose (file);
+
+    /* The second record starts after the file header and the first record */
+    int i;
+    uint64_t time = 0;
+    int second = HEADER_SIZE + HEADER_SIZE + 8;
+    for (i = 7; i >= 0; --i)
+        time = (time << 8) | contents [second + i];
+
+    time += 3600ULL * 1000000000ULL;
+    for (i = 0; i < 8; ++i)
+        contents [HEADER_SIZE + i] = (uint8_t) (time >> (8 * i));
+
+    file = fopen (CAPTURE_FILE, "wb");
+    fwrite (contents, 1, size, file);
+    fclose (file);
+
+    DS_CaptureRecord first;
+    DS_CaptureRecord last;
+    DS_CaptureReader* reader = DS_CaptureReaderOpen (CAPTURE_FILE);
+    int read = DS_CaptureReaderNext (reader, &first) &&
+               DS_CaptureReaderNext (reader, &last);
+    int backwards = read && first.time > last.time;
+    DS_CaptureReaderClose (reader);
+
+    DS_ReplayStats stats;
+    int replayed = DS_ReplayCapture (CAPTURE_FILE, 1, &stats);
+
+    TEST_ASSERT (backwards);
+    TEST_ASSERT (replayed);
+    TEST_ASSERT (stats.packets == 2);
+    TEST_ASSERT (stats.time < 1000000000ULL);
+    TEST_ASSERT (DS_GetRobotVoltage() == 12);
+
+    remove (CAPTURE_FILE);
+}
+
+/**
+ * Every datagram sent by the protocol must be written to the capture of the
+ * context, until the capture is stopped
+ */
+static void test_live_capture()
+{
+    remove (CAPTURE_FILE);
+
+    DS_Protocol* protocol = DS_GetProtocolFRC_2015();
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    protocol->netconsole_socket->in_port = 0;
+    DS_ConfigureProtocol (protocol);
+
+    int started = DS_StartCapture (CAPTURE_FILE);
+    Protocols_Start();
+    DS_Sleep (100);
+    DS_StopCapture();
+    Protocols_Stop();
+
+    int robot = 0;
+    int inbound = 0;
+    DS_CaptureRecord record;
+    DS_CaptureReader* reader = DS_CaptureReaderOpen (CAPTURE_FILE);
+    while (DS_CaptureReaderNext (reader, &record)) {
+        robot += (record.channel == DS_CAPTURE_ROBOT);
+        inbound += (record.direction == DS_CAPTURE_INBOUND);
+    }
+
+    DS_CaptureReaderClose (reader);
+
+    TEST_ASSERT (started);
+    TEST_ASSERT (robot > 0);
+    TEST_ASSERT (inbound == 0);
+
+    remove (CAPTURE_FILE);
+}
+
+/**
+ * Runs the capture and replay tests
+ */
+void Test_Capture()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_round_trip);
+    RUN_TEST (test_invalid_file);
+    RUN_TEST (test_replay);
+    RUN_TEST (test_replay_backwards);
+    RUN_TEST (test_live_capture);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
@@ -0,0 +1,162 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+
+#include <pthread.h>
+
+static DS_Context* thread_context = NULL;
+
+/**
+ * Stores the context used by a new thread
+ */
+static void* get_thread_context (void* ptr)
+{
+    (void) ptr;
+    thread_context = DS_CurrentContext();
+    return NULL;
+}
+
+/**
+ * Each context must have its own configuration and events, and changing
+ * the current context must only affect the calling thread
+ */
+static void test_isolation()
+{
+    DS_Event event;
+    pthread_t thread;
+
+    DS_Context* context = DS_ContextCreate();
+    TEST_ASSERT (context != NULL);
+    TEST_ASSERT (DS_CurrentContext() == DS_DefaultContext());
+
+    /* Drain the events of the default context */
+    while (DS_PollEvent (&event));
+
+    /* Change the team number and the enabled state of the new context */
+    DS_SetCurrentContext (context);
+    DS_SetTeamNumber (3794);
+    DS_SetRobotEnabled (1);
+    int team = DS_GetTeamNumber();
+    int events = DS_PollEvent (&event);
+
+    /* Other threads keep using the default context */
+    pthread_create (&thread, NULL, &get_thread_context, NULL);
+    pthread_join (thread, NULL);
+
+    /* Check that the default context was not changed */
+    DS_SetCurrentContext (NULL);
+    int default_team = DS_GetTeamNumber();
+    int default_events = DS_PollEvent (&event);
+
+    DS_ContextDestroy (context);
+
+    TEST_ASSERT (team == 3794);
+    TEST_ASSERT (events);
+    TEST_ASSERT (default_team == 0);
+    TEST_ASSERT (default_events == 0);
+    TEST_ASSERT (thread_context == DS_DefaultContext());
+}
+
+/**
+ * Each context must run its own protocol with its own packet counters,
+ * driven by the shared event loop
+ */
+static void test_shared_event_loop()
+{
+    int i;
+    DS_Context* contexts [4];
+
+    for (i = 0; i < 4; ++i) {
+        contexts [i] = DS_ContextCreate();
+        DS_SetCurrentContext (contexts [i]);
+
+        DS_Protocol* protocol = DS_GetProtocolFRC_2015();
+        protocol->fms_socket->in_port = 0;
+        protocol->robot_socket->in_port = 0;
+        protocol->netconsole_socket->in_port = 0;
+        DS_SetCustomRobotAddress ("127.0.0.1");
+        DS_ConfigureProtocol (protocol);
+    }
+
+    DS_SetCurrentContext (NULL);
+    DS_Sleep (200);
+
+    /* Every context must have sent about 10 robot packets (50 Hz) */
+    int sent = 1;
+    for (i = 0; i < 4; ++i) {
+        DS_SetCurrentContext (contexts [i]);
+        sent &= (DS_GetSendStats (DS_CHANNEL_ROBOT).sent >= 5);
+        DS_SetCurrentContext (NULL);
+        DS_ContextDestroy (contexts [i]);
+    }
+
+    /* The default context has no protocol, so it sent nothing */
+    int idle = (DS_GetSendStats (DS_CHANNEL_ROBOT).sent == 0);
+
+    TEST_ASSERT (sent);
+    TEST_ASSERT (idle);
+}
+
+/**
+ * Replacing the protocol of a context while the event loop sends and
+ * receives its packets must not make the loop use the freed protocol
+ */
+static void test_reconfigure()
+{
+    int i;
+    DS_Context* context = DS_ContextCreate();
+    DS_SetCurrentContext (context);
+    DS_SetCustomRobotAddress ("127.0.0.1");
+
+    for (i = 0; i < 20; ++i) {
+        DS_Protocol* protocol = DS_GetProtocolFRC_2015();
+        protocol->fms_socket->in_port = 0;
+        protocol->robot_socket->in_port = 0;
+        protocol->netconsole_socket->in_port = 0;
+        DS_ConfigureProtocol (protocol);
+        DS_Sleep (10);
+    }
+
+    int sent = (DS_GetSendStats (DS_CHANNEL_ROBOT).sent > 0);
+
+    DS_SetCurrentContext (NULL);
+    DS_ContextDestroy (context);
+
+    TEST_ASSERT (sent);
+}
+
+/**
+ * Runs the context tests
+ */
+void Test_Contexts()
+{
+    DS_Init();
+
+    RUN_TEST (test_isolation);
+    RUN_TEST (test_shared_event_loop);
+    RUN_TEST (test_reconfigure);
+
+    DS_Close();
+}
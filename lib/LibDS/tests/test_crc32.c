@@ -0,0 +1,174 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+
+#include <string.h>
+
+#define MAX_LENGTH 2048 /* Longest buffer checked */
+
+/**
+ * Fills the given \a buffer with pseudo-random bytes
+ */
+static void fill_random (uint8_t* buffer, const int length)
+{
+    int i;
+    uint32_t seed = 0x12345678;
+
+    for (i = 0; i < length; ++i) {
+        seed = seed * 1103515245 + 12345;
+        buffer [i] = (uint8_t) (seed >> 16);
+    }
+}
+
+/**
+ * Every kernel must give the standard CRC32 check value
+ */
+static void test_check_value()
+{
+    const char* data = "123456789";
+
+    TEST_ASSERT (DS_CRC32Bytewise (data, 9) == 0xCBF43926);
+    TEST_ASSERT (DS_CRC32Slice8 (data, 9) == 0xCBF43926);
+    TEST_ASSERT (DS_CRC32Folding (data, 9) == 0xCBF43926);
+    TEST_ASSERT (DS_CRC32 (data, 9) == 0xCBF43926);
+    TEST_ASSERT (DS_CRC32 (data, 0) == 0);
+}
+
+/**
+ * The fast kernels must give the same checksums as the table version for
+ * every length and alignment (which exercises every tail of every kernel)
+ */
+static void test_conformance()
+{
+    int offset;
+    int length;
+    int matches = 1;
+    static uint8_t buffer [MAX_LENGTH + 16];
+
+    fill_random (buffer, sizeof (buffer));
+
+    for (offset = 0; offset < 16; ++offset) {
+        for (length = 0; length <= MAX_LENGTH; ++length) {
+            const uint8_t* data = buffer + offset;
+            uint32_t expected = DS_CRC32Bytewise (data, length);
+
+            matches &= (DS_CRC32Slice8 (data, length) == expected);
+            matches &= (DS_CRC32Folding (data, length) == expected);
+            matches &= (DS_CRC32 (data, length) == expected);
+        }
+    }
+
+    TEST_ASSERT (matches);
+}
+
+/**
+ * Updating a checksum with the changed bytes must give the same checksum as
+ * processing the whole changed message
+ */
+static void test_patch()
+{
+    int i;
+    int matches = 1;
+    uint8_t before [16];
+    static uint8_t buffer [MAX_LENGTH];
+
+    fill_random (buffer, sizeof (buffer));
+    uint32_t crc = DS_CRC32 (buffer, sizeof (buffer));
+
+    for (i = 0; i < 500; ++i) {
+        int span = 1 + (i % 16);
+        int offset = (i * 37) % (MAX_LENGTH - span + 1);
+
+        memcpy (before, buffer + offset, span);
+        buffer [offset] ^= (uint8_t) (i + 1);
+        buffer [offset + span - 1] ^= (uint8_t) (i * 7);
+
+        crc = DS_CRC32Patch (crc, before, buffer + offset, span,
+                             MAX_LENGTH - offset - span);
+        matches &= (crc == DS_CRC32 (buffer, sizeof (buffer)));
+    }
+
+    TEST_ASSERT (matches);
+}
+
+/**
+ * The checksum of every FRC 2014 robot packet must match the checksum of
+ * the packet data (with the checksum bytes set to zero)
+ */
+static void test_frc_2014_checksum()
+{
+    int i;
+    int matches = 1;
+    static DS_Packet packet;
+
+    DS_Protocol* protocol = DS_GetProtocolFRC_2014();
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    DS_ConfigureProtocol (protocol);
+
+    DS_JoysticksReset();
+    DS_JoysticksAdd (6, 0, 10);
+    DS_SetRobotEnabled (1);
+
+    for (i = 0; i < 300; ++i) {
+        DS_SetJoystickAxis (0, i % 6, (i % 3) * 0.25);
+        DS_SetJoystickButton (0, i % 10, i & 1);
+        DS_SetRobotEnabled ((i % 50) < 40);
+
+        packet.length = 0;
+        protocol->create_robot_packet (&packet);
+
+        uint32_t sent = ((uint32_t) packet.data [1020] << 24)
+                        | ((uint32_t) packet.data [1021] << 16)
+                        | ((uint32_t) packet.data [1022] << 8)
+                        | ((uint32_t) packet.data [1023]);
+
+        memset (packet.data + 1020, 0, 4);
+        matches &= (packet.length == 1024);
+        matches &= (packet.data [72] == 0x30 && packet.data [79] == 0x30);
+        matches &= (sent == DS_CRC32 (packet.data, 1024));
+    }
+
+    TEST_ASSERT (matches);
+}
+
+/**
+ * Runs the CRC32 tests
+ */
+void Test_CRC32()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_check_value);
+    RUN_TEST (test_conformance);
+    RUN_TEST (test_patch);
+    RUN_TEST (test_frc_2014_checksum);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
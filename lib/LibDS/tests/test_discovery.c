@@ -0,0 +1,204 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Tests the robot discovery module with stand-in robots that answer on
+ * different loopback addresses (127.0.0.x), the fastest robot must win.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+
+#include <socky.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+
+#define DS_PORT    11610
+#define ROBOT_PORT 11611
+
+/**
+ * Holds the configuration of a stand-in robot
+ */
+typedef struct {
+    const char* address;
+    int delay;
+} Robot;
+
+static atomic_int robots_running = 0;
+
+/**
+ * Answers every packet received on the robot address/port after waiting
+ * the configured delay, the answer is sent to the DS port of the sender
+ */
+static void* run_robot (void* ptr)
+{
+    Robot* robot = (Robot*) ptr;
+
+    /* Bind the robot socket to its loopback address */
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons (ROBOT_PORT);
+    inet_pton (AF_INET, robot->address, &addr.sin_addr);
+
+    int sfd = socket (AF_INET, SOCK_DGRAM, 0);
+    if (bind (sfd, (struct sockaddr*) &addr, sizeof (addr)) != 0) {
+        close (sfd);
+        return NULL;
+    }
+
+    while (robots_running) {
+        fd_set set;
+        struct timeval tv = { 0, 10000 };
+
+        FD_ZERO (&set);
+        FD_SET (sfd, &set);
+        if (select (sfd + 1, &set, NULL, NULL, &tv) <= 0)
+            continue;
+
+        /* Read the probe */
+        char buffer [64];
+        struct sockaddr_in sender;
+        socklen_t len = sizeof (sender);
+        if (recvfrom (sfd, buffer, sizeof (buffer), 0,
+                      (struct sockaddr*) &sender, &len) <= 0)
+            continue;
+
+        /* Answer the probe */
+        DS_Sleep (robot->delay);
+        sender.sin_port = htons (DS_PORT);
+        sendto (sfd, "pong", 4, 0, (struct sockaddr*) &sender, len);
+    }
+
+    close (sfd);
+    return NULL;
+}
+
+/**
+ * The discovery module must lock on to the first robot that answers, and
+ * forget it (and probe again) when it is reset
+ */
+static void test_first_answer_wins()
+{
+    int i;
+    pthread_t threads [2];
+    Robot robots [2] = { { "127.0.0.4", 100 }, { "127.0.0.3", 0 } };
+
+    /* Start the stand-in robots */
+    robots_running = 1;
+    for (i = 0; i < 2; ++i)
+        pthread_create (&threads [i], NULL, &run_robot, &robots [i]);
+
+    /* Open the DS socket */
+    DS_Socket* socket = DS_SocketEmpty();
+    socket->in_port = DS_PORT;
+    socket->out_port = ROBOT_PORT;
+    DS_SocketOpen (socket);
+
+    /* Add the candidates (the first one has no robot) */
+    DS_AddRobotAddressCandidate ("127.0.0.5");
+    DS_AddRobotAddressCandidate ("127.0.0.4");
+    DS_AddRobotAddressCandidate ("127.0.0.3");
+
+    /* Send probes every 20 ms until a robot answers */
+    bstring probe = bfromcstr ("ping");
+    uint64_t start = DS_GetTime();
+    while (Discovery_Active() && DS_GetTime() - start < 1000000000ULL) {
+        bstring data, source = NULL;
+        Discovery_SendProbes (socket, probe->data, blength (probe));
+        DS_SocketWaitForData (DS_GetTime() + 20000000ULL);
+
+        while ((data = DS_SocketReadFrom (socket, &source))) {
+            Discovery_ProbeAnswered (source);
+            bdestroy (source);
+            bdestroy (data);
+        }
+    }
+
+    /* Stop the robots */
+    robots_running = 0;
+    for (i = 0; i < 2; ++i)
+        pthread_join (threads [i], NULL);
+
+    /* Check that the fastest robot was discovered */
+    bstring address = Discovery_GetAddress();
+    int found = address && biseqcstr (address, "127.0.0.3");
+    bdestroy (address);
+
+    /* Reset the discovery */
+    Discovery_Reset();
+    int active = Discovery_Active();
+
+    /* Clean up */
+    bdestroy (probe);
+    DS_SocketClose (socket);
+    DS_FREE (socket);
+    DS_ClearRobotAddressCandidates();
+
+    TEST_ASSERT (found);
+    TEST_ASSERT (active);
+}
+
+/**
+ * The discovery must stay disabled while a custom robot address is set,
+ * even if the discovery is reset (e.g. when the robot watchdog expires)
+ */
+static void test_custom_address()
+{
+    int initial = Discovery_Active();
+
+    DS_SetCustomRobotAddress ("127.0.0.1");
+    int custom = Discovery_Active();
+
+    Discovery_Reset();
+    int reset = Discovery_Active();
+
+    DS_SetCustomRobotAddress ("");
+    int cleared = Discovery_Active();
+
+    TEST_ASSERT (initial);
+    TEST_ASSERT (!custom);
+    TEST_ASSERT (!reset);
+    TEST_ASSERT (cleared);
+}
+
+/**
+ * Runs the discovery module tests
+ */
+void Test_Discovery()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_first_answer_wins);
+    RUN_TEST (test_custom_address);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
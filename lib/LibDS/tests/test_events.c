@@ -0,0 +1,465 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+
+#include <pthread.h>
+
+#ifndef _WIN32
+    #include <poll.h>
+#endif
+
+#define PRODUCERS  4     /* Threads that add events at the same time */
+#define PER_THREAD 50000 /* Events added by each producer thread */
+
+/*
+ * Test events are null events (which LibDS never generates) that carry the
+ * producer number and a sequence number in their joystick count
+ */
+#define EVENT_ID(producer, number) (((producer) << 24) | (number))
+#define EVENT_PRODUCER(id)         ((id) >> 24)
+#define EVENT_NUMBER(id)           ((id) & 0xffffff)
+
+static int producers_done = 0;
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Adds a test event with the given \a id
+ */
+static void add_event (const int id)
+{
+    DS_Event event;
+    event.joystick.type = DS_NULL_EVENT;
+    event.joystick.count = id;
+    DS_AddEvent (&event);
+}
+
+/**
+ * Removes every pending event from the queue
+ */
+static void drain()
+{
+    DS_Event event;
+    while (DS_PollEvent (&event));
+}
+
+/**
+ * Adds the events of one producer thread, mixed with voltage events (which
+ * are conflated)
+ */
+static void* producer (void* data)
+{
+    int i;
+    DS_Event voltage;
+    int number = *((int*) data);
+
+    for (i = 0; i < PER_THREAD; ++i) {
+        add_event (EVENT_ID (number, i));
+
+        if ((i % 16) == 0) {
+            voltage.robot.type = DS_ROBOT_VOLTAGE_CHANGED;
+            voltage.robot.voltage = i;
+            DS_AddEvent (&voltage);
+        }
+    }
+
+    pthread_mutex_lock (&done_lock);
+    ++producers_done;
+    pthread_mutex_unlock (&done_lock);
+
+    return NULL;
+}
+
+/**
+ * Returns the number of producer threads that finished
+ */
+static int finished_producers()
+{
+    pthread_mutex_lock (&done_lock);
+    int done = producers_done;
+    pthread_mutex_unlock (&done_lock);
+
+    return done;
+}
+
+/**
+ * Adds a test event after waiting for a while
+ */
+static void* delayed_producer (void* data)
+{
+    (void) data;
+
+    DS_Sleep (20);
+    add_event (EVENT_ID (0, 1));
+
+    return NULL;
+}
+
+/**
+ * Returns \c 1 if the given file descriptor can be read without blocking
+ */
+static int readable (const int fd)
+{
+#ifndef _WIN32
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    return poll (&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+#else
+    (void) fd;
+    return 0;
+#endif
+}
+
+/**
+ * Events must be polled in the order that they were added
+ */
+static void test_order()
+{
+    int i;
+    int ordered = 1;
+    DS_Event event;
+
+    drain();
+    for (i = 0; i < 100; ++i)
+        add_event (EVENT_ID (0, i));
+
+    for (i = 0; i < 100; ++i) {
+        if (!DS_PollEvent (&event) || event.joystick.count != EVENT_ID (0, i))
+            ordered = 0;
+    }
+
+    TEST_ASSERT (ordered);
+    TEST_ASSERT (DS_PollEvent (&event) == 0);
+}
+
+/**
+ * DS_PollEvents() must drain up to the given number of events, in order
+ */
+static void test_batch()
+{
+    int i;
+    int ordered = 1;
+    DS_Event buffer [64];
+
+    drain();
+    for (i = 0; i < 100; ++i)
+        add_event (EVENT_ID (0, i));
+
+    int first = DS_PollEvents (buffer, 64);
+    for (i = 0; i < first; ++i)
+        ordered &= (buffer [i].joystick.count == EVENT_ID (0, i));
+
+    int second = DS_PollEvents (buffer, 64);
+    for (i = 0; i < second; ++i)
+        ordered &= (buffer [i].joystick.count == EVENT_ID (0, first + i));
+
+    TEST_ASSERT (first == 64);
+    TEST_ASSERT (second == 36);
+    TEST_ASSERT (ordered);
+    TEST_ASSERT (DS_PollEvents (buffer, 64) == 0);
+    TEST_ASSERT (DS_PollEvents (buffer, 0) == 0);
+}
+
+/**
+ * Only the event types included in the event mask must be queued
+ */
+static void test_mask()
+{
+    DS_Event event;
+
+    drain();
+    DS_SetEventMask (DS_EVENT_MASK (DS_ROBOT_VOLTAGE_CHANGED));
+
+    int voltage = Events_Subscribed (DS_ROBOT_VOLTAGE_CHANGED);
+    int netconsole = Events_Subscribed (DS_NETCONSOLE_NEW_MESSAGE);
+
+    event.netconsole.type = DS_NETCONSOLE_NEW_MESSAGE;
+    event.netconsole.handle = 1;
+    DS_AddEvent (&event);
+
+    event.robot.type = DS_ROBOT_ENABLED_CHANGED;
+    DS_AddEvent (&event);
+
+    event.robot.type = DS_ROBOT_VOLTAGE_CHANGED;
+    event.robot.voltage = 12;
+    DS_AddEvent (&event);
+
+    int first = DS_PollEvent (&event);
+    DS_EventType type = event.type;
+    int second = DS_PollEvent (&event);
+
+    DS_SetEventMask (DS_ALL_EVENTS);
+
+    TEST_ASSERT (voltage);
+    TEST_ASSERT (!netconsole);
+    TEST_ASSERT (first);
+    TEST_ASSERT (type == DS_ROBOT_VOLTAGE_CHANGED);
+    TEST_ASSERT (!second);
+    TEST_ASSERT (DS_GetEventMask() == DS_ALL_EVENTS);
+}
+
+/**
+ * Events added while the queue is full must be dropped (and counted), the
+ * events that were already queued must be kept
+ */
+static void test_overflow()
+{
+    int i;
+    int kept = 1;
+    DS_Event event;
+    DS_EventStats before;
+    DS_EventStats full;
+
+    drain();
+    DS_GetEventStats (&before);
+
+    for (i = 0; i < DS_EVENT_QUEUE_SIZE + 10; ++i)
+        add_event (EVENT_ID (0, i));
+
+    DS_GetEventStats (&full);
+
+    for (i = 0; i < DS_EVENT_QUEUE_SIZE; ++i) {
+        if (!DS_PollEvent (&event) || event.joystick.count != EVENT_ID (0, i))
+            kept = 0;
+    }
+
+    TEST_ASSERT (kept);
+    TEST_ASSERT (full.pending == DS_EVENT_QUEUE_SIZE);
+    TEST_ASSERT (full.dropped - before.dropped == 10);
+    TEST_ASSERT (full.added - before.added == DS_EVENT_QUEUE_SIZE);
+
+    /* The queue must be usable again after it was full */
+    add_event (EVENT_ID (0, 1));
+    TEST_ASSERT (DS_PollEvent (&event) == 1);
+    TEST_ASSERT (event.joystick.count == EVENT_ID (0, 1));
+}
+
+/**
+ * With conflation enabled, value events must be polled once (at the position
+ * of the first one) with the latest value, while edge events keep their order
+ */
+static void test_conflation()
+{
+    int i;
+    int edges = 0;
+    int voltages = 0;
+    int ordered = 1;
+    float voltage = 0;
+    DS_Event event;
+    DS_EventStats before;
+    DS_EventStats after;
+
+    drain();
+    DS_SetEventConflation (1);
+    DS_GetEventStats (&before);
+
+    for (i = 0; i < 100; ++i) {
+        event.robot.type = DS_ROBOT_VOLTAGE_CHANGED;
+        event.robot.voltage = i;
+        DS_AddEvent (&event);
+
+        event.robot.type = DS_ROBOT_ENABLED_CHANGED;
+        event.robot.enabled = i;
+        DS_AddEvent (&event);
+    }
+
+    DS_GetEventStats (&after);
+
+    while (DS_PollEvent (&event)) {
+        if (event.type == DS_ROBOT_VOLTAGE_CHANGED) {
+            voltage = event.robot.voltage;
+            ordered &= (edges == 0);
+            ++voltages;
+        }
+
+        else if (event.type == DS_ROBOT_ENABLED_CHANGED)
+            ordered &= (event.robot.enabled == edges++);
+    }
+
+    DS_SetEventConflation (0);
+
+    TEST_ASSERT (ordered);
+    TEST_ASSERT (edges == 100);
+    TEST_ASSERT (voltages == 1);
+    TEST_ASSERT (voltage == 99);
+    TEST_ASSERT (after.merged - before.merged == 99);
+    TEST_ASSERT (after.pending == 101);
+
+    /* Without conflation every value event is queued */
+    for (i = 0; i < 10; ++i) {
+        event.robot.type = DS_ROBOT_VOLTAGE_CHANGED;
+        DS_AddEvent (&event);
+    }
+
+    for (voltages = 0; DS_PollEvent (&event); ++voltages);
+    TEST_ASSERT (voltages == 10);
+}
+
+/**
+ * DS_WaitEvent() must return when its timeout expires, and as soon as an
+ * event is added by another thread
+ */
+static void test_wait()
+{
+    DS_Event event;
+    pthread_t thread;
+
+    drain();
+
+    uint64_t start = DS_GetTime();
+    int timed_out = !DS_WaitEvent (&event, 20);
+    uint64_t waited = DS_GetTime() - start;
+
+    pthread_create (&thread, NULL, &delayed_producer, NULL);
+    start = DS_GetTime();
+    int woken = DS_WaitEvent (&event, 5000);
+    uint64_t latency = DS_GetTime() - start;
+    pthread_join (thread, NULL);
+
+    TEST_ASSERT (timed_out);
+    TEST_ASSERT (waited >= 19000000);
+    TEST_ASSERT (woken);
+    TEST_ASSERT (event.joystick.count == EVENT_ID (0, 1));
+    TEST_ASSERT (latency < 1000000000);
+    TEST_ASSERT (DS_WaitEvent (&event, 0) == 0);
+}
+
+/**
+ * The wake-up descriptor must become readable when an event is added to the
+ * empty queue, and stop being readable once the events are polled
+ */
+static void test_wake_fd()
+{
+    DS_Event event;
+    int fd = DS_GetEventFd();
+
+#ifdef _WIN32
+    TEST_ASSERT (fd == -1);
+    return;
+#endif
+
+    drain();
+    int idle = readable (fd);
+
+    add_event (EVENT_ID (0, 1));
+    add_event (EVENT_ID (0, 2));
+    int signaled = readable (fd);
+
+    drain();
+    int cleared = !readable (fd);
+
+    TEST_ASSERT (fd >= 0);
+    TEST_ASSERT (!idle);
+    TEST_ASSERT (signaled);
+    TEST_ASSERT (cleared);
+    TEST_ASSERT (DS_PollEvent (&event) == 0);
+}
+
+/**
+ * Several threads add events while the main thread polls them, every event
+ * must be received once and in the order of its producer (or be counted as
+ * dropped). The dropped count also includes the voltage events.
+ */
+static void test_stress()
+{
+    int i;
+    int ordered = 1;
+    DS_Event event;
+    DS_EventStats before;
+    DS_EventStats after;
+    unsigned long received = 0;
+    int numbers [PRODUCERS];
+    int next [PRODUCERS] = {0};
+    pthread_t threads [PRODUCERS];
+
+    drain();
+    producers_done = 0;
+    DS_SetEventConflation (1);
+    DS_GetEventStats (&before);
+
+    for (i = 0; i < PRODUCERS; ++i) {
+        numbers [i] = i;
+        pthread_create (&threads [i], NULL, &producer, &numbers [i]);
+    }
+
+    /* Poll until every producer finished and the queue is empty */
+    for (;;) {
+        int done = finished_producers() == PRODUCERS;
+        int polled = 0;
+
+        while (DS_PollEvent (&event)) {
+            polled = 1;
+            if (event.type != DS_NULL_EVENT)
+                continue;
+
+            int id = event.joystick.count;
+            int thread = EVENT_PRODUCER (id);
+            if (thread >= PRODUCERS || EVENT_NUMBER (id) < next [thread])
+                ordered = 0;
+            else
+                next [thread] = EVENT_NUMBER (id) + 1;
+
+            ++received;
+        }
+
+        if (done && !polled)
+            break;
+    }
+
+    for (i = 0; i < PRODUCERS; ++i)
+        pthread_join (threads [i], NULL);
+
+    DS_GetEventStats (&after);
+    DS_SetEventConflation (0);
+
+    TEST_ASSERT (ordered);
+    TEST_ASSERT (after.pending == 0);
+    TEST_ASSERT (received <= PRODUCERS * PER_THREAD);
+    TEST_ASSERT (received + (after.dropped - before.dropped)
+                 >= PRODUCERS * PER_THREAD);
+}
+
+/**
+ * Runs the event queue tests
+ */
+void Test_Events()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_order);
+    RUN_TEST (test_batch);
+    RUN_TEST (test_mask);
+    RUN_TEST (test_overflow);
+    RUN_TEST (test_conflation);
+    RUN_TEST (test_wait);
+    RUN_TEST (test_wake_fd);
+    RUN_TEST (test_stress);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
@@ -0,0 +1,253 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+ * Offsets of the joystick values in a FRC 2015 robot packet, with two
+ * joysticks of two axes, four buttons and one hat (11 bytes per joystick)
+ */
+#define BUTTONS_0 13 /* Lower button byte of the first joystick */
+#define AXIS_1    20 /* First axis of the second joystick */
+
+#define UPDATES 20000
+
+static atomic_int writer_done;
+
+/**
+ * Generates a new robot packet with the current protocol
+ */
+static DS_Packet* robot_packet()
+{
+    static DS_Packet packet;
+
+    packet.length = 0;
+    DS_CurrentProtocol()->create_robot_packet (&packet);
+    return &packet;
+}
+
+/**
+ * The version of a joystick must only change when one of its values changes
+ */
+static void test_versions()
+{
+    DS_JoysticksReset();
+    DS_JoysticksAdd (2, 1, 4);
+    DS_JoysticksAdd (2, 1, 4);
+
+    unsigned int first = DS_GetJoystickVersion (0);
+    unsigned int second = DS_GetJoystickVersion (1);
+
+    DS_SetJoystickAxis (0, 0, 0);
+    DS_SetJoystickButton (0, 0, 0);
+    int unchanged = (DS_GetJoystickVersion (0) == first);
+
+    DS_SetJoystickAxis (0, 0, 0.5);
+    int changed = (DS_GetJoystickVersion (0) != first);
+
+    TEST_ASSERT (first != 0 && second != 0 && first != second);
+    TEST_ASSERT (unchanged);
+    TEST_ASSERT (changed);
+    TEST_ASSERT (DS_GetJoystickVersion (1) == second);
+    TEST_ASSERT (DS_GetJoystickVersion (2) == 0);
+}
+
+/**
+ * A whole joystick frame must be applied with a single version, and
+ * publishing the same frame again must not change the version
+ */
+static void test_bulk_state()
+{
+    float axes[] = { 0.5, -1 };
+    int hats[] = { 90 };
+
+    DS_JoysticksReset();
+    DS_JoysticksAdd (2, 1, 4);
+    DS_SetRobotEnabled (1);
+
+    unsigned int first = DS_GetJoystickVersion (0);
+    DS_SetJoystickState (0, axes, 0xff, hats);
+    unsigned int second = DS_GetJoystickVersion (0);
+
+    DS_SetJoystickState (0, axes, 0x0f, hats);
+    int unchanged = (DS_GetJoystickVersion (0) == second);
+
+    DS_SetJoystickState (0, NULL, 0x0f, NULL);
+    int kept = (DS_GetJoystickVersion (0) == second);
+
+    DS_SetJoystickState (5, axes, 0x0f, hats);
+
+    TEST_ASSERT (second != first);
+    TEST_ASSERT (unchanged);
+    TEST_ASSERT (kept);
+    TEST_ASSERT (DS_GetJoystickButtons (0) == 0x0f);
+    TEST_ASSERT (DS_GetJoystickButton (0, 3) == 1);
+    TEST_ASSERT (DS_GetJoystickButton (0, 4) == 0);
+    TEST_ASSERT (DS_GetJoystickAxis (0, 1) == -1);
+    TEST_ASSERT (DS_GetFByte (DS_GetJoystickAxis (0, 0), 1) ==
+                 DS_GetFByte (0.5, 1));
+    TEST_ASSERT (DS_GetJoystickHat (0, 0) == 90);
+
+    DS_SetRobotEnabled (0);
+    TEST_ASSERT (DS_GetJoystickButtons (0) == 0);
+    TEST_ASSERT (DS_GetJoystickAxis (0, 1) == 0);
+}
+
+/**
+ * Joysticks, axes, hats and buttons beyond the store capacity are ignored
+ */
+static void test_capacity()
+{
+    int i;
+    DS_JoysticksReset();
+
+    DS_JoysticksAdd (DS_MAX_JOYSTICK_AXES + 1, DS_MAX_JOYSTICK_HATS + 1,
+                     DS_MAX_JOYSTICK_BUTTONS + 1);
+
+    for (i = 0; i < DS_MAX_JOYSTICKS; ++i)
+        DS_JoysticksAdd (2, 0, 4);
+
+    TEST_ASSERT (DS_GetJoystickCount() == DS_MAX_JOYSTICKS);
+    TEST_ASSERT (DS_GetJoystickNumAxes (0) == DS_MAX_JOYSTICK_AXES);
+    TEST_ASSERT (DS_GetJoystickNumHats (0) == DS_MAX_JOYSTICK_HATS);
+    TEST_ASSERT (DS_GetJoystickNumButtons (0) == DS_MAX_JOYSTICK_BUTTONS);
+    TEST_ASSERT (DS_GetJoystickVersion (-1) == 0);
+
+    DS_JoysticksReset();
+    TEST_ASSERT (DS_GetJoystickCount() == 0);
+}
+
+/**
+ * The joystick data sent to the robot must follow the joystick values and
+ * the enabled state of the robot, even if the joystick data is cached
+ */
+static void test_cached_encoding()
+{
+    int i;
+    DS_Protocol* protocol = DS_GetProtocolFRC_2015();
+    protocol->fms_socket->in_port = 0;
+    protocol->robot_socket->in_port = 0;
+    protocol->netconsole_socket->in_port = 0;
+    DS_ConfigureProtocol (protocol);
+
+    DS_JoysticksReset();
+    DS_JoysticksAdd (2, 1, 4);
+    DS_JoysticksAdd (2, 1, 4);
+    DS_SetRobotEnabled (1);
+
+    /* Joystick data is sent after the first packets */
+    for (i = 0; i < 10; ++i)
+        robot_packet();
+
+    DS_Packet* packet = robot_packet();
+    int length = packet->length;
+    int neutral = (packet->data [AXIS_1] == 0);
+
+    DS_SetJoystickAxis (1, 0, 0.5);
+    DS_SetJoystickButton (0, 2, 1);
+    packet = robot_packet();
+    int axis = (packet->data [AXIS_1] == DS_GetFByte (0.5, 1));
+    int buttons = (packet->data [BUTTONS_0] == 0x04);
+
+    DS_SetRobotEnabled (0);
+    packet = robot_packet();
+    int disabled = (packet->data [AXIS_1] == 0) &&
+                   (packet->data [BUTTONS_0] == 0);
+
+    TEST_ASSERT (length == 6 + 2 * 11);
+    TEST_ASSERT (neutral);
+    TEST_ASSERT (axis);
+    TEST_ASSERT (buttons);
+    TEST_ASSERT (disabled);
+}
+
+/**
+ * Updates the second joystick from another thread, the last update leaves
+ * the first axis at \c 0.5 with the first button pressed
+ */
+static void* write_joystick (void* unused)
+{
+    int i;
+    (void) unused;
+
+    for (i = 0; i < UPDATES; ++i) {
+        float axes [2] = { (i % 2) ? 0.5 : -0.5, 0 };
+        int hats [1] = { i % 360 };
+        DS_SetJoystickState (1, axes, (i % 2) ? 0x01 : 0x02, hats);
+    }
+
+    atomic_store (&writer_done, 1);
+    return NULL;
+}
+
+/**
+ * Joystick values that change while the protocol encodes them must not be
+ * cached with a version that hides the change
+ */
+static void test_concurrent_encoding()
+{
+    pthread_t writer;
+
+    DS_JoysticksReset();
+    DS_JoysticksAdd (2, 1, 4);
+    DS_JoysticksAdd (2, 1, 4);
+    DS_SetRobotEnabled (1);
+
+    atomic_store (&writer_done, 0);
+    pthread_create (&writer, NULL, &write_joystick, NULL);
+
+    while (!atomic_load (&writer_done))
+        robot_packet();
+
+    pthread_join (writer, NULL);
+
+    DS_Packet* packet = robot_packet();
+    int axis = (packet->data [AXIS_1] == DS_GetFByte (0.5, 1));
+
+    DS_SetRobotEnabled (0);
+    TEST_ASSERT (axis);
+}
+
+/**
+ * Runs the joystick tests
+ */
+void Test_Joysticks()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_versions);
+    RUN_TEST (test_bulk_state);
+    RUN_TEST (test_capacity);
+    RUN_TEST (test_cached_encoding);
+    RUN_TEST (test_concurrent_encoding);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
@@ -0,0 +1,91 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+
+#define DELAY 5000000ULL /* Simulated round-trip time (5 ms) */
+
+/**
+ * Every echoed packet must add one RTT sample, and the statistics must
+ * reflect the time elapsed between the send and the echo
+ */
+static void test_echo_matching()
+{
+    unsigned int i;
+    DS_ResetLatencyStats (DS_CHANNEL_ROBOT);
+
+    /* Send packets and echo them after the simulated delay */
+    for (i = 0; i < 100; ++i)
+        DS_PacketSent (DS_CHANNEL_ROBOT, i);
+
+    DS_SleepUntil (DS_GetTime() + DELAY);
+
+    for (i = 0; i < 100; ++i)
+        DS_PacketEchoed (DS_CHANNEL_ROBOT, i);
+
+    DS_LatencyStats stats = DS_GetLatencyStats (DS_CHANNEL_ROBOT);
+    TEST_ASSERT (stats.samples == 100);
+    TEST_ASSERT (stats.min >= DELAY / 1000000.0);
+    TEST_ASSERT (stats.min <= stats.p50);
+    TEST_ASSERT (stats.p50 <= stats.p99);
+    TEST_ASSERT (stats.mean >= stats.min && stats.mean <= stats.p99);
+}
+
+/**
+ * Duplicated echoes, unknown sequence numbers and echoes on channels that
+ * did not send the packet must not add RTT samples
+ */
+static void test_invalid_echoes()
+{
+    DS_ResetLatencyStats (DS_CHANNEL_FMS);
+    DS_ResetLatencyStats (DS_CHANNEL_ROBOT);
+
+    DS_PacketSent (DS_CHANNEL_ROBOT, 10);
+    DS_PacketEchoed (DS_CHANNEL_ROBOT, 10);
+    DS_PacketEchoed (DS_CHANNEL_ROBOT, 10);
+    DS_PacketEchoed (DS_CHANNEL_ROBOT, 11);
+    DS_PacketEchoed (DS_CHANNEL_FMS, 10);
+
+    /* Sequence numbers wrap around at 16 bits */
+    DS_PacketSent (DS_CHANNEL_ROBOT, 0x10005);
+    DS_PacketEchoed (DS_CHANNEL_ROBOT, 0x0005);
+
+    TEST_ASSERT (DS_GetLatencyStats (DS_CHANNEL_ROBOT).samples == 2);
+    TEST_ASSERT (DS_GetLatencyStats (DS_CHANNEL_FMS).samples == 0);
+}
+
+/**
+ * Runs the latency measurement tests
+ */
+void Test_Latency()
+{
+    Timers_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_echo_matching);
+    RUN_TEST (test_invalid_echoes);
+
+    Contexts_Close();
+    Timers_Close();
+}
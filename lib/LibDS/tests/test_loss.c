@@ -0,0 +1,139 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+
+/**
+ * Feeds the downlink loss window of the FMS channel with the given
+ * sequence numbers
+ */
+static void receive (const unsigned int* sequence, const int count)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+        DS_PacketReceived (DS_CHANNEL_FMS, sequence [i]);
+}
+
+/**
+ * Gaps in the sequence numbers must be counted as loss bursts
+ */
+static void test_loss_bursts()
+{
+    unsigned int i;
+    DS_ResetLossStats (DS_CHANNEL_FMS);
+
+    /* Lose 3 packets in a row, and then a single packet */
+    for (i = 0; i < 100; ++i) {
+        if ((i < 10 || i > 12) && i != 50)
+            DS_PacketReceived (DS_CHANNEL_FMS, i);
+    }
+
+    DS_LossStats stats = DS_GetDownlinkLoss (DS_CHANNEL_FMS);
+    TEST_ASSERT (stats.expected == 100);
+    TEST_ASSERT (stats.lost == 4);
+    TEST_ASSERT (stats.bursts == 2);
+    TEST_ASSERT (stats.max_burst == 3);
+    TEST_ASSERT (stats.mean_burst == 2);
+    TEST_ASSERT (stats.loss == 4);
+}
+
+/**
+ * Late packets must be counted as reordered (not lost), duplicates must be
+ * ignored and the sequence numbers must wrap around at 16 bits
+ */
+static void test_reordering()
+{
+    unsigned int sequence [] = { 65533, 65534, 0, 65535, 1, 1, 2, 3 };
+    DS_ResetLossStats (DS_CHANNEL_FMS);
+    receive (sequence, sizeof (sequence) / sizeof (sequence [0]));
+
+    DS_LossStats stats = DS_GetDownlinkLoss (DS_CHANNEL_FMS);
+    TEST_ASSERT (stats.expected == 7);
+    TEST_ASSERT (stats.lost == 0);
+    TEST_ASSERT (stats.reordered == 1);
+    TEST_ASSERT (stats.loss == 0);
+}
+
+/**
+ * An older packet must only recover its loss once, even if it is repeated,
+ * and a duplicate of a packet that was not lost must not recover any loss
+ */
+static void test_old_duplicates()
+{
+    unsigned int sequence [] = { 1, 2, 4, 5, 6, 3, 3, 2, 5 };
+    DS_ResetLossStats (DS_CHANNEL_FMS);
+    receive (sequence, sizeof (sequence) / sizeof (sequence [0]));
+
+    DS_LossStats stats = DS_GetDownlinkLoss (DS_CHANNEL_FMS);
+    TEST_ASSERT (stats.expected == 6);
+    TEST_ASSERT (stats.lost == 0);
+    TEST_ASSERT (stats.reordered == 1);
+
+    /* Packet 8 is lost, and old duplicates must not hide it */
+    unsigned int more [] = { 7, 9, 3, 4, 6 };
+    receive (more, sizeof (more) / sizeof (more [0]));
+
+    stats = DS_GetDownlinkLoss (DS_CHANNEL_FMS);
+    TEST_ASSERT (stats.expected == 9);
+    TEST_ASSERT (stats.lost == 1);
+    TEST_ASSERT (stats.reordered == 1);
+}
+
+/**
+ * A very large jump (e.g. the peer restarted) must not be counted as loss,
+ * and echoes must only update the uplink window
+ */
+static void test_resync()
+{
+    unsigned int sequence [] = { 5000, 5001, 0, 1, 2 };
+    DS_ResetLossStats (DS_CHANNEL_FMS);
+    receive (sequence, sizeof (sequence) / sizeof (sequence [0]));
+
+    DS_PacketEchoed (DS_CHANNEL_FMS, 7);
+    DS_PacketEchoed (DS_CHANNEL_FMS, 9);
+
+    DS_LossStats down = DS_GetDownlinkLoss (DS_CHANNEL_FMS);
+    DS_LossStats up = DS_GetUplinkLoss (DS_CHANNEL_FMS);
+    TEST_ASSERT (down.lost == 0);
+    TEST_ASSERT (down.expected == 5);
+    TEST_ASSERT (up.lost == 1);
+    TEST_ASSERT (up.expected == 3);
+}
+
+/**
+ * Runs the packet loss estimator tests
+ */
+void Test_Loss()
+{
+    Timers_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_loss_bursts);
+    RUN_TEST (test_reordering);
+    RUN_TEST (test_old_duplicates);
+    RUN_TEST (test_resync);
+
+    Contexts_Close();
+    Timers_Close();
+}
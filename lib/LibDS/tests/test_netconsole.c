@@ -0,0 +1,174 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+#include "DS_Config.h"
+
+#include <string.h>
+
+/**
+ * Adds a message through the config module (like the protocols do) and
+ * returns the handle carried by its event, or \c 0 if there was no event
+ */
+static uint64_t add_message (const char* text)
+{
+    DS_Event event;
+    CFG_AddNetConsoleMessage (text, strlen (text));
+
+    while (DS_PollEvent (&event)) {
+        if (event.type == DS_NETCONSOLE_NEW_MESSAGE)
+            return event.netconsole.handle;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns \c 1 if the message with the given \a handle is equal to \a text
+ */
+static int message_equals (const uint64_t handle, const char* text)
+{
+    DS_NetConsoleMessage message;
+    if (!DS_GetNetConsoleMessage (handle, &message))
+        return 0;
+
+    int equal = message.length == (int) strlen (text) &&
+                memcmp (message.data, text, message.length) == 0;
+
+    DS_ReleaseNetConsoleMessage();
+    return equal;
+}
+
+/**
+ * Messages must be readable (as views) from the handles of their events
+ */
+static void test_views()
+{
+    uint64_t first = add_message ("Hello");
+    uint64_t second = add_message ("World");
+
+    TEST_ASSERT (first != 0);
+    TEST_ASSERT (second == first + 1);
+    TEST_ASSERT (message_equals (first, "Hello"));
+    TEST_ASSERT (message_equals (second, "World"));
+    TEST_ASSERT (!message_equals (0, ""));
+    TEST_ASSERT (!message_equals (second + 1, ""));
+}
+
+/**
+ * Old messages must be overwritten (and counted as dropped if they were not
+ * read) when the buffer is full, new messages must never be split
+ */
+static void test_overwrite()
+{
+    int i;
+    static char text [1000];
+    int intact = 1;
+    uint64_t handles [200];
+    unsigned long dropped = DS_GetNetConsoleDroppedMessages();
+
+    memset (text, 'x', sizeof (text) - 1);
+    text [sizeof (text) - 1] = '\0';
+
+    /* Write about three times the size of the buffer */
+    for (i = 0; i < 200; ++i)
+        handles [i] = add_message (text);
+
+    /* The newest messages must be intact */
+    for (i = 200 - DS_NETCONSOLE_BUFFER_SIZE / 1000; i < 200; ++i)
+        intact &= message_equals (handles [i], text);
+
+    unsigned long lost = DS_GetNetConsoleDroppedMessages() - dropped;
+
+    TEST_ASSERT (intact);
+    TEST_ASSERT (!message_equals (handles [0], text));
+    TEST_ASSERT (lost >= 200 - DS_NETCONSOLE_BUFFER_SIZE / 1000);
+    TEST_ASSERT (lost < 200);
+}
+
+/**
+ * A message that is being viewed must not be overwritten, new messages are
+ * dropped instead until the view is released
+ */
+static void test_pinned()
+{
+    int i;
+    static char text [1000];
+    DS_NetConsoleMessage message;
+
+    memset (text, 'y', sizeof (text) - 1);
+    text [sizeof (text) - 1] = '\0';
+
+    uint64_t viewed = add_message ("Viewed message");
+    int found = DS_GetNetConsoleMessage (viewed, &message);
+
+    /* Fill the buffer twice */
+    int added = 0;
+    for (i = 0; i < 2 * DS_NETCONSOLE_BUFFER_SIZE / 1000; ++i)
+        added += (add_message (text) != 0);
+
+    int intact = message.length == 14 &&
+                 memcmp (message.data, "Viewed message", 14) == 0;
+
+    DS_ReleaseNetConsoleMessage();
+    uint64_t next = add_message (text);
+
+    TEST_ASSERT (found);
+    TEST_ASSERT (intact);
+    TEST_ASSERT (added < 2 * DS_NETCONSOLE_BUFFER_SIZE / 1000);
+    TEST_ASSERT (next != 0);
+    TEST_ASSERT (!message_equals (viewed, "Viewed message"));
+}
+
+/**
+ * Messages must not be stored if the application does not subscribe to
+ * NetConsole events
+ */
+static void test_unsubscribed()
+{
+    DS_SetEventMask (DS_ALL_EVENTS & ~DS_EVENT_MASK (DS_NETCONSOLE_NEW_MESSAGE));
+    uint64_t handle = add_message ("Nobody reads this");
+    DS_SetEventMask (DS_ALL_EVENTS);
+
+    TEST_ASSERT (handle == 0);
+}
+
+/**
+ * Runs the NetConsole buffer tests
+ */
+void Test_NetConsole()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_views);
+    RUN_TEST (test_overwrite);
+    RUN_TEST (test_pinned);
+    RUN_TEST (test_unsubscribed);
+
+    Contexts_Close();
+    Sockets_Close();
+    Timers_Close();
+}
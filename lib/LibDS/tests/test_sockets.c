@@ -0,0 +1,192 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+
+#include <socky.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define PORT         11600
+#define BURST_SIZE   16
+#define BURST_COUNT  500
+
+static int sender = -1;
+static volatile int sent = 0;
+
+/**
+ * Sends a datagram with the given sequence number to the test socket
+ */
+static void send_sequence (const int sequence)
+{
+    char data [32];
+    int length = snprintf (data, sizeof (data), "%d", sequence);
+    udp_sendto (sender, data, length, "127.0.0.1", "11600", 0);
+}
+
+/**
+ * Returns the sequence number stored in the given datagram
+ */
+static int read_sequence (const bstring data)
+{
+    return atoi ((char*) data->data);
+}
+
+/**
+ * Opens the test socket (and the sender socket)
+ */
+static DS_Socket* open_socket()
+{
+    DS_Socket* socket = DS_SocketEmpty();
+    socket->in_port = PORT;
+    socket->out_port = PORT + 1;
+    DS_SocketOpen (socket);
+
+    sender = create_client_udp (SOCKY_IPv4, 0);
+    return socket;
+}
+
+/**
+ * Closes the test socket (and the sender socket)
+ */
+static void close_socket (DS_Socket* socket)
+{
+    socket_close (sender);
+    DS_SocketClose (socket);
+    DS_FREE (socket);
+}
+
+/**
+ * Sends bursts of datagrams every millisecond (16 kHz)
+ */
+static void* send_bursts (void* ptr)
+{
+    (void) ptr;
+
+    int i, j;
+    for (i = 0; i < BURST_COUNT; ++i) {
+        for (j = 0; j < BURST_SIZE; ++j)
+            send_sequence (sent++);
+
+        DS_Sleep (1);
+    }
+
+    return NULL;
+}
+
+/**
+ * Datagrams received while nobody reads the socket must be kept in order
+ * until the ring is full, the rest must be dropped and counted
+ */
+static void test_ring_overflow()
+{
+    int i;
+    DS_Socket* socket = open_socket();
+    TEST_ASSERT (socket->info.server_init);
+
+    /* Send more datagrams than the ring can hold */
+    for (i = 0; i < DS_SOCKET_RING_SIZE * 3; ++i)
+        send_sequence (i);
+
+    /* Let the reactor read the datagrams */
+    DS_Sleep (100);
+
+    /* Only the first datagrams are kept */
+    bstring data;
+    int received = 0;
+    while ((data = DS_SocketRead (socket))) {
+        int sequence = read_sequence (data);
+        bdestroy (data);
+
+        TEST_ASSERT (sequence == received);
+        ++received;
+    }
+
+    TEST_ASSERT (received == DS_SOCKET_RING_SIZE);
+    TEST_ASSERT (DS_SocketDroppedPackets (socket) == DS_SOCKET_RING_SIZE * 2);
+
+    close_socket (socket);
+}
+
+/**
+ * Datagrams sent in bursts at kHz rates must be read in order, without
+ * duplicates, and every datagram must be either read or counted as dropped
+ */
+static void test_burst_stress()
+{
+    DS_Socket* socket = open_socket();
+    TEST_ASSERT (socket->info.server_init);
+
+    /* Start sending datagrams */
+    sent = 0;
+    pthread_t thread;
+    pthread_create (&thread, NULL, &send_bursts, NULL);
+
+    /* Read datagrams until the sender finishes (and the socket is empty) */
+    int last = -1;
+    int received = 0;
+    int in_order = 1;
+    uint64_t idle_since = DS_GetTime();
+
+    while (DS_GetTime() - idle_since < 200000000ULL) {
+        bstring data;
+        DS_SocketWaitForData (DS_GetTime() + 10000000ULL);
+
+        while ((data = DS_SocketRead (socket))) {
+            int sequence = read_sequence (data);
+            bdestroy (data);
+
+            in_order &= (sequence > last);
+            idle_since = DS_GetTime();
+            last = sequence;
+            ++received;
+        }
+    }
+
+    pthread_join (thread, NULL);
+
+    unsigned long dropped = DS_SocketDroppedPackets (socket);
+    printf ("  sent %d, received %d, dropped %lu\n", sent, received, dropped);
+
+    TEST_ASSERT (in_order);
+    TEST_ASSERT (received > 0);
+    TEST_ASSERT (received + (int) dropped <= sent);
+
+    close_socket (socket);
+}
+
+/**
+ * Runs the sockets module tests
+ */
+void Test_Sockets()
+{
+    Timers_Init();
+    Sockets_Init();
+
+    RUN_TEST (test_ring_overflow);
+    RUN_TEST (test_burst_stress);
+
+    Sockets_Close();
+    Timers_Close();
+}
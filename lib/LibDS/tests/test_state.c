@@ -0,0 +1,255 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tests.h"
+#include "LibDS.h"
+#include "DS_Config.h"
+
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define UPDATES 20000
+
+static atomic_int writer_done;
+
+/**
+ * Drains the event queue, the tests below only care about the snapshots
+ */
+static void drain_events()
+{
+    DS_Event event;
+    while (DS_PollEvent (&event));
+}
+
+/**
+ * The snapshot must reflect the setters once the state is published
+ */
+static void test_snapshot()
+{
+    DS_StateSnapshot snapshot;
+
+    CFG_SetTeamNumber (3794);
+    CFG_SetRobotCode (1);
+    CFG_SetRobotCommunications (1);
+    CFG_SetRobotVoltage (12.5);
+    CFG_SetAlliance (DS_ALLIANCE_BLUE);
+    CFG_SetPosition (DS_POSITION_3);
+    CFG_SetControlMode (DS_CONTROL_AUTONOMOUS);
+    CFG_PublishState();
+    drain_events();
+
+    uint32_t version = DS_GetStateSnapshot (&snapshot);
+    TEST_ASSERT (version == snapshot.version);
+    TEST_ASSERT (version == DS_GetStateVersion());
+    TEST_ASSERT (snapshot.team == 3794);
+    TEST_ASSERT (snapshot.robot_code == 1);
+    TEST_ASSERT (snapshot.robot_communications == 1);
+    TEST_ASSERT (snapshot.can_be_enabled == DS_GetCanBeEnabled());
+    TEST_ASSERT (snapshot.voltage == DS_GetRobotVoltage());
+    TEST_ASSERT (snapshot.alliance == DS_ALLIANCE_BLUE);
+    TEST_ASSERT (snapshot.position == DS_POSITION_3);
+    TEST_ASSERT (snapshot.control_mode == DS_CONTROL_AUTONOMOUS);
+}
+
+/**
+ * The version must only change when the state changes
+ */
+static void test_version()
+{
+    uint32_t version = DS_GetStateVersion();
+
+    /* Nothing changed, nothing is published */
+    CFG_PublishState();
+    TEST_ASSERT (DS_GetStateVersion() == version);
+
+    /* Setting the same value again is not a change */
+    CFG_SetTeamNumber (DS_GetTeamNumber());
+    CFG_PublishState();
+    TEST_ASSERT (DS_GetStateVersion() == version);
+
+    /* Unpublished changes are not visible */
+    CFG_SetRobotCPUUsage (DS_GetRobotCPUUsage() == 42 ? 24 : 42);
+    TEST_ASSERT (DS_GetStateVersion() == version);
+
+    /* Several changes are published as a single version */
+    CFG_SetRobotRAMUsage (DS_GetRobotRAMUsage() == 42 ? 24 : 42);
+    CFG_PublishState();
+    TEST_ASSERT (DS_GetStateVersion() == version + 1);
+    drain_events();
+}
+
+/**
+ * Publishes snapshots where the CPU and RAM usages are always equal
+ */
+static void* writer (void* data)
+{
+    (void) data;
+
+    int i;
+    for (i = 0; i < UPDATES; ++i) {
+        CFG_SetRobotCPUUsage (i % 100);
+        CFG_SetRobotRAMUsage (i % 100);
+        CFG_PublishState();
+    }
+
+    atomic_store (&writer_done, 1);
+    return NULL;
+}
+
+/**
+ * Readers must never observe a snapshot that is being written, even if the
+ * writer publishes new versions all the time
+ */
+static void test_concurrent()
+{
+    pthread_t thread;
+    DS_StateSnapshot snapshot;
+    uint32_t last = DS_GetStateVersion();
+
+    CFG_SetRobotCPUUsage (0);
+    CFG_SetRobotRAMUsage (0);
+    CFG_PublishState();
+
+    atomic_store (&writer_done, 0);
+    pthread_create (&thread, NULL, &writer, NULL);
+
+    int consistent = 1;
+    int monotonic = 1;
+    while (!atomic_load (&writer_done)) {
+        uint32_t version = DS_GetStateSnapshot (&snapshot);
+        consistent &= snapshot.cpu_usage == snapshot.ram_usage;
+        monotonic &= version >= last && version == snapshot.version;
+        last = version;
+    }
+
+    pthread_join (thread, NULL);
+    drain_events();
+
+    TEST_ASSERT (consistent);
+    TEST_ASSERT (monotonic);
+    TEST_ASSERT (DS_GetStateSnapshot (&snapshot) == DS_GetStateVersion());
+    TEST_ASSERT (snapshot.cpu_usage == (UPDATES - 1) % 100);
+}
+
+/**
+ * The status string must only get a new version when the string changes,
+ * and the returned strings must remain valid
+ */
+static void test_status()
+{
+    uint32_t version;
+
+    CFG_SetRobotCommunications (0);
+    const char* status = DS_GetStatusText (&version);
+    TEST_ASSERT (strcmp (status, "No Robot Communications") == 0);
+    TEST_ASSERT (version == DS_GetStatusVersion());
+
+    /* Changes that do not affect the status string */
+    CFG_SetRobotCPUUsage (DS_GetRobotCPUUsage() == 42 ? 24 : 42);
+    CFG_SetRobotCode (!DS_GetRobotCode());
+    TEST_ASSERT (DS_GetStatusVersion() == version);
+
+    CFG_SetRobotCode (1);
+    CFG_SetEmergencyStopped (0);
+    CFG_SetControlMode (DS_CONTROL_TEST);
+    CFG_SetRobotCommunications (1);
+    TEST_ASSERT (DS_GetStatusVersion() == version + 1);
+    TEST_ASSERT (strcmp (DS_GetStatusText (NULL), "Test Disabled") == 0);
+
+    CFG_SetControlMode (DS_CONTROL_AUTONOMOUS);
+    TEST_ASSERT (DS_GetStatusVersion() == version + 2);
+    TEST_ASSERT (strcmp (DS_GetStatusText (NULL), "Autonomous Disabled") == 0);
+
+    CFG_SetEmergencyStopped (1);
+    TEST_ASSERT (strcmp (DS_GetStatusText (NULL), "Emergency Stopped") == 0);
+
+    /* The old string is still valid */
+    TEST_ASSERT (strcmp (status, "No Robot Communications") == 0);
+
+    /* The allocating getter returns the same string */
+    bstring copy = DS_GetStatusString();
+    TEST_ASSERT (biseqcstr (copy, DS_GetStatusText (NULL)));
+    DS_FREESTR (copy);
+
+    CFG_SetEmergencyStopped (0);
+    CFG_SetRobotCommunications (0);
+    drain_events();
+}
+
+/**
+ * Without a context (before DS_Init() or after DS_Close()), the client
+ * functions must return the default values instead of crashing
+ */
+static void test_no_context()
+{
+    DS_Event event;
+    DS_StateSnapshot snapshot;
+
+    TEST_ASSERT (DS_CurrentContext() == NULL);
+
+    DS_SetTeamNumber (3794);
+    DS_SetRobotEnabled (1);
+    DS_SetCustomRobotAddress ("10.37.94.2");
+    DS_JoysticksAdd (6, 1, 12);
+
+    TEST_ASSERT (DS_GetTeamNumber() == 0);
+    TEST_ASSERT (DS_GetRobotEnabled() == -1);
+    TEST_ASSERT (DS_GetRobotVoltage() == -1);
+    TEST_ASSERT (DS_GetCanBeEnabled() == 0);
+    TEST_ASSERT (DS_GetAlliance() == DS_ALLIANCE_RED);
+    TEST_ASSERT (DS_GetPosition() == DS_POSITION_1);
+    TEST_ASSERT (DS_GetControlMode() == DS_CONTROL_TELEOPERATED);
+    TEST_ASSERT (DS_GetStateSnapshot (&snapshot) == 0);
+    TEST_ASSERT (DS_GetStateVersion() == 0);
+    TEST_ASSERT (DS_GetStatusVersion() == 0);
+    TEST_ASSERT (DS_GetMaximumBatteryVoltage() == 0);
+    TEST_ASSERT (DS_GetJoystickCount() == 0);
+    TEST_ASSERT (DS_PollEvent (&event) == 0);
+    TEST_ASSERT (DS_WaitEvent (&event, -1) == 0);
+
+    bstring address = DS_GetCustomRobotAddress();
+    TEST_ASSERT (DS_StringIsEmpty (address));
+    DS_FREESTR (address);
+}
+
+/**
+ * Runs the state snapshot tests
+ */
+void Test_State()
+{
+    Timers_Init();
+    Sockets_Init();
+    Contexts_Init();
+
+    RUN_TEST (test_snapshot);
+    RUN_TEST (test_version);
+    RUN_TEST (test_concurrent);
+    RUN_TEST (test_status);
+
+    Contexts_Close();
+    RUN_TEST (test_no_context);
+
+    Sockets_Close();
+    Timers_Close();
+}
@@ -0,0 +1,63 @@
+/*
+ * The Driver Station Library (LibDS)
+ * Copyright (C) 2015-2016 Alex Spataru <alex_spataru@outlook>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LIB_DS_TESTS_H
+#define _LIB_DS_TESTS_H
+
+#include <stdio.h>
+
+/**
+ * Fails the current test (and returns from it) if \a condition is false
+ */
+#define TEST_ASSERT(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf (stderr, "%s:%d: assertion failed: %s\n", \
+                     __FILE__, __LINE__, #condition); \
+            Tests_Fail(); \
+            return; \
+        } \
+    } while (0)
+
+/**
+ * Runs the given test function and reports its result
+ */
+#define RUN_TEST(test) Tests_Run (#test, &test)
+
+extern void Tests_Fail();
+extern void Tests_Run (const char* name, void (*test)());
+
+extern void Test_Sockets();
+extern void Test_Discovery();
+extern void Test_Latency();
+extern void Test_Loss();
+extern void Test_Contexts();
+extern void Test_Allocations();
+extern void Test_Joysticks();
+extern void Test_CRC32();
+extern void Test_Capture();
+extern void Test_Events();
+extern void Test_NetConsole();
+extern void Test_State();
+
+#endif
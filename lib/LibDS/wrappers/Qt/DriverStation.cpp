@@ -30,8 +30,10 @@
 #include <QDebug>
 #include <QHostAddress>
 #include <QApplication>
+#include <QSocketNotifier>
 
 #define LOG qDebug() << "DS Client:"
+#define EVENT_BATCH 64 /* Number of LibDS events read at once */
 
 static QString bstr_to_qstring (bstring string)
 {
@@ -46,6 +48,12 @@ static QString bstr_to_qstring (bstring string)
     return str;
 }
 
+/**
+ * Creates the instance of this class, the LibDS is initialized later with
+ * \c start()
+ */
+DriverStation::DriverStation() : m_eventNotifier (NULL), m_statusVersion (0) {}
+
 /**
  * Thar shall be only one tavern that manages
  * th' Driver Station interface
@@ -91,33 +99,73 @@ int DriverStation::diskUsage() const
 }
 
 /**
- * Returns the packet loss percentage between the FMS and the client
+ * Returns the packet loss percentage between the FMS and the client over the
+ * last few seconds (calculated from the FMS packet sequence numbers)
  */
 int DriverStation::fmsPacketLoss() const
 {
-    return (qreal) (DS_ReceivedFMSPackets() / DS_SentFMSPackets()) * 100;
+    if (!connectedToFMS())
+        return 100;
+
+    return qRound (DS_GetDownlinkLoss (DS_CHANNEL_FMS).loss);
 }
 
 /**
- * Returns the packet loss percentage between the radio and the client
+ * Returns the packet loss percentage between the radio and the client.
+ * The radio does not number its packets, so only total loss is detected.
  */
 int DriverStation::radioPacketLoss() const
 {
-    return (qreal) (DS_ReceivedRadioPackets() / DS_SentRadioPackets()) * 100;
+    if (!connectedToRadio())
+        return 100;
+
+    return qRound (DS_GetDownlinkLoss (DS_CHANNEL_RADIO).loss);
 }
 
 /**
- * Returns the packet loss percentage between the robot and the client
+ * Returns the packet loss percentage between the robot and the client over
+ * the last few seconds (calculated from the packet indexes echoed by the
+ * robot)
  */
 int DriverStation::robotPacketLoss() const
 {
-    qreal sent = (qreal) DS_SentRobotPackets();
-    qreal recv = (qreal) DS_ReceivedRobotPackets();
+    if (!connectedToRobot())
+        return 100;
+
+    return qRound (DS_GetUplinkLoss (DS_CHANNEL_ROBOT).loss);
+}
+
+/**
+ * Returns the minimum round-trip time to the robot (in milliseconds)
+ */
+qreal DriverStation::robotMinLatency() const
+{
+    return DS_GetLatencyStats (DS_CHANNEL_ROBOT).min;
+}
+
+/**
+ * Returns the mean round-trip time to the robot (in milliseconds)
+ */
+qreal DriverStation::robotMeanLatency() const
+{
+    return DS_GetLatencyStats (DS_CHANNEL_ROBOT).mean;
+}
 
-    if (sent > 0)
-        return (1 - (recv / sent)) * 100;
+/**
+ * Returns the median round-trip time to the robot (in milliseconds)
+ */
+qreal DriverStation::robotMedianLatency() const
+{
+    return DS_GetLatencyStats (DS_CHANNEL_ROBOT).p50;
+}
 
-    return 100;
+/**
+ * Returns the 99th percentile of the round-trip time to the robot
+ * (in milliseconds)
+ */
+qreal DriverStation::robot99thLatency() const
+{
+    return DS_GetLatencyStats (DS_CHANNEL_ROBOT).p99;
 }
 
 /**
@@ -494,7 +542,16 @@ QString DriverStation::elapsedTime()
  */
 QString DriverStation::generalStatus() const
 {
-    return bstr_to_qstring (DS_GetStatusString());
+    uint32_t version;
+    const char* status = DS_GetStatusText (&version);
+
+    /* Only convert the string when the LibDS changes it */
+    if (m_status.isNull() || version != m_statusVersion) {
+        m_status = QString::fromLatin1 (status);
+        m_statusVersion = version;
+    }
+
+    return m_status;
 }
 
 /**
@@ -594,8 +651,20 @@ void DriverStation::start()
 {
     if (!DS_Initialized()) {
         DS_Init();
+        DS_SetEventConflation (1);
+
+        /* Process the LibDS events as soon as they are added */
+        int fd = DS_GetEventFd();
+        if (fd >= 0) {
+            m_eventNotifier = new QSocketNotifier (fd, QSocketNotifier::Read,
+                                                   this);
+            connect (m_eventNotifier, SIGNAL (activated (int)),
+                     this,              SLOT (processEvents()));
+        }
+
         processEvents();
         updateElapsedTime();
+        updateRobotLatency();
         emit statusChanged (generalStatus());
         connect (qApp, SIGNAL (aboutToQuit()), this, SLOT (quitDS()));
     }
@@ -672,7 +741,7 @@ void DriverStation::loadProtocol (DS_Protocol* protocol)
         DS_ConfigureProtocol (protocol);
 
         emit protocolChanged();
-        emit statusChanged (bstr_to_qstring (DS_GetStatusString()));
+        emit statusChanged (generalStatus());
 
         setCustomFMSAddress (customFMSAddress());
         setCustomRadioAddress (customRadioAddress());
@@ -939,76 +1008,115 @@ void DriverStation::quitDS()
 {
     if (DS_Initialized()) {
         LOG << "Stopping DS Engine...";
+
+        /* The event descriptor is closed with the DS */
+        if (m_eventNotifier) {
+            m_eventNotifier->setEnabled (false);
+            m_eventNotifier->deleteLater();
+            m_eventNotifier = NULL;
+        }
+
         DS_Close();
         LOG << "DS Engine Stopped";
     }
 }
 
+/**
+ * Reads the NetConsole message with the given \a handle from the LibDS
+ * buffer and emits it (if it was not overwritten yet)
+ */
+void DriverStation::emitMessage (const quint64 handle)
+{
+    DS_NetConsoleMessage message;
+    if (DS_GetNetConsoleMessage (handle, &message)) {
+        QString text = QString::fromUtf8 (message.data, message.length);
+        DS_ReleaseNetConsoleMessage();
+        emit newMessage (text);
+    }
+}
+
 /**
  * Polls for new LibDS events and emits Qt signals as appropiate.
- * This function is called every 5 milliseconds.
+ * This function is called when the LibDS event descriptor becomes readable,
+ * or every 5 milliseconds on platforms without an event descriptor.
  */
 void DriverStation::processEvents()
 {
-    DS_Event event;
-    while (DS_PollEvent (&event)) {
-        switch (event.type) {
-        case DS_FMS_COMMS_CHANGED:
-            emit fmsAddressChanged();
-            emit fmsCommunicationsChanged (event.fms.connected);
-            break;
-        case DS_RADIO_COMMS_CHANGED:
-            emit radioAddressChanged();
-            emit radioCommunicationsChanged (event.radio.connected);
-            break;
-        case DS_NETCONSOLE_NEW_MESSAGE:
-            emit newMessage (bstr_to_qstring (event.netconsole.message));
-            break;
-        case DS_ROBOT_ENABLED_CHANGED:
-            emit enabledChanged (event.robot.enabled);
-            break;
-        case DS_ROBOT_MODE_CHANGED:
-            emit controlModeChanged (controlMode());
-            break;
-        case DS_ROBOT_COMMS_CHANGED:
-            emit robotAddressChanged();
-            emit robotCommunicationsChanged (event.robot.connected);
-            break;
-        case DS_ROBOT_CODE_CHANGED:
-            emit robotCodeChanged (event.robot.code);
-            break;
-        case DS_ROBOT_VOLTAGE_CHANGED:
-            emit voltageChanged (event.robot.voltage);
-            break;
-        case DS_ROBOT_CAN_UTIL_CHANGED:
-            emit canUsageChanged (event.robot.can_util);
-            break;
-        case DS_ROBOT_CPU_INFO_CHANGED:
-            emit cpuUsageChanged (event.robot.cpu_usage);
-            break;
-        case DS_ROBOT_RAM_INFO_CHANGED:
-            emit ramUsageChanged (event.robot.ram_usage);
-            break;
-        case DS_ROBOT_DISK_INFO_CHANGED:
-            emit diskUsageChanged (event.robot.disk_usage);
-            break;
-        case DS_ROBOT_STATION_CHANGED:
-            emit stationChanged();
-            emit allianceChanged (teamAlliance());
-            emit positionChanged (teamPosition());
-            break;
-        case DS_ROBOT_ESTOP_CHANGED:
-            emit emergencyStoppedChanged (event.robot.estopped);
-            break;
-        case DS_STATUS_STRING_CHANGED:
-            emit statusChanged (bstr_to_qstring (DS_GetStatusString()));
-            break;
-        default:
-            break;
+    if (!DS_Initialized())
+        return;
+
+    int count;
+    bool status = false;
+    DS_Event events [EVENT_BATCH];
+
+    do {
+        count = DS_PollEvents (events, EVENT_BATCH);
+
+        for (int i = 0; i < count; ++i) {
+            const DS_Event& event = events [i];
+            switch (event.type) {
+            case DS_FMS_COMMS_CHANGED:
+                emit fmsAddressChanged();
+                emit fmsCommunicationsChanged (event.fms.connected);
+                break;
+            case DS_RADIO_COMMS_CHANGED:
+                emit radioAddressChanged();
+                emit radioCommunicationsChanged (event.radio.connected);
+                break;
+            case DS_NETCONSOLE_NEW_MESSAGE:
+                emitMessage (event.netconsole.handle);
+                break;
+            case DS_ROBOT_ENABLED_CHANGED:
+                emit enabledChanged (event.robot.enabled);
+                break;
+            case DS_ROBOT_MODE_CHANGED:
+                emit controlModeChanged (controlMode());
+                break;
+            case DS_ROBOT_COMMS_CHANGED:
+                emit robotAddressChanged();
+                emit robotCommunicationsChanged (event.robot.connected);
+                break;
+            case DS_ROBOT_CODE_CHANGED:
+                emit robotCodeChanged (event.robot.code);
+                break;
+            case DS_ROBOT_VOLTAGE_CHANGED:
+                emit voltageChanged (event.robot.voltage);
+                break;
+            case DS_ROBOT_CAN_UTIL_CHANGED:
+                emit canUsageChanged (event.robot.can_util);
+                break;
+            case DS_ROBOT_CPU_INFO_CHANGED:
+                emit cpuUsageChanged (event.robot.cpu_usage);
+                break;
+            case DS_ROBOT_RAM_INFO_CHANGED:
+                emit ramUsageChanged (event.robot.ram_usage);
+                break;
+            case DS_ROBOT_DISK_INFO_CHANGED:
+                emit diskUsageChanged (event.robot.disk_usage);
+                break;
+            case DS_ROBOT_STATION_CHANGED:
+                emit stationChanged();
+                emit allianceChanged (teamAlliance());
+                emit positionChanged (teamPosition());
+                break;
+            case DS_ROBOT_ESTOP_CHANGED:
+                emit emergencyStoppedChanged (event.robot.estopped);
+                break;
+            case DS_STATUS_STRING_CHANGED:
+                status = true;
+                break;
+            default:
+                break;
+            }
         }
-    }
+    } while (count == EVENT_BATCH);
+
+    /* The status string is read once for all the status events */
+    if (status)
+        emit statusChanged (generalStatus());
 
-    QTimer::singleShot (5, Qt::CoarseTimer, this, SLOT (processEvents()));
+    if (!m_eventNotifier)
+        QTimer::singleShot (5, Qt::CoarseTimer, this, SLOT (processEvents()));
 }
 
 /**
@@ -1047,6 +1155,17 @@ void DriverStation::updateElapsedTime()
                         this, SLOT (updateElapsedTime()));
 }
 
+/**
+ * Notifies the UI that the robot latency statistics have been updated,
+ * this is done twice per second to avoid flooding the UI with updates
+ */
+void DriverStation::updateRobotLatency()
+{
+    emit robotLatencyChanged();
+    QTimer::singleShot (500, Qt::CoarseTimer,
+                        this, SLOT (updateRobotLatency()));
+}
+
 /**
  * Returns a valid network \a address
  */
@@ -32,6 +32,8 @@
 #include <QStringList>
 #include <DS_Protocol.h>
 
+class QSocketNotifier;
+
 class DriverStation : public QObject
 {
     Q_OBJECT
@@ -150,6 +152,18 @@ class DriverStation : public QObject
                 READ radioPacketLoss)
     Q_PROPERTY (int robotPacketLoss
                 READ robotPacketLoss)
+    Q_PROPERTY (qreal robotMinLatency
+                READ robotMinLatency
+                NOTIFY robotLatencyChanged)
+    Q_PROPERTY (qreal robotMeanLatency
+                READ robotMeanLatency
+                NOTIFY robotLatencyChanged)
+    Q_PROPERTY (qreal robotMedianLatency
+                READ robotMedianLatency
+                NOTIFY robotLatencyChanged)
+    Q_PROPERTY (qreal robot99thLatency
+                READ robot99thLatency
+                NOTIFY robotLatencyChanged)
     Q_PROPERTY (bool isTestMode
                 READ isTestMode
                 NOTIFY controlModeChanged)
@@ -223,6 +237,11 @@ public:
     int radioPacketLoss() const;
     int robotPacketLoss() const;
 
+    qreal robotMinLatency() const;
+    qreal robotMeanLatency() const;
+    qreal robotMedianLatency() const;
+    qreal robot99thLatency() const;
+
     bool isEnabled() const;
     bool isTestMode() const;
     bool canBeEnabled() const;
@@ -293,8 +312,11 @@ private slots:
     void processEvents();
     void resetElapsedTime();
     void updateElapsedTime();
+    void updateRobotLatency();
 
 private:
+    DriverStation();
+    void emitMessage (const quint64 handle);
     QString getAddress (const QString& address);
 
 signals:
@@ -304,6 +326,7 @@ signals:
     void radioAddressChanged();
     void robotAddressChanged();
     void joystickCountChanged();
+    void robotLatencyChanged();
     void canUsageChanged (const int usage);
     void cpuUsageChanged (const int usage);
     void ramUsageChanged (const int usage);
@@ -326,6 +349,10 @@ signals:
 private:
     QTime m_time;
     QString m_elapsedTime;
+    QSocketNotifier* m_eventNotifier;
+
+    mutable QString m_status;
+    mutable quint32 m_statusVersion;
 };
 
 #endif
@@ -141,6 +141,22 @@ RowLayout {
             Label {
                 text: DS.connectedToRobot ? DS.canUsage+ " %" : Globals.invalidStr
             }
+
+            Label {
+                text: qsTr ("Latency (p50)")
+            }
+
+            Label {
+                text: DS.connectedToRobot ? DS.robotMedianLatency.toFixed (1) + " ms" : Globals.invalidStr
+            }
+
+            Label {
+                text: qsTr ("Latency (p99)")
+            }
+
+            Label {
+                text: DS.connectedToRobot ? DS.robot99thLatency.toFixed (1) + " ms" : Globals.invalidStr
+            }
         }
     }
 